@@ -0,0 +1,182 @@
+package statestore
+
+import (
+	"encoding/binary"
+	"encoding/json"
+	"fmt"
+	"math"
+)
+
+// Object logs start with a version byte. Logs written in JSON start with '{',
+// so they are still decoded after switching to the binary encoding.
+const (
+	logEncodingBinaryV1 byte = 0x01
+	logEncodingJSON     byte = '{'
+)
+
+func encodeObjectLog(l *ObjectLogEntry) []byte {
+	if FLAGS_JsonLogEncoding {
+		encoded, err := json.Marshal(l)
+		if err != nil {
+			panic(err)
+		}
+		return encoded
+	}
+	e := &logEncoder{buf: make([]byte, 0, 64)}
+	e.buf = append(e.buf, logEncodingBinaryV1)
+	e.uvarint(uint64(l.LogType))
+	e.uvarint(l.TxnId)
+	e.uvarint(uint64(len(l.Ops)))
+	for _, op := range l.Ops {
+		e.uvarint(uint64(op.OpType))
+		e.str(op.ObjName)
+		e.str(op.Path)
+		e.value(&op.Value)
+		e.varint(int64(op.IntParam))
+	}
+	return e.buf
+}
+
+func decodeObjectLog(data []byte) (*ObjectLogEntry, error) {
+	if len(data) == 0 {
+		return nil, fmt.Errorf("Empty object log")
+	}
+	objectLog := &ObjectLogEntry{}
+	switch data[0] {
+	case logEncodingJSON:
+		if err := json.Unmarshal(data, objectLog); err != nil {
+			return nil, err
+		}
+		return objectLog, nil
+	case logEncodingBinaryV1:
+		d := &logDecoder{buf: data[1:]}
+		objectLog.LogType = int(d.uvarint())
+		objectLog.TxnId = d.uvarint()
+		numOps := d.uvarint()
+		if numOps > uint64(len(d.buf)) {
+			return nil, fmt.Errorf("Corrupted object log: %d ops", numOps)
+		}
+		if numOps > 0 {
+			objectLog.Ops = make([]*WriteOp, numOps)
+			for i := range objectLog.Ops {
+				op := &WriteOp{}
+				op.OpType = int(d.uvarint())
+				op.ObjName = d.str()
+				op.Path = d.str()
+				op.Value = d.value()
+				op.IntParam = int(d.varint())
+				objectLog.Ops[i] = op
+			}
+		}
+		if d.err != nil {
+			return nil, d.err
+		}
+		if len(d.buf) > 0 {
+			return nil, fmt.Errorf("Corrupted object log: %d trailing bytes", len(d.buf))
+		}
+		return objectLog, nil
+	default:
+		return nil, fmt.Errorf("Unknown object log encoding %#02x", data[0])
+	}
+}
+
+type logEncoder struct {
+	buf []byte
+	tmp [binary.MaxVarintLen64]byte
+}
+
+func (e *logEncoder) uvarint(v uint64) {
+	n := binary.PutUvarint(e.tmp[:], v)
+	e.buf = append(e.buf, e.tmp[:n]...)
+}
+
+func (e *logEncoder) varint(v int64) {
+	n := binary.PutVarint(e.tmp[:], v)
+	e.buf = append(e.buf, e.tmp[:n]...)
+}
+
+func (e *logEncoder) str(s string) {
+	e.uvarint(uint64(len(s)))
+	e.buf = append(e.buf, s...)
+}
+
+func (e *logEncoder) value(v *Value) {
+	e.uvarint(uint64(v.ValueType))
+	switch v.ValueType {
+	case VALUE_Number:
+		binary.LittleEndian.PutUint64(e.tmp[:8], math.Float64bits(v.NumberValue))
+		e.buf = append(e.buf, e.tmp[:8]...)
+	case VALUE_String:
+		e.str(v.StringValue)
+	case VALUE_Bool:
+		if v.BoolValue {
+			e.buf = append(e.buf, 1)
+		} else {
+			e.buf = append(e.buf, 0)
+		}
+	}
+}
+
+// Errors are sticky, decoded fields are zero after the first error
+type logDecoder struct {
+	buf []byte
+	err error
+}
+
+func (d *logDecoder) fail() {
+	if d.err == nil {
+		d.err = fmt.Errorf("Corrupted object log")
+	}
+	d.buf = nil
+}
+
+func (d *logDecoder) uvarint() uint64 {
+	v, n := binary.Uvarint(d.buf)
+	if n <= 0 {
+		d.fail()
+		return 0
+	}
+	d.buf = d.buf[n:]
+	return v
+}
+
+func (d *logDecoder) varint() int64 {
+	v, n := binary.Varint(d.buf)
+	if n <= 0 {
+		d.fail()
+		return 0
+	}
+	d.buf = d.buf[n:]
+	return v
+}
+
+func (d *logDecoder) bytes(n uint64) []byte {
+	if n > uint64(len(d.buf)) {
+		d.fail()
+		return nil
+	}
+	b := d.buf[:n]
+	d.buf = d.buf[n:]
+	return b
+}
+
+func (d *logDecoder) str() string {
+	return string(d.bytes(d.uvarint()))
+}
+
+func (d *logDecoder) value() Value {
+	v := Value{ValueType: int(d.uvarint())}
+	switch v.ValueType {
+	case VALUE_Number:
+		if b := d.bytes(8); b != nil {
+			v.NumberValue = math.Float64frombits(binary.LittleEndian.Uint64(b))
+		}
+	case VALUE_String:
+		v.StringValue = d.str()
+	case VALUE_Bool:
+		if b := d.bytes(1); b != nil {
+			v.BoolValue = b[0] != 0
+		}
+	}
+	return v
+}
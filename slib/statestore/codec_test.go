@@ -0,0 +1,176 @@
+package statestore
+
+import (
+	"fmt"
+	"testing"
+
+	"cs.utexas.edu/zjia/faas/slib/common"
+
+	gabs "github.com/Jeffail/gabs/v2"
+)
+
+const benchNumLogs = 256
+
+// Builds op logs of a counter object, in the shape applications write them:
+// one field set, one counter bumped and one bounded history appended per log.
+func syntheticObjectLogs(numLogs int) []*ObjectLogEntry {
+	logs := make([]*ObjectLogEntry, numLogs)
+	for i := 0; i < numLogs; i++ {
+		logs[i] = &ObjectLogEntry{
+			LogType: LOG_NormalOp,
+			TxnId:   uint64(i),
+			Ops: []*WriteOp{
+				{
+					OpType:  OP_Set,
+					ObjName: "bench",
+					Path:    fmt.Sprintf("fields.f%d", i%16),
+					Value:   StringValue(fmt.Sprintf("value-%d", i)),
+				},
+				{
+					OpType:  OP_NumberFetchAdd,
+					ObjName: "bench",
+					Path:    "counter",
+					Value:   NumberValue(1),
+				},
+				{
+					OpType:   OP_ArrayPushBackWithLimit,
+					ObjName:  "bench",
+					Path:     "history",
+					Value:    NumberValue(float64(i)),
+					IntParam: 32,
+				},
+			},
+		}
+	}
+	return logs
+}
+
+func newBenchObjectView() *ObjectView {
+	contents := gabs.New()
+	contents.Object("fields")
+	contents.Set(float64(0), "counter")
+	contents.Array("history")
+	return &ObjectView{
+		name:       "bench",
+		nextSeqNum: 0,
+		contents:   contents,
+	}
+}
+
+func withLogEncoding(json bool, f func()) {
+	saved := FLAGS_JsonLogEncoding
+	FLAGS_JsonLogEncoding = json
+	defer func() { FLAGS_JsonLogEncoding = saved }()
+	f()
+}
+
+var logEncodings = []struct {
+	name string
+	json bool
+}{
+	{"JSON", true},
+	{"Binary", false},
+}
+
+func TestDecodeObjectLog(t *testing.T) {
+	logs := syntheticObjectLogs(4)
+	for _, encoding := range logEncodings {
+		withLogEncoding(encoding.json, func() {
+			for _, l := range logs {
+				data := encodeObjectLog(l)
+				decoded, err := decodeObjectLog(data)
+				if err != nil {
+					t.Fatalf("%s: failed to decode: %v", encoding.name, err)
+				}
+				if decoded.LogType != l.LogType || decoded.TxnId != l.TxnId || len(decoded.Ops) != len(l.Ops) {
+					t.Fatalf("%s: decoded log differs", encoding.name)
+				}
+				for i, op := range decoded.Ops {
+					expected := l.Ops[i]
+					if op.OpType != expected.OpType || op.ObjName != expected.ObjName || op.Path != expected.Path ||
+						op.Value.String() != expected.Value.String() || op.IntParam != expected.IntParam {
+						t.Fatalf("%s: op %d differs: %+v", encoding.name, i, *op)
+					}
+				}
+				if _, err := decodeObjectLog(data[:len(data)-1]); err == nil {
+					t.Fatalf("%s: truncated log is accepted", encoding.name)
+				}
+				if _, err := decodeObjectLog(append(data, 0)); err == nil {
+					t.Fatalf("%s: log with trailing bytes is accepted", encoding.name)
+				}
+			}
+		})
+	}
+}
+
+func BenchmarkEncodeObjectLog(b *testing.B) {
+	logs := syntheticObjectLogs(benchNumLogs)
+	for _, encoding := range logEncodings {
+		b.Run(encoding.name, func(b *testing.B) {
+			withLogEncoding(encoding.json, func() {
+				b.ReportAllocs()
+				for i := 0; i < b.N; i++ {
+					encodeLogEntry(logs[i%len(logs)])
+				}
+			})
+		})
+	}
+}
+
+// Decodes and applies a log suffix to an object view, as syncToForward does
+func BenchmarkSyncObjectView(b *testing.B) {
+	logs := syntheticObjectLogs(benchNumLogs)
+	for _, encoding := range logEncodings {
+		b.Run(encoding.name, func(b *testing.B) {
+			withLogEncoding(encoding.json, func() {
+				encoded := make([][]byte, len(logs))
+				for i, l := range logs {
+					encoded[i] = encodeLogEntry(l)
+				}
+				b.ReportAllocs()
+				b.ResetTimer()
+				for i := 0; i < b.N; i++ {
+					view := newBenchObjectView()
+					for _, data := range encoded {
+						decompressed, err := common.DecompressData(data)
+						if err != nil {
+							b.Fatal(err)
+						}
+						objectLog, err := decodeObjectLog(decompressed)
+						if err != nil {
+							b.Fatal(err)
+						}
+						for _, op := range objectLog.Ops {
+							view.applyWriteOp(op)
+						}
+					}
+				}
+			})
+		})
+	}
+}
+
+func BenchmarkApplyWriteOp(b *testing.B) {
+	logs := syntheticObjectLogs(benchNumLogs)
+	view := newBenchObjectView()
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		for _, op := range logs[i%len(logs)].Ops {
+			view.applyWriteOp(op)
+		}
+	}
+}
+
+func BenchmarkCloneObjectView(b *testing.B) {
+	view := newBenchObjectView()
+	for _, l := range syntheticObjectLogs(benchNumLogs) {
+		for _, op := range l.Ops {
+			view.applyWriteOp(op)
+		}
+	}
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		view.Clone()
+	}
+}
@@ -10,6 +10,8 @@ type Env interface {
 	Object(name string) *ObjectRef
 	TxnCommit() (bool /* committed */, error)
 	TxnAbort() error
+	// Sync views of given objects concurrently, before reading them
+	Prefetch(objNames ...string) error
 }
 
 type envImpl struct {
@@ -17,13 +19,16 @@ type envImpl struct {
 	faasEnv types.Environment
 	objs    map[string]*ObjectRef
 	txnCtx  *txnContext
+	// Only set for transactions
+	readCache *logReadCache
 }
 
 func CreateEnv(ctx context.Context, faasEnv types.Environment) Env {
 	return &envImpl{
-		faasCtx: ctx,
-		faasEnv: faasEnv,
-		objs:    make(map[string]*ObjectRef),
-		txnCtx:  nil,
+		faasCtx:   ctx,
+		faasEnv:   faasEnv,
+		objs:      make(map[string]*ObjectRef),
+		txnCtx:    nil,
+		readCache: nil,
 	}
 }
@@ -6,6 +6,7 @@ import (
 	"fmt"
 	"log"
 	"os"
+	"sync"
 
 	"cs.utexas.edu/zjia/faas/slib/common"
 
@@ -18,6 +19,8 @@ import (
 
 var FLAGS_DisableAuxData bool = false
 var FLAGS_RedisForAuxData bool = false
+var FLAGS_DisableCheckConflict bool = false
+var FLAGS_JsonLogEncoding bool = false
 
 var redisClient *redis.Client
 
@@ -26,6 +29,14 @@ func init() {
 		FLAGS_DisableAuxData = true
 		log.Printf("[INFO] AuxData disabled")
 	}
+	if val, exists := os.LookupEnv("DISABLE_CHECK_CONFLICT"); exists && val == "1" {
+		FLAGS_DisableCheckConflict = true
+		log.Printf("[INFO] Engine-side conflict check disabled")
+	}
+	if val, exists := os.LookupEnv("JSON_LOG_ENCODING"); exists && val == "1" {
+		FLAGS_JsonLogEncoding = true
+		log.Printf("[INFO] Encode object logs in JSON")
+	}
 	if val, exists := os.LookupEnv("AUXDATA_REDIS_URL"); exists {
 		FLAGS_RedisForAuxData = true
 		log.Printf("[INFO] Use Redis for AuxData")
@@ -72,13 +83,16 @@ func (l *ObjectLogEntry) fillWriteSet() {
 	}
 }
 
+func encodeLogEntry(objectLog *ObjectLogEntry) []byte {
+	return common.CompressData(encodeObjectLog(objectLog))
+}
+
 func decodeLogEntry(logEntry *types.LogEntry) *ObjectLogEntry {
-	reader, err := common.DecompressReader(logEntry.Data)
+	data, err := common.DecompressData(logEntry.Data)
 	if err != nil {
 		panic(err)
 	}
-	objectLog := &ObjectLogEntry{}
-	err = json.NewDecoder(reader).Decode(objectLog)
+	objectLog, err := decodeObjectLog(data)
 	if err != nil {
 		panic(err)
 	}
@@ -144,54 +158,155 @@ func (txnCommitLog *ObjectLogEntry) checkTxnCommitResult(env *envImpl) (bool, er
 	} else {
 		txnCommitLog.auxData = make(map[string]interface{})
 	}
+	if env.readCache != nil {
+		if committed, exists := env.readCache.getCommitResult(txnCommitLog.seqNum); exists {
+			txnCommitLog.auxData["r"] = committed
+			return committed, nil
+		}
+	}
 	// log.Printf("[DEBUG] Failed to load txn status: seqNum=%#016x", txnCommitLog.seqNum)
-	commitResult := true
+	tags := make([]uint64, 0, len(txnCommitLog.Ops))
 	checkedTag := make(map[uint64]bool)
 	for _, op := range txnCommitLog.Ops {
 		tag := objectLogTag(common.NameHash(op.ObjName))
-		if _, exists := checkedTag[tag]; exists {
-			continue
+		if _, exists := checkedTag[tag]; !exists {
+			tags = append(tags, tag)
+			checkedTag[tag] = true
 		}
-		seqNum := txnCommitLog.seqNum
-		for seqNum > txnCommitLog.TxnId {
-			logEntry, err := env.faasEnv.SharedLogReadPrev(env.faasCtx, tag, seqNum-1)
-			if err != nil {
-				return false, newRuntimeError(err.Error())
-			}
-			if logEntry == nil || logEntry.SeqNum <= txnCommitLog.TxnId {
-				break
-			}
-			seqNum = logEntry.SeqNum
-			// log.Printf("[DEBUG] Read log with seqnum %#016x", seqNum)
-
-			objectLog := decodeLogEntry(logEntry)
-			if !txnCommitLog.writeSetOverlapped(objectLog) {
-				continue
-			}
-			if objectLog.LogType == LOG_NormalOp {
-				commitResult = false
-				break
-			} else if objectLog.LogType == LOG_TxnCommit {
-				if committed, err := objectLog.checkTxnCommitResult(env); err != nil {
-					return false, err
-				} else if committed {
-					commitResult = false
-					break
-				}
-			}
+	}
+	commitResult, complete := true, false
+	var err error
+	if !FLAGS_DisableCheckConflict {
+		commitResult, complete, err = txnCommitLog.checkConflictsByEngine(env, tags)
+		if err != nil {
+			return false, err
 		}
-		if !commitResult {
-			break
+	}
+	if !complete {
+		commitResult, err = txnCommitLog.checkConflictsByReadPrev(env, tags)
+		if err != nil {
+			return false, err
 		}
-		checkedTag[tag] = true
 	}
 	txnCommitLog.auxData["r"] = commitResult
+	if env.readCache != nil {
+		env.readCache.putCommitResult(txnCommitLog.seqNum, commitResult)
+	}
 	if !FLAGS_DisableAuxData {
 		env.setLogAuxData(txnCommitLog.seqNum, txnCommitLog.auxData)
 	}
 	return commitResult, nil
 }
 
+// Asks the engine for conflicting logs within (TxnId, seqNum) in one round trip,
+// and reads them concurrently with at most FLAGS_MaxOutstandingLogReads workers
+func (txnCommitLog *ObjectLogEntry) checkConflictsByEngine(env *envImpl, tags []uint64) (bool /* committed */, bool /* complete */, error) {
+	seqNums, complete, err := env.faasEnv.SharedLogCheckConflict(env.faasCtx, tags, txnCommitLog.TxnId+1, txnCommitLog.seqNum)
+	if err != nil || !complete {
+		return false, false, err
+	}
+	objectLogs := make([]*ObjectLogEntry, len(seqNums))
+	errs := make([]error, len(seqNums))
+	indices := make(chan int, len(seqNums))
+	for i := range seqNums {
+		indices <- i
+	}
+	close(indices)
+	numWorkers := len(seqNums)
+	if numWorkers > FLAGS_MaxOutstandingLogReads {
+		numWorkers = FLAGS_MaxOutstandingLogReads
+	}
+	var wg sync.WaitGroup
+	for w := 0; w < numWorkers; w++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for i := range indices {
+				seqNum := seqNums[i]
+				logEntry, err := env.sharedLogReadNext(0 /* tag */, seqNum)
+				if err != nil {
+					errs[i] = err
+				} else if logEntry == nil || logEntry.SeqNum != seqNum {
+					errs[i] = fmt.Errorf("Failed to read log at seqnum %#016x", seqNum)
+				} else {
+					objectLogs[i] = decodeLogEntry(logEntry)
+				}
+			}
+		}()
+	}
+	wg.Wait()
+	for _, err := range errs {
+		if err != nil {
+			return false, false, newRuntimeError(err.Error())
+		}
+	}
+	// Normal ops decide without recursion, so check them first
+	for _, objectLog := range objectLogs {
+		if objectLog.LogType == LOG_NormalOp && txnCommitLog.writeSetOverlapped(objectLog) {
+			return false, true, nil
+		}
+	}
+	for _, objectLog := range objectLogs {
+		if objectLog.LogType == LOG_TxnCommit && txnCommitLog.writeSetOverlapped(objectLog) {
+			if committed, err := objectLog.checkTxnCommitResult(env); err != nil {
+				return false, false, err
+			} else if committed {
+				return false, true, nil
+			}
+		}
+	}
+	return true, true, nil
+}
+
+// Walks back logs of each tag within (TxnId, seqNum), with tags walked concurrently
+func (txnCommitLog *ObjectLogEntry) checkConflictsByReadPrev(env *envImpl, tags []uint64) (bool /* committed */, error) {
+	conflicts := make([]bool, len(tags))
+	errs := runConcurrently(len(tags), func(i int) error {
+		conflict, err := txnCommitLog.hasConflictOnTag(env, tags[i])
+		conflicts[i] = conflict
+		return err
+	})
+	for i := range tags {
+		if errs[i] != nil {
+			return false, errs[i]
+		}
+		if conflicts[i] {
+			return false, nil
+		}
+	}
+	return true, nil
+}
+
+func (txnCommitLog *ObjectLogEntry) hasConflictOnTag(env *envImpl, tag uint64) (bool, error) {
+	seqNum := txnCommitLog.seqNum
+	for seqNum > txnCommitLog.TxnId {
+		logEntry, err := env.sharedLogReadPrev(tag, seqNum-1)
+		if err != nil {
+			return false, newRuntimeError(err.Error())
+		}
+		if logEntry == nil || logEntry.SeqNum <= txnCommitLog.TxnId {
+			break
+		}
+		seqNum = logEntry.SeqNum
+		// log.Printf("[DEBUG] Read log with seqnum %#016x", seqNum)
+
+		objectLog := decodeLogEntry(logEntry)
+		if !txnCommitLog.writeSetOverlapped(objectLog) {
+			continue
+		}
+		if objectLog.LogType == LOG_NormalOp {
+			return true, nil
+		} else if objectLog.LogType == LOG_TxnCommit {
+			if committed, err := objectLog.checkTxnCommitResult(env); err != nil {
+				return false, err
+			} else if committed {
+				return true, nil
+			}
+		}
+	}
+	return false, nil
+}
+
 func (l *ObjectLogEntry) hasCachedObjectView(objName string) bool {
 	if l.auxData == nil {
 		return false
@@ -267,7 +382,7 @@ func (obj *ObjectRef) syncToForward(tailSeqNum uint64) error {
 		log.Fatalf("[FATAL] Current seqNum=%#016x, cannot sync to %#016x", seqNum, tailSeqNum)
 	}
 	for seqNum < tailSeqNum {
-		logEntry, err := env.faasEnv.SharedLogReadNext(env.faasCtx, tag, seqNum)
+		logEntry, err := env.sharedLogReadNext(tag, seqNum)
 		if err != nil {
 			return newRuntimeError(err.Error())
 		}
@@ -320,7 +435,7 @@ func (obj *ObjectRef) syncToBackward(tailSeqNum uint64) error {
 		if seqNum != protocol.MaxLogSeqnum {
 			seqNum -= 1
 		}
-		logEntry, err := env.faasEnv.SharedLogReadPrev(env.faasCtx, tag, seqNum)
+		logEntry, err := env.sharedLogReadPrev(tag, seqNum)
 		if err != nil {
 			return newRuntimeError(err.Error())
 		}
@@ -385,12 +500,8 @@ func (obj *ObjectRef) appendNormalOpLog(ops []*WriteOp) (uint64 /* seqNum */, er
 		LogType: LOG_NormalOp,
 		Ops:     ops,
 	}
-	encoded, err := json.Marshal(logEntry)
-	if err != nil {
-		panic(err)
-	}
 	tags := []uint64{objectLogTag(obj.nameHash)}
-	seqNum, err := obj.env.faasEnv.SharedLogAppend(obj.env.faasCtx, tags, common.CompressData(encoded))
+	seqNum, err := obj.env.faasEnv.SharedLogAppend(obj.env.faasCtx, tags, encodeLogEntry(logEntry))
 	if err != nil {
 		return 0, newRuntimeError(err.Error())
 	} else {
@@ -404,12 +515,8 @@ func (obj *ObjectRef) appendWriteLog(op *WriteOp) (uint64 /* seqNum */, error) {
 
 func (env *envImpl) appendTxnBeginLog() (uint64 /* seqNum */, error) {
 	logEntry := &ObjectLogEntry{LogType: LOG_TxnBegin}
-	encoded, err := json.Marshal(logEntry)
-	if err != nil {
-		panic(err)
-	}
 	tags := []uint64{common.TxnMetaLogTag}
-	seqNum, err := env.faasEnv.SharedLogAppend(env.faasCtx, tags, common.CompressData(encoded))
+	seqNum, err := env.faasEnv.SharedLogAppend(env.faasCtx, tags, encodeLogEntry(logEntry))
 	if err != nil {
 		return 0, newRuntimeError(err.Error())
 	} else {
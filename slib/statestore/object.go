@@ -53,16 +53,23 @@ func (objView *ObjectView) Clone() *ObjectView {
 
 func (obj *ObjectRef) ensureView() error {
 	if obj.view == nil {
-		tailSeqNum := protocol.MaxLogSeqnum
 		if obj.txnCtx != nil {
-			tailSeqNum = obj.txnCtx.id
+			return obj.env.loadTxnViews(obj)
 		}
-		return obj.syncTo(tailSeqNum)
+		return obj.loadView()
 	} else {
 		return nil
 	}
 }
 
+func (obj *ObjectRef) loadView() error {
+	tailSeqNum := protocol.MaxLogSeqnum
+	if obj.txnCtx != nil {
+		tailSeqNum = obj.txnCtx.id
+	}
+	return obj.syncTo(tailSeqNum)
+}
+
 func (obj *ObjectRef) Sync() error {
 	if obj.txnCtx != nil {
 		panic("Cannot Sync() objects within a transaction context")
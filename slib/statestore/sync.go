@@ -0,0 +1,167 @@
+package statestore
+
+import (
+	"log"
+	"os"
+	"strconv"
+	"sync"
+
+	"cs.utexas.edu/zjia/faas/protocol"
+	"cs.utexas.edu/zjia/faas/types"
+)
+
+var FLAGS_MaxOutstandingLogReads int = 16
+
+// Bounds shared log reads in flight from this worker, across all envs
+var logReadSlots chan struct{}
+
+func init() {
+	if val, exists := os.LookupEnv("MAX_OUTSTANDING_LOG_READS"); exists {
+		if n, err := strconv.Atoi(val); err == nil && n > 0 {
+			FLAGS_MaxOutstandingLogReads = n
+		} else {
+			log.Fatalf("[FATAL] Invalid MAX_OUTSTANDING_LOG_READS: %s", val)
+		}
+	}
+	logReadSlots = make(chan struct{}, FLAGS_MaxOutstandingLogReads)
+}
+
+type logReadKey struct {
+	tag    uint64
+	seqNum uint64
+}
+
+type logReadResult struct {
+	done     chan struct{}
+	logEntry *types.LogEntry
+	err      error
+}
+
+// Per-transaction cache of ReadPrev results and txn commit results. Logs
+// below seqnums already assigned never change, so results stay valid
+// within a transaction. Concurrent reads of the same key are issued once.
+type logReadCache struct {
+	mu            sync.Mutex
+	reads         map[logReadKey]*logReadResult
+	commitResults map[uint64]bool
+}
+
+func newLogReadCache() *logReadCache {
+	return &logReadCache{
+		reads:         make(map[logReadKey]*logReadResult),
+		commitResults: make(map[uint64]bool),
+	}
+}
+
+func (c *logReadCache) getCommitResult(seqNum uint64) (bool, bool /* exists */) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	committed, exists := c.commitResults[seqNum]
+	return committed, exists
+}
+
+func (c *logReadCache) putCommitResult(seqNum uint64, committed bool) {
+	c.mu.Lock()
+	c.commitResults[seqNum] = committed
+	c.mu.Unlock()
+}
+
+func acquireLogReadSlot() {
+	logReadSlots <- struct{}{}
+}
+
+func releaseLogReadSlot() {
+	<-logReadSlots
+}
+
+func (env *envImpl) sharedLogReadPrev(tag uint64, seqNum uint64) (*types.LogEntry, error) {
+	if env.readCache == nil || seqNum == protocol.MaxLogSeqnum {
+		acquireLogReadSlot()
+		defer releaseLogReadSlot()
+		return env.faasEnv.SharedLogReadPrev(env.faasCtx, tag, seqNum)
+	}
+	key := logReadKey{tag: tag, seqNum: seqNum}
+	c := env.readCache
+	c.mu.Lock()
+	if result, exists := c.reads[key]; exists {
+		c.mu.Unlock()
+		<-result.done
+		return result.logEntry, result.err
+	}
+	result := &logReadResult{done: make(chan struct{})}
+	c.reads[key] = result
+	c.mu.Unlock()
+
+	acquireLogReadSlot()
+	result.logEntry, result.err = env.faasEnv.SharedLogReadPrev(env.faasCtx, tag, seqNum)
+	releaseLogReadSlot()
+	if result.err != nil {
+		c.mu.Lock()
+		delete(c.reads, key)
+		c.mu.Unlock()
+	}
+	close(result.done)
+	return result.logEntry, result.err
+}
+
+func (env *envImpl) sharedLogReadNext(tag uint64, seqNum uint64) (*types.LogEntry, error) {
+	acquireLogReadSlot()
+	defer releaseLogReadSlot()
+	return env.faasEnv.SharedLogReadNext(env.faasCtx, tag, seqNum)
+}
+
+// Runs fn(0..n-1) on separate goroutines, and returns errors by index
+func runConcurrently(n int, fn func(i int) error) []error {
+	errs := make([]error, n)
+	if n == 1 {
+		errs[0] = fn(0)
+		return errs
+	}
+	var wg sync.WaitGroup
+	for i := 0; i < n; i++ {
+		wg.Add(1)
+		go func(i int) {
+			defer wg.Done()
+			errs[i] = fn(i)
+		}(i)
+	}
+	wg.Wait()
+	return errs
+}
+
+// Backward walks of different objects run concurrently, while log reads
+// are bounded by logReadSlots
+func loadViews(objs []*ObjectRef) []error {
+	return runConcurrently(len(objs), func(i int) error {
+		return objs[i].loadView()
+	})
+}
+
+// Objects of a txn are usually all read, so the first read of a txn object
+// loads views of other objects created within the txn along with it.
+// Failed loads of other objects are left for their own reads to retry.
+func (env *envImpl) loadTxnViews(obj *ObjectRef) error {
+	objs := []*ObjectRef{obj}
+	for _, other := range env.objs {
+		if other != obj && other.view == nil && other.txnCtx == obj.txnCtx {
+			objs = append(objs, other)
+		}
+	}
+	return loadViews(objs)[0]
+}
+
+// Implement Env
+func (env *envImpl) Prefetch(objNames ...string) error {
+	objs := make([]*ObjectRef, 0, len(objNames))
+	for _, name := range objNames {
+		if obj := env.Object(name); obj.view == nil {
+			objs = append(objs, obj)
+		}
+	}
+	for _, err := range loadViews(objs) {
+		if err != nil {
+			return err
+		}
+	}
+	return nil
+}
@@ -0,0 +1,189 @@
+package statestore
+
+import (
+	"context"
+	"fmt"
+	"sort"
+	"sync"
+	"testing"
+	"time"
+
+	"cs.utexas.edu/zjia/faas/protocol"
+	"cs.utexas.edu/zjia/faas/types"
+)
+
+// In-memory shared log, where every read takes readLatency as a round trip
+// to the engine does
+type fakeEnvironment struct {
+	mu          sync.Mutex
+	logs        []*types.LogEntry
+	tagIndex    map[uint64][]uint64 // tag -> seqnums
+	readLatency time.Duration
+}
+
+// Seqnum 0 is taken by an untagged log, as seqnums of the engine never start from 0
+func newFakeEnvironment(readLatency time.Duration) *fakeEnvironment {
+	return &fakeEnvironment{
+		logs:        []*types.LogEntry{{SeqNum: 0}},
+		tagIndex:    make(map[uint64][]uint64),
+		readLatency: readLatency,
+	}
+}
+
+func (env *fakeEnvironment) InvokeFunc(ctx context.Context, funcName string, input []byte) ([]byte, error) {
+	panic("Not implemented")
+}
+
+func (env *fakeEnvironment) InvokeFuncAsync(ctx context.Context, funcName string, input []byte) error {
+	panic("Not implemented")
+}
+
+func (env *fakeEnvironment) GrpcCall(ctx context.Context, service string, method string, request []byte) ([]byte, error) {
+	panic("Not implemented")
+}
+
+func (env *fakeEnvironment) GenerateUniqueID() uint64 {
+	panic("Not implemented")
+}
+
+func (env *fakeEnvironment) SharedLogAppend(ctx context.Context, tags []uint64, data []byte) (uint64, error) {
+	env.mu.Lock()
+	defer env.mu.Unlock()
+	seqNum := uint64(len(env.logs))
+	env.logs = append(env.logs, &types.LogEntry{SeqNum: seqNum, Tags: tags, Data: data})
+	for _, tag := range tags {
+		env.tagIndex[tag] = append(env.tagIndex[tag], seqNum)
+	}
+	return seqNum, nil
+}
+
+// Returns a copy, as aux data of logs may be set concurrently
+func (env *fakeEnvironment) readLocked(seqNum uint64) *types.LogEntry {
+	logEntry := *env.logs[seqNum]
+	return &logEntry
+}
+
+func (env *fakeEnvironment) SharedLogReadNext(ctx context.Context, tag uint64, seqNum uint64) (*types.LogEntry, error) {
+	time.Sleep(env.readLatency)
+	env.mu.Lock()
+	defer env.mu.Unlock()
+	if tag == 0 {
+		if seqNum >= uint64(len(env.logs)) {
+			return nil, nil
+		}
+		return env.readLocked(seqNum), nil
+	}
+	seqNums := env.tagIndex[tag]
+	idx := sort.Search(len(seqNums), func(i int) bool { return seqNums[i] >= seqNum })
+	if idx == len(seqNums) {
+		return nil, nil
+	}
+	return env.readLocked(seqNums[idx]), nil
+}
+
+func (env *fakeEnvironment) SharedLogReadNextBlock(ctx context.Context, tag uint64, seqNum uint64) (*types.LogEntry, error) {
+	return env.SharedLogReadNext(ctx, tag, seqNum)
+}
+
+func (env *fakeEnvironment) SharedLogReadPrev(ctx context.Context, tag uint64, seqNum uint64) (*types.LogEntry, error) {
+	time.Sleep(env.readLatency)
+	env.mu.Lock()
+	defer env.mu.Unlock()
+	if tag == 0 {
+		if seqNum >= uint64(len(env.logs)) {
+			seqNum = uint64(len(env.logs) - 1)
+		}
+		return env.readLocked(seqNum), nil
+	}
+	seqNums := env.tagIndex[tag]
+	idx := sort.Search(len(seqNums), func(i int) bool { return seqNums[i] > seqNum })
+	if idx == 0 {
+		return nil, nil
+	}
+	return env.readLocked(seqNums[idx-1]), nil
+}
+
+func (env *fakeEnvironment) SharedLogCheckTail(ctx context.Context, tag uint64) (*types.LogEntry, error) {
+	return env.SharedLogReadPrev(ctx, tag, protocol.MaxLogSeqnum)
+}
+
+func (env *fakeEnvironment) SharedLogSetAuxData(ctx context.Context, seqNum uint64, auxData []byte) error {
+	env.mu.Lock()
+	defer env.mu.Unlock()
+	env.logs[seqNum].AuxData = auxData
+	return nil
+}
+
+func (env *fakeEnvironment) SharedLogConditionalAppend(ctx context.Context, tags []uint64, data []byte, condTag uint64, condPos uint32) (uint64, error) {
+	panic("Not implemented")
+}
+
+func (env *fakeEnvironment) SharedLogOverwrite(ctx context.Context, tag uint64, pos uint32, data []byte) error {
+	panic("Not implemented")
+}
+
+// Fake engines cannot answer, so commits check conflicts with ReadPrev
+func (env *fakeEnvironment) SharedLogCheckConflict(ctx context.Context, tags []uint64, fromSeqNum uint64, toSeqNum uint64) ([]uint64, bool, error) {
+	return nil, false, nil
+}
+
+const benchLogReadLatency = 100 * time.Microsecond
+
+// Reports latency of txns reading and updating 1..32 objects, each with a
+// few logs appended since its view was last cached, with log reads issued
+// one at a time and with the default bound on outstanding reads
+func BenchmarkTxnLatency(b *testing.B) {
+	ctx := context.Background()
+	savedSlots := logReadSlots
+	defer func() { logReadSlots = savedSlots }()
+	for _, numObjs := range []int{1, 2, 4, 8, 16, 32} {
+		for _, maxReads := range []int{1, FLAGS_MaxOutstandingLogReads} {
+			name := fmt.Sprintf("Objects=%d/MaxOutstandingReads=%d", numObjs, maxReads)
+			b.Run(name, func(b *testing.B) {
+				logReadSlots = make(chan struct{}, maxReads)
+				faasEnv := newFakeEnvironment(benchLogReadLatency)
+				objNames := make([]string, numObjs)
+				for i := range objNames {
+					objNames[i] = fmt.Sprintf("obj%d", i)
+				}
+				appendObjectWrites := func() {
+					env := CreateEnv(ctx, faasEnv)
+					for _, name := range objNames {
+						for j := 0; j < 4; j++ {
+							if result := env.Object(name).NumberFetchAdd("counter", 1); result.Err != nil {
+								b.Fatal(result.Err)
+							}
+						}
+					}
+				}
+				appendObjectWrites()
+				b.ResetTimer()
+				for i := 0; i < b.N; i++ {
+					b.StopTimer()
+					appendObjectWrites()
+					b.StartTimer()
+					env, err := CreateTxnEnv(ctx, faasEnv)
+					if err != nil {
+						b.Fatal(err)
+					}
+					objs := make([]*ObjectRef, numObjs)
+					for j, name := range objNames {
+						objs[j] = env.Object(name)
+					}
+					for _, obj := range objs {
+						value, err := obj.Get("counter")
+						if err != nil {
+							b.Fatal(err)
+						}
+						obj.SetNumber("counter", value.AsNumber()+1)
+					}
+					if committed, err := env.TxnCommit(); err != nil {
+						b.Fatal(err)
+					} else if !committed {
+						b.Fatal("Txn without concurrent writers is aborted")
+					}
+				}
+			})
+		}
+	}
+}
@@ -2,7 +2,6 @@ package statestore
 
 import (
 	"context"
-	"encoding/json"
 
 	"cs.utexas.edu/zjia/faas/slib/common"
 
@@ -18,6 +17,7 @@ type txnContext struct {
 
 func CreateTxnEnv(ctx context.Context, faasEnv types.Environment) (Env, error) {
 	env := CreateEnv(ctx, faasEnv).(*envImpl)
+	env.readCache = newLogReadCache()
 	if seqNum, err := env.appendTxnBeginLog(); err == nil {
 		env.txnCtx = &txnContext{
 			active:   true,
@@ -33,6 +33,7 @@ func CreateTxnEnv(ctx context.Context, faasEnv types.Environment) (Env, error) {
 
 func CreateReadOnlyTxnEnv(ctx context.Context, faasEnv types.Environment) (Env, error) {
 	env := CreateEnv(ctx, faasEnv).(*envImpl)
+	env.readCache = newLogReadCache()
 	if tail, err := faasEnv.SharedLogCheckTail(ctx, 0 /* tag */); err == nil {
 		seqNum := uint64(0)
 		if tail != nil {
@@ -60,16 +61,12 @@ func (env *envImpl) TxnAbort() error {
 	ctx := env.txnCtx
 	env.txnCtx = nil
 	ctx.active = false
-	logEntry := ObjectLogEntry{
+	logEntry := &ObjectLogEntry{
 		LogType: LOG_TxnAbort,
 		TxnId:   ctx.id,
 	}
-	encoded, err := json.Marshal(logEntry)
-	if err != nil {
-		panic(err)
-	}
 	tags := []uint64{common.TxnMetaLogTag, txnHistoryLogTag(ctx.id)}
-	if _, err := env.faasEnv.SharedLogAppend(env.faasCtx, tags, common.CompressData(encoded)); err == nil {
+	if _, err := env.faasEnv.SharedLogAppend(env.faasCtx, tags, encodeLogEntry(logEntry)); err == nil {
 		return nil
 	} else {
 		return newRuntimeError(err.Error())
@@ -92,15 +89,11 @@ func (env *envImpl) TxnCommit() (bool /* committed */, error) {
 		Ops:     ctx.ops,
 		TxnId:   ctx.id,
 	}
-	encoded, err := json.Marshal(objectLog)
-	if err != nil {
-		panic(err)
-	}
 	tags := []uint64{common.TxnMetaLogTag, txnHistoryLogTag(ctx.id)}
 	for _, op := range ctx.ops {
 		tags = append(tags, objectLogTag(common.NameHash(op.ObjName)))
 	}
-	seqNum, err := env.faasEnv.SharedLogAppend(env.faasCtx, tags, common.CompressData(encoded))
+	seqNum, err := env.faasEnv.SharedLogAppend(env.faasCtx, tags, encodeLogEntry(objectLog))
 	if err != nil {
 		return false, newRuntimeError(err.Error())
 	}
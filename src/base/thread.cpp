@@ -70,18 +70,7 @@ void Thread::MarkThreadCategory(std::string_view category) {
     std::string cpuset_var_name(fmt::format("FAAS_{}_THREAD_CPUSET", category));
     std::string cpuset_str(utils::GetEnvVariable(cpuset_var_name));
     if (!cpuset_str.empty()) {
-        cpu_set_t set;
-        CPU_ZERO(&set);
-        for (const std::string_view& cpu_str : absl::StrSplit(cpuset_str, ",")) {
-            int cpu;
-            CHECK(absl::SimpleAtoi(cpu_str, &cpu));
-            CPU_SET(cpu, &set);
-        }
-        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
-            PLOG_F(FATAL, "Failed to set CPU affinity to {}", cpuset_str);
-        } else {
-            LOG_F(INFO, "Successfully set CPU affinity of current thread to {}", cpuset_str);
-        }
+        SetCurrentThreadAffinity(ParseCpuList(cpuset_str));
     } else {
         LOG_F(INFO, "Does not find cpuset setting for {} threads (can be set by {})",
               category, cpuset_var_name);
@@ -106,6 +95,31 @@ void Thread::MarkThreadCategory(std::string_view category) {
     }
 }
 
+std::vector<int> Thread::ParseCpuList(std::string_view cpus_str) {
+    std::vector<int> cpus;
+    for (const std::string_view& cpu_str : absl::StrSplit(cpus_str, ",", absl::SkipEmpty())) {
+        int cpu;
+        CHECK(absl::SimpleAtoi(cpu_str, &cpu)) << "Invalid CPU: " << cpu_str;
+        cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+void Thread::SetCurrentThreadAffinity(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::string cpus_str;
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+        absl::StrAppend(&cpus_str, cpus_str.empty() ? "" : ",", cpu);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        PLOG_F(FATAL, "Failed to set CPU affinity to {}", cpus_str);
+    } else {
+        LOG_F(INFO, "Successfully set CPU affinity of current thread to {}", cpus_str);
+    }
+}
+
 void* Thread::StartRoutine(void* arg) {
     Thread* self = reinterpret_cast<Thread*>(arg);
     current_ = self;
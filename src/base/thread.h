@@ -22,6 +22,10 @@ public:
 
     void MarkThreadCategory(std::string_view category);
 
+    // Parses a comma-separated list of CPUs, such as "0,2,4"
+    static std::vector<int> ParseCpuList(std::string_view cpus_str);
+    static void SetCurrentThreadAffinity(const std::vector<int>& cpus);
+
     const char* name() const { return name_.c_str(); }
     int tid() const { return tid_; }
 
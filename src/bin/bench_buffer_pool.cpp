@@ -0,0 +1,136 @@
+#include "base/init.h"
+#include "base/common.h"
+#include "common/time.h"
+#include "utils/bench.h"
+#include "utils/buffer_pool.h"
+
+ABSL_FLAG(size_t, buffer_size, 65536, "Size of buffers");
+ABSL_FLAG(size_t, burst_size, 256, "Number of buffers taken before returned in each loop");
+ABSL_FLAG(size_t, num_loops, 20000, "Number of Get/Return bursts measured");
+
+// Checks watermarks of BufferPool, and measures Get/Return against the
+// previous unbounded free list.
+
+using namespace faas;
+
+// BufferPool before watermarks
+class UnboundedBufferPool {
+public:
+    explicit UnboundedBufferPool(size_t buffer_size) : buffer_size_(buffer_size) {}
+    ~UnboundedBufferPool() {}
+
+    void Get(char** buf, size_t* size) {
+        if (available_buffers_.empty()) {
+            std::unique_ptr<char[]> new_buffer(new char[buffer_size_]);
+            available_buffers_.push_back(new_buffer.get());
+            all_buffers_.push_back(std::move(new_buffer));
+        }
+        *buf = available_buffers_.back();
+        available_buffers_.pop_back();
+        *size = buffer_size_;
+    }
+
+    void Return(char* buf) {
+        available_buffers_.push_back(buf);
+    }
+
+private:
+    size_t buffer_size_;
+    absl::InlinedVector<char*, 16> available_buffers_;
+    absl::InlinedVector<std::unique_ptr<char[]>, 16> all_buffers_;
+
+    DISALLOW_COPY_AND_ASSIGN(UnboundedBufferPool);
+};
+
+static void CheckWatermarks() {
+    constexpr size_t kBufferSize = 4096;
+    utils::BufferPool pool("Watermark", kBufferSize);
+    pool.set_watermarks(/* low_bytes= */ 8 * kBufferSize, /* high_bytes= */ 32 * kBufferSize);
+
+    std::vector<char*> bufs(64);
+    size_t size;
+    for (char*& buf : bufs) {
+        pool.Get(&buf, &size);
+    }
+    CHECK_EQ(pool.total_buffers(), 64U);
+    CHECK_EQ(pool.in_use_bytes(), int64_t{64 * kBufferSize});
+    CHECK_EQ(pool.peak_in_use_bytes(), int64_t{64 * kBufferSize});
+    CHECK_EQ(pool.Trim(), 0U) << "Buffers in use are trimmed";
+
+    // At the high watermark, nothing is trimmed
+    for (size_t i = 0; i < 32; i++) {
+        pool.Return(bufs[i]);
+    }
+    CHECK_EQ(pool.Trim(), 0U);
+    CHECK_EQ(pool.free_buffers(), 32U);
+
+    // Above the high watermark, trimmed down to the low watermark
+    pool.Return(bufs[32]);
+    CHECK_EQ(pool.Trim(), 25U);
+    CHECK_EQ(pool.free_buffers(), 8U);
+    CHECK_EQ(pool.total_buffers(), 39U);
+    CHECK_EQ(pool.allocated_bytes(), 39 * kBufferSize);
+    CHECK_EQ(pool.in_use_bytes(), int64_t{31 * kBufferSize});
+    CHECK_EQ(pool.peak_in_use_bytes(), int64_t{64 * kBufferSize});
+
+    // Most recently returned buffers are kept
+    char* buf;
+    pool.Get(&buf, &size);
+    CHECK_EQ(buf, bufs[32]);
+    pool.Return(buf);
+
+    for (size_t i = 33; i < bufs.size(); i++) {
+        pool.Return(bufs[i]);
+    }
+    CHECK_EQ(pool.Trim(), 31U);
+    CHECK_EQ(pool.total_buffers(), 8U);
+    CHECK_EQ(pool.in_use_bytes(), 0);
+    CHECK_EQ(pool.peak_in_use_bytes(), int64_t{64 * kBufferSize});
+    pool.set_watermarks(0, 0);
+    CHECK_EQ(pool.Trim(), 0U) << "Trimming is not disabled";
+    LOG(INFO) << "Watermark checks passed";
+}
+
+template<class T>
+static void RunGetReturn(std::string_view name, T* pool) {
+    size_t burst_size = absl::GetFlag(FLAGS_burst_size);
+    size_t num_loops = absl::GetFlag(FLAGS_num_loops);
+    std::vector<char*> bufs(burst_size);
+    size_t size;
+    // Warm up, so that no allocation is measured
+    for (char*& buf : bufs) {
+        pool->Get(&buf, &size);
+    }
+    for (char* buf : bufs) {
+        pool->Return(buf);
+    }
+    bench_utils::Samples<int32_t> burst_ns(num_loops);
+    bench_utils::BenchLoop bench_loop(num_loops, [&] () -> bool {
+        int64_t start_timestamp = GetMonotonicNanoTimestamp();
+        for (char*& buf : bufs) {
+            pool->Get(&buf, &size);
+        }
+        for (char* buf : bufs) {
+            pool->Return(buf);
+        }
+        burst_ns.Add(gsl::narrow_cast<int32_t>(GetMonotonicNanoTimestamp() - start_timestamp));
+        return true;
+    });
+    double per_op_ns = absl::ToDoubleNanoseconds(bench_loop.elapsed_time())
+                     / static_cast<double>(bench_loop.loop_count() * burst_size);
+    LOG_F(INFO, "{}: {:.2f} ns per Get/Return", name, per_op_ns);
+    burst_ns.ReportStatistics(fmt::format("{}: burst of {} Get/Return (ns)", name, burst_size));
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    CheckWatermarks();
+
+    size_t buffer_size = absl::GetFlag(FLAGS_buffer_size);
+    UnboundedBufferPool unbounded_pool(buffer_size);
+    RunGetReturn("Unbounded", &unbounded_pool);
+    utils::BufferPool pool("Bench", buffer_size);
+    RunGetReturn("Watermarks", &pool);
+    CHECK_EQ(pool.total_buffers(), absl::GetFlag(FLAGS_burst_size));
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include "base/init.h"
+#include "base/common.h"
+#include "common/time.h"
+#include "log/flags.h"
+#include "log/utils.h"
+
+ABSL_FLAG(int, idle_ms, 200, "Length of the phase without appends");
+ABSL_FLAG(int, trickle_ms, 200, "Length of the phase with sparse appends");
+ABSL_FLAG(int, trickle_gap_us, 5000, "Gap between shard progress records when sparse");
+ABSL_FLAG(int, burst_ms, 100, "Length of the phase with bursty appends");
+ABSL_FLAG(int, burst_gap_us, 5, "Gap between shard progress records in bursts");
+
+// Drives log_utils::CutScheduler the way SequencerBase does, against a fake
+// MetaLogPrimary, through idle, sparse and bursty phases. Checks that the
+// adaptive scheduler backs off while idle, cuts early in bursts, and keeps
+// the delay of pending progress bounded, also after a skipped early cut.
+// Reports cut attempts and delays of both the fixed and the adaptive scheduler.
+
+using namespace faas;
+
+using log_utils::CutScheduler;
+
+// Counts new logs instead of tracking shard progress and metalogs
+class FakeMetaLogPrimary {
+public:
+    FakeMetaLogPrimary() : num_cuts_(0), num_attempts_(0) {}
+    ~FakeMetaLogPrimary() {}
+
+    size_t num_cuts() const { return num_cuts_; }
+    size_t num_attempts() const { return num_attempts_; }
+
+    void UpdateStorageProgress(int64_t timestamp) {
+        pending_timestamps_.push_back(timestamp);
+    }
+
+    // Returns the number of new logs in the cut, and the oldest delay of them
+    uint32_t MarkNextCut(int64_t now, int64_t* max_delay_us) {
+        num_attempts_++;
+        if (pending_timestamps_.empty()) {
+            return 0;
+        }
+        num_cuts_++;
+        *max_delay_us = std::max(*max_delay_us, now - pending_timestamps_.front());
+        uint32_t num_new_logs = gsl::narrow_cast<uint32_t>(pending_timestamps_.size());
+        pending_timestamps_.clear();
+        return num_new_logs;
+    }
+
+private:
+    std::vector<int64_t> pending_timestamps_;
+    size_t num_cuts_;
+    size_t num_attempts_;
+
+    DISALLOW_COPY_AND_ASSIGN(FakeMetaLogPrimary);
+};
+
+struct PhaseResult {
+    size_t  num_attempts;
+    size_t  num_cuts;
+    size_t  num_early_cuts;
+    int64_t max_delay_us;
+};
+
+// Mirrors SequencerBase::OnCutTimerTick and the SHARD_PROG handler
+static PhaseResult RunPhase(CutScheduler* scheduler, FakeMetaLogPrimary* primary,
+                            int64_t duration_us, int64_t record_gap_us) {
+    int64_t timer_interval_us = absl::GetFlag(FLAGS_slog_global_cut_interval_us);
+    size_t num_attempts = primary->num_attempts();
+    size_t num_cuts = primary->num_cuts();
+    PhaseResult result = {.num_attempts = 0, .num_cuts = 0,
+                          .num_early_cuts = 0, .max_delay_us = 0};
+    auto mark_cut = [&] (int64_t now) {
+        scheduler->OnCutMarked(primary->MarkNextCut(now, &result.max_delay_us));
+    };
+    int64_t start = GetMonotonicMicroTimestamp();
+    int64_t next_tick = start + timer_interval_us;
+    int64_t next_record = record_gap_us > 0 ? start : std::numeric_limits<int64_t>::max();
+    while (true) {
+        int64_t now = GetMonotonicMicroTimestamp();
+        if (now - start >= duration_us) {
+            break;
+        }
+        if (now >= next_record) {
+            primary->UpdateStorageProgress(now);
+            if (scheduler->OnShardProgress(/* payload_size= */ 64)) {
+                result.num_early_cuts++;
+                mark_cut(now);
+            }
+            next_record += record_gap_us;
+        }
+        if (now >= next_tick) {
+            if (scheduler->ShouldMarkCut()) {
+                mark_cut(now);
+            }
+            next_tick += timer_interval_us;
+        }
+        int64_t sleep_us = std::min(next_tick, next_record) - GetMonotonicMicroTimestamp();
+        if (sleep_us > 0) {
+            absl::SleepFor(absl::Microseconds(sleep_us));
+        }
+    }
+    result.num_attempts = primary->num_attempts() - num_attempts;
+    result.num_cuts = primary->num_cuts() - num_cuts;
+    return result;
+}
+
+static std::vector<PhaseResult> RunScheduler(bool adaptive) {
+    absl::SetFlag(&FLAGS_slog_global_cut_adaptive, adaptive);
+    CutScheduler scheduler;
+    FakeMetaLogPrimary primary;
+    std::vector<PhaseResult> results;
+    results.push_back(RunPhase(&scheduler, &primary,
+                               int64_t{absl::GetFlag(FLAGS_idle_ms)} * 1000, 0));
+    results.push_back(RunPhase(&scheduler, &primary,
+                               int64_t{absl::GetFlag(FLAGS_trickle_ms)} * 1000,
+                               absl::GetFlag(FLAGS_trickle_gap_us)));
+    results.push_back(RunPhase(&scheduler, &primary,
+                               int64_t{absl::GetFlag(FLAGS_burst_ms)} * 1000,
+                               absl::GetFlag(FLAGS_burst_gap_us)));
+    const char* phase_names[] = {"idle", "trickle", "burst"};
+    for (size_t i = 0; i < results.size(); i++) {
+        const PhaseResult& result = results[i];
+        LOG_F(INFO, "{} scheduler, {} phase: {} cut attempts, {} cuts ({} early), "
+                    "max delay {}us",
+              adaptive ? "adaptive" : "fixed", phase_names[i], result.num_attempts,
+              result.num_cuts, result.num_early_cuts, result.max_delay_us);
+    }
+    return results;
+}
+
+// Sequencer::MarkNextCutIfDoable skips an early cut, e.g. with too many
+// metalogs in flight, which must not suppress later early cuts
+static void CheckSkippedEarlyCut() {
+    absl::SetFlag(&FLAGS_slog_global_cut_adaptive, true);
+    CutScheduler scheduler;
+    size_t max_records = absl::GetFlag(FLAGS_slog_global_cut_max_pending_records);
+    auto trigger_early_cut = [&] () {
+        for (size_t i = 0; i < max_records; i++) {
+            if (scheduler.OnShardProgress(/* payload_size= */ 64)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    CHECK(trigger_early_cut());
+    scheduler.OnCutSkipped();
+    CHECK(trigger_early_cut()) << "Skipped early cut suppresses later ones";
+    scheduler.OnCutMarked(/* num_new_logs= */ 1);
+    CHECK(trigger_early_cut());
+    LOG(INFO) << "Skipped early cut checks passed";
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    int64_t interval_us = absl::GetFlag(FLAGS_slog_global_cut_interval_us);
+    int64_t max_delay_us = absl::GetFlag(FLAGS_slog_global_cut_max_delay_us);
+    CHECK_GT(interval_us, 0);
+    CheckSkippedEarlyCut();
+
+    std::vector<PhaseResult> fixed = RunScheduler(/* adaptive= */ false);
+    std::vector<PhaseResult> adaptive = RunScheduler(/* adaptive= */ true);
+
+    // Idle: fixed cadence attempts a cut on every tick, adaptive backs off
+    CHECK_EQ(fixed[0].num_cuts, 0U);
+    CHECK_EQ(adaptive[0].num_cuts, 0U);
+    CHECK_LT(adaptive[0].num_attempts * 2, fixed[0].num_attempts)
+        << "Adaptive scheduler does not back off when idle";
+    CHECK_EQ(fixed[0].num_early_cuts + fixed[1].num_early_cuts + fixed[2].num_early_cuts, 0U);
+
+    // Sparse and bursty: pending progress is cut within the max delay, with
+    // a slack of a few timer ticks for scheduling jitter
+    for (size_t i = 1; i < adaptive.size(); i++) {
+        CHECK_GT(adaptive[i].num_cuts, 0U);
+        CHECK_LE(adaptive[i].max_delay_us, max_delay_us + 4 * interval_us)
+            << "Pending shard progress waits too long";
+    }
+
+    // Bursts pass the record threshold before the next tick
+    if (interval_us > int64_t{absl::GetFlag(FLAGS_burst_gap_us)}
+                      * gsl::narrow_cast<int64_t>(
+                          absl::GetFlag(FLAGS_slog_global_cut_max_pending_records))) {
+        CHECK_GT(adaptive[2].num_early_cuts, 0U) << "Bursts do not trigger early cuts";
+    }
+    LOG(INFO) << "Cut scheduler checks passed";
+    return 0;
+}
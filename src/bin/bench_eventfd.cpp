@@ -1,17 +1,34 @@
 #define __FAAS_NOWARN_SIGN_CONVERSION
 #include "base/init.h"
 #include "base/common.h"
+#include "base/thread.h"
 #include "common/time.h"
+#include "server/io_worker.h"
 #include "utils/bench.h"
 
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/eventfd.h>
+#include <sys/socket.h>
 
 ABSL_FLAG(int, server_cpu, -1, "Pin server process to this CPU");
 ABSL_FLAG(int, client_cpu, -1, "Pin client process to this CPU");
 ABSL_FLAG(absl::Duration, duration, absl::Seconds(30), "Duration to run");
 
+ABSL_FLAG(std::string, scenario, "ping_pong",
+          "ping_pong: two processes ping-pong over eventfds; "
+          "io_worker: many producers schedule functions to one IOWorker");
+ABSL_FLAG(size_t, producers, 4, "Number of producers in io_worker scenario");
+ABSL_FLAG(std::string, producer_type, "thread",
+          "thread: producers are plain threads, woken up with eventfd; "
+          "io_worker: producers are IOWorkers, woken up with IORING_OP_MSG_RING");
+ABSL_FLAG(size_t, batch_size, 1,
+          "Functions per ScheduleFunctions call, 1 to use ScheduleFunction");
+ABSL_FLAG(size_t, max_inflight_functions, 256,
+          "Maximum number of functions scheduled but not run, per producer");
+
+ABSL_DECLARE_FLAG(uint32_t, io_uring_cq_wait_timeout_us);
+
 using namespace faas;
 
 static constexpr size_t kBufferSizeForSamples = 1<<24;
@@ -86,9 +103,166 @@ void Client(int infd, int outfd) {
     PCHECK(close(outfd) == 0);
 }
 
+// State of the IOWorker running scheduled functions
+struct Consumer {
+    bench_utils::Samples<int32_t> handoff_delay{kBufferSizeForSamples};
+    uint64_t executed = 0;
+};
+
+class Producer {
+public:
+    Producer(Consumer* consumer, server::IOWorker* target)
+        : consumer_(consumer), target_(target), scheduled_(0), inflight_(0) {}
+
+    uint64_t scheduled() const { return scheduled_; }
+
+    // Schedules functions to `target_`, up to --max_inflight_functions
+    void Produce() {
+        size_t max_inflight = absl::GetFlag(FLAGS_max_inflight_functions);
+        size_t batch_size = absl::GetFlag(FLAGS_batch_size);
+        if (inflight_.load(std::memory_order_acquire) + batch_size > max_inflight) {
+            return;
+        }
+        inflight_.fetch_add(batch_size, std::memory_order_relaxed);
+        scheduled_ += batch_size;
+        if (batch_size == 1) {
+            target_->ScheduleFunction(nullptr, NewFunction());
+            return;
+        }
+        fns_.clear();
+        for (size_t i = 0; i < batch_size; i++) {
+            fns_.push_back(NewFunction());
+        }
+        target_->ScheduleFunctions(
+            nullptr, std::span<server::IOWorker::Function>(fns_.data(), fns_.size()));
+    }
+
+    // Produces on the event loop of `io_worker`, until `stop` is set
+    void ProduceOnIOWorker(server::IOWorker* io_worker, const std::atomic<bool>* stop) {
+        if (stop->load(std::memory_order_acquire)) {
+            return;
+        }
+        Produce();
+        io_worker->ScheduleIdleFunction(
+            nullptr, absl::bind_front(&Producer::ProduceOnIOWorker, this, io_worker, stop));
+    }
+
+private:
+    Consumer* consumer_;
+    server::IOWorker* target_;
+    uint64_t scheduled_;
+    std::atomic<size_t> inflight_;
+    std::vector<server::IOWorker::Function> fns_;
+
+    server::IOWorker::Function NewFunction() {
+        int64_t timestamp = GetMonotonicNanoTimestamp();
+        return [this, timestamp] {
+            consumer_->handoff_delay.Add(
+                gsl::narrow_cast<int32_t>(GetMonotonicNanoTimestamp() - timestamp));
+            consumer_->executed++;
+            inflight_.fetch_sub(1, std::memory_order_release);
+        };
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(Producer);
+};
+
+static int StartIOWorker(server::IOWorker* io_worker) {
+    int pipe_fds[2] = {-1, -1};
+    PCHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pipe_fds) == 0);
+    io_worker->Start(pipe_fds[1]);
+    return pipe_fds[0];
+}
+
+static void StopIOWorker(server::IOWorker* io_worker, int pipe_fd) {
+    io_worker->ScheduleStop();
+    io_worker->WaitForFinish();
+    PCHECK(close(pipe_fd) == 0);
+}
+
+void IOWorkerScenario() {
+    size_t num_producers = absl::GetFlag(FLAGS_producers);
+    bool io_worker_producers = absl::GetFlag(FLAGS_producer_type) == "io_worker";
+    CHECK_GT(num_producers, 0U);
+    CHECK_GT(absl::GetFlag(FLAGS_batch_size), 0U);
+    if (io_worker_producers && absl::GetFlag(FLAGS_io_uring_cq_wait_timeout_us) == 0) {
+        // Producer event loops should not block when no wakeup is sent
+        absl::SetFlag(&FLAGS_io_uring_cq_wait_timeout_us, 10);
+    }
+
+    Consumer consumer;
+    server::IOWorker target(0, "Target", 4096);
+    int target_pipe_fd = StartIOWorker(&target);
+    std::vector<std::unique_ptr<Producer>> producers;
+    for (size_t i = 0; i < num_producers; i++) {
+        producers.push_back(std::make_unique<Producer>(&consumer, &target));
+    }
+
+    std::atomic<bool> stop(false);
+    int64_t start_timestamp = GetMonotonicNanoTimestamp();
+    std::vector<std::unique_ptr<base::Thread>> threads;
+    std::vector<std::pair<std::unique_ptr<server::IOWorker>, int>> producer_workers;
+    for (size_t i = 0; i < num_producers; i++) {
+        Producer* producer = producers[i].get();
+        if (io_worker_producers) {
+            auto io_worker = std::make_unique<server::IOWorker>(
+                static_cast<int>(i + 1), fmt::format("Producer-{}", i), 4096);
+            int pipe_fd = StartIOWorker(io_worker.get());
+            io_worker->ScheduleFunction(
+                nullptr, absl::bind_front(&Producer::ProduceOnIOWorker, producer,
+                                          io_worker.get(), &stop));
+            producer_workers.emplace_back(std::move(io_worker), pipe_fd);
+        } else {
+            threads.push_back(std::make_unique<base::Thread>(
+                fmt::format("Producer-{}", i), [producer, &stop] {
+                    while (!stop.load(std::memory_order_acquire)) {
+                        producer->Produce();
+                    }
+                }));
+            threads.back()->Start();
+        }
+    }
+    absl::SleepFor(absl::GetFlag(FLAGS_duration));
+    stop.store(true, std::memory_order_release);
+    for (const auto& thread: threads) {
+        thread->Join();
+    }
+    for (const auto& [io_worker, pipe_fd]: producer_workers) {
+        StopIOWorker(io_worker.get(), pipe_fd);
+    }
+    int64_t elapsed_time = GetMonotonicNanoTimestamp() - start_timestamp;
+
+    uint64_t scheduled = 0;
+    for (const auto& producer: producers) {
+        scheduled += producer->scheduled();
+    }
+    // Wait for the target to run all scheduled functions
+    std::atomic<bool> drained(false);
+    while (!drained.load(std::memory_order_acquire)) {
+        target.ScheduleFunction(nullptr, [&consumer, &drained, scheduled] {
+            if (consumer.executed == scheduled) {
+                drained.store(true, std::memory_order_release);
+            }
+        });
+        absl::SleepFor(absl::Milliseconds(10));
+    }
+    StopIOWorker(&target, target_pipe_fd);
+
+    LOG_F(INFO, "{} {} producers, batch size {}", num_producers,
+          absl::GetFlag(FLAGS_producer_type), absl::GetFlag(FLAGS_batch_size));
+    LOG(INFO) << "Throughput: " << scheduled / (elapsed_time / 1e9) << " functions per second";
+    consumer.handoff_delay.ReportStatistics("Handoff delay");
+}
+
 int main(int argc, char* argv[]) {
     base::InitMain(argc, argv);
 
+    if (absl::GetFlag(FLAGS_scenario) == "io_worker") {
+        IOWorkerScenario();
+        return 0;
+    }
+    CHECK_EQ(absl::GetFlag(FLAGS_scenario), "ping_pong");
+
     int fd1 = eventfd(0, 0);
     PCHECK(fd1 != -1);
     int fd2 = eventfd(0, 0);
@@ -0,0 +1,170 @@
+#define __FAAS_NOWARN_CONVERSION
+#include "base/init.h"
+#include "base/common.h"
+#include "common/time.h"
+#include "common/protocol.h"
+#include "ipc/base.h"
+#include "launcher/launcher.h"
+#include "utils/fs.h"
+#include "utils/io.h"
+#include "utils/socket.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+
+ABSL_FLAG(std::string, root_path_for_ipc, "/dev/shm/faas_bench_ipc",
+          "Root directory for IPCs, where the fake engine listens");
+ABSL_FLAG(std::string, fprocess, "",
+          "Command of the C++ func worker, e.g. \"func_worker_v1 libfunc.so\". "
+          "If set, func workers stop crashing after --crashes exits, and the "
+          "benchmark waits for the recovered worker");
+ABSL_FLAG(std::string, func_config_file, "", "Path to the function config JSON");
+ABSL_FLAG(int, func_id, 1, "Function ID of func workers");
+ABSL_FLAG(size_t, crashes, 8,
+          "Number of func worker crashes, which is also the limit of restarts");
+
+ABSL_DECLARE_FLAG(absl::Duration, fprocess_restart_initial_backoff);
+ABSL_DECLARE_FLAG(absl::Duration, fprocess_restart_max_backoff);
+ABSL_DECLARE_FLAG(size_t, fprocess_crash_loop_threshold);
+ABSL_DECLARE_FLAG(size_t, fprocess_max_restarts);
+ABSL_DECLARE_FLAG(absl::Duration, fprocess_restart_limit_window);
+
+using namespace faas;
+
+using protocol::Message;
+using protocol::MessageHelper;
+
+// Plays the engine towards an in-process Launcher, whose func workers exit
+// right away until the healthy mark is created. Without the healthy mark,
+// checks that restarts pause at the limit, and resume once the first
+// restart leaves --fprocess_restart_limit_window, so that the lost func
+// worker is replaced.
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    ipc::SetRootPathForIpc(absl::GetFlag(FLAGS_root_path_for_ipc), /* create= */ true);
+
+    std::string func_config_json;
+    CHECK(fs_utils::ReadContents(absl::GetFlag(FLAGS_func_config_file), &func_config_json))
+        << "Failed to read function config file";
+    std::string healthy_mark = fs_utils::JoinPath(ipc::GetRootPathForIpc(), "healthy");
+    fs_utils::Remove(healthy_mark);
+    std::string fprocess = absl::GetFlag(FLAGS_fprocess);
+    bool recover = !fprocess.empty();
+    std::string crashing_fprocess = recover
+        ? fmt::format("test -e {} || exit 1; exec {}", healthy_mark, fprocess)
+        : "exit 1";
+
+    std::string socket_path(ipc::GetEngineUnixSocketPath());
+    unlink(socket_path.c_str());
+    int listen_fd = utils::UnixSocketBindAndListen(socket_path, 16);
+    CHECK(listen_fd != -1);
+
+    size_t crashes = absl::GetFlag(FLAGS_crashes);
+    absl::SetFlag(&FLAGS_fprocess_max_restarts, crashes);
+    absl::Duration backoff = absl::GetFlag(FLAGS_fprocess_restart_initial_backoff);
+    absl::Duration max_backoff = absl::GetFlag(FLAGS_fprocess_restart_max_backoff);
+    // The window covers all restarts and the backoff of the next one, which
+    // is then delayed
+    absl::Duration limit_window = absl::Seconds(2);
+    for (size_t i = 0; i <= crashes; i++) {
+        limit_window += std::min(backoff * (int64_t{1} << std::min<size_t>(i, 30)), max_backoff);
+    }
+    absl::SetFlag(&FLAGS_fprocess_restart_limit_window, limit_window);
+    launcher::Launcher launcher;
+    launcher.set_func_id(absl::GetFlag(FLAGS_func_id));
+    launcher.set_fprocess(crashing_fprocess);
+    launcher.set_fprocess_mode(launcher::Launcher::kCppMode);
+    launcher.Start();
+
+    int launcher_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    PCHECK(launcher_fd != -1);
+    Message handshake;
+    CHECK(io_utils::RecvMessage(launcher_fd, &handshake, nullptr));
+    CHECK(MessageHelper::IsLauncherHandshake(handshake));
+    Message response = MessageHelper::NewHandshakeResponse(
+        gsl::narrow_cast<uint32_t>(func_config_json.size()));
+    response.flags |= protocol::kFuncWorkerUseEngineSocketFlag;
+    CHECK(io_utils::SendMessage(launcher_fd, response));
+    CHECK(io_utils::SendData(launcher_fd, func_config_json.data(), func_config_json.size()));
+
+    size_t crash_loop_threshold = absl::GetFlag(FLAGS_fprocess_crash_loop_threshold);
+    uint16_t next_client_id = 1;
+    CHECK(io_utils::SendMessage(launcher_fd, MessageHelper::NewCreateFuncWorker(next_client_id)));
+    int64_t create_timestamp = GetMonotonicNanoTimestamp();
+    // No later than the first restart, which starts the limit window
+    int64_t start_timestamp = create_timestamp;
+    for (size_t i = 0; i < crashes; i++) {
+        Message restart;
+        CHECK(io_utils::RecvMessage(launcher_fd, &restart, nullptr));
+        int64_t now = GetMonotonicNanoTimestamp();
+        CHECK(MessageHelper::IsFuncWorkerRestart(restart));
+        CHECK_EQ(restart.client_id, next_client_id);
+        CHECK_EQ(restart.call_id, gsl::narrow_cast<uint32_t>(i + 1)) << "Unexpected restart count";
+        bool crash_loop = (restart.flags & protocol::kFuncWorkerCrashLoopFlag) != 0;
+        CHECK_EQ(crash_loop, i + 1 >= crash_loop_threshold);
+        // Includes spawning and exit of the crashing worker
+        double elapsed_ms = static_cast<double>(now - create_timestamp) / 1e6;
+        LOG_F(INFO, "Restart {}: {:.1f} ms after creation, expected backoff {:.1f} ms{}",
+              restart.call_id, elapsed_ms, absl::ToDoubleMilliseconds(backoff),
+              crash_loop ? ", in crash loop" : "");
+        CHECK_GE(elapsed_ms, absl::ToDoubleMilliseconds(backoff));
+        backoff = std::min(backoff * 2, max_backoff);
+
+        if (recover && i + 1 == crashes) {
+            auto fd = fs_utils::Create(healthy_mark);
+            CHECK(fd.has_value());
+            PCHECK(close(*fd) == 0);
+        }
+        next_client_id++;
+        CHECK(io_utils::SendMessage(launcher_fd,
+                                    MessageHelper::NewCreateFuncWorker(next_client_id)));
+        create_timestamp = GetMonotonicNanoTimestamp();
+    }
+
+    int worker_fd = -1;
+    if (recover) {
+        worker_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        PCHECK(worker_fd != -1);
+        Message worker_handshake;
+        CHECK(io_utils::RecvMessage(worker_fd, &worker_handshake, nullptr));
+        CHECK(MessageHelper::IsFuncWorkerHandshake(worker_handshake));
+        CHECK_EQ(worker_handshake.client_id, next_client_id);
+        CHECK(io_utils::SendMessage(worker_fd, MessageHelper::NewHandshakeResponse(0)));
+        LOG_F(INFO, "Func worker recovered after {} restarts, in {:.1f} ms",
+              crashes, static_cast<double>(GetMonotonicNanoTimestamp() - create_timestamp) / 1e6);
+    } else {
+        // No restart comes after the next backoff
+        struct pollfd pfd = { .fd = launcher_fd, .events = POLLIN, .revents = 0 };
+        int timeout_ms = static_cast<int>(
+            absl::ToInt64Milliseconds(backoff + absl::Milliseconds(500)));
+        int ret = poll(&pfd, 1, timeout_ms);
+        PCHECK(ret != -1);
+        CHECK_EQ(ret, 0) << "Func worker restarted beyond the limit";
+        LOG_F(INFO, "Restarts paused at the limit of {}", crashes);
+
+        // The lost func worker is replaced once the first restart leaves
+        // the window
+        Message restart;
+        CHECK(io_utils::RecvMessage(launcher_fd, &restart, nullptr));
+        int64_t now = GetMonotonicNanoTimestamp();
+        CHECK(MessageHelper::IsFuncWorkerRestart(restart));
+        CHECK_EQ(restart.client_id, next_client_id);
+        CHECK_EQ(restart.call_id, gsl::narrow_cast<uint32_t>(crashes + 1));
+        double elapsed_ms = static_cast<double>(now - start_timestamp) / 1e6;
+        CHECK_GE(elapsed_ms, absl::ToDoubleMilliseconds(limit_window))
+            << "Restart limit is not enforced over the window";
+        LOG_F(INFO, "Restarts resumed {:.1f} ms after the first creation, window {}",
+              elapsed_ms, absl::FormatDuration(limit_window));
+    }
+
+    launcher.ScheduleStop();
+    launcher.WaitForFinish();
+    if (worker_fd != -1) {
+        PCHECK(close(worker_fd) == 0);
+    }
+    PCHECK(close(launcher_fd) == 0);
+    PCHECK(close(listen_fd) == 0);
+    PCHECK(unlink(socket_path.c_str()) == 0);
+    fs_utils::Remove(healthy_mark);
+    return 0;
+}
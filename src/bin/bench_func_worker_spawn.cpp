@@ -0,0 +1,107 @@
+#define __FAAS_NOWARN_CONVERSION
+#include "base/init.h"
+#include "base/common.h"
+#include "common/time.h"
+#include "common/protocol.h"
+#include "ipc/base.h"
+#include "launcher/launcher.h"
+#include "utils/fs.h"
+#include "utils/io.h"
+#include "utils/socket.h"
+#include "utils/bench.h"
+
+#include <sys/socket.h>
+
+ABSL_FLAG(std::string, root_path_for_ipc, "/dev/shm/faas_bench_ipc",
+          "Root directory for IPCs, where the fake engine listens");
+ABSL_FLAG(std::string, fprocess, "",
+          "Command of the C++ func worker, e.g. \"func_worker_v1 libfunc.so\"");
+ABSL_FLAG(std::string, func_config_file, "", "Path to the function config JSON");
+ABSL_FLAG(int, func_id, 1, "Function ID of func workers");
+ABSL_FLAG(size_t, num_workers, 32, "Number of func workers created in each mode");
+ABSL_FLAG(std::string, modes, "spawn,zygote",
+          "Comma-separated modes to measure. spawn: spawn each func worker from scratch; "
+          "zygote: fork func workers from an initialized zygote");
+
+using namespace faas;
+
+using protocol::Message;
+using protocol::MessageHelper;
+
+// Plays the engine towards an in-process Launcher, and measures the latency
+// from sending CREATE_FUNC_WORKER to receiving the handshake of the new worker
+static void RunMode(std::string_view mode, std::string_view func_config_json) {
+    std::string socket_path(ipc::GetEngineUnixSocketPath());
+    unlink(socket_path.c_str());
+    int listen_fd = utils::UnixSocketBindAndListen(socket_path, 64);
+    CHECK(listen_fd != -1);
+
+    auto launcher = std::make_unique<launcher::Launcher>();
+    launcher->set_func_id(absl::GetFlag(FLAGS_func_id));
+    launcher->set_fprocess(absl::GetFlag(FLAGS_fprocess));
+    launcher->set_fprocess_mode(launcher::Launcher::kCppMode);
+    launcher->set_fprocess_zygote(mode == "zygote");
+    launcher->Start();
+
+    int launcher_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    PCHECK(launcher_fd != -1);
+    Message handshake;
+    CHECK(io_utils::RecvMessage(launcher_fd, &handshake, nullptr));
+    CHECK(MessageHelper::IsLauncherHandshake(handshake));
+    Message response = MessageHelper::NewHandshakeResponse(
+        gsl::narrow_cast<uint32_t>(func_config_json.size()));
+    // Func workers talk through engine sockets, without FIFOs
+    response.flags |= protocol::kFuncWorkerUseEngineSocketFlag;
+    CHECK(io_utils::SendMessage(launcher_fd, response));
+    CHECK(io_utils::SendData(launcher_fd, func_config_json.data(), func_config_json.size()));
+
+    size_t num_workers = absl::GetFlag(FLAGS_num_workers);
+    bench_utils::Samples<int32_t> latency(num_workers);
+    std::vector<int> worker_fds;
+    for (size_t i = 0; i < num_workers; i++) {
+        uint16_t client_id = gsl::narrow_cast<uint16_t>(i + 1);
+        int64_t start_timestamp = GetMonotonicNanoTimestamp();
+        CHECK(io_utils::SendMessage(launcher_fd, MessageHelper::NewCreateFuncWorker(client_id)));
+        int worker_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        PCHECK(worker_fd != -1);
+        Message worker_handshake;
+        CHECK(io_utils::RecvMessage(worker_fd, &worker_handshake, nullptr));
+        int64_t elapsed_us = (GetMonotonicNanoTimestamp() - start_timestamp) / 1000;
+        CHECK(MessageHelper::IsFuncWorkerHandshake(worker_handshake));
+        CHECK_EQ(worker_handshake.client_id, client_id);
+        CHECK(io_utils::SendMessage(worker_fd, MessageHelper::NewHandshakeResponse(0)));
+        worker_fds.push_back(worker_fd);
+        // The first zygote fork waits for the zygote to initialize
+        if (i == 0) {
+            LOG_F(INFO, "{}: first func worker takes {} us", mode, elapsed_us);
+        } else {
+            latency.Add(gsl::narrow_cast<int32_t>(elapsed_us));
+        }
+    }
+    latency.ReportStatistics(fmt::format("{}: spawn-to-handshake latency (us)", mode));
+
+    launcher->ScheduleStop();
+    launcher->WaitForFinish();
+    for (int fd : worker_fds) {
+        PCHECK(close(fd) == 0);
+    }
+    PCHECK(close(launcher_fd) == 0);
+    PCHECK(close(listen_fd) == 0);
+    PCHECK(unlink(socket_path.c_str()) == 0);
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    ipc::SetRootPathForIpc(absl::GetFlag(FLAGS_root_path_for_ipc), /* create= */ true);
+    CHECK(!absl::GetFlag(FLAGS_fprocess).empty()) << "--fprocess is required";
+
+    std::string func_config_json;
+    CHECK(fs_utils::ReadContents(absl::GetFlag(FLAGS_func_config_file), &func_config_json))
+        << "Failed to read function config file";
+    for (std::string_view mode : absl::StrSplit(absl::GetFlag(FLAGS_modes), ',',
+                                                absl::SkipEmpty())) {
+        CHECK(mode == "spawn" || mode == "zygote") << "Unknown mode: " << mode;
+        RunMode(mode, func_config_json);
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+#define __FAAS_NOWARN_CONVERSION
+#include "base/init.h"
+#include "base/common.h"
+#include "common/time.h"
+#include "server/io_uring.h"
+#include "utils/bench.h"
+
+#include <sys/socket.h>
+
+ABSL_FLAG(size_t, message_size, 64, "Byte size of each message");
+ABSL_FLAG(size_t, batch_size, 16, "Number of SendAll calls before running the event loop");
+ABSL_FLAG(size_t, warmup_rounds, 1000, "Rounds to run before measuring");
+ABSL_FLAG(int, cpu, -1, "Pin the benchmark to this CPU");
+ABSL_FLAG(absl::Duration, duration, absl::Seconds(10), "Duration to run");
+
+// Counts heap allocations made by this process, including those of IOUring
+static std::atomic<uint64_t> num_allocations{0};
+
+void* operator new(size_t size) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+using namespace faas;
+
+static constexpr uint16_t kRecvBufGroup = 1;
+static constexpr size_t kRecvBufSize = 4096;
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+
+    int cpu = absl::GetFlag(FLAGS_cpu);
+    if (cpu != -1) {
+        bench_utils::PinCurrentThreadToCpu(cpu);
+    }
+    int fds[2];
+    PCHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    int sendfd = fds[0];
+    int recvfd = fds[1];
+
+    server::IOUring io_uring;
+    io_uring.PrepareBuffers(kRecvBufGroup, kRecvBufSize);
+    CHECK(io_uring.RegisterFd(sendfd));
+    CHECK(io_uring.RegisterFd(recvfd));
+
+    size_t bytes_received = 0;
+    CHECK(io_uring.StartRecv(recvfd, kRecvBufGroup,
+                             [&bytes_received] (int status, std::span<const char> data) -> bool {
+        PCHECK(status == 0);
+        bytes_received += data.size();
+        return true;
+    }));
+
+    size_t message_size = absl::GetFlag(FLAGS_message_size);
+    size_t batch_size = absl::GetFlag(FLAGS_batch_size);
+    std::vector<char> message(message_size, 'x');
+    size_t bytes_sent = 0;
+    size_t inflight_sends = 0;
+    size_t inflight_ops;
+    // One round sends a batch and runs the event loop until all data arrives
+    auto run_round = [&] () {
+        for (size_t i = 0; i < batch_size; i++) {
+            CHECK(io_uring.SendAll(sendfd, std::span<const char>(message.data(), message.size()),
+                                   [&inflight_sends, &bytes_sent, message_size] (int status) {
+                PCHECK(status == 0);
+                bytes_sent += message_size;
+                inflight_sends--;
+            }));
+            inflight_sends++;
+        }
+        while (inflight_sends > 0 || bytes_received < bytes_sent) {
+            io_uring.EventLoopRunOnce(&inflight_ops);
+        }
+    };
+    for (size_t i = 0; i < absl::GetFlag(FLAGS_warmup_rounds); i++) {
+        run_round();
+    }
+
+    // Empty sends complete right away, also when queued behind others
+    size_t empty_sends = 0;
+    auto empty_send_cb = [&empty_sends] (int status) {
+        CHECK_EQ(status, 0);
+        empty_sends++;
+    };
+    CHECK(io_uring.SendAll(sendfd, std::span<const char>(message.data(), message.size()),
+                           [&inflight_sends, &bytes_sent, message_size] (int status) {
+        PCHECK(status == 0);
+        bytes_sent += message_size;
+        inflight_sends--;
+    }));
+    inflight_sends++;
+    CHECK(io_uring.SendAll(sendfd, std::span<const char>(), empty_send_cb));
+    CHECK(io_uring.SendAll(sendfd, std::vector<std::span<const char>>(2), empty_send_cb));
+    CHECK_EQ(empty_sends, 2U);
+    while (inflight_sends > 0 || bytes_received < bytes_sent) {
+        io_uring.EventLoopRunOnce(&inflight_ops);
+    }
+
+    uint64_t start_cqes = io_uring.completed_cqe_count();
+    uint64_t start_allocations = num_allocations.load(std::memory_order_relaxed);
+    auto perf_event_group = bench_utils::SetupCpuRelatedPerfEvents(cpu);
+    perf_event_group->ResetAndEnable();
+    bench_utils::BenchLoop bench_loop(absl::GetFlag(FLAGS_duration), [&] () -> bool {
+        run_round();
+        return true;
+    });
+    perf_event_group->Disable();
+    uint64_t allocations = num_allocations.load(std::memory_order_relaxed) - start_allocations;
+    uint64_t ops = io_uring.completed_cqe_count() - start_cqes;
+    CHECK_GT(ops, 0U);
+
+    LOG(INFO) << "Completed ops: " << ops;
+    LOG(INFO) << "Time per op: "
+              << absl::ToDoubleNanoseconds(bench_loop.elapsed_time()) / ops << " ns";
+    LOG(INFO) << "Allocations per op: " << static_cast<double>(allocations) / ops;
+    bench_utils::ReportCpuRelatedPerfEventValues("IOUring", perf_event_group.get(),
+                                                 bench_loop.elapsed_time(), ops);
+
+    CHECK(io_uring.StopReadOrRecv(recvfd));
+    size_t closed = 0;
+    CHECK(io_uring.Close(sendfd, [&closed] () { closed++; }));
+    CHECK(io_uring.Close(recvfd, [&closed] () { closed++; }));
+    while (closed < 2 || inflight_ops > 0) {
+        io_uring.EventLoopRunOnce(&inflight_ops);
+    }
+    return 0;
+}
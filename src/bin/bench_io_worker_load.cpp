@@ -0,0 +1,246 @@
+#define __FAAS_NOWARN_CONVERSION
+#include "base/init.h"
+#include "base/common.h"
+#include "base/thread.h"
+#include "common/time.h"
+#include "server/io_worker.h"
+#include "server/io_worker_balancer.h"
+#include "server/ingress_connection.h"
+#include "utils/bench.h"
+
+#include <cmath>
+#include <random>
+#include <sys/socket.h>
+
+ABSL_FLAG(size_t, workers, 4, "Number of IOWorkers");
+ABSL_FLAG(size_t, connections, 32, "Number of connections");
+ABSL_FLAG(double, active_ratio, 0.5, "Ratio of connections receiving messages in each phase");
+ABSL_FLAG(double, zipf_skew, 1.0, "Skew of message rates among active connections");
+ABSL_FLAG(double, total_load, 2.0, "Total work of messages, in number of busy IOWorkers");
+ABSL_FLAG(absl::Duration, work_per_message, absl::Microseconds(20),
+          "CPU time spent on each message");
+ABSL_FLAG(size_t, phases, 3, "Number of phases, each with a different set of active connections");
+ABSL_FLAG(absl::Duration, phase_duration, absl::Seconds(10), "Duration of each phase");
+ABSL_FLAG(absl::Duration, placement_interval, absl::Milliseconds(50),
+          "Interval between placing connections, so that loads become visible");
+ABSL_FLAG(absl::Duration, balance_interval, absl::Seconds(1),
+          "Interval of migrating connections off busy IOWorkers, 0 to disable");
+
+ABSL_DECLARE_FLAG(bool, tcp_enable_nodelay);
+ABSL_DECLARE_FLAG(bool, tcp_enable_keepalive);
+
+// Runs the same phases of skewed message rates twice, first placing
+// connections round-robin without migration, then placing them with
+// IOWorkerBalancer and migrating busy ones. Reports load spread (max - min
+// over IOWorkers) of both, and checks load-aware placement keeps the mean
+// spread tighter.
+
+using namespace faas;
+
+static constexpr size_t kMessageSize = 8;
+static constexpr int kConnectionType = 1;
+
+// Message rates of connections within a phase, summed up to 1
+static std::vector<double> PhaseWeights(size_t phase, size_t num_connections) {
+    std::vector<size_t> order(num_connections);
+    for (size_t i = 0; i < num_connections; i++) {
+        order[i] = i;
+    }
+    std::mt19937 rng(static_cast<uint32_t>(phase));
+    std::shuffle(order.begin(), order.end(), rng);
+    size_t num_active = std::max<size_t>(
+        1, static_cast<size_t>(num_connections * absl::GetFlag(FLAGS_active_ratio)));
+    std::vector<double> weights(num_connections, 0.0);
+    double sum = 0;
+    for (size_t rank = 0; rank < num_active; rank++) {
+        double weight = 1.0 / std::pow(rank + 1, absl::GetFlag(FLAGS_zipf_skew));
+        weights[order[rank]] = weight;
+        sum += weight;
+    }
+    for (double& weight: weights) {
+        weight /= sum;
+    }
+    return weights;
+}
+
+// Writes messages to connections at rates given by weights of the current phase
+class Sender {
+public:
+    explicit Sender(std::vector<int> sockfds)
+        : sockfds_(std::move(sockfds)),
+          num_placed_(0), phase_(0), stop_(false),
+          thread_("Sender", absl::bind_front(&Sender::ThreadMain, this)) {}
+
+    void Start() { thread_.Start(); }
+    void SetPlaced(size_t num_placed) { num_placed_.store(num_placed); }
+    void SetPhase(size_t phase) { phase_.store(phase); }
+    void Stop() { stop_.store(true); thread_.Join(); }
+
+private:
+    std::vector<int> sockfds_;
+    std::atomic<size_t> num_placed_;
+    std::atomic<size_t> phase_;
+    std::atomic<bool> stop_;
+    base::Thread thread_;
+
+    void ThreadMain() {
+        size_t n = sockfds_.size();
+        double messages_per_ms = absl::GetFlag(FLAGS_total_load)
+            / absl::ToDoubleMilliseconds(absl::GetFlag(FLAGS_work_per_message));
+        std::vector<double> credits(n, 0.0);
+        std::vector<char> data(static_cast<size_t>(messages_per_ms + 1) * kMessageSize, 0);
+        size_t current_phase = std::numeric_limits<size_t>::max();
+        std::vector<double> weights;
+        int64_t last_timestamp = GetMonotonicNanoTimestamp();
+        while (!stop_.load()) {
+            absl::SleepFor(absl::Milliseconds(1));
+            if (phase_.load() != current_phase) {
+                current_phase = phase_.load();
+                weights = PhaseWeights(current_phase, n);
+            }
+            int64_t now = GetMonotonicNanoTimestamp();
+            double elapsed_ms = (now - last_timestamp) / 1e6;
+            last_timestamp = now;
+            size_t num_placed = num_placed_.load();
+            for (size_t i = 0; i < num_placed; i++) {
+                credits[i] += weights[i] * messages_per_ms * elapsed_ms;
+                size_t count = std::min(static_cast<size_t>(credits[i]),
+                                        data.size() / kMessageSize);
+                if (count == 0) {
+                    continue;
+                }
+                credits[i] -= count;
+                // Messages are dropped if the IOWorker falls behind
+                ssize_t ret = send(sockfds_[i], data.data(), count * kMessageSize, MSG_DONTWAIT);
+                PCHECK(ret >= 0 || errno == EAGAIN || errno == EWOULDBLOCK);
+                CHECK(ret < 0 || ret % kMessageSize == 0);
+            }
+        }
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(Sender);
+};
+
+static void SpinFor(absl::Duration d) {
+    int64_t deadline = GetMonotonicNanoTimestamp() + absl::ToInt64Nanoseconds(d);
+    while (GetMonotonicNanoTimestamp() < deadline) {}
+}
+
+// Returns the mean load spread over all phases
+static double RunPlacement(bool load_aware) {
+    std::string_view placement = load_aware ? "load_aware" : "round_robin";
+    size_t num_workers = absl::GetFlag(FLAGS_workers);
+    size_t num_connections = absl::GetFlag(FLAGS_connections);
+
+    std::vector<std::unique_ptr<server::IOWorker>> io_workers;
+    std::vector<int> pipe_fds;
+    std::vector<server::IOWorker*> io_worker_ptrs;
+    for (size_t i = 0; i < num_workers; i++) {
+        auto io_worker = std::make_unique<server::IOWorker>(
+            static_cast<int>(i), fmt::format("IO-{}", i), 4096);
+        int fds[2] = {-1, -1};
+        PCHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+        io_worker->Start(fds[1]);
+        pipe_fds.push_back(fds[0]);
+        io_worker_ptrs.push_back(io_worker.get());
+        io_workers.push_back(std::move(io_worker));
+    }
+    server::IOWorkerBalancer balancer(io_worker_ptrs);
+
+    absl::Duration work_per_message = absl::GetFlag(FLAGS_work_per_message);
+    std::vector<std::unique_ptr<server::IngressConnection>> connections;
+    std::vector<int> sender_fds;
+    for (size_t i = 0; i < num_connections; i++) {
+        int fds[2] = {-1, -1};
+        PCHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+        auto connection = std::make_unique<server::IngressConnection>(
+            kConnectionType, fds[1], kMessageSize);
+        connection->SetMessageFullSizeCallback([] (std::span<const char>) -> size_t {
+            return kMessageSize;
+        });
+        connection->SetNewMessageCallback([work_per_message] (std::span<const char>) {
+            SpinFor(work_per_message);
+        });
+        connection->set_id(static_cast<int>(i));
+        connections.push_back(std::move(connection));
+        sender_fds.push_back(fds[0]);
+    }
+
+    Sender sender(sender_fds);
+    sender.Start();
+    for (size_t i = 0; i < num_connections; i++) {
+        size_t idx = load_aware ? balancer.PickForConnType(kConnectionType)->worker_id()
+                                : i % num_workers;
+        server::ConnectionBase* connection = connections[i].get();
+        PCHECK(write(pipe_fds[idx], &connection, __FAAS_PTR_SIZE) == __FAAS_PTR_SIZE);
+        sender.SetPlaced(i + 1);
+        absl::SleepFor(absl::GetFlag(FLAGS_placement_interval));
+    }
+
+    absl::Duration balance_interval = absl::GetFlag(FLAGS_balance_interval);
+    absl::Duration sample_interval = absl::Milliseconds(100);
+    double spread_sum = 0;
+    size_t num_samples = 0;
+    for (size_t phase = 0; phase < absl::GetFlag(FLAGS_phases); phase++) {
+        sender.SetPhase(phase);
+        bench_utils::Samples<int32_t> spread(1 << 16);
+        bench_utils::Samples<int32_t> max_load(1 << 16);
+        absl::Time phase_end = absl::Now() + absl::GetFlag(FLAGS_phase_duration);
+        absl::Time next_balance = absl::Now() + balance_interval;
+        while (absl::Now() < phase_end) {
+            absl::SleepFor(sample_interval);
+            uint32_t min = std::numeric_limits<uint32_t>::max();
+            uint32_t max = 0;
+            for (server::IOWorker* io_worker: io_worker_ptrs) {
+                min = std::min(min, io_worker->load());
+                max = std::max(max, io_worker->load());
+            }
+            spread.Add(static_cast<int32_t>(max - min));
+            max_load.Add(static_cast<int32_t>(max));
+            spread_sum += max - min;
+            num_samples++;
+            if (load_aware && balance_interval > absl::ZeroDuration()
+                  && absl::Now() >= next_balance) {
+                for (server::IOWorker* io_worker: io_worker_ptrs) {
+                    io_worker->ScheduleFunction(nullptr, [&balancer] {
+                        balancer.BalanceCurrentIOWorker();
+                    });
+                }
+                next_balance = absl::Now() + balance_interval;
+            }
+        }
+        LOG_F(INFO, "Phase {} with {} placement", phase, placement);
+        spread.ReportStatistics("Load spread (max - min)");
+        max_load.ReportStatistics("Max load");
+    }
+
+    sender.Stop();
+    for (size_t i = 0; i < num_workers; i++) {
+        io_workers[i]->ScheduleStop();
+    }
+    for (size_t i = 0; i < num_workers; i++) {
+        io_workers[i]->WaitForFinish();
+        PCHECK(close(pipe_fds[i]) == 0);
+    }
+    for (int fd: sender_fds) {
+        PCHECK(close(fd) == 0);
+    }
+    CHECK_GT(num_samples, 0U);
+    return spread_sum / num_samples;
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    // Connections are Unix sockets
+    absl::SetFlag(&FLAGS_tcp_enable_nodelay, false);
+    absl::SetFlag(&FLAGS_tcp_enable_keepalive, false);
+    CHECK_GT(absl::GetFlag(FLAGS_workers), 1U);
+
+    double round_robin_spread = RunPlacement(/* load_aware= */ false);
+    double load_aware_spread = RunPlacement(/* load_aware= */ true);
+    LOG_F(INFO, "Mean load spread: round_robin {:.1f}, load_aware {:.1f}",
+          round_robin_spread, load_aware_spread);
+    CHECK_LT(load_aware_spread, round_robin_spread)
+        << "Load-aware placement does not balance IOWorkers better";
+    return 0;
+}
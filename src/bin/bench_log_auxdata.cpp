@@ -0,0 +1,130 @@
+#define __FAAS_NOWARN_CONVERSION
+#include "base/init.h"
+#include "base/common.h"
+#include "common/time.h"
+#include "log/cache.h"
+#include "log/db.h"
+#include "utils/bits.h"
+#include "utils/fs.h"
+#include "utils/bench.h"
+
+ABSL_FLAG(std::string, backends, "rocksdb,tkrzw_hash,tkrzw_tree,tkrzw_skip",
+          "Comma-separated storage backends to measure");
+ABSL_FLAG(std::string, tmp_dir, "/tmp", "Directory for temporary databases");
+ABSL_FLAG(size_t, num_entries, 4096, "Number of log entries with aux data");
+ABSL_FLAG(size_t, aux_data_size, 256, "Size of each aux data");
+ABSL_FLAG(int, cache_cap_mb, 1, "Capacity of the log cache, which is filled to evict aux data");
+
+using namespace faas;
+
+static constexpr uint32_t kLogSpaceId = 0x00010000;
+
+static std::unique_ptr<log::DBInterface> OpenDB(std::string_view backend,
+                                                std::string_view db_path) {
+    if (backend == "rocksdb") {
+        return std::make_unique<log::RocksDBBackend>(db_path);
+    } else if (backend == "tkrzw_hash") {
+        return std::make_unique<log::TkrzwDBMBackend>(log::TkrzwDBMBackend::kHashDBM, db_path);
+    } else if (backend == "tkrzw_tree") {
+        return std::make_unique<log::TkrzwDBMBackend>(log::TkrzwDBMBackend::kTreeDBM, db_path);
+    } else if (backend == "tkrzw_skip") {
+        return std::make_unique<log::TkrzwDBMBackend>(log::TkrzwDBMBackend::kSkipDBM, db_path);
+    } else {
+        LOG(FATAL) << "Unknown storage backend: " << backend;
+        return nullptr;
+    }
+}
+
+static std::string AuxData(uint64_t seqnum, uint64_t version) {
+    std::string data = fmt::format("{:016x}-{:016x}-", seqnum, version);
+    data.resize(std::max(data.size(), absl::GetFlag(FLAGS_aux_data_size)), 'a');
+    return data;
+}
+
+// Writes log entries with versioned aux data as a storage node would, evicts
+// them from the log cache, and checks they are read back from a reopened DB
+static void RunBackend(std::string_view backend) {
+    std::string db_path = fs_utils::JoinPath(absl::GetFlag(FLAGS_tmp_dir),
+                                             "faas_auxdata_XXXXXX");
+    PCHECK(mkdtemp(db_path.data()) != nullptr);
+    size_t num_entries = absl::GetFlag(FLAGS_num_entries);
+    auto seqnum_of = [] (size_t i) {
+        return bits::JoinTwo32(kLogSpaceId, gsl::narrow_cast<uint32_t>(i));
+    };
+
+    auto db = OpenDB(backend, db_path);
+    db->InstallLogSpace(kLogSpaceId);
+    CHECK(!db->IsReopenedLogSpace(kLogSpaceId));
+    log::LRUCache cache(absl::GetFlag(FLAGS_cache_cap_mb));
+    bench_utils::Samples<int32_t> put_latency(num_entries * 2);
+    for (size_t i = 0; i < num_entries; i++) {
+        uint64_t seqnum = seqnum_of(i);
+        std::string log_data = fmt::format("log-{}", i);
+        db->Put(kLogSpaceId, bits::LowHalf64(seqnum), STRING_AS_SPAN(log_data));
+        // Versions 1 and 3 are written, version 2 comes late and is dropped
+        for (uint64_t version : {uint64_t{1}, uint64_t{3}, uint64_t{2}}) {
+            std::string aux_data = AuxData(seqnum, version);
+            int64_t start_timestamp = GetMonotonicNanoTimestamp();
+            bool stored = db->PutAuxData(seqnum, version, STRING_AS_SPAN(aux_data));
+            int64_t elapsed_ns = GetMonotonicNanoTimestamp() - start_timestamp;
+            CHECK_EQ(stored, version != 2) << "Last writer does not win";
+            if (stored) {
+                put_latency.Add(gsl::narrow_cast<int32_t>(elapsed_ns));
+                cache.PutAuxData(seqnum, STRING_AS_SPAN(aux_data));
+            }
+        }
+    }
+    put_latency.ReportStatistics(fmt::format("{}: put aux data latency (ns)", backend));
+
+    // Aux data is evicted by newer cache entries
+    std::string filler(absl::GetFlag(FLAGS_aux_data_size), 'f');
+    size_t num_fillers = (size_t{1} << 20) * gsl::narrow_cast<size_t>(
+        std::max(absl::GetFlag(FLAGS_cache_cap_mb), 1)) / filler.size() * 2;
+    for (size_t i = 0; i < num_fillers; i++) {
+        cache.PutAuxData(seqnum_of(num_entries + i), STRING_AS_SPAN(filler));
+    }
+    size_t num_evicted = 0;
+    for (size_t i = 0; i < num_entries; i++) {
+        if (!cache.GetAuxData(seqnum_of(i)).has_value()) {
+            num_evicted++;
+        }
+    }
+    LOG_F(INFO, "{}: {} of {} aux data evicted from the log cache",
+          backend, num_evicted, num_entries);
+
+    // Restart
+    db.reset();
+    db = OpenDB(backend, db_path);
+    db->InstallLogSpace(kLogSpaceId);
+    // Storage nodes look up aux data missing from the cache in the DB only
+    // for logs in reopened log spaces, or with aux data received since start
+    CHECK(db->IsReopenedLogSpace(kLogSpaceId)) << "Reopened log space not detected";
+    bench_utils::Samples<int32_t> get_latency(num_entries);
+    for (size_t i = 0; i < num_entries; i++) {
+        uint64_t seqnum = seqnum_of(i);
+        auto log_data = db->Get(kLogSpaceId, bits::LowHalf64(seqnum));
+        CHECK(log_data.has_value()) << "Log entry lost after restart";
+        CHECK_EQ(*log_data, fmt::format("log-{}", i));
+        uint64_t version = 0;
+        int64_t start_timestamp = GetMonotonicNanoTimestamp();
+        auto aux_data = db->GetAuxData(seqnum, &version);
+        int64_t elapsed_ns = GetMonotonicNanoTimestamp() - start_timestamp;
+        get_latency.Add(gsl::narrow_cast<int32_t>(elapsed_ns));
+        CHECK(aux_data.has_value()) << "Aux data lost after restart";
+        CHECK_EQ(version, 3U);
+        CHECK_EQ(*aux_data, AuxData(seqnum, 3));
+    }
+    get_latency.ReportStatistics(fmt::format("{}: get aux data latency (ns)", backend));
+
+    db.reset();
+    CHECK(fs_utils::RemoveDirectoryRecursively(db_path));
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    for (std::string_view backend : absl::StrSplit(absl::GetFlag(FLAGS_backends), ',',
+                                                   absl::SkipEmpty())) {
+        RunBackend(backend);
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+#define __FAAS_NOWARN_SIGN_CONVERSION
+#include "base/init.h"
+#include "base/common.h"
+#include "log/utils.h"
+#include "log/view.h"
+
+#include <random>
+
+ABSL_FLAG(size_t, num_phylogs, 4, "Number of physical logs (primary sequencers)");
+ABSL_FLAG(size_t, num_log_spaces, 1024, "Number of user log spaces");
+ABSL_FLAG(double, zipf_skew, 0.99, "Zipf skew of appends over user log spaces");
+ABSL_FLAG(size_t, appends_per_epoch, 1000000, "Appends sampled per epoch");
+ABSL_FLAG(double, append_rate, 100000, "Total appends per second");
+ABSL_FLAG(int, global_cut_interval_us, 300, "Interval of global cuts");
+ABSL_FLAG(size_t, hash_tokens, 128, "Number of log space hash tokens");
+ABSL_FLAG(size_t, max_placed, 1024, "Max user log spaces placed by load");
+ABSL_FLAG(uint32_t, random_seed, 23333, "Random seed");
+
+// Simulates per-sequencer global cut sizes under a skewed workload over
+// user log spaces, with the hashed mapping and with load-aware placement.
+// Placement is computed from append rates observed in the first epoch,
+// and evaluated on appends of the second one.
+
+using namespace faas;
+
+using log::View;
+using log::ViewProto;
+
+static ViewProto BuildViewProto(size_t num_phylogs, size_t num_tokens,
+                                std::mt19937* rnd_gen) {
+    ViewProto view_proto;
+    view_proto.set_view_id(0);
+    view_proto.set_metalog_replicas(1);
+    view_proto.set_userlog_replicas(1);
+    view_proto.set_index_replicas(1);
+    view_proto.set_num_phylogs(gsl::narrow_cast<uint32_t>(num_phylogs));
+    for (size_t i = 0; i < num_phylogs; i++) {
+        view_proto.add_sequencer_nodes(gsl::narrow_cast<uint32_t>(i));
+        view_proto.add_index_plan(0);
+    }
+    view_proto.add_engine_nodes(0);
+    view_proto.add_storage_nodes(0);
+    view_proto.add_storage_plan(0);
+    view_proto.set_log_space_hash_seed((*rnd_gen)());
+    std::vector<uint32_t> tokens(num_tokens);
+    for (size_t i = 0; i < num_tokens; i++) {
+        tokens[i] = gsl::narrow_cast<uint32_t>(i % num_phylogs);
+    }
+    std::shuffle(tokens.begin(), tokens.end(), *rnd_gen);
+    for (uint32_t token : tokens) {
+        view_proto.add_log_space_hash_tokens(token);
+    }
+    return view_proto;
+}
+
+static absl::flat_hash_map<uint32_t, uint64_t> SampleAppends(
+        const std::vector<uint32_t>& log_spaces, const std::vector<double>& weights,
+        size_t num_appends, std::mt19937* rnd_gen) {
+    std::discrete_distribution<size_t> dist(weights.begin(), weights.end());
+    absl::flat_hash_map<uint32_t, uint64_t> appends;
+    for (size_t i = 0; i < num_appends; i++) {
+        appends[log_spaces[dist(*rnd_gen)]]++;
+    }
+    return appends;
+}
+
+static void ReportCutSizes(std::string_view name, const View* view,
+                           const absl::flat_hash_map<uint32_t, uint64_t>& appends,
+                           size_t num_appends) {
+    absl::flat_hash_map<uint16_t, uint64_t> phylog_appends;
+    for (const auto& [user_logspace, count] : appends) {
+        phylog_appends[bits::LowHalf32(view->LogSpaceIdentifier(user_logspace))] += count;
+    }
+    double appends_per_cut = absl::GetFlag(FLAGS_append_rate)
+                           * absl::GetFlag(FLAGS_global_cut_interval_us) / 1e6;
+    std::vector<double> cut_sizes;
+    for (uint16_t sequencer_id : view->GetSequencerNodes()) {
+        double share = static_cast<double>(phylog_appends[sequencer_id])
+                     / static_cast<double>(num_appends);
+        cut_sizes.push_back(share * appends_per_cut);
+    }
+    double mean = absl::c_accumulate(cut_sizes, 0.0) / static_cast<double>(cut_sizes.size());
+    double var = 0;
+    for (double cut_size : cut_sizes) {
+        var += (cut_size - mean) * (cut_size - mean);
+    }
+    double stddev = std::sqrt(var / static_cast<double>(cut_sizes.size()));
+    double max_size = *absl::c_max_element(cut_sizes);
+    LOG(INFO) << fmt::format("{}: cut sizes = [{:.1f}], max/mean = {:.3f}, cv = {:.3f}",
+                             name, fmt::join(cut_sizes, ", "),
+                             max_size / mean, stddev / mean);
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+
+    size_t num_phylogs = absl::GetFlag(FLAGS_num_phylogs);
+    size_t num_log_spaces = absl::GetFlag(FLAGS_num_log_spaces);
+    size_t num_appends = absl::GetFlag(FLAGS_appends_per_epoch);
+    CHECK_GT(num_phylogs, 0U);
+    CHECK_GT(num_log_spaces, 0U);
+    CHECK_GT(num_appends, 0U);
+
+    std::mt19937 rnd_gen(absl::GetFlag(FLAGS_random_seed));
+    ViewProto view_proto = BuildViewProto(
+        num_phylogs, absl::GetFlag(FLAGS_hash_tokens), &rnd_gen);
+    View hashed_view(view_proto);
+
+    std::vector<uint32_t> log_spaces(num_log_spaces);
+    std::vector<double> weights(num_log_spaces);
+    for (size_t i = 0; i < num_log_spaces; i++) {
+        log_spaces[i] = static_cast<uint32_t>(rnd_gen());
+        weights[i] = 1.0 / std::pow(static_cast<double>(i + 1),
+                                    absl::GetFlag(FLAGS_zipf_skew));
+    }
+
+    // Epoch 1: rates as sequencers would report them
+    auto observed = SampleAppends(log_spaces, weights, num_appends, &rnd_gen);
+    log_utils::LogSpaceLoads loads;
+    for (const auto& [user_logspace, count] : observed) {
+        loads[user_logspace] = static_cast<double>(count);
+    }
+    auto placement = log_utils::PlaceLogSpacesByLoad(
+        &hashed_view, loads, absl::GetFlag(FLAGS_max_placed));
+    ViewProto placed_view_proto = view_proto;
+    placed_view_proto.set_view_id(1);
+    for (const auto& [user_logspace, sequencer_id] : placement) {
+        placed_view_proto.add_placed_log_spaces(user_logspace);
+        placed_view_proto.add_placed_sequencers(sequencer_id);
+    }
+    View placed_view(placed_view_proto);
+    LOG(INFO) << fmt::format("{} of {} user log spaces placed away from hashed phylogs",
+                             placement.size(), num_log_spaces);
+
+    // Epoch 2: evaluate both mappings on fresh appends
+    auto appends = SampleAppends(log_spaces, weights, num_appends, &rnd_gen);
+    ReportCutSizes("Hashed", &hashed_view, appends, num_appends);
+    ReportCutSizes("Load-aware", &placed_view, appends, num_appends);
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+#define __FAAS_NOWARN_SIGN_CONVERSION
+#include "base/init.h"
+#include "base/common.h"
+#include "common/protocol.h"
+#include "log/view.h"
+#include "utils/random.h"
+
+ABSL_FLAG(size_t, num_engines, 64, "Number of engine nodes");
+ABSL_FLAG(size_t, num_storages, 16, "Number of storage nodes");
+ABSL_FLAG(size_t, metalog_bytes, 256, "Size of metalog payloads");
+ABSL_FLAG(size_t, num_rounds, 1000, "Number of random sets of offline engines checked");
+
+// Simulates propagation of one metalog through the fan-out tree of a view,
+// as SequencerBase::PropagateMetaLog and EngineBase::ForwardMetaLog do it,
+// with random interior engines offline. Checks that every online engine and
+// every storage node receives the metalog exactly once, and reports egress
+// of the sequencer with and without fan-out.
+
+using namespace faas;
+
+using log::View;
+using log::ViewProto;
+
+static ViewProto BuildViewProto(size_t num_engines, size_t num_storages) {
+    ViewProto view_proto;
+    view_proto.set_view_id(0);
+    view_proto.set_metalog_replicas(1);
+    view_proto.set_userlog_replicas(1);
+    view_proto.set_index_replicas(1);
+    view_proto.set_num_phylogs(1);
+    view_proto.add_sequencer_nodes(0);
+    view_proto.add_index_plan(0);
+    for (size_t i = 0; i < num_storages; i++) {
+        view_proto.add_storage_nodes(gsl::narrow_cast<uint32_t>(i));
+    }
+    for (size_t i = 0; i < num_engines; i++) {
+        view_proto.add_engine_nodes(gsl::narrow_cast<uint32_t>(i));
+        view_proto.add_storage_plan(gsl::narrow_cast<uint32_t>(i % num_storages));
+    }
+    view_proto.add_log_space_hash_tokens(0);
+    return view_proto;
+}
+
+struct Delivery {
+    std::vector<size_t> engine_counts;
+    std::vector<size_t> storage_counts;
+    size_t sequencer_messages;
+};
+
+static Delivery Propagate(const View& view, size_t fanout,
+                          const absl::flat_hash_set<uint16_t>& offline_engines) {
+    Delivery delivery;
+    delivery.engine_counts.assign(view.num_engine_nodes(), 0);
+    delivery.storage_counts.assign(view.num_storage_nodes(), 0);
+    auto is_down = [&offline_engines] (uint16_t engine_id) {
+        return offline_engines.contains(engine_id);
+    };
+    std::vector<uint16_t> engines;
+    std::vector<uint16_t> storages;
+    if (fanout == 0) {
+        // Without fan-out, the sequencer sends to every node
+        for (uint16_t engine_id: view.GetEngineNodes()) {
+            if (!is_down(engine_id)) {
+                engines.push_back(engine_id);
+            }
+        }
+        storages.assign(view.GetStorageNodes().begin(), view.GetStorageNodes().end());
+    } else {
+        view.ResolveMetaLogFanoutTargets(fanout, view.GetMetaLogFanoutRoots(fanout),
+                                         is_down, &engines, &storages);
+    }
+    delivery.sequencer_messages = engines.size() + storages.size();
+    for (uint16_t storage_id: storages) {
+        delivery.storage_counts[storage_id]++;
+    }
+    while (!engines.empty()) {
+        uint16_t engine_id = engines.back();
+        engines.pop_back();
+        delivery.engine_counts[engine_id]++;
+        if (fanout == 0) {
+            continue;
+        }
+        const View::Engine* engine_node = view.GetEngineNode(engine_id);
+        std::vector<uint16_t> children;
+        std::vector<uint16_t> child_storages(engine_node->GetMetaLogStorageNodes().begin(),
+                                             engine_node->GetMetaLogStorageNodes().end());
+        view.ResolveMetaLogFanoutTargets(fanout, engine_node->GetMetaLogFanoutChildren(fanout),
+                                         is_down, &children, &child_storages);
+        engines.insert(engines.end(), children.begin(), children.end());
+        for (uint16_t storage_id: child_storages) {
+            delivery.storage_counts[storage_id]++;
+        }
+    }
+    return delivery;
+}
+
+static void CheckDelivery(const View& view, const Delivery& delivery,
+                          const absl::flat_hash_set<uint16_t>& offline_engines) {
+    for (uint16_t engine_id: view.GetEngineNodes()) {
+        size_t expected = offline_engines.contains(engine_id) ? 0 : 1;
+        CHECK_EQ(delivery.engine_counts[engine_id], expected)
+            << "Engine " << engine_id << " receives the metalog "
+            << delivery.engine_counts[engine_id] << " times";
+    }
+    for (uint16_t storage_id: view.GetStorageNodes()) {
+        CHECK_EQ(delivery.storage_counts[storage_id], 1U)
+            << "Storage " << storage_id << " receives the metalog "
+            << delivery.storage_counts[storage_id] << " times";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    size_t num_engines = absl::GetFlag(FLAGS_num_engines);
+    size_t num_storages = absl::GetFlag(FLAGS_num_storages);
+    CHECK_GE(num_engines, num_storages) << "Every storage node needs a source engine";
+    View view(BuildViewProto(num_engines, num_storages));
+    size_t message_bytes = sizeof(protocol::SharedLogMessage)
+                         + absl::GetFlag(FLAGS_metalog_bytes);
+
+    for (size_t fanout: {size_t{0}, size_t{2}, size_t{4}, size_t{8}}) {
+        Delivery delivery = Propagate(view, fanout, {});
+        CheckDelivery(view, delivery, {});
+        LOG_F(INFO, "Fanout {}: sequencer sends {} messages, {} bytes per metalog",
+              fanout, delivery.sequencer_messages, delivery.sequencer_messages * message_bytes);
+
+        if (fanout == 0) {
+            continue;
+        }
+        size_t num_rounds = absl::GetFlag(FLAGS_num_rounds);
+        size_t max_messages = 0;
+        for (size_t round = 0; round < num_rounds; round++) {
+            absl::flat_hash_set<uint16_t> offline_engines;
+            size_t num_offline = static_cast<size_t>(
+                utils::GetRandomInt(1, gsl::narrow_cast<int>(num_engines / 4 + 2)));
+            for (size_t i = 0; i < num_offline; i++) {
+                offline_engines.insert(gsl::narrow_cast<uint16_t>(
+                    utils::GetRandomInt(0, gsl::narrow_cast<int>(num_engines))));
+            }
+            delivery = Propagate(view, fanout, offline_engines);
+            CheckDelivery(view, delivery, offline_engines);
+            max_messages = std::max(max_messages, delivery.sequencer_messages);
+        }
+        LOG_F(INFO, "Fanout {} with offline engines: sequencer sends at most {} messages",
+              fanout, max_messages);
+    }
+    LOG(INFO) << "Metalog fan-out checks passed";
+    return 0;
+}
@@ -0,0 +1,181 @@
+#define __FAAS_NOWARN_SIGN_CONVERSION
+#include "base/init.h"
+#include "base/common.h"
+#include "log/flags.h"
+#include "log/log_space.h"
+#include "log/utils.h"
+#include "log/view.h"
+#include "utils/random.h"
+
+ABSL_FLAG(size_t, num_shards, 4, "Number of engine shards");
+ABSL_FLAG(size_t, active_ticks, 2000, "Number of gap check intervals with new metalogs");
+ABSL_FLAG(size_t, metalogs_per_tick, 2, "Number of metalogs produced per interval");
+ABSL_FLAG(size_t, max_idle_ticks, 1000, "Gap check intervals allowed to recover when idle");
+ABSL_FLAG(size_t, num_nodes, 4, "Number of nodes receiving metalogs");
+
+// Delivers metalogs of a MetaLogPrimary to the logspaces of --num_nodes
+// nodes, dropping them independently at --slog_debug_metalog_drop_rate (0.05
+// if unset) as engine and storage nodes do, and serves METALOG_FETCH as
+// Sequencer::OnRecvMetaLogFetch does on every gap check tick, through a
+// serialized METALOGS payload. Checks every node converges to the metalogs
+// of the primary, also when the last metalogs are lost right before the
+// logspace goes idle, and reports the ticks taken. Time is counted in gap
+// check intervals.
+
+using namespace faas;
+
+using log::LogSpaceBase;
+using log::MetaLogBackup;
+using log::MetaLogPrimary;
+using log::View;
+using log::ViewProto;
+
+static ViewProto BuildViewProto(size_t num_shards) {
+    ViewProto view_proto;
+    view_proto.set_view_id(0);
+    view_proto.set_metalog_replicas(1);
+    view_proto.set_userlog_replicas(1);
+    view_proto.set_index_replicas(1);
+    view_proto.set_num_phylogs(1);
+    view_proto.add_sequencer_nodes(0);
+    view_proto.add_index_plan(0);
+    view_proto.add_storage_nodes(0);
+    for (size_t i = 0; i < num_shards; i++) {
+        view_proto.add_engine_nodes(gsl::narrow_cast<uint32_t>(i));
+        view_proto.add_storage_plan(0);
+    }
+    view_proto.add_log_space_hash_tokens(0);
+    return view_proto;
+}
+
+struct FetchResult {
+    bool     recovered;
+    size_t   idle_ticks;
+    size_t   num_fetches;
+    size_t   num_dropped;
+};
+
+static bool AllRecovered(const MetaLogPrimary& primary,
+                         const std::vector<std::unique_ptr<MetaLogBackup>>& nodes) {
+    for (const auto& node : nodes) {
+        if (node->metalog_position() != primary.metalog_position()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static FetchResult RunFetch(const View& view, double drop_rate) {
+    MetaLogPrimary primary(&view, /* sequencer_id= */ 0);
+    // Each stands for the logspace of an engine or storage node
+    std::vector<std::unique_ptr<MetaLogBackup>> nodes;
+    for (size_t i = 0; i < absl::GetFlag(FLAGS_num_nodes); i++) {
+        nodes.push_back(std::make_unique<MetaLogBackup>(&view, /* sequencer_id= */ 0));
+    }
+    size_t max_batch = absl::GetFlag(FLAGS_slog_metalog_fetch_max_batch);
+    size_t num_source_engines = view.GetStorageNode(0)->GetSourceEngineNodes().size();
+    std::vector<uint32_t> progress(num_source_engines, 0);
+    FetchResult result = {.recovered = false, .idle_ticks = 0,
+                          .num_fetches = 0, .num_dropped = 0};
+
+    auto gap_check_tick = [&] () {
+        for (auto& node : nodes) {
+            auto gap = node->CheckMetaLogGap();
+            if (!gap.has_value()) {
+                continue;
+            }
+            CHECK_EQ(gap->sequencer_id, 0U);
+            result.num_fetches++;
+            uint32_t end_position = std::min(gap->end_position,
+                                             gap->start_position
+                                                 + gsl::narrow_cast<uint32_t>(max_batch));
+            std::string payload;
+            if (primary.SerializeMetaLogs(gap->start_position, end_position, &payload) == 0) {
+                continue;
+            }
+            log::MetaLogsProto metalogs_proto =
+                log_utils::MetaLogsFromPayload(STRING_AS_SPAN(payload));
+            CHECK_EQ(metalogs_proto.logspace_id(), primary.identifier());
+            for (const log::MetaLogProto& metalog : metalogs_proto.metalogs()) {
+                node->ProvideMetaLog(metalog);
+            }
+        }
+    };
+
+    size_t active_ticks = absl::GetFlag(FLAGS_active_ticks);
+    size_t per_tick = absl::GetFlag(FLAGS_metalogs_per_tick);
+    for (size_t tick = 0; tick < active_ticks; tick++) {
+        for (size_t i = 0; i < per_tick; i++) {
+            for (uint32_t& p : progress) {
+                p += gsl::narrow_cast<uint32_t>(utils::GetRandomInt(1, 3));
+            }
+            primary.UpdateStorageProgress(
+                0, std::span<const char>(reinterpret_cast<const char*>(progress.data()),
+                                         progress.size() * sizeof(uint32_t)));
+            auto metalog = primary.MarkNextCut();
+            CHECK(metalog.has_value());
+            // The last metalogs are always lost
+            bool last_tick = (tick + 1 == active_ticks);
+            for (auto& node : nodes) {
+                if (last_tick || utils::GetRandomDouble() < drop_rate) {
+                    result.num_dropped++;
+                    continue;
+                }
+                node->ProvideMetaLog(*metalog);
+            }
+        }
+        gap_check_tick();
+    }
+    for (const auto& node : nodes) {
+        CHECK_LT(node->metalog_position(), primary.metalog_position());
+    }
+
+    size_t max_idle_ticks = absl::GetFlag(FLAGS_max_idle_ticks);
+    while (result.idle_ticks < max_idle_ticks) {
+        result.idle_ticks++;
+        gap_check_tick();
+        if (AllRecovered(primary, nodes)) {
+            result.recovered = true;
+            break;
+        }
+    }
+    if (result.recovered) {
+        for (uint32_t pos = 0; pos < primary.metalog_position(); pos++) {
+            std::string expected = primary.GetMetaLog(pos)->SerializeAsString();
+            for (const auto& node : nodes) {
+                CHECK_EQ(node->GetMetaLog(pos)->SerializeAsString(), expected)
+                    << "Node diverges from the primary at metalog " << pos;
+            }
+        }
+    }
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    double drop_rate = absl::GetFlag(FLAGS_slog_debug_metalog_drop_rate);
+    if (drop_rate <= 0) {
+        drop_rate = 0.05;
+    }
+    size_t stale_gap_checks = absl::GetFlag(FLAGS_slog_metalog_stale_gap_checks);
+    CHECK_GT(stale_gap_checks, 0U);
+    CHECK_GT(absl::GetFlag(FLAGS_num_nodes), 0U);
+    View view(BuildViewProto(absl::GetFlag(FLAGS_num_shards)));
+
+    FetchResult result = RunFetch(view, drop_rate);
+    LOG_F(INFO, "Drop rate {}, {} nodes: {} metalogs dropped, {} fetches, "
+                "lost tail recovered after {} idle ticks",
+          drop_rate, absl::GetFlag(FLAGS_num_nodes), result.num_dropped,
+          result.num_fetches, result.idle_ticks);
+    CHECK(result.recovered) << "Lost tail metalogs are not recovered";
+    // A gap left from the active phase takes two more ticks to fetch, and
+    // moves metalog_position, which restarts the stale period
+    CHECK_LE(result.idle_ticks, stale_gap_checks + 4);
+
+    // Without probing on staleness, nothing reveals the lost tail
+    absl::SetFlag(&FLAGS_slog_metalog_stale_gap_checks, size_t{0});
+    result = RunFetch(view, drop_rate);
+    CHECK(!result.recovered);
+    LOG(INFO) << "Metalog fetch checks passed";
+    return 0;
+}
@@ -0,0 +1,533 @@
+#define __FAAS_NOWARN_SIGN_CONVERSION
+#include "base/init.h"
+#include "base/common.h"
+#include "log/flags.h"
+#include "log/journal.h"
+#include "log/log_space.h"
+#include "log/utils.h"
+#include "log/view.h"
+#include "proto/shared_log.pb.h"
+#include "server/io_worker.h"
+#include "utils/bench.h"
+#include "utils/fs.h"
+#include "utils/kth_largest.h"
+#include "utils/random.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+ABSL_FLAG(size_t, num_shards, 8, "Number of engine shards per metalog");
+ABSL_FLAG(size_t, num_replicas, 3, "Number of replica sequencers");
+ABSL_FLAG(size_t, metalogs_per_tick, 4, "Number of metalogs produced per tick");
+ABSL_FLAG(absl::Duration, duration, absl::Seconds(10), "Duration to run");
+ABSL_FLAG(size_t, num_checked_cuts, 10000, "Number of cuts replicated in correctness checks");
+ABSL_FLAG(std::string, tmp_dir, "/tmp", "Directory for temporary journal files");
+
+using namespace faas;
+
+using log::MetaLogProto;
+using log::MetaLogsProto;
+using log::MetaLogPrimary;
+using log::MetaLogBackup;
+using log::View;
+using log::ViewProto;
+
+static MetaLogProto BuildMetaLog(uint32_t metalog_seqnum, size_t num_shards) {
+    MetaLogProto metalog;
+    metalog.set_logspace_id(1);
+    metalog.set_metalog_seqnum(metalog_seqnum);
+    metalog.set_type(MetaLogProto::NEW_LOGS);
+    auto* new_logs_proto = metalog.mutable_new_logs_proto();
+    new_logs_proto->set_start_seqnum(metalog_seqnum * 16);
+    for (size_t i = 0; i < num_shards; i++) {
+        new_logs_proto->add_shard_starts(metalog_seqnum);
+        new_logs_proto->add_shard_deltas(utils::GetRandomInt(0, 4));
+    }
+    return metalog;
+}
+
+// Acks for one metalog arrive from replicas in a random order
+static std::vector<uint16_t> ShuffledReplicas(size_t num_replicas) {
+    std::vector<uint16_t> replicas(num_replicas);
+    for (size_t i = 0; i < num_replicas; i++) {
+        replicas[i] = gsl::narrow_cast<uint16_t>(i);
+    }
+    for (size_t i = num_replicas; i > 1; i--) {
+        std::swap(replicas[i - 1],
+                  replicas[utils::GetRandomInt(0, gsl::narrow_cast<int>(i))]);
+    }
+    return replicas;
+}
+
+// Baseline: serialize and send each metalog on its own, and sort
+// replica progresses on every ack
+void BenchPerMetaLog(size_t num_shards, size_t num_replicas, size_t per_tick) {
+    absl::flat_hash_map<uint16_t, uint32_t> progresses;
+    std::vector<std::string> egress(num_replicas);
+    uint32_t next_seqnum = 0;
+    uint32_t replicated = 0;
+    bench_utils::BenchLoop bench_loop(absl::GetFlag(FLAGS_duration), [&] () -> bool {
+        for (size_t i = 0; i < per_tick; i++) {
+            MetaLogProto metalog = BuildMetaLog(next_seqnum++, num_shards);
+            std::string payload;
+            CHECK(metalog.SerializeToString(&payload));
+            for (size_t j = 0; j < num_replicas; j++) {
+                egress[j].assign(payload);
+            }
+        }
+        for (uint16_t replica : ShuffledReplicas(num_replicas)) {
+            progresses[replica] = next_seqnum;
+            std::vector<uint32_t> tmp;
+            for (const auto& [id, progress] : progresses) {
+                tmp.push_back(progress);
+            }
+            absl::c_sort(tmp);
+            replicated = tmp.at(tmp.size() / 2);
+        }
+        return true;
+    });
+    CHECK_EQ(replicated, next_seqnum);
+    LOG(INFO) << "Per-metalog path: "
+              << next_seqnum / absl::ToDoubleSeconds(bench_loop.elapsed_time())
+              << " metalogs per second";
+}
+
+// Coalesce metalogs of one tick into a single MetaLogsProto, and track
+// the quorum position incrementally
+void BenchBatched(size_t num_shards, size_t num_replicas, size_t per_tick) {
+    utils::KthLargestTracker<uint16_t, uint32_t> progresses(
+        num_replicas - num_replicas / 2);
+    for (size_t i = 0; i < num_replicas; i++) {
+        progresses.Add(gsl::narrow_cast<uint16_t>(i), 0);
+    }
+    std::vector<std::string> egress(num_replicas);
+    uint32_t next_seqnum = 0;
+    uint32_t replicated = 0;
+    bench_utils::BenchLoop bench_loop(absl::GetFlag(FLAGS_duration), [&] () -> bool {
+        MetaLogsProto metalogs;
+        metalogs.set_logspace_id(1);
+        for (size_t i = 0; i < per_tick; i++) {
+            *metalogs.add_metalogs() = BuildMetaLog(next_seqnum++, num_shards);
+        }
+        std::string payload;
+        CHECK(metalogs.SerializeToString(&payload));
+        for (size_t j = 0; j < num_replicas; j++) {
+            egress[j].assign(payload);
+        }
+        for (uint16_t replica : ShuffledReplicas(num_replicas)) {
+            progresses.Update(replica, next_seqnum);
+            replicated = progresses.kth_largest();
+        }
+        return true;
+    });
+    CHECK_EQ(replicated, next_seqnum);
+    LOG(INFO) << "Batched path: "
+              << next_seqnum / absl::ToDoubleSeconds(bench_loop.elapsed_time())
+              << " metalogs per second";
+}
+
+// Compares KthLargestTracker with sorting all values after every update
+static void CheckKthLargestTracker() {
+    for (size_t n = 1; n <= 7; n++) {
+        for (size_t k = 1; k <= n; k++) {
+            utils::KthLargestTracker<uint16_t, uint32_t> tracker(k);
+            std::vector<uint32_t> values(n, 0);
+            for (size_t i = 0; i < n; i++) {
+                CHECK(tracker.Add(gsl::narrow_cast<uint16_t>(i), 0));
+            }
+            CHECK(!tracker.Add(0, 1)) << "Duplicate key is added";
+            CHECK_EQ(tracker.size(), n);
+            for (int round = 0; round < 1000; round++) {
+                uint16_t key = gsl::narrow_cast<uint16_t>(
+                    utils::GetRandomInt(0, gsl::narrow_cast<int>(n)));
+                uint32_t value = values[key] + gsl::narrow_cast<uint32_t>(
+                    utils::GetRandomInt(0, 4));
+                CHECK(tracker.Update(key, value));
+                values[key] = value;
+                if (value > 0) {
+                    CHECK(!tracker.Update(key, value - 1)) << "Value moves backwards";
+                }
+                CHECK(!tracker.Update(gsl::narrow_cast<uint16_t>(n), value));
+                CHECK_EQ(tracker.Get(key).value(), value);
+                std::vector<uint32_t> sorted = values;
+                absl::c_sort(sorted, std::greater<uint32_t>());
+                CHECK_EQ(tracker.kth_largest(), sorted[k - 1])
+                    << fmt::format("n={}, k={}", n, k);
+            }
+        }
+    }
+    LOG(INFO) << "KthLargestTracker checks passed";
+}
+
+static ViewProto BuildViewProto(size_t num_sequencers, size_t num_engines) {
+    ViewProto view_proto;
+    view_proto.set_view_id(0);
+    view_proto.set_metalog_replicas(gsl::narrow_cast<uint32_t>(num_sequencers));
+    view_proto.set_userlog_replicas(1);
+    view_proto.set_index_replicas(1);
+    view_proto.set_num_phylogs(1);
+    for (size_t i = 0; i < num_sequencers; i++) {
+        view_proto.add_sequencer_nodes(gsl::narrow_cast<uint32_t>(i));
+        view_proto.add_index_plan(0);
+    }
+    view_proto.add_storage_nodes(0);
+    for (size_t i = 0; i < num_engines; i++) {
+        view_proto.add_engine_nodes(gsl::narrow_cast<uint32_t>(i));
+        view_proto.add_storage_plan(0);
+    }
+    view_proto.add_log_space_hash_tokens(0);
+    return view_proto;
+}
+
+// Replicates cuts of MetaLogPrimary to MetaLogBackups as METALOGS batches,
+// which arrive at one backup in a shuffled order, and checks that backups
+// end up with the same metalogs and the primary sees them replicated
+static void CheckBatchedReplication(size_t num_shards, size_t num_replicas, size_t per_tick) {
+    View view(BuildViewProto(num_replicas, num_shards));
+    MetaLogPrimary primary(&view, /* sequencer_id= */ 0);
+    std::vector<uint16_t> backup_ids(
+        view.GetSequencerNode(0)->GetReplicaSequencerNodes().begin(),
+        view.GetSequencerNode(0)->GetReplicaSequencerNodes().end());
+    std::vector<std::unique_ptr<MetaLogBackup>> backups;
+    for (size_t i = 0; i < backup_ids.size(); i++) {
+        backups.push_back(std::make_unique<MetaLogBackup>(&view, /* sequencer_id= */ 0));
+    }
+    size_t num_source_engines = view.GetStorageNode(0)->GetSourceEngineNodes().size();
+    std::vector<uint32_t> progress(num_source_engines, 0);
+    std::vector<std::string> delayed_batches;
+    auto deliver = [&] (size_t i, std::span<const char> payload) {
+        MetaLogsProto metalogs = log_utils::MetaLogsFromPayload(payload);
+        CHECK_EQ(metalogs.logspace_id(), primary.identifier());
+        for (const MetaLogProto& metalog : metalogs.metalogs()) {
+            backups[i]->ProvideMetaLog(metalog);
+        }
+        primary.UpdateReplicaProgress(backup_ids[i], backups[i]->metalog_position());
+    };
+
+    size_t num_cuts = absl::GetFlag(FLAGS_num_checked_cuts);
+    MetaLogsProto batch;
+    for (size_t n = 0; n < num_cuts; n++) {
+        for (uint32_t& p : progress) {
+            p += gsl::narrow_cast<uint32_t>(utils::GetRandomInt(0, 3));
+        }
+        primary.UpdateStorageProgress(
+            0, std::span<const char>(reinterpret_cast<const char*>(progress.data()),
+                                     progress.size() * sizeof(uint32_t)));
+        auto metalog = primary.MarkNextCut();
+        if (!metalog.has_value()) {
+            continue;
+        }
+        batch.set_logspace_id(primary.identifier());
+        *batch.add_metalogs() = std::move(*metalog);
+        if (gsl::narrow_cast<size_t>(batch.metalogs_size()) < per_tick) {
+            continue;
+        }
+        std::string payload;
+        CHECK(batch.SerializeToString(&payload));
+        batch.Clear();
+        for (size_t i = 0; i + 1 < backups.size(); i++) {
+            deliver(i, STRING_AS_SPAN(payload));
+        }
+        // The last backup sees batches reordered
+        delayed_batches.push_back(std::move(payload));
+        if (delayed_batches.size() == 4) {
+            std::reverse(delayed_batches.begin(), delayed_batches.end());
+            for (const std::string& delayed : delayed_batches) {
+                deliver(backups.size() - 1, STRING_AS_SPAN(delayed));
+            }
+            delayed_batches.clear();
+        }
+    }
+    if (batch.metalogs_size() > 0) {
+        std::string payload;
+        CHECK(batch.SerializeToString(&payload));
+        for (size_t i = 0; i + 1 < backups.size(); i++) {
+            deliver(i, STRING_AS_SPAN(payload));
+        }
+        delayed_batches.push_back(std::move(payload));
+    }
+    std::reverse(delayed_batches.begin(), delayed_batches.end());
+    for (const std::string& delayed : delayed_batches) {
+        deliver(backups.size() - 1, STRING_AS_SPAN(delayed));
+    }
+
+    uint32_t position = primary.metalog_position();
+    CHECK_GT(position, 0U);
+    CHECK(primary.all_metalog_replicated());
+    for (const auto& backup : backups) {
+        CHECK_EQ(backup->metalog_position(), position);
+        for (uint32_t pos = 0; pos < position; pos++) {
+            CHECK_EQ(backup->GetMetaLog(pos)->SerializeAsString(),
+                     primary.GetMetaLog(pos)->SerializeAsString());
+        }
+    }
+    LOG_F(INFO, "Batched replication checks passed: {} metalogs to {} backups",
+          position, backups.size());
+}
+
+// Mirrors Sequencer::OnRecvNewMetaLog without the journal. Returns the
+// position acknowledged with META_PROG, or 0 if none is sent.
+static uint32_t ReceiveOnBackup(MetaLogBackup* backup, const MetaLogsProto& metalogs) {
+    uint32_t old_position = backup->metalog_position();
+    for (const MetaLogProto& metalog : metalogs.metalogs()) {
+        backup->ProvideMetaLog(metalog);
+    }
+    uint32_t new_position = backup->metalog_position();
+    if (new_position > old_position) {
+        return new_position;
+    }
+    int n = metalogs.metalogs_size();
+    if (n > 0 && metalogs.metalogs(n - 1).metalog_seqnum() < old_position) {
+        return old_position;
+    }
+    return 0;
+}
+
+// Journals `metalogs` in a child process, which is killed right after
+// leaving a torn record behind the persisted ones. Returns metalogs
+// replayed from the journal file, once the torn tail is truncated away.
+static std::vector<MetaLogProto> ReplayAfterCrash(const std::vector<MetaLogProto>& metalogs) {
+    CHECK(!metalogs.empty());
+    uint32_t logspace_id = metalogs[0].logspace_id();
+    std::string dir = fs_utils::JoinPath(absl::GetFlag(FLAGS_tmp_dir),
+                                         "faas_journal_XXXXXX");
+    PCHECK(mkdtemp(dir.data()) != nullptr);
+    std::string file_path = log::MetaLogJournal::FilePath(dir, logspace_id);
+    size_t persisted_size = 0;
+    for (const MetaLogProto& metalog : metalogs) {
+        persisted_size += 2 * sizeof(uint32_t) + metalog.ByteSizeLong();
+    }
+
+    pid_t pid = fork();
+    PCHECK(pid >= 0);
+    if (pid == 0) {
+        server::IOWorker io_worker(0, "Journal", 4096);
+        int pipe_fds[2] = {-1, -1};
+        PCHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pipe_fds) == 0);
+        io_worker.Start(pipe_fds[1]);
+        uint32_t end = gsl::narrow_cast<uint32_t>(metalogs.size());
+        absl::Notification persisted;
+        log::MetaLogJournal journal(
+            logspace_id, file_path, &io_worker,
+            [end, &persisted] (uint32_t, uint32_t end_position) {
+                if (end_position == end) {
+                    persisted.Notify();
+                }
+            });
+        std::vector<MetaLogProto> replayed;
+        CHECK(journal.Open(&replayed));
+        CHECK(replayed.empty());
+        for (const MetaLogProto& metalog : metalogs) {
+            journal.Append(metalog);
+            if (metalog.metalog_seqnum() % 64 == 63) {
+                io_worker.ScheduleFunction(nullptr, [&journal] { journal.Flush(); });
+            }
+        }
+        io_worker.ScheduleFunction(nullptr, [&journal] { journal.Flush(); });
+        persisted.WaitForNotification();
+        // Killed while writing the next record
+        std::string data = metalogs.back().SerializeAsString();
+        uint32_t header[2] = { gsl::narrow_cast<uint32_t>(data.size()), 0 };
+        auto fd = fs_utils::Open(file_path, O_WRONLY | O_APPEND);
+        CHECK(fd.has_value());
+        PCHECK(write(*fd, header, sizeof(header)) == sizeof(header));
+        PCHECK(write(*fd, data.data(), data.size() / 2) >= 0);
+        raise(SIGKILL);
+    }
+    int status = 0;
+    PCHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL)
+        << "Journal writer exited unexpectedly";
+
+    struct stat st;
+    PCHECK(stat(file_path.c_str(), &st) == 0);
+    CHECK_GT(gsl::narrow_cast<size_t>(st.st_size), persisted_size) << "No torn tail is left";
+    std::vector<MetaLogProto> replayed;
+    {
+        log::MetaLogJournal journal(logspace_id, file_path, nullptr, nullptr);
+        CHECK(journal.Open(&replayed));
+        CHECK_EQ(journal.persisted_position(), metalogs.size());
+    }
+    PCHECK(stat(file_path.c_str(), &st) == 0);
+    CHECK_EQ(gsl::narrow_cast<size_t>(st.st_size), persisted_size) << "Torn tail is not truncated";
+    CHECK_EQ(replayed.size(), metalogs.size());
+    for (size_t i = 0; i < metalogs.size(); i++) {
+        CHECK_EQ(replayed[i].SerializeAsString(), metalogs[i].SerializeAsString());
+    }
+    CHECK(fs_utils::RemoveDirectoryRecursively(dir));
+    return replayed;
+}
+
+// Restarts the primary from its metalogs, as replayed from a journal file
+// after a crash, and checks that re-sending the replayed tail, as
+// ReplicateReplayedMetaLogs does, restores replica progress so that cuts
+// are no longer held back
+static void CheckPrimaryRestart(size_t num_shards, size_t num_replicas) {
+    View view(BuildViewProto(num_replicas, num_shards));
+    auto primary = std::make_unique<MetaLogPrimary>(&view, /* sequencer_id= */ 0);
+    std::vector<uint16_t> backup_ids(
+        view.GetSequencerNode(0)->GetReplicaSequencerNodes().begin(),
+        view.GetSequencerNode(0)->GetReplicaSequencerNodes().end());
+    std::vector<std::unique_ptr<MetaLogBackup>> backups;
+    for (size_t i = 0; i < backup_ids.size(); i++) {
+        backups.push_back(std::make_unique<MetaLogBackup>(&view, /* sequencer_id= */ 0));
+    }
+    uint32_t max_inflight = gsl::narrow_cast<uint32_t>(
+        absl::GetFlag(FLAGS_slog_max_inflight_metalogs));
+    size_t num_source_engines = view.GetStorageNode(0)->GetSourceEngineNodes().size();
+    std::vector<uint32_t> progress(num_source_engines, 0);
+    auto advance_progress = [&] () {
+        for (uint32_t& p : progress) {
+            p += gsl::narrow_cast<uint32_t>(utils::GetRandomInt(1, 3));
+        }
+    };
+    auto next_cut = [&] (MetaLogPrimary* primary) {
+        primary->UpdateStorageProgress(
+            0, std::span<const char>(reinterpret_cast<const char*>(progress.data()),
+                                     progress.size() * sizeof(uint32_t)));
+        auto metalog = primary->MarkNextCut();
+        CHECK(metalog.has_value());
+        return std::move(*metalog);
+    };
+    auto replicate = [&] (MetaLogPrimary* primary, size_t i, const MetaLogsProto& metalogs) {
+        uint32_t ack = ReceiveOnBackup(backups[i].get(), metalogs);
+        if (ack > 0) {
+            primary->UpdateReplicaProgress(backup_ids[i], ack);
+        }
+    };
+
+    // Before the crash, the last backup misses the newest metalogs
+    size_t num_cuts = absl::GetFlag(FLAGS_num_checked_cuts);
+    for (size_t n = 0; n < num_cuts; n++) {
+        MetaLogsProto batch;
+        batch.set_logspace_id(primary->identifier());
+        advance_progress();
+        *batch.add_metalogs() = next_cut(primary.get());
+        size_t num_receivers = n + max_inflight < num_cuts ? backups.size() : backups.size() - 1;
+        for (size_t i = 0; i < num_receivers; i++) {
+            replicate(primary.get(), i, batch);
+        }
+    }
+    uint32_t position = primary->metalog_position();
+    std::vector<MetaLogProto> persisted;
+    for (uint32_t pos = 0; pos < position; pos++) {
+        persisted.push_back(*primary->GetMetaLog(pos));
+    }
+    std::vector<MetaLogProto> journal = ReplayAfterCrash(persisted);
+    advance_progress();
+    MetaLogProto expected_next = next_cut(primary.get());
+
+    // Restart, progress of all replicas is lost
+    auto restarted = std::make_unique<MetaLogPrimary>(&view, /* sequencer_id= */ 0);
+    for (const MetaLogProto& metalog : journal) {
+        restarted->ProvideMetaLog(metalog);
+    }
+    CHECK_EQ(restarted->metalog_position(), position);
+    CHECK_EQ(restarted->replicated_metalog_position(), 0U);
+    CHECK_GE(restarted->num_inflight_metalogs(), max_inflight)
+        << "Restarted primary is not blocked before re-replication";
+
+    MetaLogsProto tail;
+    tail.set_logspace_id(restarted->identifier());
+    for (uint32_t pos = position - std::min(max_inflight, position); pos < position; pos++) {
+        *tail.add_metalogs() = journal[pos];
+    }
+    for (size_t i = 0; i < backups.size(); i++) {
+        replicate(restarted.get(), i, tail);
+    }
+    CHECK(restarted->all_metalog_replicated());
+    for (const auto& backup : backups) {
+        CHECK_EQ(backup->metalog_position(), position);
+    }
+
+    // Cut positions are restored as well
+    MetaLogProto next = next_cut(restarted.get());
+    CHECK_EQ(next.SerializeAsString(), expected_next.SerializeAsString());
+    LOG_F(INFO, "Primary restart checks passed: {} metalogs replayed", position);
+}
+
+// A replica lags far behind the replicated position. Checks that the tail
+// the primary hands off on a planned reconfiguration, which starts at the
+// lowest acknowledged position as in Sequencer::OnViewFrozen, lets it
+// catch up, while the last in-flight cuts alone would not
+static void CheckHandoffTail(size_t num_shards, size_t num_replicas) {
+    View view(BuildViewProto(num_replicas, num_shards));
+    MetaLogPrimary primary(&view, /* sequencer_id= */ 0);
+    std::vector<uint16_t> backup_ids(
+        view.GetSequencerNode(0)->GetReplicaSequencerNodes().begin(),
+        view.GetSequencerNode(0)->GetReplicaSequencerNodes().end());
+    std::vector<std::unique_ptr<MetaLogBackup>> backups;
+    for (size_t i = 0; i < backup_ids.size(); i++) {
+        backups.push_back(std::make_unique<MetaLogBackup>(&view, /* sequencer_id= */ 0));
+    }
+    uint32_t max_inflight = gsl::narrow_cast<uint32_t>(
+        absl::GetFlag(FLAGS_slog_max_inflight_metalogs));
+    size_t num_source_engines = view.GetStorageNode(0)->GetSourceEngineNodes().size();
+    std::vector<uint32_t> progress(num_source_engines, 0);
+    size_t num_cuts = absl::GetFlag(FLAGS_num_checked_cuts);
+    size_t lag = std::min(num_cuts - 1, size_t{max_inflight} * 4);
+    for (size_t n = 0; n < num_cuts; n++) {
+        for (uint32_t& p : progress) {
+            p += gsl::narrow_cast<uint32_t>(utils::GetRandomInt(1, 3));
+        }
+        primary.UpdateStorageProgress(
+            0, std::span<const char>(reinterpret_cast<const char*>(progress.data()),
+                                     progress.size() * sizeof(uint32_t)));
+        auto metalog = primary.MarkNextCut();
+        CHECK(metalog.has_value());
+        MetaLogsProto batch;
+        batch.set_logspace_id(primary.identifier());
+        *batch.add_metalogs() = std::move(*metalog);
+        // The last backup stops receiving metalogs
+        size_t num_receivers = n + lag < num_cuts ? backups.size() : backups.size() - 1;
+        for (size_t i = 0; i < num_receivers; i++) {
+            uint32_t ack = ReceiveOnBackup(backups[i].get(), batch);
+            if (ack > 0) {
+                primary.UpdateReplicaProgress(backup_ids[i], ack);
+            }
+        }
+    }
+    uint32_t position = primary.metalog_position();
+    MetaLogBackup* lagging = backups.back().get();
+    CHECK_EQ(primary.GetLowestReplicaPosition(), lagging->metalog_position());
+    CHECK_EQ(position - lagging->metalog_position(), gsl::narrow_cast<uint32_t>(lag));
+
+    uint32_t start_pos = position - std::min(max_inflight, position);
+    CHECK_GT(start_pos, lagging->metalog_position())
+        << "Lag is too small to be checked";
+    start_pos = std::min(start_pos, primary.GetLowestReplicaPosition());
+    MetaLogsProto tail;
+    tail.set_logspace_id(primary.identifier());
+    for (uint32_t pos = start_pos; pos < position; pos++) {
+        *tail.add_metalogs() = *primary.GetMetaLog(pos);
+    }
+    ReceiveOnBackup(lagging, tail);
+    CHECK_EQ(lagging->metalog_position(), position)
+        << "Handed off tail does not cover the lagging replica";
+    LOG_F(INFO, "Handoff tail checks passed: {} metalogs handed off", tail.metalogs_size());
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+
+    size_t num_shards = absl::GetFlag(FLAGS_num_shards);
+    size_t num_replicas = absl::GetFlag(FLAGS_num_replicas);
+    size_t per_tick = absl::GetFlag(FLAGS_metalogs_per_tick);
+    CHECK_GT(num_replicas, 0U);
+    CHECK_GT(per_tick, 0U);
+
+    CheckKthLargestTracker();
+    if (num_replicas > 1) {
+        CheckBatchedReplication(num_shards, num_replicas, per_tick);
+        CheckPrimaryRestart(num_shards, num_replicas);
+        CheckHandoffTail(num_shards, num_replicas);
+    }
+
+    BenchPerMetaLog(num_shards, num_replicas, per_tick);
+    BenchBatched(num_shards, num_replicas, per_tick);
+
+    return 0;
+}
@@ -0,0 +1,265 @@
+#define __FAAS_NOWARN_SIGN_CONVERSION
+#include "base/init.h"
+#include "base/common.h"
+#include "common/time.h"
+#include "log/flags.h"
+#include "log/utils.h"
+#include "utils/bench.h"
+#include "utils/random.h"
+
+ABSL_FLAG(size_t, num_replicas, 3, "Number of metalog replicas of the phylog");
+ABSL_FLAG(size_t, num_shards, 16, "Number of shards in each metalog");
+ABSL_FLAG(size_t, num_seals, 2000, "Number of seals measured");
+
+// Drives log_utils::PhylogSeal the way Controller::CheckAllSealed does.
+// Checks that a divergent longest tail is rejected in favor of the next
+// agreeing one, that a replica publishing its report twice is counted once,
+// and that an aborted fetch falls back to the next agreeing replica only
+// when replicas not rejected still make a quorum.
+// Reports seal time against merging full tails of all replicas, which the
+// controller did before tail digests.
+
+using namespace faas;
+
+using log::MetaLogProto;
+using log::MetaLogsProto;
+using log_utils::PhylogSeal;
+using log_utils::SealReport;
+
+static MetaLogProto BuildMetaLog(uint32_t metalog_seqnum, uint32_t start_seqnum) {
+    MetaLogProto metalog;
+    metalog.set_logspace_id(1);
+    metalog.set_metalog_seqnum(metalog_seqnum);
+    metalog.set_type(MetaLogProto::NEW_LOGS);
+    auto* new_logs_proto = metalog.mutable_new_logs_proto();
+    new_logs_proto->set_start_seqnum(start_seqnum);
+    size_t num_shards = absl::GetFlag(FLAGS_num_shards);
+    for (size_t i = 0; i < num_shards; i++) {
+        new_logs_proto->add_shard_starts(start_seqnum);
+        new_logs_proto->add_shard_deltas(
+            gsl::narrow_cast<uint32_t>(utils::GetRandomInt(1, 16)));
+    }
+    return metalog;
+}
+
+static std::vector<MetaLogProto> BuildHistory(size_t length) {
+    std::vector<MetaLogProto> history;
+    for (size_t i = 0; i < length; i++) {
+        history.push_back(BuildMetaLog(gsl::narrow_cast<uint32_t>(i),
+                                       gsl::narrow_cast<uint32_t>(i * 1000)));
+    }
+    return history;
+}
+
+// Tail of a replica at `position`, as kept by MetaLogBackup
+static MetaLogsProto BuildTail(const std::vector<MetaLogProto>& history, size_t position) {
+    size_t tail_length = absl::GetFlag(FLAGS_slog_num_tail_metalog_entries);
+    MetaLogsProto tail;
+    tail.set_logspace_id(1);
+    size_t start = position > tail_length ? position - tail_length : 0;
+    for (size_t i = start; i < position; i++) {
+        tail.add_metalogs()->CopyFrom(history[i]);
+    }
+    return tail;
+}
+
+// Returns the final tail after answering fetches, with `answer` deciding
+// which replicas answer
+static const MetaLogsProto* RunSeal(PhylogSeal* seal, size_t quorum,
+                                    const std::vector<MetaLogsProto>& tails,
+                                    std::function<bool(uint16_t)> answer,
+                                    std::vector<uint16_t>* fetched) {
+    std::optional<uint16_t> fetch_source;
+    const MetaLogsProto* final_tail = seal->PickFinalTail(quorum, &fetch_source);
+    while (final_tail == nullptr && fetch_source.has_value()) {
+        uint16_t sequencer_id = *fetch_source;
+        fetched->push_back(sequencer_id);
+        CHECK(seal->pending_fetch() == sequencer_id);
+        if (answer(sequencer_id)) {
+            seal->AddTail(sequencer_id, tails[sequencer_id]);
+            CHECK(!seal->pending_fetch().has_value());
+        } else {
+            seal->AbortFetch();
+        }
+        final_tail = seal->PickFinalTail(quorum, &fetch_source);
+    }
+    return final_tail;
+}
+
+static void CheckDivergentTails() {
+    size_t tail_length = absl::GetFlag(FLAGS_slog_num_tail_metalog_entries);
+    CHECK_GE(tail_length, 4U);
+    size_t position = tail_length * 2;
+    std::vector<MetaLogProto> history = BuildHistory(position + 2);
+    // Replica 0 has the longest tail, which diverges from others two
+    // metalogs before replica 2 ends
+    std::vector<MetaLogProto> divergent(history);
+    for (size_t i = position - 2; i < divergent.size(); i++) {
+        divergent[i] = BuildMetaLog(gsl::narrow_cast<uint32_t>(i), 7);
+    }
+    std::vector<MetaLogsProto> tails = {
+        BuildTail(divergent, position + 2),
+        BuildTail(history, position + 1),
+        BuildTail(history, position),
+    };
+    std::vector<SealReport> reports;
+    for (size_t i = 0; i < tails.size(); i++) {
+        reports.push_back(log_utils::BuildSealReport(gsl::narrow_cast<uint16_t>(i), tails[i]));
+    }
+    size_t quorum = 2;
+
+    PhylogSeal seal;
+    for (const SealReport& report : reports) {
+        seal.AddReport(report);
+        // Re-published freeze znodes carry the same report
+        seal.AddReport(report);
+    }
+    CHECK_EQ(seal.num_reports(), reports.size());
+    std::vector<uint16_t> fetched;
+    const MetaLogsProto* final_tail = RunSeal(
+        &seal, quorum, tails, [] (uint16_t) { return true; }, &fetched);
+    CHECK(final_tail != nullptr);
+    CHECK((fetched == std::vector<uint16_t>{0, 1}));
+    CHECK_EQ(final_tail->SerializeAsString(), tails[1].SerializeAsString());
+
+    // A divergent replica reporting many times never makes a quorum alone
+    std::vector<SealReport> duplicated(3, reports[0]);
+    duplicated.push_back(reports[1]);
+    CHECK_EQ(log_utils::CountAgreeingReports(tails[0], duplicated, /* rejected= */ {}), 1U);
+    LOG(INFO) << "Divergent tail checks passed";
+}
+
+static void CheckFetchFallback() {
+    size_t tail_length = absl::GetFlag(FLAGS_slog_num_tail_metalog_entries);
+    size_t position = tail_length * 2;
+    std::vector<MetaLogProto> history = BuildHistory(position + 2);
+    std::vector<MetaLogsProto> tails = {
+        BuildTail(history, position + 2),
+        BuildTail(history, position + 1),
+        BuildTail(history, position),
+    };
+    size_t quorum = 2;
+
+    // Replica 0 goes offline, or never answers, when its tail is fetched.
+    // With replica 2 not reported yet, replica 1 alone is not a quorum, and
+    // its shorter tail may miss metalogs held by replicas 0 and 2.
+    PhylogSeal seal;
+    for (size_t i = 0; i < 2; i++) {
+        seal.AddReport(log_utils::BuildSealReport(gsl::narrow_cast<uint16_t>(i), tails[i]));
+    }
+    auto answer = [] (uint16_t sequencer_id) { return sequencer_id != 0; };
+    std::vector<uint16_t> fetched;
+    const MetaLogsProto* final_tail = RunSeal(&seal, quorum, tails, answer, &fetched);
+    CHECK(final_tail == nullptr) << "Aborted fetch falls back without a quorum";
+    CHECK((fetched == std::vector<uint16_t>{0}));
+
+    // Replica 2 reporting makes a quorum with replica 1
+    seal.AddReport(log_utils::BuildSealReport(2, tails[2]));
+    fetched.clear();
+    final_tail = RunSeal(&seal, quorum, tails, answer, &fetched);
+    CHECK(final_tail != nullptr);
+    CHECK((fetched == std::vector<uint16_t>{1}));
+    CHECK_EQ(final_tail->SerializeAsString(), tails[1].SerializeAsString());
+
+    // Late answer of the aborted replica is ignored
+    seal.AddTail(0, tails[0]);
+    std::optional<uint16_t> fetch_source;
+    final_tail = seal.PickFinalTail(quorum, &fetch_source);
+    CHECK(!fetch_source.has_value());
+    CHECK_EQ(final_tail->SerializeAsString(), tails[1].SerializeAsString());
+
+    // No replica answers
+    PhylogSeal silent_seal;
+    for (size_t i = 0; i < tails.size(); i++) {
+        silent_seal.AddReport(
+            log_utils::BuildSealReport(gsl::narrow_cast<uint16_t>(i), tails[i]));
+    }
+    fetched.clear();
+    final_tail = RunSeal(&silent_seal, quorum, tails, [] (uint16_t) { return false; }, &fetched);
+    CHECK(final_tail == nullptr);
+    // Fetching stops once the replicas left are fewer than a quorum
+    CHECK_EQ(fetched.size(), tails.size() - quorum + 1);
+    LOG(INFO) << "Fetch fallback checks passed";
+}
+
+// Controller::CheckAllSealed before tail digests
+static MetaLogsProto MergeFullTails(const std::vector<MetaLogsProto>& tails) {
+    std::map<uint32_t, MetaLogProto> entries;
+    for (const MetaLogsProto& metalogs : tails) {
+        for (const MetaLogProto& metalog : metalogs.metalogs()) {
+            entries[metalog.metalog_seqnum()] = metalog;
+        }
+    }
+    MetaLogsProto final_tail;
+    final_tail.set_logspace_id(1);
+    for (const auto& [metalog_seqnum, metalog] : entries) {
+        final_tail.add_metalogs()->CopyFrom(metalog);
+    }
+    return final_tail;
+}
+
+static void RunSealTime() {
+    size_t num_replicas = absl::GetFlag(FLAGS_num_replicas);
+    size_t num_seals = absl::GetFlag(FLAGS_num_seals);
+    size_t tail_length = absl::GetFlag(FLAGS_slog_num_tail_metalog_entries);
+    size_t quorum = (num_replicas + 1) / 2;
+    size_t position = tail_length * 2;
+    std::vector<MetaLogProto> history = BuildHistory(position + num_replicas);
+    std::vector<MetaLogsProto> tails;
+    std::vector<std::string> serialized_tails;
+    size_t full_tail_bytes = 0;
+    for (size_t i = 0; i < num_replicas; i++) {
+        tails.push_back(BuildTail(history, position + num_replicas - i));
+        serialized_tails.push_back(tails.back().SerializeAsString());
+        full_tail_bytes += serialized_tails.back().size();
+    }
+
+    bench_utils::Samples<int32_t> merge_ns(num_seals);
+    bench_utils::Samples<int32_t> digest_ns(num_seals);
+    for (size_t i = 0; i < num_seals; i++) {
+        int64_t start_timestamp = GetMonotonicNanoTimestamp();
+        std::vector<MetaLogsProto> received(num_replicas);
+        for (size_t j = 0; j < num_replicas; j++) {
+            CHECK(received[j].ParseFromString(serialized_tails[j]));
+        }
+        MetaLogsProto merged = MergeFullTails(received);
+        merge_ns.Add(gsl::narrow_cast<int32_t>(GetMonotonicNanoTimestamp() - start_timestamp));
+        CHECK_EQ(merged.metalogs_size(),
+                 tails[0].metalogs_size() + gsl::narrow_cast<int>(num_replicas) - 1);
+
+        // Replicas compute their reports in parallel, so only the fetched
+        // tail is parsed within the controller
+        std::vector<SealReport> reports;
+        for (size_t j = 0; j < num_replicas; j++) {
+            reports.push_back(
+                log_utils::BuildSealReport(gsl::narrow_cast<uint16_t>(j), tails[j]));
+        }
+        start_timestamp = GetMonotonicNanoTimestamp();
+        PhylogSeal seal;
+        for (const SealReport& report : reports) {
+            seal.AddReport(report);
+        }
+        std::optional<uint16_t> fetch_source;
+        CHECK(seal.PickFinalTail(quorum, &fetch_source) == nullptr);
+        CHECK(fetch_source == uint16_t{0});
+        MetaLogsProto fetched;
+        CHECK(fetched.ParseFromString(serialized_tails[0]));
+        seal.AddTail(0, fetched);
+        CHECK(seal.PickFinalTail(quorum, &fetch_source) != nullptr);
+        digest_ns.Add(gsl::narrow_cast<int32_t>(GetMonotonicNanoTimestamp() - start_timestamp));
+    }
+    LOG_F(INFO, "{} replicas with {} tail metalogs: full tails publish {} bytes, "
+                "digests publish {} bytes and fetch {} bytes",
+          num_replicas, tail_length, full_tail_bytes,
+          num_replicas * sizeof(SealReport), serialized_tails[0].size());
+    merge_ns.ReportStatistics("Merge full tails (ns)");
+    digest_ns.ReportStatistics("Seal with tail digests (ns)");
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    CheckDivergentTails();
+    CheckFetchFallback();
+    RunSealTime();
+    return 0;
+}
@@ -0,0 +1,230 @@
+#define __FAAS_NOWARN_SIGN_CONVERSION
+#include "base/init.h"
+#include "base/common.h"
+#include "common/time.h"
+#include "log/log_space.h"
+#include "log/view.h"
+#include "utils/random.h"
+
+ABSL_FLAG(size_t, num_cuts, 100000, "Number of global cuts to simulate");
+ABSL_FLAG(double, changed_fraction, 0.1,
+          "Fraction of shards with new appends between two reports");
+ABSL_FLAG(size_t, full_interval, 64, "Send full reports every this many reports");
+
+// Feeds SHARD_PROG reports of one storage node, in both the legacy encoding
+// and the delta encoding, to MetaLogPrimary, and compares bytes per report
+// and decode + cut CPU time, for 8, 64 and 256 engine shards. Also checks
+// decoding against the generated serializer.
+
+using namespace faas;
+
+using log::View;
+using log::ViewProto;
+using log::MetaLogPrimary;
+using log::ShardProgressDeltaProto;
+
+static ViewProto BuildViewProto(size_t num_shards) {
+    ViewProto view_proto;
+    view_proto.set_view_id(0);
+    view_proto.set_metalog_replicas(1);
+    view_proto.set_userlog_replicas(1);
+    view_proto.set_index_replicas(1);
+    view_proto.set_num_phylogs(1);
+    view_proto.add_sequencer_nodes(0);
+    view_proto.add_index_plan(0);
+    view_proto.add_storage_nodes(0);
+    for (size_t i = 0; i < num_shards; i++) {
+        view_proto.add_engine_nodes(gsl::narrow_cast<uint32_t>(i));
+        view_proto.add_storage_plan(0);
+    }
+    view_proto.add_log_space_hash_tokens(0);
+    return view_proto;
+}
+
+// Encodes as LogStorage::GrabShardProgressDeltaForSending
+static ShardProgressDeltaProto BuildDeltaProto(size_t n, size_t full_interval,
+                                               const std::vector<uint32_t>& progress,
+                                               std::vector<uint32_t>* sent_progress) {
+    bool full = (n % full_interval == 0);
+    ShardProgressDeltaProto delta_proto;
+    delta_proto.set_report_seqnum(gsl::narrow_cast<uint32_t>(n));
+    delta_proto.set_full(full);
+    uint32_t skipped = 0;
+    for (size_t i = 0; i < progress.size(); i++) {
+        uint32_t base = full ? 0 : (*sent_progress)[i];
+        if (full || progress[i] > base) {
+            delta_proto.add_shard_updates(skipped);
+            delta_proto.add_shard_updates(progress[i] - base);
+            skipped = 0;
+        } else {
+            skipped++;
+        }
+        (*sent_progress)[i] = progress[i];
+    }
+    return delta_proto;
+}
+
+// Serializes fields of `delta_proto` in the reverse order of their
+// numbers, which parsers must accept as well
+static std::string SerializeReversed(const ShardProgressDeltaProto& delta_proto) {
+    std::string payload;
+    for (int field = ShardProgressDeltaProto::kLogspaceLoadsFieldNumber;
+             field >= ShardProgressDeltaProto::kReportSeqnumFieldNumber; field--) {
+        ShardProgressDeltaProto part;
+        switch (field) {
+        case ShardProgressDeltaProto::kReportSeqnumFieldNumber:
+            part.set_report_seqnum(delta_proto.report_seqnum());
+            break;
+        case ShardProgressDeltaProto::kFullFieldNumber:
+            part.set_full(delta_proto.full());
+            break;
+        case ShardProgressDeltaProto::kShardUpdatesFieldNumber:
+            *part.mutable_shard_updates() = delta_proto.shard_updates();
+            break;
+        default:
+            *part.mutable_logspace_loads() = delta_proto.logspace_loads();
+        }
+        payload.append(part.SerializeAsString());
+    }
+    return payload;
+}
+
+// Round-trips reports built with the generated serializer through
+// MetaLogPrimary::UpdateStorageProgressDelta, with fields in reverse order
+// and unknown fields added, and checks cuts follow the shard progress.
+// Reports out of order are interleaved, and must leave no trace.
+static void CheckDeltaDecoding(const View* view, size_t num_reports, size_t full_interval) {
+    size_t num_shards = view->GetStorageNode(0)->GetSourceEngineNodes().size();
+    MetaLogPrimary primary(view, /* sequencer_id= */ 0);
+    std::vector<uint32_t> progress(num_shards, 0);
+    std::vector<uint32_t> sent_progress(num_shards, 0);
+    std::vector<uint32_t> cut_progress(num_shards, 0);
+    std::vector<uint32_t> logspace_loads;
+    for (size_t n = 0; n < num_reports; n++) {
+        for (size_t i = 0; i < num_shards; i++) {
+            if (utils::GetRandomDouble(0.0, 1.0) < 0.3) {
+                progress[i] += gsl::narrow_cast<uint32_t>(utils::GetRandomInt(1, 8));
+            }
+        }
+        ShardProgressDeltaProto delta_proto =
+            BuildDeltaProto(n, full_interval, progress, &sent_progress);
+        delta_proto.add_logspace_loads(gsl::narrow_cast<uint32_t>(n));
+        delta_proto.add_logspace_loads(1);
+        std::string payload;
+        switch (n % 3) {
+        case 0:
+            CHECK(delta_proto.SerializeToString(&payload));
+            break;
+        case 1:
+            payload = SerializeReversed(delta_proto);
+            break;
+        default:
+            CHECK(delta_proto.SerializeToString(&payload));
+            // Field 15 with varint 1, and field 16 with a length-delimited "ab"
+            payload.append("\x78\x01\x82\x01\x02\x61\x62", 7);
+        }
+        if (!delta_proto.full() && n % 5 == 4) {
+            // A report ahead of the expected seqnum is dropped as a whole
+            ShardProgressDeltaProto stale_proto = delta_proto;
+            stale_proto.set_report_seqnum(delta_proto.report_seqnum() + 1);
+            stale_proto.clear_shard_updates();
+            stale_proto.add_shard_updates(0);
+            stale_proto.add_shard_updates(1000);
+            std::string stale_payload;
+            CHECK(stale_proto.SerializeToString(&stale_payload));
+            logspace_loads.clear();
+            primary.UpdateStorageProgressDelta(0, STRING_AS_SPAN(stale_payload),
+                                               &logspace_loads);
+            CHECK(logspace_loads.empty()) << "Loads are recorded from a rejected report";
+            CHECK(!primary.MarkNextCut().has_value()) << "Rejected report is applied";
+        }
+        logspace_loads.clear();
+        primary.UpdateStorageProgressDelta(0, STRING_AS_SPAN(payload), &logspace_loads);
+        CHECK_EQ(logspace_loads.size(), 2U);
+        CHECK_EQ(logspace_loads[0], n);
+        auto metalog = primary.MarkNextCut();
+        if (metalog.has_value()) {
+            const auto& deltas = metalog->new_logs_proto().shard_deltas();
+            CHECK_EQ(gsl::narrow_cast<size_t>(deltas.size()), num_shards);
+            for (size_t i = 0; i < num_shards; i++) {
+                cut_progress[i] += deltas[static_cast<int>(i)];
+            }
+        }
+        CHECK(cut_progress == progress) << "Cut differs from shard progress at report " << n;
+    }
+}
+
+struct BenchResult {
+    size_t   total_bytes;
+    uint64_t total_cuts;
+    int64_t  elapsed_us;
+};
+
+static BenchResult RunBench(const View* view, bool delta, size_t num_cuts,
+                            double changed_fraction, size_t full_interval) {
+    const View::NodeIdVec& engine_ids =
+        view->GetStorageNode(0)->GetSourceEngineNodes();
+    size_t num_shards = engine_ids.size();
+    MetaLogPrimary primary(view, /* sequencer_id= */ 0);
+    std::vector<uint32_t> progress(num_shards, 0);
+    std::vector<uint32_t> sent_progress(num_shards, 0);
+    std::vector<uint32_t> logspace_loads;
+    BenchResult result = {.total_bytes = 0, .total_cuts = 0, .elapsed_us = 0};
+    for (size_t n = 0; n < num_cuts; n++) {
+        for (size_t i = 0; i < num_shards; i++) {
+            if (utils::GetRandomDouble(0.0, 1.0) < changed_fraction) {
+                progress[i] += gsl::narrow_cast<uint32_t>(utils::GetRandomInt(1, 8));
+            }
+        }
+        // Encoding is done by storage nodes, and not timed
+        std::string payload;
+        if (delta) {
+            CHECK(BuildDeltaProto(n, full_interval, progress, &sent_progress)
+                      .SerializeToString(&payload));
+        } else {
+            payload.assign(reinterpret_cast<const char*>(progress.data()),
+                           progress.size() * sizeof(uint32_t));
+        }
+        result.total_bytes += payload.size();
+        int64_t start_timestamp = GetMonotonicMicroTimestamp();
+        if (delta) {
+            logspace_loads.clear();
+            primary.UpdateStorageProgressDelta(0, STRING_AS_SPAN(payload), &logspace_loads);
+        } else {
+            primary.UpdateStorageProgress(0, STRING_AS_SPAN(payload));
+        }
+        if (primary.MarkNextCut().has_value()) {
+            result.total_cuts++;
+        }
+        result.elapsed_us += GetMonotonicMicroTimestamp() - start_timestamp;
+    }
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+
+    size_t num_cuts = absl::GetFlag(FLAGS_num_cuts);
+    double changed_fraction = absl::GetFlag(FLAGS_changed_fraction);
+    size_t full_interval = absl::GetFlag(FLAGS_full_interval);
+    CHECK_GT(num_cuts, 0U);
+    CHECK_GT(full_interval, 0U);
+
+    for (size_t num_shards : {8, 64, 256}) {
+        View view(BuildViewProto(num_shards));
+        CheckDeltaDecoding(&view, /* num_reports= */ 1000, full_interval);
+        for (bool delta : {false, true}) {
+            BenchResult result = RunBench(
+                &view, delta, num_cuts, changed_fraction, full_interval);
+            LOG(INFO) << fmt::format(
+                "{} shards, {} encoding: {:.1f} bytes per report, "
+                "{:.3f} us per report, {} cuts",
+                num_shards, delta ? "delta" : "legacy",
+                static_cast<double>(result.total_bytes) / static_cast<double>(num_cuts),
+                static_cast<double>(result.elapsed_us) / static_cast<double>(num_cuts),
+                result.total_cuts);
+        }
+    }
+
+    return 0;
+}
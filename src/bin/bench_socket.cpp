@@ -5,8 +5,10 @@
 #include "utils/io.h"
 #include "utils/socket.h"
 #include "utils/bench.h"
+#include "server/io_uring.h"
 
 #include <sys/socket.h>
+#include <sys/resource.h>
 #include <sys/un.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -18,10 +20,32 @@ ABSL_FLAG(int, tcp_port, 32767, "Port for TCP socket type");
 ABSL_FLAG(int, server_cpu, -1, "Pin server process to this CPU");
 ABSL_FLAG(int, client_cpu, -1, "Pin client process to this CPU");
 ABSL_FLAG(absl::Duration, duration, absl::Seconds(30), "Duration to run");
+ABSL_FLAG(bool, io_uring_server, false, "Server receives through server::IOUring");
+ABSL_FLAG(size_t, idle_connections, 0,
+          "Number of idle unix socket connections registered with the server's IOUring");
+
+ABSL_FLAG(size_t, send_fragments, 0,
+          "If non-zero, the IOUring server sends each payload in this many fragments");
+ABSL_FLAG(bool, send_vectored, true,
+          "Send all fragments with one vectored SendAll, instead of one SendAll each");
+
+ABSL_FLAG(std::string, io_uring_configs, "default",
+          "Comma-separated configurations the IOUring server runs in turn, "
+          "each for --duration. default: block for completions; "
+          "sqpoll: submit with an SQPOLL thread; "
+          "busy_poll: SQPOLL, and spin on the CQ ring for --busy_poll_spin_us");
+ABSL_FLAG(uint32_t, busy_poll_spin_us, 100, "Spin budget of the busy_poll configuration");
+
+ABSL_DECLARE_FLAG(size_t, io_uring_entries);
+ABSL_DECLARE_FLAG(size_t, io_uring_fd_slots);
+ABSL_DECLARE_FLAG(bool, io_uring_sqpoll);
+ABSL_DECLARE_FLAG(uint32_t, io_uring_cq_spin_us);
 
 using namespace faas;
 
 static constexpr size_t kBufferSizeForSamples = 1<<24;
+static constexpr uint16_t kRecvBufGroup = 1;
+static constexpr size_t kRecvBufSize = 4096;
 
 void Server(int infd, int outfd) {
     size_t payload_bytesize = absl::GetFlag(FLAGS_payload_bytesize);
@@ -72,6 +96,196 @@ void Server(int infd, int outfd) {
     }
 }
 
+static void ApplyIOUringConfig(std::string_view config) {
+    if (config == "default") {
+        absl::SetFlag(&FLAGS_io_uring_sqpoll, false);
+        absl::SetFlag(&FLAGS_io_uring_cq_spin_us, 0);
+    } else if (config == "sqpoll") {
+        absl::SetFlag(&FLAGS_io_uring_sqpoll, true);
+        absl::SetFlag(&FLAGS_io_uring_cq_spin_us, 0);
+    } else if (config == "busy_poll") {
+        absl::SetFlag(&FLAGS_io_uring_sqpoll, true);
+        absl::SetFlag(&FLAGS_io_uring_cq_spin_us, absl::GetFlag(FLAGS_busy_poll_spin_us));
+    } else {
+        LOG(FATAL) << "Unknown IOUring config: " << config;
+    }
+}
+
+static double GetProcessCpuSeconds() {
+    struct rusage usage;
+    PCHECK(getrusage(RUSAGE_SELF, &usage) == 0);
+    auto to_seconds = [] (const struct timeval& tv) {
+        return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+    };
+    return to_seconds(usage.ru_utime) + to_seconds(usage.ru_stime);
+}
+
+// Runs ping-pong for --duration with a new IOUring, and detaches `infd` from it
+static void RunIOUringServer(int infd, int outfd, bool use_recv, std::string_view config) {
+    size_t payload_bytesize = absl::GetFlag(FLAGS_payload_bytesize);
+    bench_utils::Samples<int32_t> msg_delay(kBufferSizeForSamples);
+    // From sending a payload to receiving the echo, as the client stamps
+    // echoes with its own send time
+    bench_utils::Samples<int32_t> rtt(kBufferSizeForSamples);
+    server::IOUring io_uring;
+    io_uring.PrepareBuffers(kRecvBufGroup, kRecvBufSize);
+
+    // Idle connections only hold their fds, and never receive any data
+    std::vector<int> idle_fds;
+    std::vector<int> peer_fds;
+    size_t inflight_ops;
+    for (size_t i = 0; i < absl::GetFlag(FLAGS_idle_connections); i++) {
+        int fds[2];
+        PCHECK(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds) == 0);
+        CHECK(io_uring.RegisterFd(fds[0]));
+        CHECK(io_uring.StartRecv(fds[0], kRecvBufGroup,
+                                 [] (int status, std::span<const char> data) -> bool {
+            return false;
+        }));
+        idle_fds.push_back(fds[0]);
+        peer_fds.push_back(fds[1]);
+    }
+    LOG(INFO) << "Server: resident buffer bytes with " << idle_fds.size()
+              << " idle connections: " << io_uring.resident_buffer_bytes();
+
+    char* payload_buffer = new char[payload_bytesize];
+    char* send_buffer = new char[payload_bytesize];
+    size_t fragments = absl::GetFlag(FLAGS_send_fragments);
+    bool send_vectored = absl::GetFlag(FLAGS_send_vectored);
+    std::vector<std::span<const char>> send_vec;
+    if (fragments > 0) {
+        CHECK(use_recv) << "send_fragments requires sockets";
+        CHECK_LE(fragments, payload_bytesize);
+        size_t fragment_size = payload_bytesize / fragments;
+        for (size_t i = 0; i < fragments; i++) {
+            size_t size = (i + 1 == fragments) ? payload_bytesize - i * fragment_size
+                                               : fragment_size;
+            send_vec.emplace_back(send_buffer + i * fragment_size, size);
+        }
+    }
+    size_t pending_sends = 0;
+    auto send_cb = [&pending_sends] (int status) {
+        PCHECK(status == 0);
+        pending_sends--;
+    };
+    size_t received = 0;
+    CHECK(io_uring.RegisterFd(infd));
+    auto recv_cb = [&] (int status, std::span<const char> data) -> bool {
+        PCHECK(status == 0);
+        CHECK_LE(received + data.size(), payload_bytesize);
+        memcpy(payload_buffer + received, data.data(), data.size());
+        received += data.size();
+        return true;
+    };
+    if (use_recv) {
+        CHECK(io_uring.StartRecv(infd, kRecvBufGroup, recv_cb));
+    } else {
+        CHECK(io_uring.StartRead(infd, kRecvBufGroup, recv_cb));
+    }
+
+    uint64_t start_enter_count = io_uring.io_uring_enter_count();
+    uint64_t start_cqe_count = io_uring.completed_cqe_count();
+    uint64_t start_sqe_count = io_uring.submitted_sqe_count();
+    double start_cpu_seconds = GetProcessCpuSeconds();
+    bench_utils::BenchLoop bench_loop(absl::GetFlag(FLAGS_duration), [&] () -> bool {
+        int64_t current_timestamp = GetMonotonicNanoTimestamp();
+        int64_t start_timestamp = current_timestamp;
+        if (fragments == 0) {
+            memcpy(payload_buffer, &current_timestamp, sizeof(int64_t));
+            CHECK(io_utils::SendData(outfd, payload_buffer, payload_bytesize));
+        } else if (send_vectored) {
+            memcpy(send_buffer, &current_timestamp, sizeof(int64_t));
+            pending_sends = 1;
+            CHECK(io_uring.SendAll(outfd, send_vec, send_cb));
+        } else {
+            memcpy(send_buffer, &current_timestamp, sizeof(int64_t));
+            pending_sends = send_vec.size();
+            for (std::span<const char> data : send_vec) {
+                CHECK(io_uring.SendAll(outfd, data, send_cb));
+            }
+        }
+        received = 0;
+        while (received < payload_bytesize || pending_sends > 0) {
+            io_uring.EventLoopRunOnce(&inflight_ops);
+        }
+        current_timestamp = GetMonotonicNanoTimestamp();
+        int64_t send_timestamp;
+        memcpy(&send_timestamp, payload_buffer, sizeof(int64_t));
+        msg_delay.Add(gsl::narrow_cast<int32_t>(current_timestamp - send_timestamp));
+        rtt.Add(gsl::narrow_cast<int32_t>(current_timestamp - start_timestamp));
+        return true;
+    });
+    uint64_t enter_count = io_uring.io_uring_enter_count() - start_enter_count;
+    uint64_t cqe_count = io_uring.completed_cqe_count() - start_cqe_count;
+    uint64_t sqe_count = io_uring.submitted_sqe_count() - start_sqe_count;
+    // Includes the SQ thread, which belongs to this process
+    double cpu_seconds = GetProcessCpuSeconds() - start_cpu_seconds;
+
+    double messages = static_cast<double>(bench_loop.loop_count());
+    LOG(INFO) << "Server: IOUring config " << config;
+    LOG(INFO) << "Server: elapsed milliseconds: "
+              << absl::ToInt64Milliseconds(bench_loop.elapsed_time());
+    LOG(INFO) << "Server: loop rate: "
+              << messages / absl::ToDoubleMilliseconds(bench_loop.elapsed_time())
+              << " loops per millisecond";
+    // Without fragments, each message costs one send syscall, plus
+    // io_uring_enter calls
+    double send_syscalls = fragments == 0 ? messages : 0;
+    LOG(INFO) << "Server: syscalls per message: "
+              << (static_cast<double>(enter_count) + send_syscalls) / messages;
+    LOG(INFO) << "Server: SQEs per message: "
+              << static_cast<double>(sqe_count) / messages;
+    LOG(INFO) << "Server: CQEs per second: "
+              << static_cast<double>(cqe_count) / absl::ToDoubleSeconds(bench_loop.elapsed_time());
+    LOG(INFO) << "Server: resident buffer bytes: " << io_uring.resident_buffer_bytes();
+    LOG(INFO) << "Server: CPU usage: "
+              << cpu_seconds / absl::ToDoubleSeconds(bench_loop.elapsed_time()) << " cores";
+    msg_delay.ReportStatistics("Client message delay");
+    rtt.ReportStatistics(fmt::format("Round trip time with {} config", config));
+
+    size_t closing = 0;
+    auto close_cb = [&closing] () { closing--; };
+    for (int fd : idle_fds) {
+        CHECK(io_uring.Close(fd, close_cb));
+        closing++;
+    }
+    // Kept open for the next config
+    CHECK(io_uring.Detach(infd, close_cb));
+    closing++;
+    while (closing > 0 || inflight_ops > 0) {
+        io_uring.EventLoopRunOnce(&inflight_ops);
+    }
+    for (int fd : peer_fds) {
+        PCHECK(close(fd) == 0);
+    }
+    delete[] payload_buffer;
+    delete[] send_buffer;
+}
+
+void ServerWithIOUring(int infd, int outfd, bool use_recv) {
+    size_t payload_bytesize = absl::GetFlag(FLAGS_payload_bytesize);
+    int cpu = absl::GetFlag(FLAGS_server_cpu);
+    if (cpu != -1) {
+        bench_utils::PinCurrentThreadToCpu(cpu);
+    }
+    for (std::string_view config :
+            absl::StrSplit(absl::GetFlag(FLAGS_io_uring_configs), ",", absl::SkipEmpty())) {
+        ApplyIOUringConfig(config);
+        RunIOUringServer(infd, outfd, use_recv, config);
+    }
+
+    // Signal client to stop
+    std::vector<char> payload_buffer(payload_bytesize, 0);
+    int64_t value = -1;
+    memcpy(payload_buffer.data(), &value, sizeof(int64_t));
+    CHECK(io_utils::SendData(outfd, payload_buffer.data(), payload_bytesize));
+
+    PCHECK(close(infd) == 0);
+    if (outfd != infd) {
+        PCHECK(close(outfd) == 0);
+    }
+}
+
 void Client(int infd, int outfd) {
     size_t payload_bytesize = absl::GetFlag(FLAGS_payload_bytesize);
     int cpu = absl::GetFlag(FLAGS_client_cpu);
@@ -115,6 +329,26 @@ int main(int argc, char* argv[]) {
     int payload_bytesize = absl::GetFlag(FLAGS_payload_bytesize);
     CHECK_GE(payload_bytesize, 8) << "payload should be at least 8 bytes";
 
+    size_t idle_connections = absl::GetFlag(FLAGS_idle_connections);
+    if (idle_connections > 0) {
+        CHECK(absl::GetFlag(FLAGS_io_uring_server))
+            << "idle_connections requires io_uring_server";
+        // Every idle connection takes one fd slot, and one SQE before the
+        // first submit
+        size_t min_slots = idle_connections + 2;
+        if (absl::GetFlag(FLAGS_io_uring_fd_slots) < min_slots) {
+            absl::SetFlag(&FLAGS_io_uring_fd_slots, min_slots);
+        }
+        size_t min_entries = 1;
+        while (min_entries < min_slots) {
+            min_entries <<= 1;
+        }
+        CHECK_LE(min_entries, 32768U) << "Too many idle connections";
+        if (absl::GetFlag(FLAGS_io_uring_entries) < min_entries) {
+            absl::SetFlag(&FLAGS_io_uring_entries, min_entries);
+        }
+    }
+
     std::string socket_type(absl::GetFlag(FLAGS_socket_type));
     int tcp_server_fd = -1;
     int unix_fds[2];
@@ -172,7 +406,11 @@ int main(int argc, char* argv[]) {
         PCHECK(fd != -1);
         infd = outfd = fd;
     }
-    Server(infd, outfd);
+    if (absl::GetFlag(FLAGS_io_uring_server)) {
+        ServerWithIOUring(infd, outfd, /* use_recv= */ socket_type != "pipe");
+    } else {
+        Server(infd, outfd);
+    }
 
     int wstatus;
     CHECK(wait(&wstatus) == child_pid);
@@ -0,0 +1,197 @@
+#include "base/init.h"
+#include "base/common.h"
+#include "common/flags.h"
+#include "common/time.h"
+#include "common/zk.h"
+#include "common/zk_local.h"
+#include "common/zk_utils.h"
+#include "log/controller.h"
+#include "log/flags.h"
+#include "log/sequencer.h"
+#include "log/view_watcher.h"
+#include "utils/fs.h"
+
+ABSL_FLAG(std::string, work_dir, "/tmp/bench_tail_handoff",
+          "Directory for the coordinator socket and data file");
+ABSL_FLAG(absl::Duration, event_timeout, absl::Seconds(10),
+          "Time to wait for each new view");
+
+// Runs a Controller and three Sequencers against LocalCoordinator, with
+// planned reconfiguration. Checks that moving the phylog seals the old view
+// with a single tail merged by the successor, and that with the successor
+// down, sequencers fall back to publishing their tails once
+// --slog_tail_handoff_timeout_ms passes.
+
+using namespace faas;
+
+using log::FrozenSequencerProto;
+
+static constexpr std::string_view kRootPath = "/faas";
+
+// Records new views and freeze responses, which run on the event loop thread
+// of its session
+class ReconfigObserver {
+public:
+    struct FreezeResponse {
+        uint16_t sequencer_id;
+        bool merged;
+    };
+
+    explicit ReconfigObserver(std::string_view host)
+        : session_(host, kRootPath) {
+        view_watcher_.SetViewCreatedCallback([this] (const log::View* view) {
+            absl::MutexLock lk(&mu_);
+            views_[view->id()] = view;
+        });
+        session_.Start();
+        view_watcher_.StartWatching(&session_);
+        freeze_watcher_.emplace(&session_, "freeze", /* sequential_znodes= */ true);
+        freeze_watcher_->SetNodeCreatedCallback(
+            [this] (std::string_view, std::span<const char> contents) {
+                FrozenSequencerProto frozen_proto;
+                CHECK(frozen_proto.ParseFromArray(contents.data(),
+                                                  static_cast<int>(contents.size())));
+                absl::MutexLock lk(&mu_);
+                freeze_responses_[frozen_proto.view_id()].push_back(FreezeResponse {
+                    .sequencer_id = gsl::narrow_cast<uint16_t>(frozen_proto.sequencer_id()),
+                    .merged       = frozen_proto.merged(),
+                });
+            });
+        freeze_watcher_->Start();
+    }
+
+    ~ReconfigObserver() {
+        session_.ScheduleStop();
+        session_.WaitForFinish();
+    }
+
+    const log::View* WaitForView(uint16_t view_id) {
+        absl::MutexLock lk(&mu_);
+        auto created = [this, view_id] () ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+            return views_.contains(view_id);
+        };
+        if (!mu_.AwaitWithTimeout(absl::Condition(&created),
+                                  absl::GetFlag(FLAGS_event_timeout))) {
+            LOG(FATAL) << "Timed out waiting for view " << view_id;
+        }
+        return views_.at(view_id);
+    }
+
+    std::vector<FreezeResponse> freeze_responses(uint16_t view_id) {
+        absl::MutexLock lk(&mu_);
+        return freeze_responses_[view_id];
+    }
+
+private:
+    zk::ZKSession session_;
+    log::ViewWatcher view_watcher_;
+    std::optional<zk_utils::DirWatcher> freeze_watcher_;
+    absl::Mutex mu_;
+    absl::flat_hash_map<uint16_t, const log::View*> views_ ABSL_GUARDED_BY(mu_);
+    absl::flat_hash_map</* view_id */ uint32_t, std::vector<FreezeResponse>>
+        freeze_responses_ ABSL_GUARDED_BY(mu_);
+
+    DISALLOW_COPY_AND_ASSIGN(ReconfigObserver);
+};
+
+static void CreateEphemeral(zk::ZKSession* session, std::string_view path,
+                            std::string_view data) {
+    zk::ZKStatus status = zk_utils::CreateSync(
+        session, path, std::span<const char>(data.data(), data.size()),
+        zk::ZKCreateMode::kEphemeral, /* created_path= */ nullptr);
+    CHECK(status.ok()) << "Failed to create " << path << ": " << status.ToString();
+}
+
+static void StopSequencer(std::unique_ptr<log::Sequencer> sequencer) {
+    sequencer->ScheduleStop();
+    sequencer->WaitForFinish();
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    std::string work_dir = absl::GetFlag(FLAGS_work_dir);
+    if (fs_utils::Exists(work_dir)) {
+        CHECK(fs_utils::RemoveDirectoryRecursively(work_dir));
+    }
+    CHECK(fs_utils::MakeDirectory(work_dir));
+    std::string socket_path = fs_utils::JoinPath(work_dir, "coordinator.sock");
+    std::string host = fmt::format("{}{}", zk::LocalBackend::kHostPrefix, socket_path);
+    absl::SetFlag(&FLAGS_zookeeper_host, host);
+    absl::SetFlag(&FLAGS_zookeeper_root_path, std::string(kRootPath));
+    absl::SetFlag(&FLAGS_slog_planned_reconfig, true);
+    CHECK_GT(absl::GetFlag(FLAGS_slog_tail_handoff_timeout_ms), 0);
+
+    zk::LocalCoordinator coordinator(socket_path, fs_utils::JoinPath(work_dir, "znodes"));
+    coordinator.EnsureNode(kRootPath);
+    for (const char* dir : { "node", "view", "cmd", "freeze" }) {
+        coordinator.EnsureNode(fs_utils::JoinPath(kRootPath, dir));
+    }
+    coordinator.Start();
+
+    zk::ZKSession nodes(host, kRootPath);
+    nodes.Start();
+    // Sequencers never cut without shard progress, so engines and storage
+    // nodes only have to show up in views
+    CreateEphemeral(&nodes, "node/engine_1", "127.0.0.1:1");
+    CreateEphemeral(&nodes, "node/storage_1", "127.0.0.1:1");
+    absl::flat_hash_map<uint16_t, std::unique_ptr<log::Sequencer>> sequencers;
+    for (uint16_t id = 1; id <= 3; id++) {
+        sequencers[id] = std::make_unique<log::Sequencer>(id);
+        sequencers[id]->Start();
+    }
+
+    log::Controller controller(/* random_seed= */ 1);
+    controller.set_metalog_replicas(3);
+    controller.set_userlog_replicas(1);
+    controller.set_index_replicas(1);
+    controller.set_num_phylogs(1);
+    controller.Start();
+    auto observer = std::make_unique<ReconfigObserver>(host);
+    // Commands are handled once the controller has seen all nodes
+    absl::SleepFor(absl::Milliseconds(100));
+    CreateEphemeral(&nodes, "cmd/start", "");
+    CHECK(observer->WaitForView(0)->is_active_phylog(1));
+
+    // Sequencer 2 runs the phylog in the next view, and merges the tails
+    CreateEphemeral(&nodes, "cmd/reconfig", "seq 2 1 3");
+    CHECK(observer->WaitForView(1)->is_active_phylog(2));
+    size_t num_merged = 0;
+    for (const auto& response : observer->freeze_responses(0)) {
+        if (response.merged) {
+            CHECK_EQ(response.sequencer_id, 2U) << "Tail is not merged by the successor";
+            num_merged++;
+        }
+    }
+    CHECK_EQ(num_merged, 1U) << "View 0 is not sealed by a merged tail";
+    LOG(INFO) << "Tail handoff checks passed";
+
+    // Sequencer 3 runs the phylog in the next view, but is down
+    StopSequencer(std::move(sequencers[3]));
+    sequencers.erase(3);
+    int64_t start_timestamp = GetMonotonicMicroTimestamp();
+    CreateEphemeral(&nodes, "cmd/reconfig", "seq 3 2 1");
+    CHECK(observer->WaitForView(2)->is_active_phylog(3));
+    int64_t elapsed_ms = (GetMonotonicMicroTimestamp() - start_timestamp) / 1000;
+    CHECK_GE(elapsed_ms, absl::GetFlag(FLAGS_slog_tail_handoff_timeout_ms))
+        << "View 1 is sealed before any sequencer falls back";
+    absl::flat_hash_set<uint16_t> reported;
+    for (const auto& response : observer->freeze_responses(1)) {
+        CHECK(!response.merged) << "Tail is merged without the successor";
+        reported.insert(response.sequencer_id);
+    }
+    CHECK(reported.contains(1) && reported.contains(2))
+        << "Sequencers do not fall back to publishing their tails";
+    LOG_F(INFO, "Handoff fallback checks passed: view 1 sealed in {} ms", elapsed_ms);
+
+    observer.reset();
+    controller.ScheduleStop();
+    controller.WaitForFinish();
+    for (auto& [id, sequencer] : sequencers) {
+        StopSequencer(std::move(sequencer));
+    }
+    nodes.ScheduleStop();
+    nodes.WaitForFinish();
+    coordinator.ScheduleStop();
+    coordinator.WaitForFinish();
+    return 0;
+}
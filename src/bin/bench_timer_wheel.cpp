@@ -0,0 +1,222 @@
+#define __FAAS_NOWARN_CONVERSION
+#include "base/init.h"
+#include "base/common.h"
+#include "common/time.h"
+#include "utils/timerfd.h"
+#include "utils/bench.h"
+#include "server/io_uring.h"
+#include "server/timer_wheel.h"
+
+#include <random>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+ABSL_FLAG(size_t, num_timers, 1000000, "Number of timers scheduled on the timer wheel");
+ABSL_FLAG(size_t, num_timerfds, 10000,
+          "Number of timerfds to compare with, bounded by the limit of open files");
+ABSL_FLAG(double, cancel_ratio, 0.5, "Ratio of timers cancelled before expiry");
+ABSL_FLAG(absl::Duration, min_delay, absl::Milliseconds(1), "Minimal delay of timers");
+ABSL_FLAG(absl::Duration, max_delay, absl::Seconds(1), "Maximal delay of timers");
+ABSL_FLAG(int, cpu, -1, "Pin the benchmark to this CPU");
+ABSL_FLAG(absl::Duration, idle_time, absl::Milliseconds(500),
+          "Time the timer wheel stays empty before a timer is scheduled again");
+ABSL_DECLARE_FLAG(uint32_t, timer_wheel_tick_us);
+
+using namespace faas;
+
+// Deadlines of timers, and which of them are cancelled
+struct Workload {
+    std::vector<int64_t> deadlines;
+    std::vector<bool> cancelled;
+    size_t num_expected;
+};
+
+static Workload GenerateWorkload(size_t num_timers) {
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int64_t> delay_dist(
+        absl::ToInt64Nanoseconds(absl::GetFlag(FLAGS_min_delay)),
+        absl::ToInt64Nanoseconds(absl::GetFlag(FLAGS_max_delay)));
+    std::bernoulli_distribution cancel_dist(absl::GetFlag(FLAGS_cancel_ratio));
+    Workload workload;
+    workload.num_expected = 0;
+    int64_t start_timestamp = GetMonotonicNanoTimestamp();
+    for (size_t i = 0; i < num_timers; i++) {
+        workload.deadlines.push_back(start_timestamp + delay_dist(rng));
+        workload.cancelled.push_back(cancel_dist(rng));
+        if (!workload.cancelled.back()) {
+            workload.num_expected++;
+        }
+    }
+    return workload;
+}
+
+static void ReportResults(std::string_view name, const Workload& workload,
+                          int64_t schedule_ns, int64_t cancel_ns,
+                          bench_utils::Samples<int32_t>* lateness,
+                          utils::PerfEventGroup* perf_event_group, int64_t elapsed_ns) {
+    size_t num_timers = workload.deadlines.size();
+    size_t num_cancelled = num_timers - workload.num_expected;
+    LOG_F(INFO, "{}: {} timers, {} cancelled", name, num_timers, num_cancelled);
+    LOG_F(INFO, "{}: schedule {:.1f} ns per timer, cancel {:.1f} ns per timer", name,
+          static_cast<double>(schedule_ns) / num_timers,
+          static_cast<double>(cancel_ns) / std::max<size_t>(num_cancelled, 1));
+    lateness->ReportStatistics(fmt::format("{} lateness (us)", name));
+    bench_utils::ReportCpuRelatedPerfEventValues(name, perf_event_group,
+                                                 absl::Nanoseconds(elapsed_ns), num_timers);
+}
+
+static void RunTimerWheel(int cpu) {
+    Workload workload = GenerateWorkload(absl::GetFlag(FLAGS_num_timers));
+    size_t num_timers = workload.deadlines.size();
+    bench_utils::Samples<int32_t> lateness(num_timers + 1);
+    size_t fired = 0;
+
+    server::IOUring io_uring;
+    server::TimerWheel timer_wheel(&io_uring);
+    std::vector<std::unique_ptr<server::TimerWheel::Entry>> entries;
+    for (size_t i = 0; i < num_timers; i++) {
+        int64_t deadline = workload.deadlines[i];
+        entries.push_back(std::make_unique<server::TimerWheel::Entry>(
+            [&lateness, &fired, deadline] {
+                int64_t late_ns = GetMonotonicNanoTimestamp() - deadline;
+                lateness.Add(gsl::narrow_cast<int32_t>(late_ns / 1000));
+                fired++;
+            }));
+    }
+
+    auto perf_event_group = bench_utils::SetupCpuRelatedPerfEvents(cpu);
+    perf_event_group->ResetAndEnable();
+    int64_t start_timestamp = GetMonotonicNanoTimestamp();
+    for (size_t i = 0; i < num_timers; i++) {
+        timer_wheel.Schedule(entries[i].get(), workload.deadlines[i]);
+    }
+    int64_t schedule_timestamp = GetMonotonicNanoTimestamp();
+    for (size_t i = 0; i < num_timers; i++) {
+        if (workload.cancelled[i]) {
+            timer_wheel.Cancel(entries[i].get());
+        }
+    }
+    int64_t cancel_timestamp = GetMonotonicNanoTimestamp();
+    size_t inflight_ops;
+    while (fired < workload.num_expected) {
+        io_uring.EventLoopRunOnce(&inflight_ops);
+    }
+    int64_t elapsed_ns = GetMonotonicNanoTimestamp() - start_timestamp;
+    perf_event_group->Disable();
+    CHECK_EQ(timer_wheel.size(), 0U);
+
+    ReportResults("TimerWheel", workload, schedule_timestamp - start_timestamp,
+                  cancel_timestamp - schedule_timestamp, &lateness,
+                  perf_event_group.get(), elapsed_ns);
+    while (inflight_ops > 0) {
+        io_uring.EventLoopRunOnce(&inflight_ops);
+    }
+}
+
+// A wheel left empty does not advance, so it catches up on the next Schedule
+static void CheckIdleResync() {
+    server::IOUring io_uring;
+    server::TimerWheel timer_wheel(&io_uring);
+    size_t inflight_ops;
+    int64_t fired_timestamp = 0;
+    server::TimerWheel::Entry entry([&fired_timestamp] {
+        fired_timestamp = GetMonotonicNanoTimestamp();
+    });
+    absl::Duration delay = absl::Milliseconds(1);
+    int64_t tick_ns = int64_t{absl::GetFlag(FLAGS_timer_wheel_tick_us)} * 1000;
+    for (int round = 0; round < 3; round++) {
+        absl::SleepFor(absl::GetFlag(FLAGS_idle_time));
+        int64_t deadline = GetMonotonicNanoTimestamp() + absl::ToInt64Nanoseconds(delay);
+        timer_wheel.Schedule(&entry, deadline);
+        fired_timestamp = 0;
+        while (fired_timestamp == 0) {
+            io_uring.EventLoopRunOnce(&inflight_ops);
+        }
+        CHECK_GE(fired_timestamp, deadline) << "Timer fires before its deadline";
+        LOG_F(INFO, "Timer scheduled after idle fires {} us late",
+              (fired_timestamp - deadline) / 1000);
+        // A few ticks of slack for scheduling jitter
+        CHECK_LE(fired_timestamp - deadline, 10 * tick_ns + 1000000);
+    }
+    CHECK_EQ(timer_wheel.size(), 0U);
+    while (inflight_ops > 0) {
+        io_uring.EventLoopRunOnce(&inflight_ops);
+    }
+}
+
+// Baseline as the previous Timer implementation: one timerfd per timer
+static void RunTimerFd(int cpu) {
+    Workload workload = GenerateWorkload(absl::GetFlag(FLAGS_num_timerfds));
+    size_t num_timers = workload.deadlines.size();
+    bench_utils::Samples<int32_t> lateness(num_timers + 1);
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    PCHECK(epoll_fd != -1);
+    std::vector<int> timerfds;
+    for (size_t i = 0; i < num_timers; i++) {
+        int fd = io_utils::CreateTimerFd();
+        CHECK(fd != -1);
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = i;
+        PCHECK(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0);
+        timerfds.push_back(fd);
+    }
+
+    auto perf_event_group = bench_utils::SetupCpuRelatedPerfEvents(cpu);
+    perf_event_group->ResetAndEnable();
+    int64_t start_timestamp = GetMonotonicNanoTimestamp();
+    for (size_t i = 0; i < num_timers; i++) {
+        int64_t delay = workload.deadlines[i] - GetMonotonicNanoTimestamp();
+        CHECK(io_utils::SetupTimerFdOneTime(timerfds[i],
+                                            absl::Nanoseconds(std::max<int64_t>(delay, 1))));
+    }
+    int64_t schedule_timestamp = GetMonotonicNanoTimestamp();
+    for (size_t i = 0; i < num_timers; i++) {
+        if (workload.cancelled[i]) {
+            struct itimerspec spec;
+            memset(&spec, 0, sizeof(spec));
+            PCHECK(timerfd_settime(timerfds[i], 0, &spec, nullptr) == 0);
+        }
+    }
+    int64_t cancel_timestamp = GetMonotonicNanoTimestamp();
+    size_t fired = 0;
+    struct epoll_event events[64];
+    while (fired < workload.num_expected) {
+        int n = epoll_wait(epoll_fd, events, 64, -1);
+        PCHECK(n >= 0 || errno == EINTR);
+        for (int i = 0; i < n; i++) {
+            int64_t now = GetMonotonicNanoTimestamp();
+            size_t idx = events[i].data.u64;
+            uint64_t value;
+            PCHECK(read(timerfds[idx], &value, sizeof(value)) == sizeof(value));
+            lateness.Add(gsl::narrow_cast<int32_t>((now - workload.deadlines[idx]) / 1000));
+            fired++;
+        }
+    }
+    int64_t elapsed_ns = GetMonotonicNanoTimestamp() - start_timestamp;
+    perf_event_group->Disable();
+
+    ReportResults("TimerFd", workload, schedule_timestamp - start_timestamp,
+                  cancel_timestamp - schedule_timestamp, &lateness,
+                  perf_event_group.get(), elapsed_ns);
+    for (int fd: timerfds) {
+        PCHECK(close(fd) == 0);
+    }
+    PCHECK(close(epoll_fd) == 0);
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+
+    int cpu = absl::GetFlag(FLAGS_cpu);
+    if (cpu != -1) {
+        bench_utils::PinCurrentThreadToCpu(cpu);
+    }
+    CheckIdleResync();
+    RunTimerWheel(cpu);
+    if (absl::GetFlag(FLAGS_num_timerfds) > 0) {
+        RunTimerFd(cpu);
+    }
+    return 0;
+}
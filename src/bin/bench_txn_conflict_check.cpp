@@ -0,0 +1,230 @@
+#define __FAAS_NOWARN_CONVERSION
+#include "base/init.h"
+#include "base/common.h"
+#include "common/time.h"
+#include "log/index.h"
+#include "log/view.h"
+#include "utils/bench.h"
+#include "utils/bits.h"
+
+#include <random>
+
+ABSL_FLAG(std::string, num_objects, "4096,1024,256,64,16",
+          "Comma-separated numbers of hot objects, fewer objects mean more contention");
+ABSL_FLAG(size_t, num_logs, 1 << 18, "Number of object logs in the index");
+ABSL_FLAG(size_t, logs_per_metalog, 64, "Number of logs indexed by each metalog");
+ABSL_FLAG(size_t, objects_per_txn, 4, "Number of objects written by each log");
+ABSL_FLAG(size_t, txn_window, 256, "Number of logs appended between txn start and commit");
+ABSL_FLAG(size_t, num_commits, 4096, "Number of commits validated");
+ABSL_FLAG(int, round_trip_us, 200, "Modeled latency of one worker-engine-storage round trip");
+ABSL_FLAG(uint32_t, random_seed, 23333, "Random seed");
+
+// Validates txn commits against an in-process log index, both by serial
+// ReadPrev queries per written object (one round trip each) and by a single
+// conflict query, and checks they find the same logs.
+
+using namespace faas;
+
+using log::Index;
+using log::IndexQuery;
+using log::IndexQueryResult;
+using log::ConflictQuery;
+using log::ConflictQueryResult;
+using log::View;
+using log::ViewProto;
+
+static constexpr uint16_t kSequencerId = 0;
+static constexpr uint16_t kEngineId = 0;
+static constexpr uint32_t kUserLogSpace = 0;
+
+static ViewProto BuildViewProto() {
+    ViewProto view_proto;
+    view_proto.set_view_id(0);
+    view_proto.set_metalog_replicas(1);
+    view_proto.set_userlog_replicas(1);
+    view_proto.set_index_replicas(1);
+    view_proto.set_num_phylogs(1);
+    view_proto.add_sequencer_nodes(kSequencerId);
+    view_proto.add_engine_nodes(kEngineId);
+    view_proto.add_storage_nodes(0);
+    view_proto.add_storage_plan(0);
+    view_proto.add_index_plan(kEngineId);
+    return view_proto;
+}
+
+static uint64_t ObjectTag(size_t object) {
+    // Tag 0 is the empty tag
+    return uint64_t{object} + 1;
+}
+
+static void BuildIndex(Index* index, size_t num_objects,
+                       std::vector<log::UserTagVec>* log_tags, std::mt19937* rnd_gen) {
+    std::uniform_int_distribution<size_t> object_dist(0, num_objects - 1);
+    size_t num_logs = absl::GetFlag(FLAGS_num_logs);
+    size_t batch_size = absl::GetFlag(FLAGS_logs_per_metalog);
+    size_t objects_per_txn = std::min(absl::GetFlag(FLAGS_objects_per_txn), num_objects);
+    uint32_t metalog_seqnum = 0;
+    for (size_t start = 0; start < num_logs; start += batch_size) {
+        size_t n = std::min(batch_size, num_logs - start);
+        log::IndexDataProto index_data;
+        index_data.set_logspace_id(index->identifier());
+        for (size_t i = 0; i < n; i++) {
+            log::UserTagVec tags;
+            while (tags.size() < objects_per_txn) {
+                uint64_t tag = ObjectTag(object_dist(*rnd_gen));
+                if (absl::c_find(tags, tag) == tags.end()) {
+                    tags.push_back(tag);
+                }
+            }
+            index_data.add_seqnum_halves(gsl::narrow_cast<uint32_t>(start + i));
+            index_data.add_engine_ids(kEngineId);
+            index_data.add_user_logspaces(kUserLogSpace);
+            index_data.add_user_tag_sizes(gsl::narrow_cast<uint32_t>(tags.size()));
+            for (uint64_t tag : tags) {
+                index_data.add_user_tags(tag);
+            }
+            log_tags->push_back(std::move(tags));
+        }
+        index->ProvideIndexData(index_data);
+
+        log::MetaLogProto metalog;
+        metalog.set_logspace_id(index->identifier());
+        metalog.set_metalog_seqnum(metalog_seqnum++);
+        metalog.set_type(log::MetaLogProto::NEW_LOGS);
+        auto* new_logs_proto = metalog.mutable_new_logs_proto();
+        new_logs_proto->set_start_seqnum(gsl::narrow_cast<uint32_t>(start));
+        new_logs_proto->add_shard_starts(gsl::narrow_cast<uint32_t>(start));
+        new_logs_proto->add_shard_deltas(gsl::narrow_cast<uint32_t>(n));
+        index->ProvideMetaLog(metalog);
+    }
+    CHECK_EQ(index->metalog_position(), metalog_seqnum);
+}
+
+// Walks back from to_seqnum per tag, one ReadPrev round trip per step
+static std::vector<uint64_t> SerialReadPrev(Index* index, const log::UserTagVec& tags,
+                                            uint64_t from_seqnum, uint64_t to_seqnum,
+                                            size_t* round_trips) {
+    std::vector<uint64_t> seqnums;
+    for (uint64_t tag : tags) {
+        uint64_t seqnum = to_seqnum;
+        while (seqnum > from_seqnum) {
+            IndexQuery query = {
+                .direction = IndexQuery::kReadPrev,
+                .origin_node_id = kEngineId,
+                .hop_times = 0,
+                .initial = true,
+                .client_data = 0,
+                .user_logspace = kUserLogSpace,
+                .user_tag = tag,
+                .query_seqnum = seqnum - 1,
+                .metalog_progress = bits::JoinTwo32(index->identifier(),
+                                                    index->metalog_position()),
+                .prev_found_result = {.view_id = 0, .engine_id = 0,
+                                      .seqnum = protocol::kInvalidLogSeqNum}
+            };
+            Index::QueryResultVec results;
+            index->MakeQuery(query);
+            index->PollQueryResults(&results);
+            CHECK_EQ(results.size(), 1U);
+            (*round_trips)++;
+            if (results[0].state != IndexQueryResult::kFound ||
+                results[0].found_result.seqnum < from_seqnum) {
+                break;
+            }
+            seqnum = results[0].found_result.seqnum;
+            seqnums.push_back(seqnum);
+        }
+    }
+    absl::c_sort(seqnums, std::greater<uint64_t>());
+    seqnums.erase(std::unique(seqnums.begin(), seqnums.end()), seqnums.end());
+    return seqnums;
+}
+
+static std::vector<uint64_t> CheckConflict(Index* index, const log::UserTagVec& tags,
+                                           uint64_t from_seqnum, uint64_t to_seqnum,
+                                           size_t* round_trips) {
+    ConflictQuery query = {
+        .client_data = 0,
+        .user_logspace = kUserLogSpace,
+        .user_tags = tags,
+        .from_seqnum = from_seqnum,
+        .to_seqnum = to_seqnum,
+        .metalog_progress = bits::JoinTwo32(index->identifier(), index->metalog_position())
+    };
+    Index::ConflictResultVec results;
+    index->MakeConflictQuery(query);
+    index->PollConflictQueryResults(&results);
+    CHECK_EQ(results.size(), 1U);
+    CHECK(results[0].state == ConflictQueryResult::kFound) << "Conflict query incomplete";
+    // One more round trip for reading conflicting logs concurrently
+    *round_trips += results[0].seqnums.empty() ? 1 : 2;
+    return results[0].seqnums;
+}
+
+static void RunContention(const View* view, size_t num_objects) {
+    std::mt19937 rnd_gen(absl::GetFlag(FLAGS_random_seed));
+    Index index(view, kSequencerId);
+    std::vector<log::UserTagVec> log_tags;
+    BuildIndex(&index, num_objects, &log_tags, &rnd_gen);
+
+    size_t window = std::min(absl::GetFlag(FLAGS_txn_window), log_tags.size() - 1);
+    std::uniform_int_distribution<size_t> commit_dist(window, log_tags.size() - 1);
+    size_t num_commits = absl::GetFlag(FLAGS_num_commits);
+    bench_utils::Samples<int32_t> serial_ns(num_commits);
+    bench_utils::Samples<int32_t> conflict_ns(num_commits);
+    size_t serial_round_trips = 0;
+    size_t conflict_round_trips = 0;
+    size_t num_conflicting = 0;
+    for (size_t i = 0; i < num_commits; i++) {
+        size_t commit = commit_dist(rnd_gen);
+        uint64_t to_seqnum = bits::JoinTwo32(index.identifier(),
+                                             gsl::narrow_cast<uint32_t>(commit));
+        // TxnId is the seqnum of txn start, conflicts are after it
+        uint64_t from_seqnum = to_seqnum - window + 1;
+        const log::UserTagVec& tags = log_tags[commit];
+
+        int64_t start_timestamp = GetMonotonicNanoTimestamp();
+        auto expected = SerialReadPrev(&index, tags, from_seqnum, to_seqnum,
+                                       &serial_round_trips);
+        serial_ns.Add(gsl::narrow_cast<int32_t>(GetMonotonicNanoTimestamp() - start_timestamp));
+
+        start_timestamp = GetMonotonicNanoTimestamp();
+        auto seqnums = CheckConflict(&index, tags, from_seqnum, to_seqnum,
+                                     &conflict_round_trips);
+        conflict_ns.Add(gsl::narrow_cast<int32_t>(GetMonotonicNanoTimestamp() - start_timestamp));
+
+        CHECK(seqnums == expected) << "Conflict query differs from serial reads";
+        if (!seqnums.empty()) {
+            num_conflicting++;
+        }
+    }
+
+    double round_trip_us = absl::GetFlag(FLAGS_round_trip_us);
+    auto per_commit = [num_commits] (size_t n) {
+        return static_cast<double>(n) / static_cast<double>(num_commits);
+    };
+    LOG_F(INFO, "{} objects: {:.1f}% commits see conflicting logs",
+          num_objects, 100.0 * per_commit(num_conflicting));
+    LOG_F(INFO, "{} objects: serial ReadPrev: {:.1f} round trips, {:.1f} us per commit",
+          num_objects, per_commit(serial_round_trips),
+          per_commit(serial_round_trips) * round_trip_us);
+    LOG_F(INFO, "{} objects: CHECK_CONFLICT: {:.1f} round trips, {:.1f} us per commit",
+          num_objects, per_commit(conflict_round_trips),
+          per_commit(conflict_round_trips) * round_trip_us);
+    serial_ns.ReportStatistics(fmt::format("{} objects: serial ReadPrev index time (ns)",
+                                           num_objects));
+    conflict_ns.ReportStatistics(fmt::format("{} objects: CHECK_CONFLICT index time (ns)",
+                                             num_objects));
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    View view(BuildViewProto());
+    for (std::string_view item : absl::StrSplit(absl::GetFlag(FLAGS_num_objects), ',',
+                                                absl::SkipEmpty())) {
+        size_t num_objects;
+        CHECK(absl::SimpleAtoi(item, &num_objects) && num_objects > 0);
+        RunContention(&view, num_objects);
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+#define __FAAS_NOWARN_CONVERSION
+#include "base/init.h"
+#include "base/common.h"
+#include "server/io_uring.h"
+#include "utils/bench.h"
+#include "utils/socket.h"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+
+ABSL_FLAG(std::string, message_sizes, "4096,16384,65536,262144,1048576",
+          "Comma-separated byte sizes of messages");
+ABSL_FLAG(size_t, inflight_messages, 8, "Number of inflight messages");
+ABSL_FLAG(int, tcp_port, 32767, "Port of the loopback TCP connection");
+ABSL_FLAG(int, sender_cpu, -1, "Pin sender process to this CPU");
+ABSL_FLAG(absl::Duration, duration, absl::Seconds(5), "Duration to run each case");
+
+ABSL_DECLARE_FLAG(size_t, io_uring_zc_buf_size);
+ABSL_DECLARE_FLAG(size_t, io_uring_zc_bufs);
+
+using namespace faas;
+
+static constexpr size_t kRecvBufSize = 1 << 20;
+
+// Drains the connection until the sender closes it
+void Receiver() {
+    int fd = utils::TcpSocketConnect("127.0.0.1", absl::GetFlag(FLAGS_tcp_port));
+    CHECK(fd != -1);
+    char* buf = new char[kRecvBufSize];
+    while (true) {
+        ssize_t ret = recv(fd, buf, kRecvBufSize, 0);
+        PCHECK(ret >= 0);
+        if (ret == 0) {
+            break;
+        }
+    }
+    delete[] buf;
+    PCHECK(close(fd) == 0);
+}
+
+void RunCase(server::IOUring* io_uring, int listen_fd, size_t message_size, bool zero_copy) {
+    pid_t child_pid = fork();
+    if (child_pid == 0) {
+        Receiver();
+        exit(0);
+    }
+    PCHECK(child_pid != -1);
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int fd = accept(listen_fd, (struct sockaddr*)&addr, &addr_len);
+    PCHECK(fd != -1);
+    CHECK(io_uring->RegisterFd(fd));
+
+    // Zero-copy sends use buffers of the IOUring, the others use plain buffers
+    std::vector<std::span<char>> free_bufs;
+    size_t inflight_messages = absl::GetFlag(FLAGS_inflight_messages);
+    for (size_t i = 0; i < inflight_messages; i++) {
+        std::span<char> buf;
+        if (zero_copy) {
+            buf = io_uring->NewZeroCopyBuffer(message_size).subspan(0, message_size);
+        } else {
+            buf = std::span<char>(new char[message_size], message_size);
+        }
+        memset(buf.data(), 0, buf.size());
+        free_bufs.push_back(buf);
+    }
+
+    size_t inflight = 0;
+    size_t bytes_sent = 0;
+    size_t inflight_ops;
+    auto perf_event_group = bench_utils::SetupCpuRelatedPerfEvents(
+        absl::GetFlag(FLAGS_sender_cpu));
+    perf_event_group->ResetAndEnable();
+    bench_utils::BenchLoop bench_loop(absl::GetFlag(FLAGS_duration), [&] () -> bool {
+        while (!free_bufs.empty()) {
+            std::span<char> buf = free_bufs.back();
+            free_bufs.pop_back();
+            auto cb = [&, buf] (int status) {
+                PCHECK(status == 0);
+                free_bufs.push_back(buf);
+                bytes_sent += buf.size();
+                inflight--;
+            };
+            if (zero_copy) {
+                CHECK(io_uring->SendZeroCopy(fd, buf, cb));
+            } else {
+                CHECK(io_uring->SendAll(fd, buf, cb));
+            }
+            inflight++;
+        }
+        io_uring->EventLoopRunOnce(&inflight_ops);
+        return true;
+    });
+    perf_event_group->Disable();
+    while (inflight > 0) {
+        io_uring->EventLoopRunOnce(&inflight_ops);
+    }
+
+    std::vector<uint64_t> values = perf_event_group->ReadValues();
+    double gbytes = static_cast<double>(bytes_sent) / 1e9;
+    std::string header = fmt::format("{} message_size={}",
+                                     zero_copy ? "ZeroCopy" : "Copy", message_size);
+    LOG(INFO) << header << ": throughput: "
+              << gbytes / absl::ToDoubleSeconds(bench_loop.elapsed_time()) << " GB/s";
+    LOG(INFO) << header << ": CPU cycles per GB: "
+              << static_cast<double>(values[0]) / gbytes;
+    LOG(INFO) << header << ": instructions per GB: "
+              << static_cast<double>(values[1]) / gbytes;
+
+    for (std::span<char> buf : free_bufs) {
+        if (zero_copy) {
+            io_uring->ReturnZeroCopyBuffer(buf);
+        } else {
+            delete[] buf.data();
+        }
+    }
+    bool closed = false;
+    CHECK(io_uring->Close(fd, [&closed] () { closed = true; }));
+    while (!closed) {
+        io_uring->EventLoopRunOnce(&inflight_ops);
+    }
+    int wstatus;
+    CHECK(waitpid(child_pid, &wstatus, 0) == child_pid);
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+
+    std::vector<size_t> message_sizes;
+    for (std::string_view part : absl::StrSplit(absl::GetFlag(FLAGS_message_sizes), ',')) {
+        size_t size;
+        CHECK(absl::SimpleAtoi(part, &size)) << "Invalid message size: " << part;
+        message_sizes.push_back(size);
+    }
+    CHECK(!message_sizes.empty());
+    size_t max_size = *std::max_element(message_sizes.begin(), message_sizes.end());
+    if (absl::GetFlag(FLAGS_io_uring_zc_buf_size) < max_size) {
+        absl::SetFlag(&FLAGS_io_uring_zc_buf_size, max_size);
+    }
+    size_t inflight_messages = absl::GetFlag(FLAGS_inflight_messages);
+    if (absl::GetFlag(FLAGS_io_uring_zc_bufs) < inflight_messages) {
+        absl::SetFlag(&FLAGS_io_uring_zc_bufs, inflight_messages);
+    }
+
+    int cpu = absl::GetFlag(FLAGS_sender_cpu);
+    if (cpu != -1) {
+        bench_utils::PinCurrentThreadToCpu(cpu);
+    }
+    int listen_fd = utils::TcpSocketBindAndListen("127.0.0.1", absl::GetFlag(FLAGS_tcp_port));
+    CHECK(listen_fd != -1);
+
+    server::IOUring io_uring;
+    io_uring.PrepareZeroCopyBuffers();
+    for (size_t message_size : message_sizes) {
+        RunCase(&io_uring, listen_fd, message_size, /* zero_copy= */ false);
+        RunCase(&io_uring, listen_fd, message_size, /* zero_copy= */ true);
+    }
+    PCHECK(close(listen_fd) == 0);
+    return 0;
+}
@@ -0,0 +1,283 @@
+#include "base/init.h"
+#include "base/common.h"
+#include "common/flags.h"
+#include "common/zk.h"
+#include "common/zk_local.h"
+#include "common/zk_utils.h"
+#include "log/controller.h"
+#include "log/view_watcher.h"
+#include "utils/fs.h"
+
+ABSL_FLAG(std::string, work_dir, "/tmp/bench_zk_local_view_change",
+          "Directory for the coordinator socket and data file");
+ABSL_FLAG(absl::Duration, event_timeout, absl::Seconds(5),
+          "Time to wait for each view event");
+
+// Drives a view change through LocalCoordinator, the way Controller
+// publishes it and ViewWatcher consumes it. Checks view events arrive in
+// order, that ephemeral znodes go away with their session, and that a
+// coordinator restarted from its data file replays the same history.
+// Then runs a real Controller against the coordinator, and checks that a
+// reconfig command installs a new view with the phylog moved.
+
+using namespace faas;
+
+using log::FinalizedViewProto;
+using log::FrozenSequencerProto;
+using log::ViewProto;
+
+static constexpr std::string_view kRootPath = "/faas";
+
+static ViewProto BuildViewProto(uint16_t view_id) {
+    ViewProto view_proto;
+    view_proto.set_view_id(view_id);
+    view_proto.set_metalog_replicas(1);
+    view_proto.set_userlog_replicas(1);
+    view_proto.set_index_replicas(1);
+    view_proto.set_num_phylogs(1);
+    view_proto.add_sequencer_nodes(1);
+    view_proto.add_index_plan(1);
+    view_proto.add_storage_nodes(1);
+    view_proto.add_engine_nodes(1);
+    view_proto.add_storage_plan(1);
+    view_proto.add_log_space_hash_tokens(1);
+    return view_proto;
+}
+
+// Records view events seen by a ViewWatcher, which run on the event loop
+// thread of its session
+class ViewEventRecorder {
+public:
+    explicit ViewEventRecorder(std::string_view host)
+        : session_(host, kRootPath) {
+        watcher_.SetViewCreatedCallback([this] (const log::View* view) {
+            {
+                absl::MutexLock lk(&mu_);
+                views_[view->id()] = view;
+            }
+            Record(fmt::format("created:{}", view->id()));
+        });
+        watcher_.SetViewFrozenCallback([this] (const log::View* view) {
+            Record(fmt::format("frozen:{}", view->id()));
+        });
+        watcher_.SetViewFinalizedCallback([this] (const log::FinalizedView* view) {
+            Record(fmt::format("finalized:{}", view->view()->id()));
+        });
+        session_.Start();
+        watcher_.StartWatching(&session_);
+    }
+
+    ~ViewEventRecorder() {
+        session_.ScheduleStop();
+        session_.WaitForFinish();
+    }
+
+    zk::ZKSession* session() { return &session_; }
+
+    // Views are owned by the ViewWatcher, and never change once created
+    const log::View* view(uint16_t view_id) {
+        absl::MutexLock lk(&mu_);
+        CHECK(views_.contains(view_id)) << "View " << view_id << " is not created";
+        return views_.at(view_id);
+    }
+
+    void WaitForEvents(const std::vector<std::string>& expected) {
+        absl::MutexLock lk(&mu_);
+        auto reached = [this, &expected] () ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+            return events_.size() >= expected.size();
+        };
+        if (!mu_.AwaitWithTimeout(absl::Condition(&reached),
+                                  absl::GetFlag(FLAGS_event_timeout))) {
+            LOG(FATAL) << "Timed out waiting for view events, received: "
+                       << absl::StrJoin(events_, ", ");
+        }
+        CHECK(events_ == expected) << "Unexpected view events: "
+                                   << absl::StrJoin(events_, ", ");
+    }
+
+private:
+    zk::ZKSession session_;
+    log::ViewWatcher watcher_;
+    absl::Mutex mu_;
+    std::vector<std::string> events_ ABSL_GUARDED_BY(mu_);
+    absl::flat_hash_map<uint16_t, const log::View*> views_ ABSL_GUARDED_BY(mu_);
+
+    void Record(std::string event) {
+        absl::MutexLock lk(&mu_);
+        events_.push_back(std::move(event));
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ViewEventRecorder);
+};
+
+static std::unique_ptr<zk::LocalCoordinator> StartCoordinator(std::string_view socket_path,
+                                                              std::string_view data_file) {
+    auto coordinator = std::make_unique<zk::LocalCoordinator>(socket_path, data_file);
+    coordinator->EnsureNode(kRootPath);
+    for (const char* dir : { "node", "view", "cmd", "freeze" }) {
+        coordinator->EnsureNode(fs_utils::JoinPath(kRootPath, dir));
+    }
+    coordinator->Start();
+    return coordinator;
+}
+
+static void StopCoordinator(std::unique_ptr<zk::LocalCoordinator> coordinator) {
+    coordinator->ScheduleStop();
+    coordinator->WaitForFinish();
+}
+
+static bool NodeExists(zk::ZKSession* session, std::string_view path) {
+    zk::ZKStatus exists_status;
+    absl::Notification finished;
+    session->Exists(path, nullptr,
+                    [&] (zk::ZKStatus status, const zk::ZKResult&, bool*) {
+                        exists_status = status;
+                        finished.Notify();
+                    });
+    finished.WaitForNotification();
+    CHECK(exists_status.ok() || exists_status.IsNoNode()) << exists_status.ToString();
+    return exists_status.ok();
+}
+
+static void Publish(zk::ZKSession* session, std::string_view path, const std::string& data) {
+    zk::ZKStatus status = zk_utils::CreateSync(
+        session, path, STRING_AS_SPAN(data), zk::ZKCreateMode::kPersistentSequential,
+        /* created_path= */ nullptr);
+    CHECK(status.ok()) << "Failed to create " << path << ": " << status.ToString();
+}
+
+static void CreateEphemeral(zk::ZKSession* session, std::string_view path,
+                            std::string_view data) {
+    zk::ZKStatus status = zk_utils::CreateSync(
+        session, path, std::span<const char>(data.data(), data.size()),
+        zk::ZKCreateMode::kEphemeral, /* created_path= */ nullptr);
+    CHECK(status.ok()) << "Failed to create " << path << ": " << status.ToString();
+}
+
+// Sequencers 1 and 2 run one phylog, which the reconfig command moves from
+// sequencer 1 to sequencer 2. This bench acts as the frozen sequencer 1.
+static void CheckControllerReconfig(std::string_view host) {
+    absl::SetFlag(&FLAGS_zookeeper_host, std::string(host));
+    absl::SetFlag(&FLAGS_zookeeper_root_path, std::string(kRootPath));
+    zk::ZKSession nodes(host, kRootPath);
+    nodes.Start();
+    for (std::string_view name : { "sequencer_1", "sequencer_2", "engine_1", "storage_1" }) {
+        CreateEphemeral(&nodes, fmt::format("node/{}", name), "127.0.0.1:1");
+    }
+
+    log::Controller controller(/* random_seed= */ 1);
+    controller.set_metalog_replicas(1);
+    controller.set_userlog_replicas(1);
+    controller.set_index_replicas(1);
+    controller.set_num_phylogs(1);
+    controller.Start();
+    ViewEventRecorder recorder(host);
+    // Commands are handled once the controller has seen all nodes
+    absl::SleepFor(absl::Milliseconds(100));
+    CreateEphemeral(&nodes, "cmd/start", "");
+    recorder.WaitForEvents({"created:0"});
+    const log::View* view = recorder.view(0);
+    CHECK(view->is_active_phylog(1) && !view->is_active_phylog(2));
+
+    CreateEphemeral(&nodes, "cmd/reconfig", "seq 2 1");
+    recorder.WaitForEvents({"created:0", "frozen:0"});
+    FrozenSequencerProto frozen_proto;
+    frozen_proto.set_view_id(0);
+    frozen_proto.set_sequencer_id(1);
+    frozen_proto.add_tail_metalogs()->set_logspace_id(bits::JoinTwo16(0, 1));
+    std::string serialized;
+    CHECK(frozen_proto.SerializeToString(&serialized));
+    Publish(&nodes, "freeze/0-1", serialized);
+    recorder.WaitForEvents({"created:0", "frozen:0", "finalized:0", "created:1"});
+
+    view = recorder.view(1);
+    std::vector<uint16_t> sequencers(view->GetSequencerNodes().begin(),
+                                     view->GetSequencerNodes().end());
+    CHECK(sequencers == std::vector<uint16_t>({2, 1}))
+        << "Sequencers of the new view are not reconfigured";
+    CHECK(view->is_active_phylog(2) && !view->is_active_phylog(1));
+    CHECK_EQ(view->log_space_hash_seed(), recorder.view(0)->log_space_hash_seed());
+
+    controller.ScheduleStop();
+    controller.WaitForFinish();
+    nodes.ScheduleStop();
+    nodes.WaitForFinish();
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    std::string work_dir = absl::GetFlag(FLAGS_work_dir);
+    if (fs_utils::Exists(work_dir)) {
+        CHECK(fs_utils::RemoveDirectoryRecursively(work_dir));
+    }
+    CHECK(fs_utils::MakeDirectory(work_dir));
+    std::string socket_path = fs_utils::JoinPath(work_dir, "coordinator.sock");
+    std::string data_file = fs_utils::JoinPath(work_dir, "znodes");
+    std::string host = fmt::format("{}{}", zk::LocalBackend::kHostPrefix, socket_path);
+
+    const std::vector<std::string> expected_events = {
+        "created:0", "frozen:0", "finalized:0", "created:1"
+    };
+
+    auto coordinator = StartCoordinator(socket_path, data_file);
+    {
+        zk::ZKSession controller(host, kRootPath);
+        controller.Start();
+        auto recorder = std::make_unique<ViewEventRecorder>(host);
+        zk::ZKStatus status = zk_utils::CreateSync(
+            recorder->session(), "node/engine_1", EMPTY_CHAR_SPAN,
+            zk::ZKCreateMode::kEphemeral, /* created_path= */ nullptr);
+        CHECK(status.ok()) << status.ToString();
+
+        // Controller::InstallNewView, ReconfigView and OnSealFinished
+        std::string serialized;
+        CHECK(BuildViewProto(0).SerializeToString(&serialized));
+        Publish(&controller, "view/new", serialized);
+        recorder->WaitForEvents({expected_events.begin(), expected_events.begin() + 1});
+
+        Publish(&controller, "view/freeze", "0");
+        recorder->WaitForEvents({expected_events.begin(), expected_events.begin() + 2});
+
+        FinalizedViewProto finalized_view;
+        finalized_view.set_view_id(0);
+        finalized_view.add_metalog_positions(0);
+        finalized_view.add_tail_metalogs()->set_logspace_id(bits::JoinTwo16(0, 1));
+        CHECK(finalized_view.SerializeToString(&serialized));
+        Publish(&controller, "view/finalize", serialized);
+        recorder->WaitForEvents({expected_events.begin(), expected_events.begin() + 3});
+
+        CHECK(BuildViewProto(1).SerializeToString(&serialized));
+        Publish(&controller, "view/new", serialized);
+        recorder->WaitForEvents(expected_events);
+
+        CHECK(NodeExists(&controller, "node/engine_1"));
+        recorder.reset();
+        // Closing of the connection may race with the next request
+        absl::SleepFor(absl::Milliseconds(100));
+        CHECK(!NodeExists(&controller, "node/engine_1"))
+            << "Ephemeral znode outlives its session";
+
+        controller.ScheduleStop();
+        controller.WaitForFinish();
+    }
+    StopCoordinator(std::move(coordinator));
+    LOG(INFO) << "View change checks passed";
+
+    // Persistent znodes are replayed from the data file
+    coordinator = StartCoordinator(socket_path, data_file);
+    {
+        ViewEventRecorder recorder(host);
+        recorder.WaitForEvents(expected_events);
+        CHECK(!NodeExists(recorder.session(), "node/engine_1"));
+    }
+    StopCoordinator(std::move(coordinator));
+    LOG(INFO) << "Restarted coordinator replays the same views";
+
+    CHECK(fs_utils::RemoveDirectoryRecursively(work_dir));
+    CHECK(fs_utils::MakeDirectory(work_dir));
+    coordinator = StartCoordinator(socket_path, data_file);
+    CheckControllerReconfig(host);
+    StopCoordinator(std::move(coordinator));
+    LOG(INFO) << "Controller reconfiguration checks passed";
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "base/init.h"
+#include "base/common.h"
+#include "common/flags.h"
+#include "common/zk_local.h"
+#include "utils/fs.h"
+
+#include <signal.h>
+
+ABSL_FLAG(std::string, socket_path, "/tmp/faas_coordinator.sock",
+          "Unix socket path to listen on");
+ABSL_FLAG(std::string, data_file, "",
+          "File for persisting znodes, empty to keep them in memory only");
+
+namespace faas {
+
+static std::atomic<zk::LocalCoordinator*> coordinator_ptr{nullptr};
+static void StopCoordinatorHandler() {
+    zk::LocalCoordinator* coordinator = coordinator_ptr.exchange(nullptr);
+    if (coordinator != nullptr) {
+        coordinator->ScheduleStop();
+    }
+}
+
+void CoordinatorMain(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    base::SetInterruptHandler(StopCoordinatorHandler);
+
+    auto coordinator = std::make_unique<zk::LocalCoordinator>(
+        absl::GetFlag(FLAGS_socket_path), absl::GetFlag(FLAGS_data_file));
+
+    // Directories expected to exist by ZKSession users
+    std::string root_path = absl::GetFlag(FLAGS_zookeeper_root_path);
+    coordinator->EnsureNode(root_path);
+    for (const char* dir : { "node", "view", "freeze", "cmd", "load" }) {
+        coordinator->EnsureNode(fs_utils::JoinPath(root_path, dir));
+    }
+
+    coordinator->Start();
+    coordinator_ptr.store(coordinator.get());
+    coordinator->WaitForFinish();
+}
+
+}  // namespace faas
+
+int main(int argc, char* argv[]) {
+    faas::CoordinatorMain(argc, argv);
+    return 0;
+}
@@ -14,6 +14,9 @@ ABSL_FLAG(std::string, fprocess_output_dir, "",
           "in the given directory");
 ABSL_FLAG(std::string, fprocess_mode, "cpp",
           "Operating mode of fprocess. Valid options are cpp, go, nodejs, and python.");
+ABSL_FLAG(bool, fprocess_zygote, false,
+          "If set, C++ function processes are forked from an initialized zygote process, "
+          "instead of spawned from scratch");
 ABSL_FLAG(int, engine_tcp_port, -1, "If set, will connect to engine via localhost TCP socket");
 
 namespace faas {
@@ -37,6 +40,7 @@ void LauncherMain(int argc, char* argv[]) {
     launcher->set_fprocess_working_dir(absl::GetFlag(FLAGS_fprocess_working_dir));
     launcher->set_fprocess_output_dir(absl::GetFlag(FLAGS_fprocess_output_dir));
     launcher->set_engine_tcp_port(absl::GetFlag(FLAGS_engine_tcp_port));
+    launcher->set_fprocess_zygote(absl::GetFlag(FLAGS_fprocess_zygote));
 
     std::string fprocess_mode = absl::GetFlag(FLAGS_fprocess_mode);
     if (fprocess_mode == "cpp") {
@@ -12,6 +12,9 @@ ABSL_FLAG(int, socket_listen_backlog, 64, "Backlog for listen");
 ABSL_FLAG(bool, tcp_enable_reuseport, false, "Enable SO_REUSEPORT");
 ABSL_FLAG(bool, tcp_enable_nodelay, true, "Enable TCP_NODELAY");
 ABSL_FLAG(bool, tcp_enable_keepalive, true, "Enable TCP keep-alive");
+ABSL_FLAG(size_t, egress_hub_zero_copy_threshold, 0,
+          "Messages of EgressHub at least this large are sent with zero-copy, "
+          "0 to disable");
 
 ABSL_FLAG(std::string, zookeeper_host, "localhost:2181", "ZooKeeper host");
 ABSL_FLAG(std::string, zookeeper_root_path, "/faas", "Root path for all znodes");
\ No newline at end of file
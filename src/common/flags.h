@@ -19,6 +19,7 @@ ABSL_DECLARE_FLAG(int, socket_listen_backlog);
 ABSL_DECLARE_FLAG(bool, tcp_enable_reuseport);
 ABSL_DECLARE_FLAG(bool, tcp_enable_nodelay);
 ABSL_DECLARE_FLAG(bool, tcp_enable_keepalive);
+ABSL_DECLARE_FLAG(size_t, egress_hub_zero_copy_threshold);
 
 ABSL_DECLARE_FLAG(std::string, zookeeper_host);
 ABSL_DECLARE_FLAG(std::string, zookeeper_root_path);
\ No newline at end of file
@@ -93,7 +93,8 @@ enum class MessageType : uint16_t {
     DISPATCH_FUNC_CALL = 7,
     FUNC_CALL_COMPLETE = 8,
     FUNC_CALL_FAILED = 9,
-    SHARED_LOG_OP = 10
+    SHARED_LOG_OP = 10,
+    FUNC_WORKER_RESTART = 11
 };
 
 enum class SharedLogOpType : uint16_t {
@@ -108,6 +109,7 @@ enum class SharedLogOpType : uint16_t {
     CC_TXN_COMMIT = 0x08, // FuncWorker to Engine
     CC_TXN_WRITE = 0x09,  // FuncWorker to Engine, Engine to Storage
     OVERWRITE = 0x0a,     // FuncWorker to Engine, Engine to Storage
+    CHECK_CONFLICT = 0x0b, // FuncWorker to Engine
     READ_AT = 0x10,       // Index to Storage
     REPLICATE = 0x11,     // Engine to Storage
     INDEX_DATA = 0x12,    // Engine to Index
@@ -116,6 +118,9 @@ enum class SharedLogOpType : uint16_t {
     META_PROG = 0x15,     // Sequencer to Sequencer
     CC_READ_LOG = 0x16,   // Engine to Storage
     CC_READ_KVS = 0x17,   // Engine to Storage
+    METALOGS = 0x18,      // Sequencer to Sequencer (batched METALOG)
+    TAIL_HANDOFF = 0x19,  // Sequencer to Sequencer (planned reconfiguration)
+    METALOG_FETCH = 0x1a, // Engine to Sequencer, Storage to Sequencer
     RESPONSE = 0x20,
 };
 
@@ -128,6 +133,7 @@ enum class SharedLogResultType : uint16_t {
     LOCALID = 0x23,
     AUXDATA_OK = 0x24,
     // REPLICATE_OK = 0x25,
+    CHECK_CONFLICT_OK = 0x26,
     // Error results
     BAD_ARGS = 0x30,
     DISCARDED = 0x31, // Log to append is discarded
@@ -135,6 +141,7 @@ enum class SharedLogResultType : uint16_t {
     DATA_LOST = 0x33, // Failed to extract log data
     TRIM_FAILED = 0x34,
     COND_FAILED = 0x35,
+    UNSUPPORTED = 0x36, // Cannot be answered by this engine, clients should fall back
 };
 
 constexpr uint64_t kInvalidLogTag = std::numeric_limits<uint64_t>::max();
@@ -145,6 +152,8 @@ constexpr uint32_t kFuncWorkerUseEngineSocketFlag = (1 << 0);
 constexpr uint32_t kUseFifoForNestedCallFlag = (1 << 1);
 constexpr uint32_t kAsyncInvokeFuncFlag = (1 << 2);
 constexpr uint32_t kConditionalOpFlag = (1 << 3);
+// Set on FUNC_WORKER_RESTART when func workers keep crashing
+constexpr uint32_t kFuncWorkerCrashLoopFlag = (1 << 4);
 
 struct Message {
     struct {
@@ -182,7 +191,10 @@ struct Message {
     uint16_t log_num_tags;      // [36:38]
     uint16_t log_aux_data_size; // [38:40]
 
-    uint64_t log_tag;         // [40:48]
+    union {
+        uint64_t log_tag;         // [40:48]
+        uint64_t log_from_seqnum; // [40:48] Used in CHECK_CONFLICT
+    };
     uint64_t log_client_data; // [48:56] will be preserved for response to clients
 
     // uint64_t _8_padding_8_;
@@ -246,8 +258,39 @@ struct GatewayMessage {
 
 static_assert(sizeof(GatewayMessage) == 16, "Unexpected GatewayMessage size");
 
+// Exchanged between the launcher and a zygote func worker over its message
+// pipe. A successful fork response carries the message pipe of the forked
+// worker as SCM_RIGHTS. Only the zygote reaps forked workers, so they are
+// killed through it, which never signals a reused pid.
+enum class ZygoteRequestType : int32_t {
+    FORK = 0,
+    KILL = 1
+};
+
+struct ZygoteRequest {
+    ZygoteRequestType type;
+    int32_t fprocess_id;
+    int32_t client_id;  // Used by FORK
+    int32_t pid;        // Used by KILL
+};
+
+struct ZygoteForkResponse {
+    int32_t fprocess_id;
+    int32_t pid;  // -1 if fork failed
+};
+
+static_assert(sizeof(ZygoteRequest) == 16, "Unexpected ZygoteRequest size");
+static_assert(sizeof(ZygoteForkResponse) == 8, "Unexpected ZygoteForkResponse size");
+
 constexpr uint16_t kReadInitialFlag = (1 << 0);
 constexpr uint16_t kIndexIsTxnFlag = (1 << 1);
+constexpr uint16_t kMetaLogForwardFlag = (1 << 2);
+// Set on METALOG by sequencers accepting delta-encoded SHARD_PROG, and on
+// SHARD_PROG with a ShardProgressDeltaProto payload
+constexpr uint16_t kShardProgDeltaFlag = (1 << 3);
+// Set on METALOG_FETCH sent by storage nodes, so that the fetched
+// METALOGS go back through the sequencer-to-storage connection
+constexpr uint16_t kMetaLogFetchFromStorageFlag = (1 << 4);
 
 struct SharedLogMessage {
     uint16_t op_type; // [0:2]
@@ -269,12 +312,16 @@ struct SharedLogMessage {
     };
 
     union {
-        uint32_t metalog_position; // [16:20] (only used by META_PROG)
+        uint32_t metalog_position; // [16:20] (only used by META_PROG and METALOG_FETCH)
         uint32_t user_logspace;    // [16:20]
+        uint32_t metalog_fanout;   // [16:20] (only used by forwarded METALOG)
+        uint32_t handoff_quorum;   // [16:20] (only used by TAIL_HANDOFF)
+        uint32_t num_logspace_loads; // [16:20] (only used by SHARD_PROG)
     };
 
     union {
         uint32_t seqnum_lowhalf; // [20:24] (the high half is logspace_id)
+        uint32_t metalog_end_position; // [20:24] (only used by METALOG_FETCH)
         struct {
             uint16_t prev_view_id;
             uint16_t prev_engine_id;
@@ -296,6 +343,7 @@ struct SharedLogMessage {
         // isn't performed twice
         uint64_t cond_tag;              // [32:40]
         uint64_t user_metalog_progress; // [32:40]
+        uint64_t aux_data_version;      // [32:40] (only used by SET_AUXDATA)
     };
 
     union {
@@ -368,6 +416,12 @@ public:
                MessageType::SHARED_LOG_OP;
     }
 
+    static bool IsFuncWorkerRestart(const Message& message)
+    {
+        return static_cast<MessageType>(message.message_type) ==
+               MessageType::FUNC_WORKER_RESTART;
+    }
+
     static void SetFuncCall(Message* message, const FuncCall& func_call)
     {
         message->func_id = func_call.func_id;
@@ -496,6 +550,25 @@ public:
         return message;
     }
 
+    // Sent by launchers to replace the func worker of `client_id` that has
+    // exited. `call_id` carries the number of restarts of the function.
+    static Message NewFuncWorkerRestart(uint16_t func_id,
+                                        uint16_t client_id,
+                                        uint32_t restart_count,
+                                        bool crash_loop)
+    {
+        NEW_EMPTY_MESSAGE(message);
+        message.message_type =
+            static_cast<uint16_t>(MessageType::FUNC_WORKER_RESTART);
+        message.func_id = func_id;
+        message.client_id = client_id;
+        message.call_id = restart_count;
+        if (crash_loop) {
+            message.flags |= kFuncWorkerCrashLoopFlag;
+        }
+        return message;
+    }
+
     static Message NewInvokeFunc(const FuncCall& func_call,
                                  uint64_t parent_call_id,
                                  bool async = false)
@@ -694,6 +767,36 @@ public:
         return message;
     }
 
+    static SharedLogMessage NewMetaLogsMessage(uint32_t logspace_id)
+    {
+        NEW_EMPTY_SHAREDLOG_MESSAGE(message);
+        message.op_type = static_cast<uint16_t>(SharedLogOpType::METALOGS);
+        message.logspace_id = logspace_id;
+        return message;
+    }
+
+    static SharedLogMessage NewMetaLogFetchMessage(uint32_t logspace_id,
+                                                   uint32_t start_position,
+                                                   uint32_t end_position)
+    {
+        NEW_EMPTY_SHAREDLOG_MESSAGE(message);
+        message.op_type = static_cast<uint16_t>(SharedLogOpType::METALOG_FETCH);
+        message.logspace_id = logspace_id;
+        message.metalog_position = start_position;
+        message.metalog_end_position = end_position;
+        return message;
+    }
+
+    static SharedLogMessage NewTailHandoffMessage(uint32_t logspace_id,
+                                                  uint32_t quorum)
+    {
+        NEW_EMPTY_SHAREDLOG_MESSAGE(message);
+        message.op_type = static_cast<uint16_t>(SharedLogOpType::TAIL_HANDOFF);
+        message.logspace_id = logspace_id;
+        message.handoff_quorum = quorum;
+        return message;
+    }
+
     static SharedLogMessage NewMetaLogProgressMessage(uint32_t logspace_id,
                                                       uint32_t progress)
     {
@@ -204,6 +204,66 @@ private:
     DISALLOW_COPY_AND_ASSIGN(Counter);
 };
 
+// Gauge keeps value and peak even with stat disabled, only reports are skipped
+class Gauge {
+public:
+    using ReportCallback =
+        std::function<void(int /* duration_ms */, int64_t /* value */, int64_t /* peak */)>;
+    static ReportCallback StandardReportCallback(std::string_view gauge_name) {
+        return [name = std::string(gauge_name)] (int duration_ms, int64_t value, int64_t peak) {
+            LOG_F(INFO, "{} gauge: value={}, peak={}", name, value, peak);
+        };
+    }
+
+    template<int L>
+    static ReportCallback VerboseLogReportCallback(std::string_view gauge_name) {
+        return [name = std::string(gauge_name)] (int duration_ms, int64_t value, int64_t peak) {
+            VLOG_F(L, "{} gauge: value={}, peak={}", name, value, peak);
+        };
+    }
+
+    explicit Gauge(ReportCallback report_callback)
+        : report_callback_(report_callback),
+          value_(0), peak_(0) {}
+
+    ~Gauge() {}
+
+    int64_t value() const { return value_; }
+    int64_t peak() const { return peak_; }
+
+    void set_report_interval_in_ms(uint32_t value) {
+        report_timer_.set_report_interval_in_ms(value);
+    }
+
+    // For values sampled less often than they change, whose peak since the
+    // last sample is tracked by the caller
+    void Set(int64_t value, int64_t peak) {
+        peak_ = std::max(peak_, peak);
+        Set(value);
+    }
+
+    void Set(int64_t value) {
+        value_ = value;
+        peak_ = std::max(peak_, value);
+#ifndef __FAAS_DISABLE_STAT
+        if (report_timer_.Check()) {
+            int duration_ms;
+            report_timer_.MarkReport(&duration_ms);
+            report_callback_(duration_ms, value_, peak_);
+        }
+#endif
+    }
+
+private:
+    ReportCallback report_callback_;
+
+    ReportTimer report_timer_;
+    int64_t value_;
+    int64_t peak_;
+
+    DISALLOW_COPY_AND_ASSIGN(Gauge);
+};
+
 class CategoryCounter {
 public:
     using ReportCallback =
@@ -13,6 +13,7 @@ Subprocess::Subprocess(std::string_view cmd, size_t max_stdout_size, size_t max_
     pipe_types_.push_back(UV_READABLE_PIPE);  // stdin
     pipe_types_.push_back(UV_WRITABLE_PIPE);  // stdout
     pipe_types_.push_back(UV_WRITABLE_PIPE);  // stderr
+    ipc_pipes_.assign(kNumStdPipes, false);
     std_fds_.assign(kNumStdPipes, -1);
 }
 
@@ -37,12 +38,21 @@ void Subprocess::SetStandardFile(StandardPipe pipe, std::string_view file_path)
 int Subprocess::CreateReadablePipe() {
     DCHECK(state_ == kCreated);
     pipe_types_.push_back(UV_READABLE_PIPE);
+    ipc_pipes_.push_back(false);
     return gsl::narrow_cast<int>(pipe_types_.size()) - 1;
 }
 
 int Subprocess::CreateWritablePipe() {
     DCHECK(state_ == kCreated);
     pipe_types_.push_back(UV_WRITABLE_PIPE);
+    ipc_pipes_.push_back(false);
+    return gsl::narrow_cast<int>(pipe_types_.size()) - 1;
+}
+
+int Subprocess::CreateIpcPipe() {
+    DCHECK(state_ == kCreated);
+    pipe_types_.push_back(static_cast<uv_stdio_flags>(UV_READABLE_PIPE | UV_WRITABLE_PIPE));
+    ipc_pipes_.push_back(true);
     return gsl::narrow_cast<int>(pipe_types_.size()) - 1;
 }
 
@@ -100,7 +110,7 @@ bool Subprocess::Start(uv_loop_t* uv_loop, utils::BufferPool* read_buffer_pool,
             stdio[i].data.fd = std_fds_[i];
             pipe_closed_[i] = true;
         } else {
-            UV_DCHECK_OK(uv_pipe_init(uv_loop, uv_pipe, 0));
+            UV_DCHECK_OK(uv_pipe_init(uv_loop, uv_pipe, ipc_pipes_[i] ? 1 : 0));
             uv_pipe->data = this;
             handle_scope_.AddHandle(uv_pipe);
             stdio[i].flags = static_cast<uv_stdio_flags>(UV_CREATE_PIPE | pipe_types_[i]);
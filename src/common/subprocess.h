@@ -36,6 +36,9 @@ public:
     // subprocess.
     int CreateReadablePipe();
     int CreateWritablePipe();
+    // Bidirectional pipe, over which file descriptors can be passed (see
+    // uv_pipe_pending_count and uv_accept)
+    int CreateIpcPipe();
 
     void SetWorkingDir(std::string_view path);
     void AddEnvVariable(std::string_view name, std::string_view value);
@@ -71,6 +74,7 @@ private:
 
     std::vector<int> std_fds_;
     std::vector<uv_stdio_flags> pipe_types_;
+    std::vector<bool> ipc_pipes_;
     std::string working_dir_;
     std::vector<std::string> env_variables_;
 
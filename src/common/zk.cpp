@@ -1,5 +1,7 @@
 #include "common/zk.h"
 
+#include "common/zk_local.h"
+
 #include <sys/types.h>
 #include <sys/eventfd.h>
 #include <sys/time.h>
@@ -14,15 +16,52 @@ ABSL_FLAG(std::string, zk_logfile, "", "");
 namespace faas {
 namespace zk {
 
+class ZooKeeperBackend final : public Backend {
+public:
+    ZooKeeperBackend(ZKSession* sess, std::string_view host);
+    ~ZooKeeperBackend();
+
+    void Connect() override;
+    int GetInterest(short* events, struct timespec* timeout) override;
+    void Process(short revents) override;
+    int StartOp(Op* op) override;
+
+private:
+    std::string host_;
+    zhandle_t* handle_;
+
+    static ZKResult StringResult(const char* string);
+    static ZKResult StringsResult(const struct String_vector* strings);
+    static ZKResult DataResult(const char* data, int data_len, const struct Stat* stat);
+    static ZKResult StatResult(const struct Stat* stat);
+
+    static void WatcherCallback(zhandle_t* handle, int type, int state,
+                                const char* path, void* watcher_ctx);
+    static void VoidCompletionCallback(int rc, const void* data);
+    static void StringCompletionCallback(int rc, const char* value, const void* data);
+    static void StringsCompletionCallback(int rc, const struct String_vector* strings,
+                                          const void* data);
+    static void DataCompletionCallback(int rc, const char* value, int value_len,
+                                       const struct Stat* stat, const void* data);
+    static void StatCompletionCallback(int rc, const struct Stat* stat, const void* data);
+
+    DISALLOW_COPY_AND_ASSIGN(ZooKeeperBackend);
+};
+
 ZKSession::ZKSession(std::string_view host, std::string_view root_path)
     : state_(kCreated),
       host_(host),
       root_path_(absl::StripSuffix(root_path, "/")),
-      handle_(nullptr),
       event_loop_thread_("ZK/EL",
                          absl::bind_front(&ZKSession::EventLoopThreadMain, this)),
       stop_eventfd_(-1),
       new_op_eventfd_(-1) {
+    if (absl::StartsWith(host, LocalBackend::kHostPrefix)) {
+        backend_.reset(new LocalBackend(
+            this, absl::StripPrefix(host, LocalBackend::kHostPrefix)));
+    } else {
+        backend_.reset(new ZooKeeperBackend(this, host));
+    }
     stop_eventfd_ = eventfd(0, EFD_CLOEXEC);
     PCHECK(stop_eventfd_ >= 0) << "Failed to create eventfd";
     new_op_eventfd_ = eventfd(0, EFD_CLOEXEC);
@@ -30,13 +69,8 @@ ZKSession::ZKSession(std::string_view host, std::string_view root_path)
 }
 
 ZKSession::~ZKSession() {
-    if (handle_ != nullptr) {
-        DCHECK(state_.load() == kStopped);
-        int ret = zookeeper_close(handle_);
-        if (ret != ZOK) {
-            HLOG(FATAL) << "Failed to close zookeeper handle: " << zerror(ret);
-        }
-    }
+    DCHECK(state_.load() != kRunning);
+    backend_.reset();
     PCHECK(close(stop_eventfd_) == 0) << "Failed to close eventfd";
     PCHECK(close(new_op_eventfd_) == 0) << "Failed to close eventfd";
 }
@@ -66,17 +100,7 @@ static void ZKLogCallback(const char *message) {
 
 void ZKSession::Start() {
     DCHECK(state_.load() == kCreated);
-    handle_ = zookeeper_init2(
-        /* host= */         host_.c_str(),
-        /* watcher_fn= */   nullptr,
-        /* recv_timeout= */ absl::GetFlag(FLAGS_zk_recv_timeout_ms),
-        /* clientid= */     nullptr,
-        /* context= */      this,
-        /* flags= */        0,
-        /* log_callback= */ &ZKLogCallback);
-    if (handle_ == nullptr) {
-        PLOG(FATAL) << "zookeeper_init failed";
-    }
+    backend_->Connect();
     event_loop_thread_.Start();
     state_.store(kRunning);
 }
@@ -197,71 +221,7 @@ void ZKSession::ProcessPendingOps() {
 }
 
 void ZKSession::DoOp(Op* op) {
-    int ret = ZOK;
-    switch (op->type) {
-    case kCreate:
-        ret = zoo_acreate(
-            handle_, /* path= */ op->path.c_str(),
-            /* value= */ op->value.data(),
-            /* valuelen= */ gsl::narrow_cast<int>(op->value.length()),
-            /* acl= */ &ZOO_OPEN_ACL_UNSAFE, /* mode= */ op->create_mode,
-            &ZKSession::StringCompletionCallback, /* data= */ op);
-        break;
-    case kDelete:
-        ret = zoo_adelete(
-            handle_, /* path= */ op->path.c_str(), /* version= */ op->data_version,
-            &ZKSession::VoidCompletionCallback, /* data= */ op);
-        break;
-    case kExists:
-        if (op->watch != nullptr) {
-            ret = zoo_awexists(
-                handle_, /* path= */ op->path.c_str(),
-                /* watcher= */ &ZKSession::WatcherCallback,
-                /* watcherCtx= */ op->watch,
-                &ZKSession::StatCompletionCallback, /* data= */ op);
-        } else {
-            ret = zoo_aexists(
-                handle_, /* path= */ op->path.c_str(), /* watch= */ 0,
-                &ZKSession::StatCompletionCallback, /* data= */ op);
-        }
-        break;
-    case kGet:
-        if (op->watch != nullptr) {
-            ret = zoo_awget(
-                handle_, /* path= */ op->path.c_str(),
-                /* watcher= */ &ZKSession::WatcherCallback,
-                /* watcherCtx= */ op->watch,
-                &ZKSession::DataCompletionCallback, /* data= */ op);
-        } else {
-            ret = zoo_aget(
-                handle_, /* path= */ op->path.c_str(), /* watch= */ 0,
-                &ZKSession::DataCompletionCallback, /* data= */ op);
-        }
-        break;
-    case kSet:
-        ret = zoo_aset(
-            handle_, /* path= */ op->path.c_str(),
-            /* buffer= */ op->value.data(),
-            /* buflen= */ gsl::narrow_cast<int>(op->value.length()),
-            /* version= */ op->data_version,
-            &ZKSession::StatCompletionCallback, /* data= */ op);
-        break;
-    case kGetChildren:
-        if (op->watch != nullptr) {
-            ret = zoo_awget_children(
-                handle_, /* path= */ op->path.c_str(),
-                /* watcher= */ &ZKSession::WatcherCallback,
-                /* watcherCtx= */ op->watch,
-                &ZKSession::StringsCompletionCallback, /* data= */ op);
-        } else {
-            ret = zoo_aget_children(
-                handle_, /* path= */ op->path.c_str(), /* watch= */ 0,
-                &ZKSession::StringsCompletionCallback, /* data= */ op);
-        }
-        break;
-    default:
-        UNREACHABLE();
-    }
+    int ret = backend_->StartOp(op);
     if (ret != ZOK) {
         if (ret == ZBADARGUMENTS) {
             OpCompleted(op, ret, EmptyResult());
@@ -329,30 +289,13 @@ void ZKSession::EventLoopThreadMain() {
         pollfds.push_back({ .fd = stop_eventfd_, .events = POLLIN, .revents = 0 });
         pollfds.push_back({ .fd = new_op_eventfd_, .events = POLLIN, .revents = 0 });
 
-        int zk_fd;
-        int zk_interest;
-        struct timeval zk_timeout;
-        int zk_status = zookeeper_interest(handle_, &zk_fd, &zk_interest, &zk_timeout);
-        if (zk_status == ZSYSTEMERROR) {
-            HPLOG(FATAL) << "System error happens for zookeeper";
-        } else if (zk_status != ZOK) {
-            HLOG(FATAL) << "zookeeper_interest failed: " << zerror(zk_status);
-        }
-        DCHECK_EQ(zk_status, ZOK);
+        short backend_events = 0;
+        struct timespec timeout;
+        int backend_fd = backend_->GetInterest(&backend_events, &timeout);
+        pollfds.push_back({ .fd = backend_fd, .events = backend_events, .revents = 0 });
 
-        short zk_fd_events = 0;
-        if (zk_interest & ZOOKEEPER_READ) {
-            zk_fd_events |= POLLIN;
-        }
-        if (zk_interest & ZOOKEEPER_WRITE) {
-            zk_fd_events |= POLLOUT;
-        }
-        pollfds.push_back({ .fd = zk_fd, .events = zk_fd_events, .revents = 0 });
-
-        struct timespec spec;
-        TIMEVAL_TO_TIMESPEC(&zk_timeout, &spec);
         int ret = ppoll(pollfds.data(), pollfds.size(),
-                        /* tmo_p= */ &spec, /* sigmask= */ nullptr);
+                        /* tmo_p= */ &timeout, /* sigmask= */ nullptr);
         PCHECK(ret >= 0) << "ppoll failed";
 
         for (const auto& item : pollfds) {
@@ -361,30 +304,16 @@ void ZKSession::EventLoopThreadMain() {
             }
             CHECK_EQ(item.revents & POLLNVAL, 0)
                 << fmt::format("Invalid fd {}", item.fd);
+            if (item.fd == backend_fd) {
+                // Backends handle errors on their own fds
+                backend_->Process(item.revents);
+                continue;
+            }
             if ((item.revents & POLLERR) != 0 || (item.revents & POLLHUP) != 0) {
-                if (item.fd == zk_fd) {
-                    HLOG(ERROR) << "Error happens on Zookeeper fd";
-                } else {
-                    HLOG_F(ERROR, "Error happens on fd {}", item.fd);
-                }
+                HLOG_F(ERROR, "Error happens on fd {}", item.fd);
                 continue;
             }
-            if (item.fd == zk_fd) {
-                int zk_events = 0;
-                if (item.revents & POLLIN) {
-                    zk_events |= ZOOKEEPER_READ;
-                }
-                if (item.revents & POLLOUT) {
-                    zk_events |= ZOOKEEPER_WRITE;
-                }
-                zk_status = zookeeper_process(handle_, zk_events);
-                if (zk_status == ZSYSTEMERROR) {
-                    HPLOG(FATAL) << "System error happens for zookeeper";
-                } else if (zk_status != ZOK && zk_status != ZNOTHING) {
-                    HLOG(FATAL) << "zookeeper_process failed: " << zerror(zk_status);
-                }
-                DCHECK(zk_status == ZOK || zk_status == ZNOTHING);
-            } else if (item.fd == new_op_eventfd_) {
+            if (item.fd == new_op_eventfd_) {
                 uint64_t value;
                 PCHECK(eventfd_read(new_op_eventfd_, &value) == 0)
                     << "eventfd_read failed";
@@ -414,13 +343,154 @@ ZKResult ZKSession::EmptyResult() {
     };
 }
 
-ZKResult ZKSession::StringResult(const char* string) {
+ZooKeeperBackend::ZooKeeperBackend(ZKSession* sess, std::string_view host)
+    : Backend(sess),
+      host_(host),
+      handle_(nullptr) {}
+
+ZooKeeperBackend::~ZooKeeperBackend() {
+    if (handle_ != nullptr) {
+        int ret = zookeeper_close(handle_);
+        if (ret != ZOK) {
+            HLOG(FATAL) << "Failed to close zookeeper handle: " << zerror(ret);
+        }
+    }
+}
+
+void ZooKeeperBackend::Connect() {
+    handle_ = zookeeper_init2(
+        /* host= */         host_.c_str(),
+        /* watcher_fn= */   nullptr,
+        /* recv_timeout= */ absl::GetFlag(FLAGS_zk_recv_timeout_ms),
+        /* clientid= */     nullptr,
+        /* context= */      this,
+        /* flags= */        0,
+        /* log_callback= */ &ZKLogCallback);
+    if (handle_ == nullptr) {
+        PLOG(FATAL) << "zookeeper_init failed";
+    }
+}
+
+int ZooKeeperBackend::GetInterest(short* events, struct timespec* timeout) {
+    int zk_fd;
+    int zk_interest;
+    struct timeval zk_timeout;
+    int zk_status = zookeeper_interest(handle_, &zk_fd, &zk_interest, &zk_timeout);
+    if (zk_status == ZSYSTEMERROR) {
+        HPLOG(FATAL) << "System error happens for zookeeper";
+    } else if (zk_status != ZOK) {
+        HLOG(FATAL) << "zookeeper_interest failed: " << zerror(zk_status);
+    }
+    DCHECK_EQ(zk_status, ZOK);
+
+    *events = 0;
+    if (zk_interest & ZOOKEEPER_READ) {
+        *events |= POLLIN;
+    }
+    if (zk_interest & ZOOKEEPER_WRITE) {
+        *events |= POLLOUT;
+    }
+    TIMEVAL_TO_TIMESPEC(&zk_timeout, timeout);
+    return zk_fd;
+}
+
+void ZooKeeperBackend::Process(short revents) {
+    if ((revents & POLLERR) != 0 || (revents & POLLHUP) != 0) {
+        HLOG(ERROR) << "Error happens on Zookeeper fd";
+        return;
+    }
+    int zk_events = 0;
+    if (revents & POLLIN) {
+        zk_events |= ZOOKEEPER_READ;
+    }
+    if (revents & POLLOUT) {
+        zk_events |= ZOOKEEPER_WRITE;
+    }
+    int zk_status = zookeeper_process(handle_, zk_events);
+    if (zk_status == ZSYSTEMERROR) {
+        HPLOG(FATAL) << "System error happens for zookeeper";
+    } else if (zk_status != ZOK && zk_status != ZNOTHING) {
+        HLOG(FATAL) << "zookeeper_process failed: " << zerror(zk_status);
+    }
+    DCHECK(zk_status == ZOK || zk_status == ZNOTHING);
+}
+
+int ZooKeeperBackend::StartOp(Op* op) {
+    int ret = ZOK;
+    switch (op->type) {
+    case ZKSession::kCreate:
+        ret = zoo_acreate(
+            handle_, /* path= */ op->path.c_str(),
+            /* value= */ op->value.data(),
+            /* valuelen= */ gsl::narrow_cast<int>(op->value.length()),
+            /* acl= */ &ZOO_OPEN_ACL_UNSAFE, /* mode= */ op->create_mode,
+            &ZooKeeperBackend::StringCompletionCallback, /* data= */ op);
+        break;
+    case ZKSession::kDelete:
+        ret = zoo_adelete(
+            handle_, /* path= */ op->path.c_str(), /* version= */ op->data_version,
+            &ZooKeeperBackend::VoidCompletionCallback, /* data= */ op);
+        break;
+    case ZKSession::kExists:
+        if (op->watch != nullptr) {
+            ret = zoo_awexists(
+                handle_, /* path= */ op->path.c_str(),
+                /* watcher= */ &ZooKeeperBackend::WatcherCallback,
+                /* watcherCtx= */ op->watch,
+                &ZooKeeperBackend::StatCompletionCallback, /* data= */ op);
+        } else {
+            ret = zoo_aexists(
+                handle_, /* path= */ op->path.c_str(), /* watch= */ 0,
+                &ZooKeeperBackend::StatCompletionCallback, /* data= */ op);
+        }
+        break;
+    case ZKSession::kGet:
+        if (op->watch != nullptr) {
+            ret = zoo_awget(
+                handle_, /* path= */ op->path.c_str(),
+                /* watcher= */ &ZooKeeperBackend::WatcherCallback,
+                /* watcherCtx= */ op->watch,
+                &ZooKeeperBackend::DataCompletionCallback, /* data= */ op);
+        } else {
+            ret = zoo_aget(
+                handle_, /* path= */ op->path.c_str(), /* watch= */ 0,
+                &ZooKeeperBackend::DataCompletionCallback, /* data= */ op);
+        }
+        break;
+    case ZKSession::kSet:
+        ret = zoo_aset(
+            handle_, /* path= */ op->path.c_str(),
+            /* buffer= */ op->value.data(),
+            /* buflen= */ gsl::narrow_cast<int>(op->value.length()),
+            /* version= */ op->data_version,
+            &ZooKeeperBackend::StatCompletionCallback, /* data= */ op);
+        break;
+    case ZKSession::kGetChildren:
+        if (op->watch != nullptr) {
+            ret = zoo_awget_children(
+                handle_, /* path= */ op->path.c_str(),
+                /* watcher= */ &ZooKeeperBackend::WatcherCallback,
+                /* watcherCtx= */ op->watch,
+                &ZooKeeperBackend::StringsCompletionCallback, /* data= */ op);
+        } else {
+            ret = zoo_aget_children(
+                handle_, /* path= */ op->path.c_str(), /* watch= */ 0,
+                &ZooKeeperBackend::StringsCompletionCallback, /* data= */ op);
+        }
+        break;
+    default:
+        UNREACHABLE();
+    }
+    return ret;
+}
+
+ZKResult ZooKeeperBackend::StringResult(const char* string) {
     ZKResult result = EmptyResult();
     result.path = string;
     return result;
 }
 
-ZKResult ZKSession::StringsResult(const struct String_vector* strings) {
+ZKResult ZooKeeperBackend::StringsResult(const struct String_vector* strings) {
     ZKResult result = EmptyResult();
     size_t count = static_cast<size_t>(strings->count);
     result.paths.resize(count);
@@ -430,7 +500,8 @@ ZKResult ZKSession::StringsResult(const struct String_vector* strings) {
     return result;
 }
 
-ZKResult ZKSession::DataResult(const char* data, int data_len, const struct Stat* stat) {
+ZKResult ZooKeeperBackend::DataResult(const char* data, int data_len,
+                                      const struct Stat* stat) {
     ZKResult result = EmptyResult();
     if (data != nullptr) {
         DCHECK_GE(data_len, 0);
@@ -440,44 +511,48 @@ ZKResult ZKSession::DataResult(const char* data, int data_len, const struct Stat
     return result;
 }
 
-ZKResult ZKSession::StatResult(const struct Stat* stat) {
+ZKResult ZooKeeperBackend::StatResult(const struct Stat* stat) {
     ZKResult result = EmptyResult();
     result.stat = stat;
     return result;
 }
 
-void ZKSession::WatcherCallback(zhandle_t* handle, int type, int state,
-                                const char* path, void* watcher_ctx) {
-    ZKSession* sess = reinterpret_cast<ZKSession*>(const_cast<void*>(zoo_get_context(handle)));
+void ZooKeeperBackend::WatcherCallback(zhandle_t* handle, int type, int state,
+                                       const char* path, void* watcher_ctx) {
+    ZooKeeperBackend* self = reinterpret_cast<ZooKeeperBackend*>(
+        const_cast<void*>(zoo_get_context(handle)));
     Watch* watch = reinterpret_cast<Watch*>(DCHECK_NOTNULL(watcher_ctx));
-    DCHECK_EQ(sess, watch->sess);
-    sess->OnWatchTriggered(watch, type, state, path);
+    DCHECK_EQ(self->sess_, watch->sess);
+    self->OnWatchTriggered(watch, type, state, path);
 }
 
-void ZKSession::VoidCompletionCallback(int rc, const void* data) {
+void ZooKeeperBackend::VoidCompletionCallback(int rc, const void* data) {
     Op* op = reinterpret_cast<Op*>(const_cast<void*>(DCHECK_NOTNULL(data)));
     op->sess->OpCompleted(op, rc, EmptyResult());
 }
 
-void ZKSession::StringCompletionCallback(int rc, const char* value, const void* data) {
+void ZooKeeperBackend::StringCompletionCallback(int rc, const char* value,
+                                                const void* data) {
     Op* op = reinterpret_cast<Op*>(const_cast<void*>(DCHECK_NOTNULL(data)));
     op->sess->OpCompleted(op, rc, (rc == ZOK) ? StringResult(value) : EmptyResult());
 }
 
-void ZKSession::StringsCompletionCallback(int rc, const struct String_vector* strings,
-                                          const void* data) {
+void ZooKeeperBackend::StringsCompletionCallback(int rc,
+                                                 const struct String_vector* strings,
+                                                 const void* data) {
     Op* op = reinterpret_cast<Op*>(const_cast<void*>(DCHECK_NOTNULL(data)));
     op->sess->OpCompleted(op, rc, (rc == ZOK) ? StringsResult(strings) : EmptyResult());
 }
 
-void ZKSession::DataCompletionCallback(int rc, const char* value, int value_len,
-                                       const struct Stat* stat, const void* data) {
+void ZooKeeperBackend::DataCompletionCallback(int rc, const char* value, int value_len,
+                                              const struct Stat* stat, const void* data) {
     Op* op = reinterpret_cast<Op*>(const_cast<void*>(DCHECK_NOTNULL(data)));
     op->sess->OpCompleted(op, rc, (rc == ZOK) ? DataResult(value, value_len, stat)
                                               : EmptyResult());
 }
 
-void ZKSession::StatCompletionCallback(int rc, const struct Stat* stat, const void* data) {
+void ZooKeeperBackend::StatCompletionCallback(int rc, const struct Stat* stat,
+                                              const void* data) {
     Op* op = reinterpret_cast<Op*>(const_cast<void*>(DCHECK_NOTNULL(data)));
     op->sess->OpCompleted(op, rc, (rc == ZOK) ? StatResult(stat) : EmptyResult());
 }
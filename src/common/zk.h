@@ -62,9 +62,13 @@ enum class ZKCreateMode : int {
     kContainer            = 4
 };
 
+class Backend;
+
 class ZKSession {
 public:
-    // If `path` in ops does not start with '/', `root_path` will be prepended
+    // If `path` in ops does not start with '/', `root_path` will be prepended.
+    // `host` in the form of "local:<socket_path>" connects to a LocalCoordinator
+    // (see common/zk_local.h) instead of a ZooKeeper ensemble.
     explicit ZKSession(std::string_view host, std::string_view root_path = "/");
     ~ZKSession();
 
@@ -101,11 +105,16 @@ public:
     }
 
 private:
+    friend class Backend;
+    friend class ZooKeeperBackend;
+    friend class LocalBackend;
+    friend class LocalCoordinator;
+
     enum State { kCreated, kRunning, kStopped };
     std::atomic<State> state_;
     std::string host_;
     std::string root_path_;
-    zhandle_t* handle_;
+    std::unique_ptr<Backend> backend_;
 
     base::Thread event_loop_thread_;
     int stop_eventfd_;
@@ -153,23 +162,44 @@ private:
     void EventLoopThreadMain();
 
     static ZKResult EmptyResult();
-    static ZKResult StringResult(const char* string);
-    static ZKResult StringsResult(const struct String_vector* strings);
-    static ZKResult DataResult(const char* data, int data_len, const struct Stat* stat);
-    static ZKResult StatResult(const struct Stat* stat);
-
-    static void WatcherCallback(zhandle_t* handle, int type, int state,
-                                const char* path, void* watcher_ctx);
-    static void VoidCompletionCallback(int rc, const void* data);
-    static void StringCompletionCallback(int rc, const char* value, const void* data);
-    static void StringsCompletionCallback(int rc, const struct String_vector* strings,
-                                          const void* data);
-    static void DataCompletionCallback(int rc, const char* value, int value_len,
-                                       const struct Stat* stat, const void* data);
-    static void StatCompletionCallback(int rc, const struct Stat* stat, const void* data);
 
     DISALLOW_COPY_AND_ASSIGN(ZKSession);
 };
 
+// Coordination service behind ZKSession. A backend is only accessed within
+// the event loop thread of its session. It reports results of started ops
+// via OpCompleted, and triggered watches via OnWatchTriggered, using
+// ZooKeeper's status codes and event types.
+class Backend {
+public:
+    explicit Backend(ZKSession* sess) : sess_(sess) {}
+    virtual ~Backend() {}
+
+    virtual void Connect() = 0;
+    // Returns the fd to poll within the event loop
+    virtual int GetInterest(short* events, struct timespec* timeout) = 0;
+    virtual void Process(short revents) = 0;
+    // Returns ZOK if `op` is started
+    virtual int StartOp(ZKSession::Op* op) = 0;
+
+protected:
+    ZKSession* sess_;
+
+    using Op = ZKSession::Op;
+    using Watch = ZKSession::Watch;
+    using OpType = ZKSession::OpType;
+
+    void OpCompleted(Op* op, int rc, const ZKResult& result) {
+        sess_->OpCompleted(op, rc, result);
+    }
+    void OnWatchTriggered(Watch* watch, int type, int state, std::string_view path) {
+        sess_->OnWatchTriggered(watch, type, state, path);
+    }
+    static ZKResult EmptyResult() { return ZKSession::EmptyResult(); }
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(Backend);
+};
+
 }  // namespace zk
 }  // namespace faas
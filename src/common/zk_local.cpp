@@ -0,0 +1,783 @@
+#include "common/zk_local.h"
+
+#include "utils/fs.h"
+#include "utils/socket.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+namespace faas {
+namespace zk {
+
+namespace {
+static constexpr size_t kReadChunkSize = 65536;
+
+// Take the next complete frame out of `buffer`
+static bool NextMessage(std::string* buffer, size_t* offset, LocalMessage* message,
+                        std::string_view* path, std::span<const char>* value) {
+    if (buffer->size() - *offset < sizeof(LocalMessage)) {
+        return false;
+    }
+    memcpy(message, buffer->data() + *offset, sizeof(LocalMessage));
+    if (buffer->size() - *offset < sizeof(LocalMessage) + message->payload_size) {
+        return false;
+    }
+    CHECK_LE(message->path_size, message->payload_size);
+    const char* payload = buffer->data() + *offset + sizeof(LocalMessage);
+    *path = std::string_view(payload, message->path_size);
+    *value = std::span<const char>(payload + message->path_size,
+                                   message->payload_size - message->path_size);
+    *offset += sizeof(LocalMessage) + message->payload_size;
+    return true;
+}
+
+static void AppendMessage(std::string* buffer, const LocalMessage& message,
+                          std::string_view path, std::span<const char> value) {
+    LocalMessage header = message;
+    header.path_size = gsl::narrow_cast<uint32_t>(path.size());
+    header.payload_size = gsl::narrow_cast<uint32_t>(path.size() + value.size());
+    buffer->append(reinterpret_cast<const char*>(&header), sizeof(LocalMessage));
+    buffer->append(path.data(), path.size());
+    buffer->append(value.data(), value.size());
+}
+
+// Returns false if the peer closed the connection
+static bool ReadAvailable(int sockfd, std::string* buffer) {
+    char chunk[kReadChunkSize];
+    while (true) {
+        ssize_t nread = recv(sockfd, chunk, kReadChunkSize, MSG_DONTWAIT);
+        if (nread == 0) {
+            return false;
+        } else if (nread < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            PLOG(ERROR) << "Failed to read from socket";
+            return false;
+        }
+        buffer->append(chunk, static_cast<size_t>(nread));
+    }
+}
+
+// Returns false on errors
+static bool WriteAvailable(int sockfd, std::string* buffer) {
+    size_t offset = 0;
+    while (offset < buffer->size()) {
+        ssize_t nwrite = send(sockfd, buffer->data() + offset, buffer->size() - offset,
+                              MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (nwrite < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            PLOG(ERROR) << "Failed to write to socket";
+            return false;
+        }
+        offset += static_cast<size_t>(nwrite);
+    }
+    buffer->erase(0, offset);
+    return true;
+}
+
+static bool IsValidPath(std::string_view path) {
+    if (path.empty() || path[0] != '/') {
+        return false;
+    }
+    if (path == "/") {
+        return true;
+    }
+    return path.back() != '/' && path.find("//") == std::string_view::npos;
+}
+
+static std::string ParentPath(std::string_view path) {
+    size_t pos = path.rfind('/');
+    return pos == 0 ? std::string("/") : std::string(path.substr(0, pos));
+}
+
+static std::string ChildPrefix(std::string_view path) {
+    return path == "/" ? std::string("/") : fmt::format("{}/", path);
+}
+}  // namespace
+
+#define log_header_ "LocalBackend: "
+
+LocalBackend::LocalBackend(ZKSession* sess, std::string_view socket_path)
+    : Backend(sess),
+      socket_path_(socket_path),
+      sockfd_(-1),
+      next_xid_(1),
+      next_watch_id_(1) {}
+
+LocalBackend::~LocalBackend() {
+    if (sockfd_ != -1) {
+        PCHECK(close(sockfd_) == 0) << "Failed to close socket";
+    }
+}
+
+void LocalBackend::Connect() {
+    sockfd_ = utils::UnixSocketConnect(socket_path_);
+    if (sockfd_ < 0) {
+        HLOG_F(FATAL, "Failed to connect to local coordinator at {}", socket_path_);
+    }
+    HLOG_F(INFO, "Connected to local coordinator at {}", socket_path_);
+}
+
+int LocalBackend::GetInterest(short* events, struct timespec* timeout) {
+    *events = POLLIN;
+    if (!write_buffer_.empty()) {
+        *events |= POLLOUT;
+    }
+    // No session timeouts to drive
+    timeout->tv_sec = 1;
+    timeout->tv_nsec = 0;
+    return sockfd_;
+}
+
+void LocalBackend::Process(short revents) {
+    if (revents & POLLOUT) {
+        FlushWriteBuffer();
+    }
+    if ((revents & (POLLIN | POLLERR | POLLHUP)) == 0) {
+        return;
+    }
+    if (!ReadAvailable(sockfd_, &read_buffer_)) {
+        HLOG(FATAL) << "Connection to local coordinator closed";
+    }
+    size_t offset = 0;
+    LocalMessage message;
+    std::string_view path;
+    std::span<const char> value;
+    while (NextMessage(&read_buffer_, &offset, &message, &path, &value)) {
+        OnRecvMessage(message, path, value);
+    }
+    read_buffer_.erase(0, offset);
+}
+
+int LocalBackend::StartOp(Op* op) {
+    LocalMessage request;
+    memset(&request, 0, sizeof(LocalMessage));
+    request.xid = next_xid_++;
+    request.type = static_cast<uint16_t>(op->type);
+    request.create_mode = gsl::narrow_cast<int16_t>(op->create_mode);
+    request.version = op->data_version;
+    if (op->watch != nullptr) {
+        request.watch_id = next_watch_id_++;
+        watches_[request.watch_id] = op->watch;
+    }
+    inflight_ops_[request.xid] = op;
+    AppendMessage(&write_buffer_, request, op->path,
+                  std::span<const char>(op->value.data(), op->value.length()));
+    FlushWriteBuffer();
+    return ZOK;
+}
+
+void LocalBackend::FlushWriteBuffer() {
+    if (!WriteAvailable(sockfd_, &write_buffer_)) {
+        HLOG(FATAL) << "Failed to send to local coordinator";
+    }
+}
+
+void LocalBackend::OnRecvMessage(const LocalMessage& message, std::string_view path,
+                                 std::span<const char> value) {
+    if (message.type == kLocalWatchEvent) {
+        if (!watches_.contains(message.watch_id)) {
+            HLOG_F(WARNING, "Unknown watch {} triggered", message.watch_id);
+            return;
+        }
+        Watch* watch = watches_[message.watch_id];
+        watches_.erase(message.watch_id);
+        OnWatchTriggered(watch, message.status, ZOO_CONNECTED_STATE, path);
+        return;
+    }
+    if (!inflight_ops_.contains(message.xid)) {
+        HLOG_F(FATAL, "Unknown xid {}", message.xid);
+    }
+    Op* op = inflight_ops_[message.xid];
+    inflight_ops_.erase(message.xid);
+    int rc = message.status;
+    if (message.watch_id != 0) {
+        // As in ZooKeeper, a failed Get or GetChildren leaves no watch,
+        // while Exists sets a watch on nonexistent nodes
+        bool watch_set = (rc == ZOK)
+                      || (op->type == ZKSession::kExists && rc == ZNONODE);
+        if (!watch_set) {
+            watches_.erase(message.watch_id);
+        }
+    }
+    ZKResult result = EmptyResult();
+    if (rc == ZOK) {
+        memset(&stat_, 0, sizeof(stat_));
+        stat_.version = message.version;
+        stat_.dataLength = gsl::narrow_cast<int32_t>(value.size());
+        switch (op->type) {
+        case ZKSession::kCreate:
+            result.path = path;
+            break;
+        case ZKSession::kExists:
+        case ZKSession::kSet:
+            result.stat = &stat_;
+            break;
+        case ZKSession::kGet:
+            result.data = value;
+            result.stat = &stat_;
+            break;
+        case ZKSession::kGetChildren:
+            if (!value.empty()) {
+                std::string_view names(value.data(), value.size());
+                result.paths = absl::StrSplit(names, '\0');
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    OpCompleted(op, rc, result);
+}
+
+#undef log_header_
+#define log_header_ "LocalCoordinator: "
+
+LocalCoordinator::LocalCoordinator(std::string_view socket_path,
+                                   std::string_view data_file)
+    : state_(kCreated),
+      socket_path_(socket_path),
+      data_file_(data_file),
+      data_fd_(-1),
+      event_loop_thread_("Coord/EL",
+                         absl::bind_front(&LocalCoordinator::EventLoopThreadMain, this)),
+      listen_fd_(-1),
+      stop_eventfd_(-1),
+      next_conn_id_(1) {
+    nodes_["/"] = Node {
+        .data = "", .version = 0, .cversion = 0, .ephemeral_owner = 0
+    };
+    stop_eventfd_ = eventfd(0, EFD_CLOEXEC);
+    PCHECK(stop_eventfd_ >= 0) << "Failed to create eventfd";
+    LoadDataFile();
+}
+
+LocalCoordinator::~LocalCoordinator() {
+    DCHECK(state_.load() != kRunning);
+    for (const auto& [id, conn] : conns_) {
+        close(conn->sockfd);
+    }
+    if (listen_fd_ != -1) {
+        PCHECK(close(listen_fd_) == 0) << "Failed to close socket";
+        fs_utils::Remove(socket_path_);
+    }
+    PCHECK(close(stop_eventfd_) == 0) << "Failed to close eventfd";
+    if (data_fd_ != -1) {
+        PCHECK(close(data_fd_) == 0) << "Failed to close " << data_file_;
+    }
+}
+
+void LocalCoordinator::EnsureNode(std::string_view path) {
+    DCHECK(state_.load() == kCreated);
+    CHECK(IsValidPath(path)) << "Invalid path: " << path;
+    if (nodes_.contains(std::string(path))) {
+        return;
+    }
+    EnsureNode(ParentPath(path));
+    nodes_[ParentPath(path)].cversion++;
+    nodes_[std::string(path)] = Node {
+        .data = "", .version = 0, .cversion = 0, .ephemeral_owner = 0
+    };
+    LogNodeUpdate(ParentPath(path));
+    LogNodeUpdate(std::string(path));
+    SyncDataFile();
+}
+
+void LocalCoordinator::Start() {
+    DCHECK(state_.load() == kCreated);
+    if (fs_utils::Exists(socket_path_)) {
+        // Left by a previous run
+        fs_utils::Remove(socket_path_);
+    }
+    listen_fd_ = utils::UnixSocketBindAndListen(socket_path_, /* backlog= */ 64);
+    if (listen_fd_ < 0) {
+        HLOG_F(FATAL, "Failed to listen on {}", socket_path_);
+    }
+    HLOG_F(INFO, "Listen on {}, {} znodes loaded", socket_path_, nodes_.size());
+    event_loop_thread_.Start();
+    state_.store(kRunning);
+}
+
+void LocalCoordinator::ScheduleStop() {
+    HLOG(INFO) << "Scheduled to stop";
+    PCHECK(eventfd_write(stop_eventfd_, 1) == 0) << "eventfd_write failed";
+}
+
+void LocalCoordinator::WaitForFinish() {
+    DCHECK(state_.load() != kCreated);
+    event_loop_thread_.Join();
+    DCHECK(state_.load() == kStopped);
+    HLOG(INFO) << "Stopped";
+}
+
+void LocalCoordinator::EventLoopThreadMain() {
+    std::vector<struct pollfd> pollfds;
+    std::vector<uint64_t> conn_ids;
+    bool stopped = false;
+    while (!stopped) {
+        pollfds.clear();
+        conn_ids.clear();
+        pollfds.push_back({ .fd = stop_eventfd_, .events = POLLIN, .revents = 0 });
+        pollfds.push_back({ .fd = listen_fd_, .events = POLLIN, .revents = 0 });
+        for (const auto& [id, conn] : conns_) {
+            short events = POLLIN;
+            if (!conn->write_buffer.empty()) {
+                events |= POLLOUT;
+            }
+            pollfds.push_back({ .fd = conn->sockfd, .events = events, .revents = 0 });
+            conn_ids.push_back(id);
+        }
+        int ret = poll(pollfds.data(), pollfds.size(), /* timeout= */ -1);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        PCHECK(ret >= 0) << "poll failed";
+        if (pollfds[0].revents != 0) {
+            uint64_t value;
+            PCHECK(eventfd_read(stop_eventfd_, &value) == 0) << "eventfd_read failed";
+            stopped = true;
+            break;
+        }
+        if (pollfds[1].revents != 0) {
+            OnNewConnection();
+        }
+        for (size_t i = 2; i < pollfds.size(); i++) {
+            short revents = pollfds[i].revents;
+            if (revents == 0 || !conns_.contains(conn_ids[i - 2])) {
+                continue;
+            }
+            Connection* conn = conns_[conn_ids[i - 2]].get();
+            if (revents & POLLOUT) {
+                FlushConnection(conn);
+            }
+            if (!conn->closed && (revents & (POLLIN | POLLERR | POLLHUP)) != 0) {
+                OnConnectionReadable(conn);
+            }
+        }
+        // Closing connections removes ephemeral znodes, which may trigger
+        // watches of other connections
+        std::vector<Connection*> closed_conns;
+        for (const auto& [id, conn] : conns_) {
+            if (conn->closed) {
+                closed_conns.push_back(conn.get());
+            }
+        }
+        for (Connection* conn : closed_conns) {
+            CloseConnection(conn);
+        }
+    }
+    state_.store(kStopped);
+}
+
+void LocalCoordinator::OnNewConnection() {
+    int sockfd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (sockfd < 0) {
+        PLOG(ERROR) << "Failed to accept";
+        return;
+    }
+    uint64_t id = next_conn_id_++;
+    Connection* conn = new Connection;
+    conn->id = id;
+    conn->sockfd = sockfd;
+    conn->closed = false;
+    conns_[id].reset(conn);
+    HVLOG_F(1, "New connection {}", id);
+}
+
+void LocalCoordinator::OnConnectionReadable(Connection* conn) {
+    if (!ReadAvailable(conn->sockfd, &conn->read_buffer)) {
+        conn->closed = true;
+        return;
+    }
+    size_t offset = 0;
+    LocalMessage message;
+    std::string_view path;
+    std::span<const char> value;
+    while (NextMessage(&conn->read_buffer, &offset, &message, &path, &value)) {
+        HandleRequest(conn, message, path, value);
+    }
+    conn->read_buffer.erase(0, offset);
+}
+
+void LocalCoordinator::FlushConnection(Connection* conn) {
+    if (!WriteAvailable(conn->sockfd, &conn->write_buffer)) {
+        conn->closed = true;
+    }
+}
+
+void LocalCoordinator::CloseConnection(Connection* conn) {
+    uint64_t id = conn->id;
+    HVLOG_F(1, "Connection {} closed", id);
+    PCHECK(close(conn->sockfd) == 0) << "Failed to close socket";
+    conns_.erase(id);
+    std::vector<std::string> ephemeral_paths;
+    for (const auto& [path, node] : nodes_) {
+        if (node.ephemeral_owner == id) {
+            ephemeral_paths.push_back(path);
+        }
+    }
+    for (const std::string& path : ephemeral_paths) {
+        HVLOG_F(1, "Remove ephemeral znode {}", path);
+        DoDelete(path, -1);
+    }
+}
+
+void LocalCoordinator::HandleRequest(Connection* conn, const LocalMessage& request,
+                                     std::string_view path, std::span<const char> value) {
+    LocalMessage response;
+    memset(&response, 0, sizeof(LocalMessage));
+    response.xid = request.xid;
+    response.watch_id = request.watch_id;
+    response.type = request.type;
+    std::string node_path(path);
+    std::string response_path;
+    std::string response_value;
+    if (!IsValidPath(path)) {
+        response.status = ZBADARGUMENTS;
+        SendMessage(conn, response, response_path, STRING_AS_SPAN(response_value));
+        return;
+    }
+    bool set_data_watch = false;
+    bool set_child_watch = false;
+    switch (request.type) {
+    case ZKSession::kCreate:
+        response.status = DoCreate(conn, path, value, request.create_mode, &response_path);
+        break;
+    case ZKSession::kDelete:
+        response.status = DoDelete(path, request.version);
+        break;
+    case ZKSession::kSet:
+        response.status = DoSet(path, value, request.version);
+        if (response.status == ZOK) {
+            response.version = nodes_[node_path].version;
+        }
+        break;
+    case ZKSession::kExists:
+        if (nodes_.contains(node_path)) {
+            response.status = ZOK;
+            response.version = nodes_[node_path].version;
+        } else {
+            response.status = ZNONODE;
+        }
+        set_data_watch = true;
+        break;
+    case ZKSession::kGet:
+        if (nodes_.contains(node_path)) {
+            response.status = ZOK;
+            response.version = nodes_[node_path].version;
+            response_value = nodes_[node_path].data;
+            set_data_watch = true;
+        } else {
+            response.status = ZNONODE;
+        }
+        break;
+    case ZKSession::kGetChildren:
+        if (nodes_.contains(node_path)) {
+            response.status = ZOK;
+            response_value = GetChildren(node_path);
+            set_child_watch = true;
+        } else {
+            response.status = ZNONODE;
+        }
+        break;
+    default:
+        HLOG_F(ERROR, "Unknown request type {}", request.type);
+        response.status = ZBADARGUMENTS;
+    }
+    if (request.watch_id != 0) {
+        WatchTarget target = { .conn_id = conn->id, .watch_id = request.watch_id };
+        if (set_data_watch) {
+            data_watches_[node_path].push_back(target);
+        } else if (set_child_watch) {
+            child_watches_[node_path].push_back(target);
+        }
+    }
+    SendMessage(conn, response, response_path, STRING_AS_SPAN(response_value));
+}
+
+int LocalCoordinator::DoCreate(Connection* conn, std::string_view path,
+                               std::span<const char> value, int create_mode,
+                               std::string* created_path) {
+    if (path == "/") {
+        return ZBADARGUMENTS;
+    }
+    std::string parent_path = ParentPath(path);
+    if (!nodes_.contains(parent_path)) {
+        return ZNONODE;
+    }
+    Node& parent = nodes_[parent_path];
+    if (parent.ephemeral_owner != 0) {
+        return ZNOCHILDRENFOREPHEMERALS;
+    }
+    bool ephemeral = (create_mode == static_cast<int>(ZKCreateMode::kEphemeral)
+                      || create_mode == static_cast<int>(ZKCreateMode::kEphemeralSequential));
+    bool sequential = (create_mode == static_cast<int>(ZKCreateMode::kPersistentSequential)
+                       || create_mode == static_cast<int>(ZKCreateMode::kEphemeralSequential));
+    std::string full_path(path);
+    if (sequential) {
+        full_path.append(fmt::format("{:010d}", parent.cversion));
+    }
+    if (nodes_.contains(full_path)) {
+        return ZNODEEXISTS;
+    }
+    parent.cversion++;
+    nodes_[full_path] = Node {
+        .data            = std::string(value.data(), value.size()),
+        .version         = 0,
+        .cversion        = 0,
+        .ephemeral_owner = ephemeral ? conn->id : 0
+    };
+    if (!ephemeral) {
+        LogNodeUpdate(parent_path);
+        LogNodeUpdate(full_path);
+        SyncDataFile();
+    }
+    TriggerWatches(&data_watches_, full_path, ZOO_CREATED_EVENT);
+    TriggerWatches(&child_watches_, parent_path, ZOO_CHILD_EVENT);
+    *created_path = std::move(full_path);
+    return ZOK;
+}
+
+int LocalCoordinator::DoDelete(std::string_view path, int version) {
+    std::string node_path(path);
+    if (node_path == "/") {
+        return ZBADARGUMENTS;
+    }
+    if (!nodes_.contains(node_path)) {
+        return ZNONODE;
+    }
+    const Node& node = nodes_[node_path];
+    if (version != -1 && version != node.version) {
+        return ZBADVERSION;
+    }
+    if (HasChildren(node_path)) {
+        return ZNOTEMPTY;
+    }
+    bool ephemeral = (node.ephemeral_owner != 0);
+    nodes_.erase(node_path);
+    std::string parent_path = ParentPath(node_path);
+    nodes_[parent_path].cversion++;
+    if (!ephemeral) {
+        LogNodeDeletion(node_path);
+        LogNodeUpdate(parent_path);
+        SyncDataFile();
+    }
+    TriggerWatches(&data_watches_, node_path, ZOO_DELETED_EVENT);
+    TriggerWatches(&child_watches_, node_path, ZOO_DELETED_EVENT);
+    TriggerWatches(&child_watches_, parent_path, ZOO_CHILD_EVENT);
+    return ZOK;
+}
+
+int LocalCoordinator::DoSet(std::string_view path, std::span<const char> value,
+                            int version) {
+    std::string node_path(path);
+    if (!nodes_.contains(node_path)) {
+        return ZNONODE;
+    }
+    Node& node = nodes_[node_path];
+    if (version != -1 && version != node.version) {
+        return ZBADVERSION;
+    }
+    node.data.assign(value.data(), value.size());
+    node.version++;
+    if (node.ephemeral_owner == 0) {
+        LogNodeUpdate(node_path);
+        SyncDataFile();
+    }
+    TriggerWatches(&data_watches_, node_path, ZOO_CHANGED_EVENT);
+    return ZOK;
+}
+
+void LocalCoordinator::SendMessage(Connection* conn, const LocalMessage& message,
+                                   std::string_view path, std::span<const char> value) {
+    if (conn->closed) {
+        return;
+    }
+    AppendMessage(&conn->write_buffer, message, path, value);
+    FlushConnection(conn);
+}
+
+void LocalCoordinator::TriggerWatches(
+        absl::flat_hash_map<std::string, std::vector<WatchTarget>>* watches,
+        const std::string& path, int event_type) {
+    if (!watches->contains(path)) {
+        return;
+    }
+    std::vector<WatchTarget> targets = std::move(watches->at(path));
+    watches->erase(path);
+    LocalMessage event;
+    memset(&event, 0, sizeof(LocalMessage));
+    event.type = kLocalWatchEvent;
+    event.status = event_type;
+    for (const WatchTarget& target : targets) {
+        if (!conns_.contains(target.conn_id)) {
+            continue;
+        }
+        event.watch_id = target.watch_id;
+        SendMessage(conns_[target.conn_id].get(), event, path, EMPTY_CHAR_SPAN);
+    }
+}
+
+bool LocalCoordinator::HasChildren(const std::string& path) const {
+    std::string prefix = ChildPrefix(path);
+    auto iter = nodes_.upper_bound(prefix);
+    return iter != nodes_.end() && absl::StartsWith(iter->first, prefix);
+}
+
+std::string LocalCoordinator::GetChildren(const std::string& path) const {
+    std::string prefix = ChildPrefix(path);
+    std::string names;
+    for (auto iter = nodes_.upper_bound(prefix);
+            iter != nodes_.end() && absl::StartsWith(iter->first, prefix); iter++) {
+        std::string_view name = std::string_view(iter->first).substr(prefix.size());
+        if (name.find('/') != std::string_view::npos) {
+            continue;
+        }
+        if (!names.empty()) {
+            names.push_back('\0');
+        }
+        names.append(name);
+    }
+    return names;
+}
+
+namespace {
+enum DataFileRecordType : uint32_t { kNodeUpdate = 0, kNodeDeletion = 1 };
+
+struct DataFileRecord {
+    uint32_t type;
+    uint32_t path_size;
+    uint32_t data_size;
+    int32_t  version;
+    int32_t  cversion;
+} __attribute__((packed));
+
+static void AppendRecord(std::string* buffer, DataFileRecordType type,
+                         std::string_view path, std::string_view data,
+                         int32_t version, int32_t cversion) {
+    DataFileRecord record = {
+        .type      = type,
+        .path_size = gsl::narrow_cast<uint32_t>(path.size()),
+        .data_size = gsl::narrow_cast<uint32_t>(data.size()),
+        .version   = version,
+        .cversion  = cversion
+    };
+    buffer->append(reinterpret_cast<const char*>(&record), sizeof(DataFileRecord));
+    buffer->append(path);
+    buffer->append(data);
+}
+
+static void WriteAll(int fd, std::string_view contents, std::string_view file) {
+    size_t offset = 0;
+    while (offset < contents.size()) {
+        ssize_t nwrite = write(fd, contents.data() + offset, contents.size() - offset);
+        PCHECK(nwrite >= 0) << "Failed to write " << file;
+        offset += static_cast<size_t>(nwrite);
+    }
+}
+}  // namespace
+
+void LocalCoordinator::LoadDataFile() {
+    if (data_file_.empty()) {
+        return;
+    }
+    if (fs_utils::Exists(data_file_)) {
+        std::string contents;
+        if (!fs_utils::ReadContents(data_file_, &contents)) {
+            HLOG_F(FATAL, "Failed to read {}", data_file_);
+        }
+        size_t pos = 0;
+        size_t num_records = 0;
+        while (pos + sizeof(DataFileRecord) <= contents.size()) {
+            DataFileRecord record;
+            memcpy(&record, contents.data() + pos, sizeof(DataFileRecord));
+            if (pos + sizeof(DataFileRecord) + record.path_size + record.data_size
+                    > contents.size()) {
+                break;
+            }
+            pos += sizeof(DataFileRecord);
+            std::string path = contents.substr(pos, record.path_size);
+            pos += record.path_size;
+            if (record.type == kNodeDeletion) {
+                nodes_.erase(path);
+            } else {
+                CHECK_EQ(record.type, kNodeUpdate) << "Corrupted data file";
+                nodes_[path] = Node {
+                    .data            = contents.substr(pos, record.data_size),
+                    .version         = record.version,
+                    .cversion        = record.cversion,
+                    .ephemeral_owner = 0
+                };
+            }
+            pos += record.data_size;
+            num_records++;
+        }
+        if (pos < contents.size()) {
+            // Left by a crash in the middle of an append
+            HLOG_F(WARNING, "Drop torn record at the end of {}", data_file_);
+        }
+        HLOG_F(INFO, "Loaded {} records from {}", num_records, data_file_);
+    }
+    WriteDataSnapshot();
+    auto fd = fs_utils::Open(data_file_, O_WRONLY | O_APPEND);
+    if (!fd.has_value()) {
+        HLOG_F(FATAL, "Failed to open {}", data_file_);
+    }
+    data_fd_ = *fd;
+}
+
+void LocalCoordinator::WriteDataSnapshot() {
+    std::string contents;
+    for (const auto& [path, node] : nodes_) {
+        if (node.ephemeral_owner != 0) {
+            continue;
+        }
+        AppendRecord(&contents, kNodeUpdate, path, node.data, node.version, node.cversion);
+    }
+    // Write to a temporary file first, so the data file is always complete
+    std::string tmp_file = fmt::format("{}.tmp", data_file_);
+    auto fd = fs_utils::Create(tmp_file);
+    if (!fd.has_value()) {
+        HLOG_F(FATAL, "Failed to create {}", tmp_file);
+    }
+    WriteAll(*fd, contents, tmp_file);
+    PCHECK(fsync(*fd) == 0) << "Failed to fsync " << tmp_file;
+    PCHECK(close(*fd) == 0) << "Failed to close " << tmp_file;
+    PCHECK(rename(tmp_file.c_str(), data_file_.c_str()) == 0)
+        << "Failed to rename " << tmp_file;
+}
+
+void LocalCoordinator::LogNodeUpdate(const std::string& path) {
+    if (data_file_.empty()) {
+        return;
+    }
+    const Node& node = nodes_.at(path);
+    DCHECK_EQ(node.ephemeral_owner, 0U);
+    AppendRecord(&data_buffer_, kNodeUpdate, path, node.data, node.version, node.cversion);
+}
+
+void LocalCoordinator::LogNodeDeletion(const std::string& path) {
+    if (data_file_.empty()) {
+        return;
+    }
+    AppendRecord(&data_buffer_, kNodeDeletion, path, "", 0, 0);
+}
+
+void LocalCoordinator::SyncDataFile() {
+    if (data_buffer_.empty()) {
+        return;
+    }
+    DCHECK_NE(data_fd_, -1);
+    WriteAll(data_fd_, data_buffer_, data_file_);
+    PCHECK(fdatasync(data_fd_) == 0) << "Failed to fdatasync " << data_file_;
+    data_buffer_.clear();
+}
+
+}  // namespace zk
+}  // namespace faas
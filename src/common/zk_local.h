@@ -0,0 +1,154 @@
+#pragma once
+
+#ifndef __FAAS_SRC
+#error common/zk_local.h cannot be included outside
+#endif
+
+#include "base/common.h"
+#include "base/thread.h"
+#include "common/zk.h"
+
+namespace faas {
+namespace zk {
+
+// Frame exchanged between LocalBackend and LocalCoordinator over a Unix
+// socket. It is followed by `path_size` bytes of path, and then the value
+// (node data, or '\0'-separated names of children).
+struct LocalMessage {
+    uint32_t payload_size;
+    uint32_t path_size;
+    uint32_t xid;         // Zero for watch events
+    uint32_t watch_id;    // Zero if no watch is set
+    uint16_t type;        // One of ZKSession's op types, or kLocalWatchEvent
+    int16_t  create_mode;
+    int32_t  status;      // ZooKeeper status, or event type of watch events
+    int32_t  version;     // Expected version in requests, node version in responses
+} __attribute__((packed));
+
+constexpr uint16_t kLocalWatchEvent = 0xff;
+
+// Client side of the local coordination backend
+class LocalBackend final : public Backend {
+public:
+    static constexpr std::string_view kHostPrefix = "local:";
+
+    LocalBackend(ZKSession* sess, std::string_view socket_path);
+    ~LocalBackend();
+
+    void Connect() override;
+    int GetInterest(short* events, struct timespec* timeout) override;
+    void Process(short revents) override;
+    int StartOp(Op* op) override;
+
+private:
+    std::string socket_path_;
+    int sockfd_;
+
+    uint32_t next_xid_;
+    uint32_t next_watch_id_;
+    absl::flat_hash_map</* xid */ uint32_t, Op*> inflight_ops_;
+    absl::flat_hash_map</* watch_id */ uint32_t, Watch*> watches_;
+
+    std::string read_buffer_;
+    std::string write_buffer_;
+    struct Stat stat_;
+
+    void FlushWriteBuffer();
+    void OnRecvMessage(const LocalMessage& message, std::string_view path,
+                       std::span<const char> value);
+
+    DISALLOW_COPY_AND_ASSIGN(LocalBackend);
+};
+
+// Single-process stand-in for a ZooKeeper ensemble. Znodes are kept in an
+// ordered map, and updates of persistent ones are appended to `data_file`
+// (if not empty), which is compacted into a snapshot when loaded. Ephemeral
+// znodes are owned by client connections, and removed once their
+// connections close. Watches are one-shot, as in ZooKeeper.
+class LocalCoordinator {
+public:
+    LocalCoordinator(std::string_view socket_path, std::string_view data_file);
+    ~LocalCoordinator();
+
+    // Create a persistent znode (and missing ancestors) if not exists.
+    // Must be called before Start.
+    void EnsureNode(std::string_view path);
+
+    void Start();
+    void ScheduleStop();
+    void WaitForFinish();
+
+private:
+    enum State { kCreated, kRunning, kStopped };
+    std::atomic<State> state_;
+    std::string socket_path_;
+    std::string data_file_;
+    int data_fd_;
+    std::string data_buffer_;
+
+    base::Thread event_loop_thread_;
+    int listen_fd_;
+    int stop_eventfd_;
+
+    struct Node {
+        std::string data;
+        int32_t     version;
+        // Bumped on child changes, used for names of sequential znodes
+        int32_t     cversion;
+        // Id of the owner connection for ephemeral znodes, zero otherwise
+        uint64_t    ephemeral_owner;
+    };
+    std::map</* path */ std::string, Node> nodes_;
+
+    struct Connection {
+        uint64_t    id;
+        int         sockfd;
+        std::string read_buffer;
+        std::string write_buffer;
+        bool        closed;
+    };
+    uint64_t next_conn_id_;
+    absl::flat_hash_map</* id */ uint64_t, std::unique_ptr<Connection>> conns_;
+
+    struct WatchTarget {
+        uint64_t conn_id;
+        uint32_t watch_id;
+    };
+    // Set by Exists and Get
+    absl::flat_hash_map</* path */ std::string, std::vector<WatchTarget>> data_watches_;
+    // Set by GetChildren
+    absl::flat_hash_map</* path */ std::string, std::vector<WatchTarget>> child_watches_;
+
+    void EventLoopThreadMain();
+    void OnNewConnection();
+    void OnConnectionReadable(Connection* conn);
+    void FlushConnection(Connection* conn);
+    void CloseConnection(Connection* conn);
+
+    void HandleRequest(Connection* conn, const LocalMessage& request,
+                       std::string_view path, std::span<const char> value);
+    int DoCreate(Connection* conn, std::string_view path, std::span<const char> value,
+                 int create_mode, std::string* created_path);
+    int DoDelete(std::string_view path, int version);
+    int DoSet(std::string_view path, std::span<const char> value, int version);
+
+    void SendMessage(Connection* conn, const LocalMessage& message,
+                     std::string_view path, std::span<const char> value);
+    void TriggerWatches(absl::flat_hash_map<std::string, std::vector<WatchTarget>>* watches,
+                        const std::string& path, int event_type);
+
+    bool HasChildren(const std::string& path) const;
+    std::string GetChildren(const std::string& path) const;
+
+    void LoadDataFile();
+    void WriteDataSnapshot();
+    // Updates are buffered, and written with one fdatasync by SyncDataFile
+    void LogNodeUpdate(const std::string& path);
+    void LogNodeDeletion(const std::string& path);
+    void SyncDataFile();
+
+    DISALLOW_COPY_AND_ASSIGN(LocalCoordinator);
+};
+
+}  // namespace zk
+}  // namespace faas
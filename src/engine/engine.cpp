@@ -587,6 +587,9 @@ Engine::OnRecvMessage(MessageConnection* connection, const Message& message)
         HandleFuncCallFailedMessage(message);
     } else if (MessageHelper::IsSharedLogOp(message)) {
         HandleSharedLogOpMessage(message);
+    } else if (MessageHelper::IsFuncWorkerRestart(message)) {
+        DCHECK(connection->is_launcher_connection());
+        worker_manager_.OnFuncWorkerRestart(connection, message);
     } else {
         LOG(ERROR) << "Unknown message type!";
     }
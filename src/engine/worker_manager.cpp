@@ -13,7 +13,9 @@ using protocol::Message;
 
 WorkerManager::WorkerManager(Engine* engine)
     : engine_(engine),
-      next_client_id_(1)
+      next_client_id_(1),
+      restart_stat_(
+          stat::CategoryCounter::StandardReportCallback("func_worker_restart"))
 {}
 
 WorkerManager::~WorkerManager() {}
@@ -132,6 +134,35 @@ WorkerManager::RequestNewFuncWorker(uint16_t func_id, uint16_t* client_id)
                                         client_id);
 }
 
+void
+WorkerManager::OnFuncWorkerRestart(MessageConnection* launcher_connection,
+                                   const Message& message)
+{
+    uint16_t func_id = launcher_connection->func_id();
+    uint32_t restart_count = message.call_id;
+    if (message.flags & protocol::kFuncWorkerCrashLoopFlag) {
+        HLOG_F(WARNING,
+               "FuncWorkers of func_id {} are crash looping, {} restarts so far",
+               func_id,
+               restart_count);
+    } else {
+        HLOG_F(INFO,
+               "Restart FuncWorker of func_id {} in place of client_id {}, "
+               "{} restarts so far",
+               func_id,
+               message.client_id,
+               restart_count);
+    }
+    {
+        absl::MutexLock lk(&mu_);
+        restart_stat_.Tick(func_id);
+    }
+    // The replacement gets a new client_id, as FIFOs of the old one are
+    // removed when it disconnects
+    uint16_t client_id;
+    RequestNewFuncWorkerInternal(launcher_connection, &client_id);
+}
+
 std::shared_ptr<FuncWorker>
 WorkerManager::GetFuncWorker(uint16_t client_id)
 {
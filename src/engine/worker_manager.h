@@ -2,6 +2,7 @@
 
 #include "base/common.h"
 #include "common/protocol.h"
+#include "common/stat.h"
 #include "engine/message_connection.h"
 #include "server/io_worker.h"
 
@@ -24,6 +25,9 @@ public:
     bool OnFuncWorkerConnected(MessageConnection* worker_connection);
     void OnFuncWorkerDisconnected(MessageConnection* worker_connection);
     bool RequestNewFuncWorker(uint16_t func_id, uint16_t* client_id);
+    // Launcher asks to replace a func worker that has exited
+    void OnFuncWorkerRestart(MessageConnection* launcher_connection,
+                             const protocol::Message& message);
     std::shared_ptr<FuncWorker> GetFuncWorker(uint16_t client_id);
 
 private:
@@ -35,7 +39,9 @@ private:
         launcher_connections_ ABSL_GUARDED_BY(mu_);
     absl::flat_hash_map</* client_id */ uint16_t, std::shared_ptr<FuncWorker>>
         func_workers_ ABSL_GUARDED_BY(mu_);
-    
+    // Restarts reported by launchers, by func_id
+    stat::CategoryCounter restart_stat_ ABSL_GUARDED_BY(mu_);
+
     bool RequestNewFuncWorkerInternal(MessageConnection* launcher_connection, uint16_t* client_id);
 
     DISALLOW_COPY_AND_ASSIGN(WorkerManager);
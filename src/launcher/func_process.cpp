@@ -3,6 +3,7 @@
 #include "common/time.h"
 #include "ipc/base.h"
 #include "launcher/launcher.h"
+#include "launcher/zygote.h"
 #include "utils/fs.h"
 
 ABSL_FLAG(bool, hostname_in_output_fname, true, "");
@@ -12,54 +13,63 @@ namespace launcher {
 
 FuncProcess::FuncProcess(Launcher *launcher, int id, int initial_client_id)
     : state_(kCreated), launcher_(launcher), id_(id), initial_client_id_(initial_client_id),
-      log_header_(fmt::format("FuncProcess[{}]: ", id)), subprocess_(launcher->fprocess()) {
+      log_header_(fmt::format("FuncProcess[{}]: ", id)), subprocess_(launcher->fprocess()),
+      message_pipe_(nullptr), zygote_(nullptr), forked_pid_(-1) {
     message_pipe_fd_ = subprocess_.CreateReadablePipe();
 }
 
 FuncProcess::~FuncProcess() { DCHECK(state_ == kCreated || state_ == kClosed); }
 
+void FuncProcess::PrepareSubprocess(Launcher *launcher, uv::Subprocess *subprocess,
+                                    int message_pipe_fd, std::string_view name) {
+    subprocess->AddEnvVariable("FAAS_FUNC_ID", launcher->func_id());
+    subprocess->AddEnvVariable("FAAS_ENGINE_ID", launcher->engine_id());
+    subprocess->AddEnvVariable("FAAS_MSG_PIPE_FD", message_pipe_fd);
+    subprocess->AddEnvVariable("FAAS_ROOT_PATH_FOR_IPC", ipc::GetRootPathForIpc());
+    if (launcher->func_worker_use_engine_socket()) {
+        subprocess->AddEnvVariable("FAAS_USE_ENGINE_SOCKET", "1");
+    }
+    if (launcher->engine_tcp_port() != -1) {
+        subprocess->AddEnvVariable("FAAS_ENGINE_TCP_PORT", launcher->engine_tcp_port());
+    }
+    std::string path_prefix = OutputPathPrefix(launcher, name);
+    if (!path_prefix.empty()) {
+        path_prefix = fmt::format("{}.{}", path_prefix, GetMonotonicMicroTimestamp());
+        subprocess->SetStandardFile(uv::Subprocess::kStdout, path_prefix + ".stdout");
+        subprocess->SetStandardFile(uv::Subprocess::kStderr, path_prefix + ".stderr");
+    }
+    if (!launcher->fprocess_working_dir().empty()) {
+        subprocess->SetWorkingDir(launcher->fprocess_working_dir());
+    }
+}
+
+std::string FuncProcess::OutputPathPrefix(Launcher *launcher, std::string_view name) {
+    if (launcher->fprocess_output_dir().empty()) {
+        return "";
+    }
+    std::string fname_prefix;
+    if (absl::GetFlag(FLAGS_hostname_in_output_fname)) {
+        std::string hostname;
+        if (!faas::fs_utils::ReadContents("/proc/sys/kernel/hostname", &hostname)) {
+            LOG(FATAL) << "Failed to read /proc/sys/kernel/hostname";
+        }
+        hostname = absl::StripSuffix(hostname, "\n");
+        fname_prefix = fmt::format("{}_{}_{}", launcher->func_name(), hostname, name);
+    } else {
+        fname_prefix = fmt::format("{}_worker_{}", launcher->func_name(), name);
+    }
+    return fs_utils::JoinPath(launcher->fprocess_output_dir(), fname_prefix);
+}
+
 bool FuncProcess::Start(uv_loop_t *uv_loop, utils::BufferPool *read_buffer_pool) {
     DCHECK(state_ == kCreated);
     uv_loop_ = uv_loop;
     read_buffer_pool_ = read_buffer_pool;
-    subprocess_.AddEnvVariable("FAAS_FUNC_ID", launcher_->func_id());
+    PrepareSubprocess(launcher_, &subprocess_, message_pipe_fd_, std::to_string(id_));
     subprocess_.AddEnvVariable("FAAS_FPROCESS_ID", id_);
-    subprocess_.AddEnvVariable("FAAS_ENGINE_ID", launcher_->engine_id());
     if (initial_client_id_ >= 0) {
         subprocess_.AddEnvVariable("FAAS_CLIENT_ID", initial_client_id_);
     }
-    subprocess_.AddEnvVariable("FAAS_MSG_PIPE_FD", message_pipe_fd_);
-    subprocess_.AddEnvVariable("FAAS_ROOT_PATH_FOR_IPC", ipc::GetRootPathForIpc());
-    if (launcher_->func_worker_use_engine_socket()) {
-        subprocess_.AddEnvVariable("FAAS_USE_ENGINE_SOCKET", "1");
-    }
-    if (launcher_->engine_tcp_port() != -1) {
-        subprocess_.AddEnvVariable("FAAS_ENGINE_TCP_PORT", launcher_->engine_tcp_port());
-    }
-    if (!launcher_->fprocess_output_dir().empty()) {
-        std::string fname_prefix;
-        if (absl::GetFlag(FLAGS_hostname_in_output_fname)) {
-            std::string hostname;
-            if (!faas::fs_utils::ReadContents("/proc/sys/kernel/hostname", &hostname)) {
-                LOG(FATAL) << "Failed to read /proc/sys/kernel/hostname";
-            }
-            hostname = absl::StripSuffix(hostname, "\n");
-            fname_prefix = fmt::format("{}_{}_{}", launcher_->func_name(), hostname, id_);
-        } else {
-            fname_prefix = fmt::format("{}_worker_{}", launcher_->func_name(), id_);
-        }
-        fname_prefix = fmt::format("{}.{}", fname_prefix, GetMonotonicMicroTimestamp());
-        subprocess_.SetStandardFile(
-            uv::Subprocess::kStdout,
-            fs_utils::JoinPath(launcher_->fprocess_output_dir(), fname_prefix + ".stdout"));
-        subprocess_.SetStandardFile(
-            uv::Subprocess::kStderr,
-            fs_utils::JoinPath(launcher_->fprocess_output_dir(), fname_prefix + ".stderr"));
-        
-    }
-    if (!launcher_->fprocess_working_dir().empty()) {
-        subprocess_.SetWorkingDir(launcher_->fprocess_working_dir());
-    }
     if (!subprocess_.Start(uv_loop, read_buffer_pool,
                            absl::bind_front(&FuncProcess::OnSubprocessExit, this))) {
         return false;
@@ -79,6 +89,38 @@ bool FuncProcess::Start(uv_loop_t *uv_loop, utils::BufferPool *read_buffer_pool)
     return true;
 }
 
+void FuncProcess::StartFromZygote(uv_loop_t *uv_loop, Zygote *zygote) {
+    DCHECK(state_ == kCreated);
+    DCHECK_GE(initial_client_id_, 0);
+    uv_loop_ = uv_loop;
+    zygote_ = zygote;
+    state_ = kForking;
+    zygote->Fork(id_, initial_client_id_, absl::bind_front(&FuncProcess::OnForked, this));
+}
+
+void FuncProcess::OnForked(uv_pipe_t *message_pipe, int pid) {
+    DCHECK(state_ == kForking || state_ == kClosing);
+    if (message_pipe == nullptr) {
+        state_ = kClosed;
+        launcher_->OnFuncProcessExit(this, /* exit_status= */ -1,
+                                     EMPTY_CHAR_SPAN, EMPTY_CHAR_SPAN);
+        return;
+    }
+    forked_pid_ = pid;
+    message_pipe_ = message_pipe;
+    message_pipe_->data = this;
+    // The forked worker never writes to the pipe, which reaches EOF
+    // once the worker exits
+    UV_DCHECK_OK(uv_read_start(UV_AS_STREAM(message_pipe_),
+                               &FuncProcess::BufferAllocCallback,
+                               &FuncProcess::ReadForkedPipeCallback));
+    if (state_ == kClosing) {
+        zygote_->Kill(id_, forked_pid_);
+    } else {
+        state_ = kRunning;
+    }
+}
+
 void FuncProcess::SendMessage(const protocol::Message &message) {
     DCHECK_IN_EVENT_LOOP_THREAD(uv_loop_);
     uv_buf_t buf;
@@ -99,8 +141,14 @@ void FuncProcess::ScheduleClose() {
         HLOG(WARNING) << "Already scheduled to close or has closed";
         return;
     }
+    // If still forking, the process is killed in OnForked
+    bool forking = (state_ == kForking);
     state_ = kClosing;
-    subprocess_.Kill();
+    if (zygote_ == nullptr) {
+        subprocess_.Kill();
+    } else if (!forking) {
+        zygote_->Kill(id_, forked_pid_);
+    }
 }
 
 void FuncProcess::OnSubprocessExit(int exit_status, std::span<const char> stdout,
@@ -114,7 +162,38 @@ void FuncProcess::OnSubprocessExit(int exit_status, std::span<const char> stdout
         HVLOG(1) << "Stderr: " << std::string_view(stderr.data(), stderr.size());
     }
     state_ = kClosed;
-    launcher_->OnFuncProcessExit(this);
+    launcher_->OnFuncProcessExit(this, exit_status, stdout, stderr);
+}
+
+UV_ALLOC_CB_FOR_CLASS(FuncProcess, BufferAlloc) {
+    launcher_->NewReadBuffer(suggested_size, buf);
+}
+
+UV_READ_CB_FOR_CLASS(FuncProcess, ReadForkedPipe) {
+    auto reclaim_resource = gsl::finally([this, buf] {
+        if (buf->base != 0) {
+            launcher_->ReturnReadBuffer(buf);
+        }
+    });
+    if (nread >= 0) {
+        return;
+    }
+    if (nread != UV_EOF) {
+        HLOG(WARNING) << "Read error on message pipe: " << uv_strerror(static_cast<int>(nread));
+    }
+    if (state_ != kClosing) {
+        HLOG(WARNING) << "Forked process " << forked_pid_ << " exits";
+    }
+    uv_close(UV_AS_HANDLE(message_pipe_), &FuncProcess::ForkedPipeCloseCallback);
+}
+
+UV_CLOSE_CB_FOR_CLASS(FuncProcess, ForkedPipeClose) {
+    free(message_pipe_);
+    message_pipe_ = nullptr;
+    state_ = kClosed;
+    // Outputs of forked workers go to their own files, or to the zygote's
+    launcher_->OnFuncProcessExit(this, /* exit_status= */ -1,
+                                 EMPTY_CHAR_SPAN, EMPTY_CHAR_SPAN);
 }
 
 UV_WRITE_CB_FOR_CLASS(FuncProcess, SendMessage) {
@@ -11,6 +11,7 @@ namespace faas {
 namespace launcher {
 
 class Launcher;
+class Zygote;
 
 class FuncProcess : public uv::Base {
 public:
@@ -18,13 +19,24 @@ public:
     ~FuncProcess();
 
     int id() const { return id_; }
+    int client_id() const { return initial_client_id_; }
 
     bool Start(uv_loop_t* uv_loop, utils::BufferPool* read_buffer_pool);
+    // Fork from the zygote, instead of spawning a new process
+    void StartFromZygote(uv_loop_t* uv_loop, Zygote* zygote);
     void SendMessage(const protocol::Message& message);
     void ScheduleClose();
 
+    // Environment variables, working directory and output files shared by
+    // func processes and the zygote
+    static void PrepareSubprocess(Launcher* launcher, uv::Subprocess* subprocess,
+                                  int message_pipe_fd, std::string_view name);
+    // Path of output files of process `name` without the timestamp and
+    // suffix, or empty if outputs are not written to files
+    static std::string OutputPathPrefix(Launcher* launcher, std::string_view name);
+
 private:
-    enum State { kCreated, kRunning, kClosing, kClosed };
+    enum State { kCreated, kForking, kRunning, kClosing, kClosed };
 
     State state_;
     Launcher* launcher_;
@@ -40,10 +52,18 @@ private:
     int message_pipe_fd_;
     uv_pipe_t* message_pipe_;
 
+    // Set if forked from the zygote, where message_pipe_ is owned
+    Zygote* zygote_;
+    int forked_pid_;
+
     void OnSubprocessExit(int exit_status, std::span<const char> stdout,
                           std::span<const char> stderr);
+    void OnForked(uv_pipe_t* message_pipe, int pid);
 
     DECLARE_UV_WRITE_CB_FOR_CLASS(SendMessage);
+    DECLARE_UV_ALLOC_CB_FOR_CLASS(BufferAlloc);
+    DECLARE_UV_READ_CB_FOR_CLASS(ReadForkedPipe);
+    DECLARE_UV_CLOSE_CB_FOR_CLASS(ForkedPipeClose);
 
     DISALLOW_COPY_AND_ASSIGN(FuncProcess);
 };
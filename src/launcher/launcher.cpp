@@ -19,12 +19,14 @@ Launcher::Launcher()
       func_id_(-1),
       fprocess_mode_(kInvalidMode),
       engine_tcp_port_(-1),
+      fprocess_zygote_(false),
       engine_id_(0),
       event_loop_thread_("Launcher/EL",
                          absl::bind_front(&Launcher::EventLoopThreadMain, this)),
       buffer_pool_("Launcher", kBufferSize),
       func_worker_use_engine_socket_(false),
       engine_connection_(this),
+      supervisor_(this, &engine_connection_),
       engine_message_delay_stat_(
           stat::StatisticsCollector<int32_t>::StandardReportCallback("engine_message_delay")) {
     UV_DCHECK_OK(uv_loop_init(&uv_loop_));
@@ -48,6 +50,8 @@ void Launcher::Start() {
     DCHECK(state_.load() == kCreated);
     CHECK(func_id_ != -1);
     CHECK(!fprocess_.empty());
+    CHECK(!fprocess_zygote_ || fprocess_mode_ == kCppMode)
+        << "Zygote is only supported for C++ func workers";
     // Connect to engine via IPC path
     Message handshake_message = MessageHelper::NewLauncherHandshake(
         gsl::narrow_cast<uint16_t>(func_id_));
@@ -55,6 +59,7 @@ void Launcher::Start() {
     DCHECK_EQ(self_container_id.size(), docker_utils::kContainerIdLength);
     MessageHelper::SetInlineData(&handshake_message, STRING_AS_SPAN(self_container_id));
     engine_connection_.Start(&uv_loop_, engine_tcp_port_, handshake_message);
+    supervisor_.Start(&uv_loop_);
     // Start thread for running event loop
     event_loop_thread_.Start();
     state_.store(kRunning);
@@ -72,7 +77,9 @@ void Launcher::OnEngineConnectionClose() {
     ScheduleStop();
 }
 
-void Launcher::OnFuncProcessExit(FuncProcess* func_process) {
+void Launcher::OnFuncProcessExit(FuncProcess* func_process, int exit_status,
+                                 std::span<const char> stdout,
+                                 std::span<const char> stderr) {
     if (fprocess_mode_ == kGoMode) {
         HLOG(FATAL) << "Golang fprocess exited";
     }
@@ -88,9 +95,19 @@ void Launcher::OnFuncProcessExit(FuncProcess* func_process) {
     DCHECK_LT(id, static_cast<int>(func_processes_.size()));
     size_t index = static_cast<size_t>(id);
     DCHECK(func_processes_[index].get() == func_process);
+    if (state_.load() != kStopping) {
+        supervisor_.OnFuncProcessExit(id, func_process->client_id(), exit_status,
+                                      stdout, stderr);
+    }
     func_processes_[index].reset(nullptr);
 }
 
+void Launcher::OnZygoteExit() {
+    if (state_.load() != kStopping) {
+        HLOG(FATAL) << "Zygote exited";
+    }
+}
+
 void Launcher::EventLoopThreadMain() {
     base::Thread::current()->MarkThreadCategory("IO");
     HLOG(INFO) << "Event loop starts";
@@ -120,6 +137,12 @@ bool Launcher::OnRecvHandshakeResponse(const Message& handshake_response,
         return false;
     }
     func_config_json_.assign(payload.data(), payload.size());
+    if (fprocess_zygote_) {
+        zygote_ = std::make_unique<Zygote>(this);
+        if (!zygote_->Start(&uv_loop_, &buffer_pool_)) {
+            HLOG(FATAL) << "Failed to start zygote!";
+        }
+    }
     return true;
 }
 
@@ -128,12 +151,25 @@ void Launcher::OnRecvMessage(const protocol::Message& message) {
     engine_message_delay_stat_.AddSample(MessageHelper::ComputeMessageDelay(message));
     if (MessageHelper::IsCreateFuncWorker(message)) {
         if (fprocess_mode_ == kCppMode) {
-            auto func_process = std::make_unique<FuncProcess>(
-                this, /* id= */ func_processes_.size(),
+            // Restarted func workers take slots of exited ones
+            size_t index = func_processes_.size();
+            for (size_t i = 0; i < func_processes_.size(); i++) {
+                if (func_processes_[i] == nullptr) {
+                    index = i;
+                    break;
+                }
+            }
+            if (index == func_processes_.size()) {
+                func_processes_.emplace_back(nullptr);
+            }
+            func_processes_[index] = std::make_unique<FuncProcess>(
+                this, /* id= */ gsl::narrow_cast<int>(index),
                 /* initial_client_id= */ message.client_id);
-            if (func_process->Start(&uv_loop_, &buffer_pool_)) {
-                func_processes_.push_back(std::move(func_process));
-            } else {
+            FuncProcess* func_process = func_processes_[index].get();
+            if (zygote_ != nullptr) {
+                // A failed fork clears the slot through OnFuncProcessExit
+                func_process->StartFromZygote(&uv_loop_, zygote_.get());
+            } else if (!func_process->Start(&uv_loop_, &buffer_pool_)) {
                 HLOG(FATAL) << "Failed to start function process!";
             }
         } else if (fprocess_mode_ == kGoMode
@@ -196,8 +232,14 @@ UV_ASYNC_CB_FOR_CLASS(Launcher, Stop) {
     }
     engine_connection_.ScheduleClose();
     for (auto& func_process : func_processes_) {
-        func_process->ScheduleClose();
+        if (func_process != nullptr) {
+            func_process->ScheduleClose();
+        }
+    }
+    if (zygote_ != nullptr) {
+        zygote_->ScheduleClose();
     }
+    supervisor_.ScheduleClose();
     uv_close(UV_AS_HANDLE(&stop_event_), nullptr);
     state_.store(kStopping);
 }
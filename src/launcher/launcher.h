@@ -9,6 +9,8 @@
 #include "utils/buffer_pool.h"
 #include "launcher/engine_connection.h"
 #include "launcher/func_process.h"
+#include "launcher/zygote.h"
+#include "launcher/supervisor.h"
 
 namespace faas {
 namespace launcher {
@@ -47,6 +49,9 @@ public:
     void set_engine_tcp_port(int port) {
         engine_tcp_port_ = port;
     }
+    void set_fprocess_zygote(bool value) {
+        fprocess_zygote_ = value;
+    }
 
     int func_id() const { return func_id_; }
     std::string_view fprocess() const { return fprocess_; }
@@ -75,7 +80,9 @@ public:
     void ReturnWriteRequest(uv_write_t* write_req);
 
     void OnEngineConnectionClose();
-    void OnFuncProcessExit(FuncProcess* func_process);
+    void OnFuncProcessExit(FuncProcess* func_process, int exit_status,
+                           std::span<const char> stdout, std::span<const char> stderr);
+    void OnZygoteExit();
     bool OnRecvHandshakeResponse(const protocol::Message& handshake_response,
                                  std::span<const char> payload);
     void OnRecvMessage(const protocol::Message& message);
@@ -90,6 +97,7 @@ private:
     std::string fprocess_output_dir_;
     Mode fprocess_mode_;
     int engine_tcp_port_;
+    bool fprocess_zygote_;
     uint16_t engine_id_;
 
     uv_loop_t uv_loop_;
@@ -102,7 +110,9 @@ private:
     std::string func_config_json_;
     bool func_worker_use_engine_socket_;
     EngineConnection engine_connection_;
+    Supervisor supervisor_;
     std::vector<std::unique_ptr<FuncProcess>> func_processes_;
+    std::unique_ptr<Zygote> zygote_;
 
     stat::StatisticsCollector<int32_t> engine_message_delay_stat_;
 
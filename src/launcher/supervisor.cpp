@@ -0,0 +1,188 @@
+#include "launcher/supervisor.h"
+
+#include "common/time.h"
+#include "launcher/launcher.h"
+#include "launcher/engine_connection.h"
+
+ABSL_FLAG(absl::Duration, fprocess_restart_initial_backoff, absl::Milliseconds(100),
+          "Delay of restarting a func worker after its first recent exit");
+ABSL_FLAG(absl::Duration, fprocess_restart_max_backoff, absl::Seconds(30),
+          "Maximal delay of restarting a func worker");
+ABSL_FLAG(size_t, fprocess_crash_loop_threshold, 5,
+          "Func workers are in crash loop with this many exits within "
+          "--fprocess_crash_loop_window");
+ABSL_FLAG(absl::Duration, fprocess_crash_loop_window, absl::Seconds(60),
+          "Window of exits counted for backoff and crash loop detection");
+ABSL_FLAG(size_t, fprocess_max_restarts, 100,
+          "Delay restarting func workers after this many restarts within "
+          "--fprocess_restart_limit_window, 0 for no limit");
+ABSL_FLAG(absl::Duration, fprocess_restart_limit_window, absl::Minutes(10),
+          "Window of restarts counted against --fprocess_max_restarts");
+ABSL_FLAG(size_t, fprocess_output_tail_bytes, 4096,
+          "Bytes kept from the end of stdout and stderr of exited func workers");
+
+#define log_header_ "Supervisor: "
+
+namespace faas {
+namespace launcher {
+
+Supervisor::Supervisor(Launcher* launcher, EngineConnection* engine_connection)
+    : launcher_(launcher),
+      engine_connection_(engine_connection),
+      uv_loop_(nullptr),
+      closed_(false),
+      initial_backoff_(absl::GetFlag(FLAGS_fprocess_restart_initial_backoff)),
+      max_backoff_(absl::GetFlag(FLAGS_fprocess_restart_max_backoff)),
+      crash_loop_threshold_(absl::GetFlag(FLAGS_fprocess_crash_loop_threshold)),
+      crash_loop_window_us_(
+          absl::ToInt64Microseconds(absl::GetFlag(FLAGS_fprocess_crash_loop_window))),
+      max_restarts_(absl::GetFlag(FLAGS_fprocess_max_restarts)),
+      restart_limit_window_us_(
+          absl::ToInt64Microseconds(absl::GetFlag(FLAGS_fprocess_restart_limit_window))),
+      output_tail_size_(absl::GetFlag(FLAGS_fprocess_output_tail_bytes)),
+      restart_count_(0),
+      crash_loop_(false),
+      timer_deadline_(-1) {}
+
+Supervisor::~Supervisor() {}
+
+void Supervisor::Start(uv_loop_t* uv_loop) {
+    uv_loop_ = uv_loop;
+    timer_.Init(uv_loop, [this] (uv::Timer*) { OnTimerExpired(); });
+}
+
+void Supervisor::ScheduleClose() {
+    DCHECK_IN_EVENT_LOOP_THREAD(uv_loop_);
+    if (closed_) {
+        return;
+    }
+    if (!pending_restarts_.empty()) {
+        HLOG_F(INFO, "Drop {} pending restarts", pending_restarts_.size());
+        pending_restarts_.clear();
+    }
+    timer_.Close();
+    closed_ = true;
+}
+
+void Supervisor::OnFuncProcessExit(int fprocess_id, int client_id, int exit_status,
+                                   std::span<const char> stdout,
+                                   std::span<const char> stderr) {
+    DCHECK_IN_EVENT_LOOP_THREAD(uv_loop_);
+    if (closed_) {
+        return;
+    }
+    int64_t now = GetMonotonicMicroTimestamp();
+    auto tail = [this] (std::span<const char> output) {
+        size_t size = std::min(output.size(), output_tail_size_);
+        return std::string(output.data() + output.size() - size, size);
+    };
+    recent_exits_.push_back(ExitRecord {
+        .fprocess_id = fprocess_id,
+        .client_id = client_id,
+        .exit_status = exit_status,
+        .timestamp = now,
+        .stdout_tail = tail(stdout),
+        .stderr_tail = tail(stderr)
+    });
+    if (recent_exits_.size() > kMaxExitRecords) {
+        recent_exits_.pop_front();
+    }
+    if (!recent_exits_.back().stderr_tail.empty()) {
+        HLOG_F(WARNING, "Stderr tail of fprocess {}:\n{}",
+               fprocess_id, recent_exits_.back().stderr_tail);
+    }
+
+    while (!exit_timestamps_.empty() && exit_timestamps_.front() + crash_loop_window_us_ < now) {
+        exit_timestamps_.pop_front();
+    }
+    exit_timestamps_.push_back(now);
+    bool crash_loop = exit_timestamps_.size() >= crash_loop_threshold_;
+    if (crash_loop && !crash_loop_) {
+        HLOG_F(ERROR, "Func workers are crash looping: {} exits within {}",
+               exit_timestamps_.size(),
+               absl::FormatDuration(absl::GetFlag(FLAGS_fprocess_crash_loop_window)));
+        LogRecentExits();
+    } else if (!crash_loop && crash_loop_) {
+        HLOG(INFO) << "Func workers recovered from crash loop";
+    }
+    crash_loop_ = crash_loop;
+
+    absl::Duration backoff = NextBackoff();
+    HLOG_F(INFO, "Restart func worker of client_id {} in {}",
+           client_id, absl::FormatDuration(backoff));
+    pending_restarts_.emplace(now + absl::ToInt64Microseconds(backoff), client_id);
+    ArmTimer();
+}
+
+absl::Duration Supervisor::NextBackoff() const {
+    // Doubles with each exit within the crash loop window
+    absl::Duration backoff = initial_backoff_;
+    for (size_t i = 1; i < exit_timestamps_.size() && backoff < max_backoff_; i++) {
+        backoff *= 2;
+    }
+    return std::min(backoff, max_backoff_);
+}
+
+void Supervisor::ArmTimer() {
+    if (pending_restarts_.empty()) {
+        return;
+    }
+    int64_t deadline = pending_restarts_.begin()->first;
+    if (timer_deadline_ != -1 && timer_deadline_ <= deadline) {
+        return;
+    }
+    timer_deadline_ = deadline;
+    int64_t delay_us = std::max<int64_t>(deadline - GetMonotonicMicroTimestamp(), 1);
+    timer_.ExpireIn(absl::Microseconds(delay_us));
+}
+
+void Supervisor::OnTimerExpired() {
+    DCHECK_IN_EVENT_LOOP_THREAD(uv_loop_);
+    timer_deadline_ = -1;
+    int64_t now = GetMonotonicMicroTimestamp();
+    while (!restart_timestamps_.empty()
+             && restart_timestamps_.front() + restart_limit_window_us_ < now) {
+        restart_timestamps_.pop_front();
+    }
+    while (!pending_restarts_.empty() && pending_restarts_.begin()->first <= now) {
+        if (max_restarts_ > 0 && restart_timestamps_.size() >= max_restarts_) {
+            // Due restarts wait for the oldest one to leave the window, so
+            // that lost func workers are replaced eventually
+            int64_t deadline = restart_timestamps_.front() + restart_limit_window_us_ + 1;
+            std::vector<int> delayed;
+            while (!pending_restarts_.empty() && pending_restarts_.begin()->first <= now) {
+                delayed.push_back(pending_restarts_.begin()->second);
+                pending_restarts_.erase(pending_restarts_.begin());
+            }
+            HLOG_F(WARNING, "Delay {} restarts by {}, as func workers have been "
+                            "restarted {} times within {}",
+                   delayed.size(), absl::FormatDuration(absl::Microseconds(deadline - now)),
+                   max_restarts_,
+                   absl::FormatDuration(absl::GetFlag(FLAGS_fprocess_restart_limit_window)));
+            for (int client_id : delayed) {
+                pending_restarts_.emplace(deadline, client_id);
+            }
+            break;
+        }
+        int client_id = pending_restarts_.begin()->second;
+        pending_restarts_.erase(pending_restarts_.begin());
+        restart_timestamps_.push_back(now);
+        restart_count_++;
+        engine_connection_->WriteMessage(protocol::MessageHelper::NewFuncWorkerRestart(
+            gsl::narrow_cast<uint16_t>(launcher_->func_id()),
+            gsl::narrow_cast<uint16_t>(client_id), restart_count_, crash_loop_));
+    }
+    ArmTimer();
+}
+
+void Supervisor::LogRecentExits() {
+    for (const ExitRecord& record : recent_exits_) {
+        HLOG_F(WARNING, "fprocess {} (client_id {}) exited with status {} at {}us, "
+                        "stdout tail:\n{}\nstderr tail:\n{}",
+               record.fprocess_id, record.client_id, record.exit_status, record.timestamp,
+               record.stdout_tail, record.stderr_tail);
+    }
+}
+
+}  // namespace launcher
+}  // namespace faas
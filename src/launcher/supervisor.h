@@ -0,0 +1,81 @@
+#pragma once
+
+#include "base/common.h"
+#include "common/protocol.h"
+#include "common/uv.h"
+
+#include <deque>
+#include <map>
+
+namespace faas {
+namespace launcher {
+
+class Launcher;
+class EngineConnection;
+
+// Restarts C++ func workers exiting while the launcher runs. Restarts are
+// delayed with exponential backoff over recent exits, and go through the
+// engine, which creates the replacement with a new client_id. Beyond
+// --fprocess_max_restarts within --fprocess_restart_limit_window, restarts
+// are delayed until earlier ones leave the window.
+class Supervisor : public uv::Base {
+public:
+    static constexpr size_t kMaxExitRecords = 16;
+
+    Supervisor(Launcher* launcher, EngineConnection* engine_connection);
+    ~Supervisor();
+
+    void Start(uv_loop_t* uv_loop);
+    void ScheduleClose();
+
+    void OnFuncProcessExit(int fprocess_id, int client_id, int exit_status,
+                           std::span<const char> stdout, std::span<const char> stderr);
+
+    uint32_t restart_count() const { return restart_count_; }
+    bool crash_loop() const { return crash_loop_; }
+
+    // Recent exits with tails of their outputs, oldest first
+    struct ExitRecord {
+        int fprocess_id;
+        int client_id;
+        int exit_status;
+        int64_t timestamp;  // In microseconds
+        std::string stdout_tail;
+        std::string stderr_tail;
+    };
+    const std::deque<ExitRecord>& recent_exits() const { return recent_exits_; }
+
+private:
+    Launcher* launcher_;
+    EngineConnection* engine_connection_;
+    uv_loop_t* uv_loop_;
+    bool closed_;
+
+    const absl::Duration initial_backoff_;
+    const absl::Duration max_backoff_;
+    const size_t crash_loop_threshold_;
+    const int64_t crash_loop_window_us_;
+    const size_t max_restarts_;
+    const int64_t restart_limit_window_us_;
+    const size_t output_tail_size_;
+
+    uint32_t restart_count_;
+    bool crash_loop_;
+    std::deque<int64_t> exit_timestamps_;  // Within the crash loop window
+    std::deque<int64_t> restart_timestamps_;  // Within the restart limit window
+    std::deque<ExitRecord> recent_exits_;
+
+    std::multimap</* deadline */ int64_t, /* client_id */ int> pending_restarts_;
+    int64_t timer_deadline_;
+    uv::Timer timer_;
+
+    absl::Duration NextBackoff() const;
+    void ArmTimer();
+    void OnTimerExpired();
+    void LogRecentExits();
+
+    DISALLOW_COPY_AND_ASSIGN(Supervisor);
+};
+
+}  // namespace launcher
+}  // namespace faas
@@ -0,0 +1,196 @@
+#include "launcher/zygote.h"
+
+#include "launcher/launcher.h"
+#include "launcher/func_process.h"
+
+#define log_header_ "Zygote: "
+
+namespace faas {
+namespace launcher {
+
+using protocol::ZygoteRequest;
+using protocol::ZygoteRequestType;
+using protocol::ZygoteForkResponse;
+
+Zygote::Zygote(Launcher* launcher)
+    : state_(kCreated), launcher_(launcher), uv_loop_(nullptr),
+      subprocess_(launcher->fprocess()), message_pipe_(nullptr) {
+    message_pipe_fd_ = subprocess_.CreateIpcPipe();
+}
+
+Zygote::~Zygote() {
+    DCHECK(state_ == kCreated || state_ == kClosed);
+    DCHECK(pending_forks_.empty());
+}
+
+bool Zygote::Start(uv_loop_t* uv_loop, utils::BufferPool* read_buffer_pool) {
+    DCHECK(state_ == kCreated);
+    uv_loop_ = uv_loop;
+    FuncProcess::PrepareSubprocess(launcher_, &subprocess_, message_pipe_fd_, "zygote");
+    subprocess_.AddEnvVariable("FAAS_ZYGOTE", 1);
+    // Forked workers append their fprocess_id, as spawned ones have it as name
+    std::string output_prefix = FuncProcess::OutputPathPrefix(launcher_, "");
+    if (!output_prefix.empty()) {
+        subprocess_.AddEnvVariable("FAAS_FORK_OUTPUT_PREFIX", output_prefix);
+    }
+    if (!subprocess_.Start(uv_loop, read_buffer_pool,
+                           absl::bind_front(&Zygote::OnSubprocessExit, this))) {
+        return false;
+    }
+    message_pipe_ = subprocess_.GetPipe(message_pipe_fd_);
+    message_pipe_->data = this;
+    // Fork requests sent before the zygote finishes initialization are
+    // simply buffered in the pipe
+    std::string_view func_config_json = launcher_->func_config_json();
+    initial_payload_size_ = gsl::narrow_cast<uint32_t>(func_config_json.size());
+    uv_buf_t bufs[2];
+    bufs[0] = {.base = reinterpret_cast<char*>(&initial_payload_size_), .len = sizeof(uint32_t)};
+    bufs[1] = {.base = const_cast<char*>(func_config_json.data()), .len = func_config_json.size()};
+    uv_write_t* write_req = launcher_->NewWriteRequest();
+    write_req->data = nullptr;
+    UV_DCHECK_OK(uv_write(write_req, UV_AS_STREAM(message_pipe_), bufs, 2,
+                          &Zygote::SendMessageCallback));
+    UV_DCHECK_OK(uv_read_start(UV_AS_STREAM(message_pipe_),
+                               &Zygote::BufferAllocCallback, &Zygote::ReadMessageCallback));
+    HLOG(INFO) << "Started with pid " << subprocess_.pid();
+    state_ = kRunning;
+    return true;
+}
+
+void Zygote::ScheduleClose() {
+    DCHECK_IN_EVENT_LOOP_THREAD(uv_loop_);
+    if (state_ != kRunning) {
+        return;
+    }
+    state_ = kClosing;
+    subprocess_.Kill();
+}
+
+void Zygote::Fork(int fprocess_id, int client_id, ForkCallback cb) {
+    DCHECK_IN_EVENT_LOOP_THREAD(uv_loop_);
+    if (state_ != kRunning) {
+        HLOG(ERROR) << "Not running, cannot fork";
+        cb(nullptr, -1);
+        return;
+    }
+    DCHECK(!pending_forks_.contains(fprocess_id));
+    pending_forks_[fprocess_id] = std::move(cb);
+    SendRequest(ZygoteRequest {
+        .type = ZygoteRequestType::FORK,
+        .fprocess_id = fprocess_id,
+        .client_id = client_id,
+        .pid = -1
+    });
+}
+
+void Zygote::Kill(int fprocess_id, int pid) {
+    DCHECK_IN_EVENT_LOOP_THREAD(uv_loop_);
+    if (state_ != kRunning) {
+        // Without the zygote, its pid may have been reused
+        HLOG(WARNING) << "Not running, cannot kill fprocess " << fprocess_id;
+        return;
+    }
+    SendRequest(ZygoteRequest {
+        .type = ZygoteRequestType::KILL,
+        .fprocess_id = fprocess_id,
+        .client_id = -1,
+        .pid = pid
+    });
+}
+
+void Zygote::SendRequest(const ZygoteRequest& request) {
+    uv_buf_t buf;
+    launcher_->NewWriteBuffer(&buf);
+    DCHECK_LE(sizeof(ZygoteRequest), buf.len);
+    memcpy(buf.base, &request, sizeof(ZygoteRequest));
+    buf.len = sizeof(ZygoteRequest);
+    uv_write_t* write_req = launcher_->NewWriteRequest();
+    write_req->data = buf.base;
+    UV_DCHECK_OK(uv_write(write_req, UV_AS_STREAM(message_pipe_), &buf, 1,
+                          &Zygote::SendMessageCallback));
+}
+
+void Zygote::OnForkResponse(const ZygoteForkResponse& response) {
+    auto iter = pending_forks_.find(response.fprocess_id);
+    if (iter == pending_forks_.end()) {
+        HLOG(FATAL) << "Cannot find pending fork for fprocess " << response.fprocess_id;
+    }
+    ForkCallback cb = std::move(iter->second);
+    pending_forks_.erase(iter);
+    if (response.pid == -1) {
+        HLOG(ERROR) << "Failed to fork fprocess " << response.fprocess_id;
+        cb(nullptr, -1);
+        return;
+    }
+    // The message pipe arrives no later than the first byte of the response
+    if (uv_pipe_pending_count(message_pipe_) == 0) {
+        HLOG(FATAL) << "Message pipe of fprocess " << response.fprocess_id << " not received";
+    }
+    DCHECK(uv_pipe_pending_type(message_pipe_) == UV_NAMED_PIPE);
+    uv_pipe_t* worker_pipe = reinterpret_cast<uv_pipe_t*>(malloc(sizeof(uv_pipe_t)));
+    UV_DCHECK_OK(uv_pipe_init(uv_loop_, worker_pipe, 0));
+    UV_DCHECK_OK(uv_accept(UV_AS_STREAM(message_pipe_), UV_AS_STREAM(worker_pipe)));
+    HVLOG(1) << "Forked fprocess " << response.fprocess_id << " with pid " << response.pid;
+    cb(worker_pipe, response.pid);
+}
+
+void Zygote::OnSubprocessExit(int exit_status, std::span<const char> stdout,
+                              std::span<const char> stderr) {
+    DCHECK_IN_EVENT_LOOP_THREAD(uv_loop_);
+    if (state_ != kClosing) {
+        HLOG(WARNING) << "Exits unexpectedly with code: " << exit_status;
+    }
+    state_ = kClosed;
+    auto pending_forks = std::move(pending_forks_);
+    pending_forks_.clear();
+    for (auto& [fprocess_id, cb] : pending_forks) {
+        cb(nullptr, -1);
+    }
+    launcher_->OnZygoteExit();
+}
+
+UV_ALLOC_CB_FOR_CLASS(Zygote, BufferAlloc) {
+    launcher_->NewReadBuffer(suggested_size, buf);
+}
+
+UV_READ_CB_FOR_CLASS(Zygote, ReadMessage) {
+    auto reclaim_resource = gsl::finally([this, buf] {
+        if (buf->base != 0) {
+            launcher_->ReturnReadBuffer(buf);
+        }
+    });
+    if (nread < 0) {
+        if (nread != UV_EOF) {
+            HLOG(WARNING) << "Read error on message pipe: "
+                          << uv_strerror(static_cast<int>(nread));
+        }
+        // Pipe handles are closed by subprocess_ once the zygote exits
+        UV_DCHECK_OK(uv_read_stop(UV_AS_STREAM(message_pipe_)));
+        return;
+    }
+    if (nread == 0) {
+        return;
+    }
+    utils::ReadMessages<ZygoteForkResponse>(
+        &read_buffer_, buf->base, static_cast<size_t>(nread),
+        [this] (ZygoteForkResponse* response) {
+            OnForkResponse(*response);
+        });
+}
+
+UV_WRITE_CB_FOR_CLASS(Zygote, SendMessage) {
+    auto reclaim_resource = gsl::finally([this, req] {
+        if (req->data != nullptr) {
+            launcher_->ReturnWriteBuffer(reinterpret_cast<char*>(req->data));
+        }
+        launcher_->ReturnWriteRequest(req);
+    });
+    if (status != 0) {
+        HLOG(WARNING) << "Failed to send message, will kill the zygote: "
+                      << uv_strerror(status);
+        ScheduleClose();
+    }
+}
+
+}  // namespace launcher
+}  // namespace faas
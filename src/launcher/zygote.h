@@ -0,0 +1,61 @@
+#pragma once
+
+#include "base/common.h"
+#include "common/protocol.h"
+#include "common/uv.h"
+#include "common/subprocess.h"
+#include "utils/appendable_buffer.h"
+#include "utils/buffer_pool.h"
+
+namespace faas {
+namespace launcher {
+
+class Launcher;
+
+// Template process of the C++ func worker, which has loaded and initialized
+// the function library. New func workers are forked from it, skipping the
+// cold start of a fresh process.
+class Zygote : public uv::Base {
+public:
+    explicit Zygote(Launcher* launcher);
+    ~Zygote();
+
+    bool Start(uv_loop_t* uv_loop, utils::BufferPool* read_buffer_pool);
+    void ScheduleClose();
+
+    // `cb` receives the message pipe of the forked worker, owned by the
+    // caller afterwards, or nullptr if the fork fails
+    using ForkCallback = std::function<void(uv_pipe_t* /* message_pipe */, int /* pid */)>;
+    void Fork(int fprocess_id, int client_id, ForkCallback cb);
+    // Kills a worker forked for `fprocess_id`, if it has not exited
+    void Kill(int fprocess_id, int pid);
+
+private:
+    enum State { kCreated, kRunning, kClosing, kClosed };
+
+    State state_;
+    Launcher* launcher_;
+
+    uv_loop_t* uv_loop_;
+    uv::Subprocess subprocess_;
+    int message_pipe_fd_;
+    uv_pipe_t* message_pipe_;
+    uint32_t initial_payload_size_;
+
+    utils::AppendableBuffer read_buffer_;
+    absl::flat_hash_map</* fprocess_id */ int, ForkCallback> pending_forks_;
+
+    void SendRequest(const protocol::ZygoteRequest& request);
+    void OnForkResponse(const protocol::ZygoteForkResponse& response);
+    void OnSubprocessExit(int exit_status, std::span<const char> stdout,
+                          std::span<const char> stderr);
+
+    DECLARE_UV_ALLOC_CB_FOR_CLASS(BufferAlloc);
+    DECLARE_UV_READ_CB_FOR_CLASS(ReadMessage);
+    DECLARE_UV_WRITE_CB_FOR_CLASS(SendMessage);
+
+    DISALLOW_COPY_AND_ASSIGN(Zygote);
+};
+
+}  // namespace launcher
+}  // namespace faas
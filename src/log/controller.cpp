@@ -1,5 +1,6 @@
 #include "log/controller.h"
 
+#include "common/time.h"
 #include "log/flags.h"
 #include "utils/random.h"
 #include "utils/bits.h"
@@ -18,8 +19,14 @@ Controller::Controller(uint32_t random_seed)
       userlog_replicas_(kDefaultNumReplicas),
       index_replicas_(kDefaultNumReplicas),
       state_(kCreated),
+      planned_reconfig_(absl::GetFlag(FLAGS_slog_planned_reconfig)),
+      load_aware_placement_(absl::GetFlag(FLAGS_slog_load_aware_placement)),
       zk_session_(absl::GetFlag(FLAGS_zookeeper_host),
-                  absl::GetFlag(FLAGS_zookeeper_root_path)) {
+                  absl::GetFlag(FLAGS_zookeeper_root_path)),
+      freeze_timestamp_(0),
+      tail_fetch_timer_thread_(
+          "TailFetchTimer", absl::bind_front(&Controller::TailFetchTimerThreadMain, this)),
+      tail_fetch_pending_(false) {
     LOG_F(INFO, "Random seed is {}", bits::HexStr0x(random_seed));
 }
 
@@ -44,13 +51,41 @@ void Controller::Start() {
     freeze_watcher_->SetNodeCreatedCallback(
         absl::bind_front(&Controller::OnFreezeZNodeCreated, this));
     freeze_watcher_->Start();
+    if (load_aware_placement_) {
+        // Sequencers publish log space loads within this directory
+        zk_session_.Create(
+            "load", EMPTY_CHAR_SPAN, zk::ZKCreateMode::kPersistent,
+            [] (zk::ZKStatus status, const zk::ZKResult& result, bool*) {
+                if (!status.ok() && !status.IsNodeExist()) {
+                    HLOG(FATAL) << "Failed to create load directory: " << status.ToString();
+                }
+            }
+        );
+        load_watcher_.emplace(&zk_session_, "load");
+        load_watcher_->SetNodeCreatedCallback(
+            absl::bind_front(&Controller::OnLoadZNodeUpdated, this));
+        load_watcher_->SetNodeChangedCallback(
+            absl::bind_front(&Controller::OnLoadZNodeUpdated, this));
+        load_watcher_->SetNodeDeletedCallback([this] (std::string_view path) {
+            int sequencer_id;
+            if (absl::SimpleAtoi(path, &sequencer_id)) {
+                log_space_loads_.erase(gsl::narrow_cast<uint16_t>(sequencer_id));
+            }
+        });
+        load_watcher_->Start();
+    }
+    tail_fetch_timer_thread_.Start();
 }
 
 void Controller::ScheduleStop() {
+    if (!stop_tail_fetch_timer_.HasBeenNotified()) {
+        stop_tail_fetch_timer_.Notify();
+    }
     zk_session_.ScheduleStop();
 }
 
 void Controller::WaitForFinish() {
+    tail_fetch_timer_thread_.Join();
     zk_session_.WaitForFinish();
 }
 
@@ -61,14 +96,22 @@ void Controller::InstallNewView(const ViewProto& view_proto) {
     views_.emplace_back(view);
     std::string serialized;
     CHECK(view_proto.SerializeToString(&serialized));
+    int64_t freeze_timestamp = freeze_timestamp_;
+    freeze_timestamp_ = 0;
     zk_session_.Create(
         "view/new", STRING_AS_SPAN(serialized),
         zk::ZKCreateMode::kPersistentSequential,
-        [view] (zk::ZKStatus status, const zk::ZKResult& result, bool*) {
+        [view, freeze_timestamp] (zk::ZKStatus status, const zk::ZKResult& result, bool*) {
             if (!status.ok()) {
                 HLOG(FATAL) << "Failed to publish the new view: " << status.ToString();
             }
             HLOG_F(INFO, "View {} is published as {}", view->id(), result.path);
+            if (freeze_timestamp > 0) {
+                // Appends are rejected by engines from freezing the previous
+                // view until they see this view
+                HLOG_F(INFO, "Append stall of reconfiguration to view {}: {} us",
+                       view->id(), GetMonotonicMicroTimestamp() - freeze_timestamp);
+            }
         }
     );
     state_ = kNormal;
@@ -93,6 +136,9 @@ void Controller::ReconfigView(const Configuration& configuration) {
         DCHECK(!views_.empty());
         DCHECK(!pending_reconfig_.has_value());
         pending_reconfig_ = configuration;
+        if (planned_reconfig_) {
+            StageView(BuildViewProto(configuration));
+        }
         FreezeView(current_view());
         return;
     }
@@ -102,6 +148,10 @@ void Controller::ReconfigView(const Configuration& configuration) {
         return;
     }
 
+    InstallNewView(BuildViewProto(configuration));
+}
+
+ViewProto Controller::BuildViewProto(const Configuration& configuration) {
     ViewProto view_proto;
     view_proto.set_view_id(next_view_id());
     view_proto.set_metalog_replicas(gsl::narrow_cast<uint32_t>(metalog_replicas_));
@@ -133,8 +183,54 @@ void Controller::ReconfigView(const Configuration& configuration) {
     for (size_t i = 0; i < num_sequencers * index_replicas_; i++) {
         view_proto.add_index_plan(configuration.engine_nodes.at(i % num_engines));
     }
+    if (load_aware_placement_) {
+        PlaceLogSpaces(&view_proto);
+    }
+    return view_proto;
+}
 
-    InstallNewView(view_proto);
+void Controller::PlaceLogSpaces(ViewProto* view_proto) {
+    // A user logspace moved across phylogs may show up in reports from both
+    // sequencers for a while, so take the larger rate instead of the sum
+    log_utils::LogSpaceLoads loads;
+    for (const auto& [sequencer_id, sequencer_loads] : log_space_loads_) {
+        for (const auto& [user_logspace, rate] : sequencer_loads) {
+            loads[user_logspace] = std::max(loads[user_logspace], rate);
+        }
+    }
+    if (loads.empty()) {
+        return;
+    }
+    View hashed_view(*view_proto);
+    auto placement = log_utils::PlaceLogSpacesByLoad(
+        &hashed_view, loads, absl::GetFlag(FLAGS_slog_max_placed_log_spaces));
+    for (const auto& [user_logspace, sequencer_id] : placement) {
+        view_proto->add_placed_log_spaces(user_logspace);
+        view_proto->add_placed_sequencers(sequencer_id);
+    }
+    HLOG_F(INFO, "Place {} of {} user log spaces away from hashed phylogs",
+           placement.size(), loads.size());
+}
+
+void Controller::StageView(const ViewProto& view_proto) {
+    DCHECK_EQ(gsl::narrow_cast<uint16_t>(view_proto.view_id()),
+              next_view_id());
+    staged_view_ = view_proto;
+    std::string serialized;
+    CHECK(view_proto.SerializeToString(&serialized));
+    uint32_t view_id = view_proto.view_id();
+    // Published before the freeze znode, so all nodes see the staged view
+    // before the current one gets frozen
+    zk_session_.Create(
+        "view/staged", STRING_AS_SPAN(serialized),
+        zk::ZKCreateMode::kPersistentSequential,
+        [view_id] (zk::ZKStatus status, const zk::ZKResult& result, bool*) {
+            if (!status.ok()) {
+                HLOG(FATAL) << "Failed to stage the new view: " << status.ToString();
+            }
+            HLOG_F(INFO, "View {} is staged as {}", view_id, result.path);
+        }
+    );
 }
 
 void Controller::FreezeView(const View* view) {
@@ -145,10 +241,12 @@ void Controller::FreezeView(const View* view) {
     for (uint16_t sequencer_id : view->GetSequencerNodes()) {
         if (view->is_active_phylog(sequencer_id)) {
             seal.phylogs.push_back(sequencer_id);
+            seal.phylog_seals[sequencer_id] = std::make_unique<log_utils::PhylogSeal>();
         }
     }
-    seal.tail_metalogs.clear();
-    ongoing_seal_ = seal;
+    seal.merged_tails.clear();
+    ongoing_seal_ = std::move(seal);
+    freeze_timestamp_ = GetMonotonicMicroTimestamp();
 
     std::string data = fmt::format("{}", view->id());
     zk_session_.Create(
@@ -165,46 +263,131 @@ void Controller::FreezeView(const View* view) {
 }
 
 namespace {
-void BuildFinalTailMetalog(const std::vector<MetaLogsProto> tail_metalogs,
-                           uint32_t* final_position, MetaLogsProto* final_tail) {
-    std::map<uint32_t, MetaLogProto> entries;
-    for (const MetaLogsProto& metalogs : tail_metalogs) {
-        DCHECK_EQ(metalogs.logspace_id(), final_tail->logspace_id());
-        for (const MetaLogProto& metalog : metalogs.metalogs()) {
-            entries[metalog.metalog_seqnum()] = metalog;
-        }
-    }
-    *final_position = 0;
-    for (const auto& [metalog_seqnum, metalog] : entries) {
-        final_tail->add_metalogs()->CopyFrom(metalog);
-        *final_position = metalog_seqnum + 1;
+uint32_t FinalMetalogPosition(const MetaLogsProto& final_tail) {
+    if (final_tail.metalogs().empty()) {
+        return 0;
     }
+    return final_tail.metalogs().rbegin()->metalog_seqnum() + 1;
 }
 }  // namespace
 
-std::optional<FinalizedViewProto> Controller::CheckAllSealed(const OngoingSeal& seal) {
+std::optional<FinalizedViewProto> Controller::CheckAllSealed(OngoingSeal* seal,
+                                                             TailFetches* fetches) {
     FinalizedViewProto finalized_view_proto;
-    finalized_view_proto.set_view_id(seal.view->id());
-    for (uint16_t sequencer_id : seal.phylogs) {
-        std::vector<MetaLogsProto> collected;
-        for (const auto& [key, value] : seal.tail_metalogs) {
-            if (key.first == sequencer_id) {
-                collected.push_back(value);
-            }
+    finalized_view_proto.set_view_id(seal->view->id());
+    size_t quorum = (seal->view->metalog_replicas() + 1) / 2;
+    bool all_sealed = true;
+    for (uint16_t sequencer_id : seal->phylogs) {
+        uint32_t logspace_id = bits::JoinTwo16(seal->view->id(), sequencer_id);
+        if (seal->merged_tails.contains(sequencer_id)) {
+            const MetaLogsProto& merged_tail = seal->merged_tails.at(sequencer_id);
+            finalized_view_proto.add_tail_metalogs()->CopyFrom(merged_tail);
+            finalized_view_proto.add_metalog_positions(FinalMetalogPosition(merged_tail));
+            continue;
+        }
+        log_utils::PhylogSeal* phylog_seal = seal->phylog_seals.at(sequencer_id).get();
+        std::optional<uint16_t> fetch_source;
+        const MetaLogsProto* final_tail = phylog_seal->PickFinalTail(quorum, &fetch_source);
+        if (fetch_source.has_value()) {
+            (*fetches)[*fetch_source].push_back(logspace_id);
         }
-        size_t quorum = (seal.view->metalog_replicas() + 1) / 2;
-        if (collected.size() < quorum) {
-            return std::nullopt;
+        if (final_tail == nullptr) {
+            all_sealed = false;
+            continue;
         }
-        uint32_t final_position;
-        MetaLogsProto* final_tail = finalized_view_proto.add_tail_metalogs();
-        final_tail->set_logspace_id(bits::JoinTwo16(seal.view->id(), sequencer_id));
-        BuildFinalTailMetalog(collected, &final_position, final_tail);
-        finalized_view_proto.add_metalog_positions(final_position);
+        finalized_view_proto.add_tail_metalogs()->CopyFrom(*final_tail);
+        finalized_view_proto.add_metalog_positions(FinalMetalogPosition(*final_tail));
+    }
+    if (!all_sealed) {
+        return std::nullopt;
     }
     return finalized_view_proto;
 }
 
+void Controller::FetchTails(const View* view, const TailFetches& fetches) {
+    for (const auto& [sequencer_id, logspace_ids] : fetches) {
+        TailFetchProto tail_fetch_proto;
+        tail_fetch_proto.set_view_id(view->id());
+        tail_fetch_proto.set_sequencer_id(sequencer_id);
+        for (uint32_t logspace_id : logspace_ids) {
+            tail_fetch_proto.add_logspace_ids(logspace_id);
+        }
+        std::string serialized;
+        CHECK(tail_fetch_proto.SerializeToString(&serialized));
+        zk_session_.Create(
+            "view/fetch_tail", STRING_AS_SPAN(serialized),
+            zk::ZKCreateMode::kPersistentSequential,
+            [view, sequencer_id = sequencer_id, this] (zk::ZKStatus status,
+                                                       const zk::ZKResult& result, bool*) {
+                if (!status.ok()) {
+                    HLOG(FATAL) << "Failed to publish tail fetch: " << status.ToString();
+                }
+                HLOG_F(INFO, "Fetch tails of view {} from sequencer {} as {}",
+                       view->id(), sequencer_id, result.path);
+                tail_fetch_znodes_.push_back(std::string(result.path));
+            }
+        );
+    }
+    if (!fetches.empty()) {
+        tail_fetch_pending_.store(true, std::memory_order_relaxed);
+    }
+}
+
+void Controller::AbortTailFetches(std::optional<uint16_t> offline_sequencer) {
+    if (!ongoing_seal_.has_value()) {
+        return;
+    }
+    int64_t now = GetMonotonicMicroTimestamp();
+    int64_t timeout_us = int64_t{absl::GetFlag(FLAGS_slog_seal_tail_fetch_timeout_ms)} * 1000;
+    bool aborted = false;
+    for (const auto& [sequencer_id, phylog_seal] : ongoing_seal_->phylog_seals) {
+        auto source = phylog_seal->pending_fetch();
+        if (!source.has_value()) {
+            continue;
+        }
+        if (offline_sequencer.has_value()) {
+            if (*source != *offline_sequencer) {
+                continue;
+            }
+            HLOG_F(WARNING, "Sequencer {} goes offline when fetching the tail of phylog {}",
+                   *source, sequencer_id);
+        } else {
+            if (timeout_us <= 0 || now - phylog_seal->fetch_timestamp() < timeout_us) {
+                continue;
+            }
+            HLOG_F(WARNING, "Sequencer {} does not answer the tail fetch of phylog {} "
+                            "within {} ms",
+                   *source, sequencer_id, timeout_us / 1000);
+        }
+        phylog_seal->AbortFetch();
+        aborted = true;
+    }
+    if (aborted) {
+        ContinueSeal();
+    }
+}
+
+void Controller::TailFetchTimerThreadMain() {
+    int timeout_ms = absl::GetFlag(FLAGS_slog_seal_tail_fetch_timeout_ms);
+    if (timeout_ms <= 0) {
+        stop_tail_fetch_timer_.WaitForNotification();
+        return;
+    }
+    absl::Duration interval = absl::Milliseconds(timeout_ms) / 4;
+    while (!stop_tail_fetch_timer_.WaitForNotificationWithTimeout(interval)) {
+        if (!tail_fetch_pending_.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        // Callbacks of ZKSession ops run within its event loop thread
+        zk_session_.Exists(
+            "view", nullptr,
+            [this] (zk::ZKStatus status, const zk::ZKResult& result, bool*) {
+                AbortTailFetches(/* offline_sequencer= */ std::nullopt);
+            }
+        );
+    }
+}
+
 void Controller::OnNodeOnline(NodeWatcher::NodeType node_type, uint16_t node_id) {
     switch (node_type) {
     case NodeWatcher::kSequencerNode:
@@ -225,6 +408,7 @@ void Controller::OnNodeOffline(NodeWatcher::NodeType node_type, uint16_t node_id
     switch (node_type) {
     case NodeWatcher::kSequencerNode:
         sequencer_nodes_.erase(node_id);
+        AbortTailFetches(node_id);
         break;
     case NodeWatcher::kEngineNode:
         engine_nodes_.erase(node_id);
@@ -245,6 +429,8 @@ void Controller::OnCmdZNodeCreated(std::string_view path,
         InfoCommandHandler();
     } else if (path == "reconfig") {
         ReconfigCommandHandler(std::string(contents.data(), contents.size()));
+    } else if (path == "rebalance") {
+        RebalanceCommandHandler();
     } else {
         HLOG(ERROR) << "Unknown command: " << path;
     }
@@ -332,6 +518,19 @@ void Controller::InfoCommandHandler() {
             stream << storage_id << ", ";
         }
         stream << "]\n";
+        stream << "  PlacedLogSpaces = " << view->num_placed_log_spaces() << "\n";
+    }
+
+    if (!log_space_loads_.empty()) {
+        stream << "Reported append rates:\n";
+        for (const auto& [sequencer_id, loads] : log_space_loads_) {
+            double total = 0;
+            for (const auto& [user_logspace, rate] : loads) {
+                total += rate;
+            }
+            stream << fmt::format("  Sequencer[{}]: {:.1f} appends/s over {} log spaces",
+                                  sequencer_id, total, loads.size()) << "\n";
+        }
     }
 
     LOG(INFO) << "\n[START PRINTING INFO]\n"
@@ -405,6 +604,57 @@ void Controller::ReconfigCommandHandler(std::string inputs) {
     ReconfigView(configuration);
 }
 
+void Controller::RebalanceCommandHandler() {
+    if (state_ != kNormal) {
+        HLOG(ERROR) << "Not in normal state, cannot rebalance";
+        return;
+    }
+    if (!load_aware_placement_) {
+        HLOG(ERROR) << "Load-aware placement is not enabled";
+        return;
+    }
+    // Same nodes and hashed mapping, only the placement is recomputed
+    const View* view = current_view();
+    Configuration configuration;
+    configuration.log_space_hash_seed = view->log_space_hash_seed();
+    configuration.log_space_hash_tokens.assign(
+        view->log_space_hash_tokens().begin(),
+        view->log_space_hash_tokens().end());
+    configuration.num_phylogs = view->num_phylogs();
+    configuration.sequencer_nodes.assign(
+        view->GetSequencerNodes().begin(),
+        view->GetSequencerNodes().end());
+    configuration.engine_nodes.assign(
+        view->GetEngineNodes().begin(),
+        view->GetEngineNodes().end());
+    configuration.storage_nodes.assign(
+        view->GetStorageNodes().begin(),
+        view->GetStorageNodes().end());
+    ReconfigView(configuration);
+}
+
+void Controller::OnLoadZNodeUpdated(std::string_view path,
+                                    std::span<const char> contents) {
+    LogSpaceLoadProto load_proto;
+    if (!load_proto.ParseFromArray(contents.data(),
+                                   static_cast<int>(contents.size()))) {
+        HLOG(ERROR) << "Failed to parse LogSpaceLoadProto";
+        return;
+    }
+    if (load_proto.user_logspaces_size() != load_proto.append_rates_size()) {
+        HLOG(ERROR) << "Malformed LogSpaceLoadProto";
+        return;
+    }
+    uint16_t sequencer_id = gsl::narrow_cast<uint16_t>(load_proto.sequencer_id());
+    log_utils::LogSpaceLoads& loads = log_space_loads_[sequencer_id];
+    loads.clear();
+    for (int i = 0; i < load_proto.user_logspaces_size(); i++) {
+        loads[load_proto.user_logspaces(i)] = load_proto.append_rates(i);
+    }
+    HVLOG_F(1, "Sequencer {} reports loads of {} user log spaces",
+            sequencer_id, loads.size());
+}
+
 void Controller::OnFreezeZNodeCreated(std::string_view path,
                                       std::span<const char> contents) {
     if (!ongoing_seal_.has_value()) {
@@ -421,33 +671,85 @@ void Controller::OnFreezeZNodeCreated(std::string_view path,
     }
     HLOG_F(INFO, "Receive seal response from sequencer {} for view {}",
            frozen_proto.sequencer_id(), view->id());
+    uint16_t replica_id = gsl::narrow_cast<uint16_t>(frozen_proto.sequencer_id());
     for (const auto& tail_metalogs : frozen_proto.tail_metalogs()) {
-        auto key = std::make_pair(tail_metalogs.logspace_id(), frozen_proto.sequencer_id());
-        ongoing_seal_->tail_metalogs[key] = tail_metalogs;
+        uint16_t sequencer_id = bits::LowHalf32(tail_metalogs.logspace_id());
+        if (frozen_proto.merged()) {
+            ongoing_seal_->merged_tails[sequencer_id] = tail_metalogs;
+            continue;
+        }
+        auto iter = ongoing_seal_->phylog_seals.find(sequencer_id);
+        if (iter == ongoing_seal_->phylog_seals.end()) {
+            continue;
+        }
+        if (!frozen_proto.fetched()) {
+            iter->second->AddReport(log_utils::BuildSealReport(replica_id, tail_metalogs));
+        }
+        iter->second->AddTail(replica_id, tail_metalogs);
+    }
+    for (const auto& tail_digest : frozen_proto.tail_digests()) {
+        uint16_t sequencer_id = bits::LowHalf32(tail_digest.logspace_id());
+        auto iter = ongoing_seal_->phylog_seals.find(sequencer_id);
+        if (iter == ongoing_seal_->phylog_seals.end()) {
+            continue;
+        }
+        iter->second->AddReport(log_utils::SealReport {
+            .sequencer_id     = replica_id,
+            .metalog_position = tail_digest.metalog_position(),
+            .digest           = tail_digest.digest(),
+        });
     }
-    auto sealed = CheckAllSealed(*ongoing_seal_);
+    ContinueSeal();
+}
+
+void Controller::ContinueSeal() {
+    DCHECK(ongoing_seal_.has_value());
+    const View* view = ongoing_seal_->view;
+    TailFetches fetches;
+    auto sealed = CheckAllSealed(&ongoing_seal_.value(), &fetches);
     if (!sealed.has_value()) {
+        FetchTails(view, fetches);
         return;
     }
     ongoing_seal_.reset();
+    tail_fetch_pending_.store(false, std::memory_order_relaxed);
     HLOG_F(INFO, "Finish sealing for view {}", view->id());
     FinalizedViewProto finalized_view = *sealed;
     std::string serialized;
     CHECK(finalized_view.SerializeToString(&serialized));
+    bool planned = staged_view_.has_value();
     zk_session_.Create(
         "view/finalize", STRING_AS_SPAN(serialized),
         zk::ZKCreateMode::kPersistentSequential,
-        [view, this] (zk::ZKStatus status, const zk::ZKResult& result, bool*) {
+        [view, planned, this] (zk::ZKStatus status, const zk::ZKResult& result, bool*) {
             if (!status.ok()) {
                 HLOG(FATAL) << "Failed to publish the new finalized view: " << status.ToString();
             }
             HLOG_F(INFO, "Finalized view {} is published as {}", view->id(), result.path);
+            // Ops of one session complete in order, so callbacks of all tail
+            // fetches of this seal have run
+            for (const std::string& path : tail_fetch_znodes_) {
+                zk_session_.Delete(path, nullptr);
+            }
+            tail_fetch_znodes_.clear();
+            if (planned) {
+                return;
+            }
             state_ = kFrozen;
             Configuration configuration = *pending_reconfig_;
             pending_reconfig_.reset();
             ReconfigView(configuration);
         }
     );
+    if (planned) {
+        // ZooKeeper applies operations of one session in order, so the staged
+        // view can be installed right away, without waiting for the finalized
+        // view to be published
+        ViewProto view_proto = std::move(*staged_view_);
+        staged_view_.reset();
+        pending_reconfig_.reset();
+        InstallNewView(view_proto);
+    }
 }
 
 }  // namespace log
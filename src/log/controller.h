@@ -5,6 +5,7 @@
 #include "common/zk_utils.h"
 #include "server/node_watcher.h"
 #include "log/view.h"
+#include "log/utils.h"
 
 #include <random>
 
@@ -38,15 +39,22 @@ private:
     size_t num_phylogs_;
 
     State state_;
+    const bool planned_reconfig_;
+    const bool load_aware_placement_;
 
     zk::ZKSession zk_session_;
     server::NodeWatcher node_watcher_;
     std::optional<zk_utils::DirWatcher> cmd_watcher_;
     std::optional<zk_utils::DirWatcher> freeze_watcher_;
+    std::optional<zk_utils::DirWatcher> load_watcher_;
 
     uint64_t log_space_hash_seed_;
     std::vector<uint32_t> log_space_hash_tokens_;
 
+    // Latest append rates of user logspaces reported by each sequencer
+    absl::flat_hash_map</* sequencer_id */ uint16_t, log_utils::LogSpaceLoads>
+        log_space_loads_;
+
     std::set</* node_id */ uint16_t> sequencer_nodes_;
     std::set</* node_id */ uint16_t> engine_nodes_;
     std::set</* node_id */ uint16_t> storage_nodes_;
@@ -64,15 +72,30 @@ private:
         NodeIdVec storage_nodes;
     };
     std::optional<Configuration> pending_reconfig_;
+    // With planned reconfiguration, the next view is published as staged
+    // before freezing the current one
+    std::optional<ViewProto> staged_view_;
+    int64_t freeze_timestamp_;
 
     struct OngoingSeal {
         const View* view;
         std::vector<uint16_t> phylogs;
-        absl::flat_hash_map<std::pair<uint16_t, uint16_t>,
-                            MetaLogsProto>
-            tail_metalogs;
+        absl::flat_hash_map</* sequencer_id */ uint16_t,
+                            std::unique_ptr<log_utils::PhylogSeal>> phylog_seals;
+        // Phylogs sealed by a tail merged from a quorum of replicas
+        absl::flat_hash_map<uint16_t, MetaLogsProto> merged_tails;
     };
     std::optional<OngoingSeal> ongoing_seal_;
+    // view/fetch_tail znodes published for the ongoing seal, deleted once
+    // the view is finalized
+    std::vector<std::string> tail_fetch_znodes_;
+
+    // Tail fetches not completed within `slog_seal_tail_fetch_timeout_ms`
+    // fall back to the next agreeing replica. The timer thread only wakes up
+    // the event loop of `zk_session_`, where seal states are accessed.
+    base::Thread tail_fetch_timer_thread_;
+    absl::Notification stop_tail_fetch_timer_;
+    std::atomic<bool> tail_fetch_pending_;
 
     inline uint16_t next_view_id() const {
         return gsl::narrow_cast<uint16_t>(views_.size());
@@ -81,21 +104,37 @@ private:
         return views_.empty() ? nullptr : views_.back().get();
     }
 
+    ViewProto BuildViewProto(const Configuration& configuration);
+    void PlaceLogSpaces(ViewProto* view_proto);
     void InstallNewView(const ViewProto& view_proto);
     void ReconfigView(const Configuration& configuration);
+    void StageView(const ViewProto& view_proto);
     void FreezeView(const View* view);
 
-    std::optional<FinalizedViewProto> CheckAllSealed(const OngoingSeal& seal);
+    using TailFetches = absl::flat_hash_map</* sequencer_id */ uint16_t,
+                                            std::vector</* logspace_id */ uint32_t>>;
+    // Tails not yet available are added to `fetches`
+    std::optional<FinalizedViewProto> CheckAllSealed(OngoingSeal* seal,
+                                                     TailFetches* fetches);
+    void FetchTails(const View* view, const TailFetches& fetches);
+    // Seals the view if all phylogs are sealed, otherwise publishes tail fetches
+    void ContinueSeal();
+    // Aborts tail fetches from `offline_sequencer`, or past the deadline if
+    // not given
+    void AbortTailFetches(std::optional<uint16_t> offline_sequencer);
+    void TailFetchTimerThreadMain();
 
     void OnNodeOnline(server::NodeWatcher::NodeType node_type, uint16_t node_id);
     void OnNodeOffline(server::NodeWatcher::NodeType node_type, uint16_t node_id);
 
     void OnCmdZNodeCreated(std::string_view path, std::span<const char> contents);
     void OnFreezeZNodeCreated(std::string_view path, std::span<const char> contents);
+    void OnLoadZNodeUpdated(std::string_view path, std::span<const char> contents);
 
     void StartCommandHandler();
     void InfoCommandHandler();
     void ReconfigCommandHandler(std::string inputs);
+    void RebalanceCommandHandler();
 
     DISALLOW_COPY_AND_ASSIGN(Controller);
 };
@@ -1,6 +1,7 @@
 #include "log/db.h"
 
 #include "utils/bits.h"
+#include "utils/fs.h"
 
 __BEGIN_THIRD_PARTY_HEADERS
 
@@ -37,16 +38,91 @@ ABSL_FLAG(bool, rocksdb_enable_compression, false, "");
 
 namespace faas { namespace log {
 
+namespace {
+rocksdb::ColumnFamilyOptions
+LogSpaceCFOptions()
+{
+    rocksdb::ColumnFamilyOptions options;
+    if (absl::GetFlag(FLAGS_rocksdb_enable_compression)) {
+        options.compression = rocksdb::kZSTD;
+    } else {
+        options.compression = rocksdb::kNoCompression;
+    }
+    options.OptimizeForPointLookup(absl::GetFlag(FLAGS_rocksdb_block_cache_size_mb));
+    return options;
+}
+
+// Aux data is kept next to the log entry, prefixed with its version
+inline std::string
+AuxDataKey(uint64_t seqnum)
+{
+    return fmt::format("{:08x}-aux", bits::LowHalf64(seqnum));
+}
+
+inline std::string
+EncodeAuxData(uint64_t version, std::span<const char> data)
+{
+    std::string encoded;
+    encoded.resize(sizeof(uint64_t) + data.size());
+    memcpy(encoded.data(), &version, sizeof(uint64_t));
+    memcpy(encoded.data() + sizeof(uint64_t), data.data(), data.size());
+    return encoded;
+}
+
+inline std::optional<std::string>
+DecodeAuxData(std::string encoded, uint64_t* version)
+{
+    if (encoded.size() < sizeof(uint64_t)) {
+        LOG_F(ERROR, "Corrupted aux data of size {}", encoded.size());
+        return std::nullopt;
+    }
+    if (version != nullptr) {
+        memcpy(version, encoded.data(), sizeof(uint64_t));
+    }
+    encoded.erase(0, sizeof(uint64_t));
+    return encoded;
+}
+} // namespace
+
 RocksDBBackend::RocksDBBackend(std::string_view db_path)
 {
     rocksdb::Options options;
     options.create_if_missing = true;
     options.max_background_jobs = absl::GetFlag(FLAGS_rocksdb_max_background_jobs);
+    // Column families of log spaces have to be opened together with the DB
+    std::vector<std::string> cf_names;
+    auto status =
+        rocksdb::DB::ListColumnFamilies(options, std::string(db_path), &cf_names);
+    if (!status.ok()) {
+        cf_names = {rocksdb::kDefaultColumnFamilyName};
+    }
+    std::vector<rocksdb::ColumnFamilyDescriptor> cf_descs;
+    for (const std::string& cf_name: cf_names) {
+        if (cf_name == rocksdb::kDefaultColumnFamilyName) {
+            cf_descs.emplace_back(cf_name, rocksdb::ColumnFamilyOptions(options));
+        } else {
+            cf_descs.emplace_back(cf_name, LogSpaceCFOptions());
+        }
+    }
     rocksdb::DB* db;
+    std::vector<rocksdb::ColumnFamilyHandle*> cf_handles;
     HLOG_F(INFO, "Open RocksDB at path {}", db_path);
-    auto status = rocksdb::DB::Open(options, std::string(db_path), &db);
+    status = rocksdb::DB::Open(options, std::string(db_path), cf_descs, &cf_handles, &db);
     ROCKSDB_CHECK_OK(status, Open);
     db_.reset(db);
+    absl::MutexLock lk(&mu_);
+    for (rocksdb::ColumnFamilyHandle* cf_handle: cf_handles) {
+        if (cf_handle->GetName() == rocksdb::kDefaultColumnFamilyName) {
+            status = db_->DestroyColumnFamilyHandle(cf_handle);
+            ROCKSDB_CHECK_OK(status, DestroyColumnFamilyHandle);
+            continue;
+        }
+        uint32_t logspace_id =
+            gsl::narrow_cast<uint32_t>(std::stoul(cf_handle->GetName(), nullptr, 16));
+        HLOG_F(INFO, "Reopen log space {}", bits::HexStr0x(logspace_id));
+        column_families_[logspace_id].reset(cf_handle);
+        reopened_logspaces_.insert(logspace_id);
+    }
 }
 
 RocksDBBackend::~RocksDBBackend() {}
@@ -54,17 +130,15 @@ RocksDBBackend::~RocksDBBackend() {}
 void
 RocksDBBackend::InstallLogSpace(uint32_t logspace_id)
 {
-    HLOG_F(INFO, "Install log space {}", bits::HexStr0x(logspace_id));
-    rocksdb::ColumnFamilyOptions options;
-    if (absl::GetFlag(FLAGS_rocksdb_enable_compression)) {
-        options.compression = rocksdb::kZSTD;
-    } else {
-        options.compression = rocksdb::kNoCompression;
+    if (GetCFHandle(logspace_id) != nullptr) {
+        HLOG_F(INFO, "Log space {} already installed", bits::HexStr0x(logspace_id));
+        return;
     }
-    options.OptimizeForPointLookup(absl::GetFlag(FLAGS_rocksdb_block_cache_size_mb));
+    HLOG_F(INFO, "Install log space {}", bits::HexStr0x(logspace_id));
     rocksdb::ColumnFamilyHandle* cf_handle = nullptr;
-    auto status =
-        db_->CreateColumnFamily(options, bits::HexStr(logspace_id), &cf_handle);
+    auto status = db_->CreateColumnFamily(LogSpaceCFOptions(),
+                                          bits::HexStr(logspace_id),
+                                          &cf_handle);
     ROCKSDB_CHECK_OK(status, CreateColumnFamily);
     {
         absl::MutexLock lk(&mu_);
@@ -145,6 +219,57 @@ RocksDBBackend::PutKV(uint64_t seqnum, uint64_t key, std::span<const char> value
     ROCKSDB_CHECK_OK(status, Put);
 }
 
+std::optional<std::string>
+RocksDBBackend::GetAuxData(uint64_t seqnum, uint64_t* version)
+{
+    uint32_t logspace_id = bits::HighHalf64(seqnum);
+    rocksdb::ColumnFamilyHandle* cf_handle = GetCFHandle(logspace_id);
+    if (cf_handle == nullptr) {
+        HLOG_F(WARNING, "Log space {} not created", bits::HexStr0x(logspace_id));
+        return std::nullopt;
+    }
+    std::string encoded;
+    auto status =
+        db_->Get(rocksdb::ReadOptions(), cf_handle, AuxDataKey(seqnum), &encoded);
+    if (status.IsNotFound()) {
+        return std::nullopt;
+    }
+    ROCKSDB_CHECK_OK(status, Get);
+    return DecodeAuxData(std::move(encoded), version);
+}
+
+bool
+RocksDBBackend::PutAuxData(uint64_t seqnum,
+                           uint64_t version,
+                           std::span<const char> data)
+{
+    uint32_t logspace_id = bits::HighHalf64(seqnum);
+    rocksdb::ColumnFamilyHandle* cf_handle = GetCFHandle(logspace_id);
+    if (cf_handle == nullptr) {
+        HLOG_F(ERROR, "Log space {} not created", bits::HexStr0x(logspace_id));
+        return false;
+    }
+    absl::MutexLock lk(&auxdata_mu_);
+    uint64_t stored_version;
+    if (GetAuxData(seqnum, &stored_version).has_value() && stored_version > version) {
+        return false;
+    }
+    std::string encoded = EncodeAuxData(version, data);
+    auto status = db_->Put(rocksdb::WriteOptions(),
+                           cf_handle,
+                           AuxDataKey(seqnum),
+                           rocksdb::Slice(encoded.data(), encoded.size()));
+    ROCKSDB_CHECK_OK(status, Put);
+    return true;
+}
+
+bool
+RocksDBBackend::IsReopenedLogSpace(uint32_t logspace_id)
+{
+    absl::ReaderMutexLock lk(&mu_);
+    return reopened_logspaces_.contains(logspace_id);
+}
+
 rocksdb::ColumnFamilyHandle*
 RocksDBBackend::GetCFHandle(uint32_t logspace_id)
 {
@@ -172,14 +297,14 @@ void
 TkrzwDBMBackend::InstallLogSpace(uint32_t logspace_id)
 {
     HLOG_F(INFO, "Install log space {}", bits::HexStr0x(logspace_id));
+    std::string path = GetDBMPath(logspace_id);
+    bool reopened = fs_utils::Exists(path);
     tkrzw::DBM* db_ptr = nullptr;
     if (type_ == kHashDBM) {
         tkrzw::HashDBM* db = new tkrzw::HashDBM();
         tkrzw::HashDBM::TuningParameters params;
         auto status = db->OpenAdvanced(
-            /* path= */ fmt::format("{}/{}.tkh",
-                                    db_path_,
-                                    bits::HexStr(logspace_id)),
+            /* path= */ path,
             /* writable= */ true,
             /* options= */ tkrzw::File::OPEN_DEFAULT,
             /* tuning_params= */ params);
@@ -189,9 +314,7 @@ TkrzwDBMBackend::InstallLogSpace(uint32_t logspace_id)
         tkrzw::TreeDBM* db = new tkrzw::TreeDBM();
         tkrzw::TreeDBM::TuningParameters params;
         auto status = db->OpenAdvanced(
-            /* path= */ fmt::format("{}/{}.tkt",
-                                    db_path_,
-                                    bits::HexStr(logspace_id)),
+            /* path= */ path,
             /* writable= */ true,
             /* options= */ tkrzw::File::OPEN_DEFAULT,
             /* tuning_params= */ params);
@@ -201,9 +324,7 @@ TkrzwDBMBackend::InstallLogSpace(uint32_t logspace_id)
         tkrzw::SkipDBM* db = new tkrzw::SkipDBM();
         tkrzw::SkipDBM::TuningParameters params;
         auto status = db->OpenAdvanced(
-            /* path= */ fmt::format("{}/{}.tks",
-                                    db_path_,
-                                    bits::HexStr(logspace_id)),
+            /* path= */ path,
             /* writable= */ true,
             /* options= */ tkrzw::File::OPEN_DEFAULT,
             /* tuning_params= */ params);
@@ -217,6 +338,9 @@ TkrzwDBMBackend::InstallLogSpace(uint32_t logspace_id)
         absl::MutexLock lk(&mu_);
         DCHECK(!dbs_.contains(logspace_id));
         dbs_[logspace_id].reset(DCHECK_NOTNULL(db_ptr));
+        if (reopened) {
+            reopened_logspaces_.insert(logspace_id);
+        }
     }
 }
 
@@ -250,6 +374,71 @@ TkrzwDBMBackend::Put(uint32_t logspace_id, uint64_t key, std::span<const char> d
     TKRZW_CHECK_OK(status, Set);
 }
 
+std::optional<std::string>
+TkrzwDBMBackend::GetAuxData(uint64_t seqnum, uint64_t* version)
+{
+    uint32_t logspace_id = bits::HighHalf64(seqnum);
+    tkrzw::DBM* dbm = GetDBM(logspace_id);
+    if (dbm == nullptr) {
+        HLOG_F(WARNING, "Log space {} not created", bits::HexStr0x(logspace_id));
+        return std::nullopt;
+    }
+    std::string encoded;
+    auto status = dbm->Get(AuxDataKey(seqnum), &encoded);
+    if (!status.IsOK()) {
+        return std::nullopt;
+    }
+    return DecodeAuxData(std::move(encoded), version);
+}
+
+bool
+TkrzwDBMBackend::PutAuxData(uint64_t seqnum,
+                            uint64_t version,
+                            std::span<const char> data)
+{
+    uint32_t logspace_id = bits::HighHalf64(seqnum);
+    tkrzw::DBM* dbm = GetDBM(logspace_id);
+    if (dbm == nullptr) {
+        HLOG_F(ERROR, "Log space {} not created", bits::HexStr0x(logspace_id));
+        return false;
+    }
+    absl::MutexLock lk(&auxdata_mu_);
+    uint64_t stored_version;
+    if (GetAuxData(seqnum, &stored_version).has_value() && stored_version > version) {
+        return false;
+    }
+    auto status = dbm->Set(AuxDataKey(seqnum), EncodeAuxData(version, data));
+    TKRZW_CHECK_OK(status, Set);
+    return true;
+}
+
+bool
+TkrzwDBMBackend::IsReopenedLogSpace(uint32_t logspace_id)
+{
+    absl::ReaderMutexLock lk(&mu_);
+    return reopened_logspaces_.contains(logspace_id);
+}
+
+std::string
+TkrzwDBMBackend::GetDBMPath(uint32_t logspace_id) const
+{
+    const char* suffix = nullptr;
+    switch (type_) {
+    case kHashDBM:
+        suffix = "tkh";
+        break;
+    case kTreeDBM:
+        suffix = "tkt";
+        break;
+    case kSkipDBM:
+        suffix = "tks";
+        break;
+    default:
+        UNREACHABLE();
+    }
+    return fmt::format("{}/{}.{}", db_path_, bits::HexStr(logspace_id), suffix);
+}
+
 tkrzw::DBM*
 TkrzwDBMBackend::GetDBM(uint32_t logspace_id)
 {
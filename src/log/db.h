@@ -30,6 +30,18 @@ public:
         return std::nullopt;
     }
     virtual void PutKV(uint64_t seqnum, uint64_t key, std::span<const char> data) {}
+
+    // Aux data is versioned with last-writer-wins: `PutAuxData` returns false,
+    // and keeps the stored aux data, if its version is newer than `version`
+    virtual std::optional<std::string> GetAuxData(uint64_t seqnum,
+                                                  uint64_t* version) = 0;
+    virtual bool PutAuxData(uint64_t seqnum,
+                            uint64_t version,
+                            std::span<const char> data) = 0;
+
+    // Whether the log space was already in the DB before this process, so
+    // that it may hold aux data the caller has not seen
+    virtual bool IsReopenedLogSpace(uint32_t logspace_id) = 0;
 };
 
 class RocksDBBackend final: public DBInterface {
@@ -46,12 +58,23 @@ public:
     std::optional<std::string> GetKV(uint64_t seqnum, uint64_t key) override;
     void PutKV(uint64_t seqnum, uint64_t key, std::span<const char> data) override;
 
+    std::optional<std::string> GetAuxData(uint64_t seqnum,
+                                          uint64_t* version) override;
+    bool PutAuxData(uint64_t seqnum,
+                    uint64_t version,
+                    std::span<const char> data) override;
+
+    bool IsReopenedLogSpace(uint32_t logspace_id) override;
+
 private:
     std::unique_ptr<rocksdb::DB> db_;
     absl::Mutex mu_;
+    absl::Mutex auxdata_mu_;
     absl::flat_hash_map</* logspace_id */ uint32_t,
                         std::unique_ptr<rocksdb::ColumnFamilyHandle>>
         column_families_ ABSL_GUARDED_BY(mu_);
+    absl::flat_hash_set</* logspace_id */ uint32_t>
+        reopened_logspaces_ ABSL_GUARDED_BY(mu_);
 
     rocksdb::ColumnFamilyHandle* GetCFHandle(uint32_t logspace_id);
 
@@ -70,14 +93,26 @@ public:
              uint64_t key,
              std::span<const char> data) override;
 
+    std::optional<std::string> GetAuxData(uint64_t seqnum,
+                                          uint64_t* version) override;
+    bool PutAuxData(uint64_t seqnum,
+                    uint64_t version,
+                    std::span<const char> data) override;
+
+    bool IsReopenedLogSpace(uint32_t logspace_id) override;
+
 private:
     Type type_;
     std::string db_path_;
 
     absl::Mutex mu_;
+    absl::Mutex auxdata_mu_;
     absl::flat_hash_map</* logspace_id */ uint32_t, std::unique_ptr<tkrzw::DBM>> dbs_
         ABSL_GUARDED_BY(mu_);
+    absl::flat_hash_set</* logspace_id */ uint32_t>
+        reopened_logspaces_ ABSL_GUARDED_BY(mu_);
 
+    std::string GetDBMPath(uint32_t logspace_id) const;
     tkrzw::DBM* GetDBM(uint32_t logspace_id);
 
     DISALLOW_COPY_AND_ASSIGN(TkrzwDBMBackend);
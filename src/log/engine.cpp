@@ -5,6 +5,7 @@
 #include "base/logging.h"
 #include "base/std_span.h"
 #include "common/protocol.h"
+#include "common/time.h"
 #include "engine/engine.h"
 #include "fmt/core.h"
 #include "gsl/gsl_util"
@@ -378,7 +379,10 @@ Engine::Engine(engine::Engine* engine)
     : EngineBase(engine),
       log_header_(fmt::format("LogEngine[{}-N]: ", my_node_id())),
       current_view_(nullptr),
-      current_view_active_(false)
+      current_view_active_(false),
+      view_frozen_timestamp_(0),
+      append_stall_stat_(stat::StatisticsCollector<int>::StandardReportCallback(
+          "view_reconfig_append_stall"))
 {}
 
 Engine::~Engine() {}
@@ -418,7 +422,12 @@ Engine::OnViewCreated(const View* view)
         current_view_ = view;
         if (contains_myself) {
             current_view_active_ = true;
+            if (view_frozen_timestamp_ > 0) {
+                append_stall_stat_.AddSample(gsl::narrow_cast<int>(
+                    GetMonotonicMicroTimestamp() - view_frozen_timestamp_));
+            }
         }
+        view_frozen_timestamp_ = 0;
         views_.push_back(view);
         log_header_ = fmt::format("LogEngine[{}-{}]: ", my_node_id(), view->id());
     }
@@ -442,6 +451,7 @@ Engine::OnViewFrozen(const View* view)
     if (view->contains_engine_node(my_node_id())) {
         DCHECK(current_view_active_);
         current_view_active_ = false;
+        view_frozen_timestamp_ = GetMonotonicMicroTimestamp();
     }
 }
 
@@ -452,6 +462,7 @@ Engine::OnViewFinalized(const FinalizedView* finalized_view)
     HLOG_F(INFO, "View {} finalized", finalized_view->view()->id());
     LogProducer::AppendResultVec append_results;
     Index::QueryResultVec query_results;
+    Index::ConflictResultVec conflict_results;
     {
         absl::MutexLock view_lk(&view_mu_);
         DCHECK_EQ(finalized_view->view()->id(), current_view_->id());
@@ -469,26 +480,33 @@ Engine::OnViewFinalized(const FinalizedView* finalized_view)
             });
         index_collection_.ForEachActiveLogSpace(
             finalized_view->view(),
-            [finalized_view, &query_results](uint32_t logspace_id,
-                                             LockablePtr<Index> index_ptr) {
+            [finalized_view, &query_results,
+             &conflict_results](uint32_t logspace_id,
+                                LockablePtr<Index> index_ptr) {
                 log_utils::FinalizedLogSpace<Index>(index_ptr, finalized_view);
                 auto locked_index = index_ptr.Lock();
                 locked_index->PollQueryResults(&query_results);
+                locked_index->PollConflictQueryResults(&conflict_results);
             });
     }
+    absl::InlinedVector<server::IOWorker::Function, 2> fns;
     if (!append_results.empty()) {
-        SomeIOWorker()->ScheduleFunction(
-            nullptr,
-            [this, results = std::move(append_results)] {
-                ProcessAppendResults(results);
-            });
+        fns.push_back([this, results = std::move(append_results)] {
+            ProcessAppendResults(results);
+        });
     }
     if (!query_results.empty()) {
-        SomeIOWorker()->ScheduleFunction(nullptr,
-                                         [this, results = std::move(query_results)] {
-                                             ProcessIndexQueryResults(results);
-                                         });
+        fns.push_back([this, results = std::move(query_results)] {
+            ProcessIndexQueryResults(results);
+        });
+    }
+    if (!conflict_results.empty()) {
+        fns.push_back([this, results = std::move(conflict_results)] {
+            ProcessConflictQueryResults(results);
+        });
     }
+    SomeIOWorker()->ScheduleFunctions(
+        nullptr, std::span<server::IOWorker::Function>(fns.data(), fns.size()));
 }
 
 namespace {
@@ -868,6 +886,54 @@ Engine::HandleLocalSetAuxData(LocalOp* op)
     }
 }
 
+void
+Engine::HandleLocalCheckConflict(LocalOp* op)
+{
+    DCHECK(op->type == SharedLogOpType::CHECK_CONFLICT);
+    HVLOG_F(1,
+            "Handle local conflict check: op_id={}, logspace={}, num_tags={}, "
+            "range=[{}, {})",
+            op->id,
+            op->user_logspace,
+            op->user_tags.size(),
+            bits::HexStr0x(op->from_seqnum),
+            bits::HexStr0x(op->seqnum));
+    if (use_txn_engine_) {
+        FinishLocalOpWithFailure(op, SharedLogResultType::UNSUPPORTED);
+        return;
+    }
+    LockablePtr<Index> index_ptr;
+    {
+        absl::ReaderMutexLock view_lk(&view_mu_);
+        ONHOLD_IF_SEEN_FUTURE_VIEW(op);
+        uint32_t logspace_id = current_view_->LogSpaceIdentifier(op->user_logspace);
+        const View::Sequencer* sequencer_node =
+            current_view_->GetSequencerNode(bits::LowHalf32(logspace_id));
+        if (sequencer_node->IsIndexEngineNode(my_node_id())) {
+            index_ptr = index_collection_.GetLogSpaceChecked(logspace_id);
+        }
+    }
+    if (index_ptr == nullptr) {
+        // Clients fall back to reading logs one by one
+        FinishLocalOpWithFailure(op, SharedLogResultType::UNSUPPORTED);
+        return;
+    }
+    onging_reads_.PutChecked(op->id, op);
+    ConflictQuery query = {.client_data = op->id,
+                           .user_logspace = op->user_logspace,
+                           .user_tags = op->user_tags,
+                           .from_seqnum = op->from_seqnum,
+                           .to_seqnum = op->seqnum,
+                           .metalog_progress = op->metalog_progress};
+    Index::ConflictResultVec conflict_results;
+    {
+        auto locked_index = index_ptr.Lock();
+        locked_index->MakeConflictQuery(query);
+        locked_index->PollConflictQueryResults(&conflict_results);
+    }
+    ProcessConflictQueryResults(conflict_results);
+}
+
 #undef ONHOLD_IF_SEEN_FUTURE_VIEW
 
 // Start handlers for remote messages
@@ -920,6 +986,20 @@ void
 Engine::OnRecvNewMetaLog(const SharedLogMessage& message,
                          std::span<const char> payload)
 {
+    if ((message.flags & protocol::kMetaLogForwardFlag) != 0) {
+        // Messages from a future view are put on hold below, and
+        // forwarded once they come back through MessageHandler
+        const View* view = nullptr;
+        {
+            absl::ReaderMutexLock view_lk(&view_mu_);
+            if (message.view_id < views_.size()) {
+                view = views_.at(message.view_id);
+            }
+        }
+        if (view != nullptr) {
+            ForwardMetaLog(view, message, payload);
+        }
+    }
     if (use_txn_engine_) {
         TxnEngineRecvMetaLog(message, payload);
     } else {
@@ -958,11 +1038,20 @@ void
 Engine::SLogRecvMetaLog(const protocol::SharedLogMessage& message,
                         std::span<const char> payload)
 {
-    DCHECK(SharedLogMessageHelper::GetOpType(message) == SharedLogOpType::METALOG);
-    MetaLogProto metalog_proto = log_utils::MetaLogFromPayload(payload);
-    DCHECK_EQ(metalog_proto.logspace_id(), message.logspace_id);
+    MetaLogsProto metalogs_proto;
+    if (SharedLogMessageHelper::GetOpType(message) == SharedLogOpType::METALOGS) {
+        // Fetched from a sequencer
+        metalogs_proto = log_utils::MetaLogsFromPayload(payload);
+    } else {
+        DCHECK(SharedLogMessageHelper::GetOpType(message) ==
+               SharedLogOpType::METALOG);
+        metalogs_proto.set_logspace_id(message.logspace_id);
+        *metalogs_proto.add_metalogs() = log_utils::MetaLogFromPayload(payload);
+    }
+    DCHECK_EQ(metalogs_proto.logspace_id(), message.logspace_id);
     LogProducer::AppendResultVec append_results;
     Index::QueryResultVec query_results;
+    Index::ConflictResultVec conflict_results;
     {
         absl::ReaderMutexLock view_lk(&view_mu_);
         ONHOLD_IF_FROM_FUTURE_VIEW(message, payload);
@@ -971,8 +1060,9 @@ Engine::SLogRecvMetaLog(const protocol::SharedLogMessage& message,
             producer_collection_.GetLogSpaceChecked(message.logspace_id);
         {
             auto locked_producer = producer_ptr.Lock();
-            // for (const MetaLogProto& metalog_proto: metalogs_proto.metalogs())
-            locked_producer->ProvideMetaLog(metalog_proto);
+            for (const MetaLogProto& metalog_proto: metalogs_proto.metalogs()) {
+                locked_producer->ProvideMetaLog(metalog_proto);
+            }
             locked_producer->PollAppendResults(&append_results);
         }
         if (current_view_->GetEngineNode(my_node_id())
@@ -982,14 +1072,69 @@ Engine::SLogRecvMetaLog(const protocol::SharedLogMessage& message,
                 index_collection_.GetLogSpaceChecked(message.logspace_id);
             {
                 auto locked_index = index_ptr.Lock();
-                // for (const MetaLogProto& metalog_proto: metalogs_proto.metalogs())
-                locked_index->ProvideMetaLog(metalog_proto);
+                for (const MetaLogProto& metalog_proto: metalogs_proto.metalogs()) {
+                    locked_index->ProvideMetaLog(metalog_proto);
+                }
                 locked_index->PollQueryResults(&query_results);
+                locked_index->PollConflictQueryResults(&conflict_results);
             }
         }
     }
     ProcessAppendResults(append_results);
     ProcessIndexQueryResults(query_results);
+    ProcessConflictQueryResults(conflict_results);
+}
+
+void
+Engine::FetchMissingMetaLogs()
+{
+    // The producer and the index of one logspace may miss different metalogs
+    absl::flat_hash_map</* logspace_id */ uint32_t, LogSpaceBase::MetaLogGap> gaps;
+    auto add_gap = [&gaps] (uint32_t logspace_id, const LogSpaceBase::MetaLogGap& gap) {
+        if (!gaps.contains(logspace_id)) {
+            gaps[logspace_id] = gap;
+            return;
+        }
+        LogSpaceBase::MetaLogGap& merged = gaps[logspace_id];
+        merged.start_position = std::min(merged.start_position, gap.start_position);
+        merged.end_position = std::max(merged.end_position, gap.end_position);
+    };
+    {
+        absl::ReaderMutexLock view_lk(&view_mu_);
+        producer_collection_.ForEachActiveLogSpace(
+            [&add_gap](uint32_t logspace_id, LockablePtr<LogProducer> producer_ptr) {
+                auto locked_producer = producer_ptr.Lock();
+                if (auto gap = locked_producer->CheckMetaLogGap(); gap.has_value()) {
+                    add_gap(logspace_id, *gap);
+                }
+            });
+        index_collection_.ForEachActiveLogSpace(
+            [&add_gap](uint32_t logspace_id, LockablePtr<Index> index_ptr) {
+                auto locked_index = index_ptr.Lock();
+                if (auto gap = locked_index->CheckMetaLogGap(); gap.has_value()) {
+                    add_gap(logspace_id, *gap);
+                }
+            });
+    }
+    for (const auto& [logspace_id, gap]: gaps) {
+        if (gap.end_position == LogSpaceBase::kUnknownEndPosition) {
+            HVLOG_F(1,
+                    "Probe metalogs from {} of logspace {} at sequencer {}",
+                    gap.start_position,
+                    bits::HexStr0x(logspace_id),
+                    gap.sequencer_id);
+        } else {
+            HLOG_F(WARNING,
+                   "Fetch missing metalogs [{}, {}) of logspace {} from sequencer {}",
+                   gap.start_position,
+                   gap.end_position,
+                   bits::HexStr0x(logspace_id),
+                   gap.sequencer_id);
+        }
+        SharedLogMessage message = SharedLogMessageHelper::NewMetaLogFetchMessage(
+            logspace_id, gap.start_position, gap.end_position);
+        SendSequencerMessage(gap.sequencer_id, &message);
+    }
 }
 
 void
@@ -1089,6 +1234,7 @@ Engine::SLogRecvIndex(const protocol::SharedLogMessage& message,
         LOG(FATAL) << "Failed to parse IndexDataProto";
     }
     Index::QueryResultVec query_results;
+    Index::ConflictResultVec conflict_results;
     {
         absl::ReaderMutexLock view_lk(&view_mu_);
         ONHOLD_IF_FROM_FUTURE_VIEW(message, payload);
@@ -1108,9 +1254,11 @@ Engine::SLogRecvIndex(const protocol::SharedLogMessage& message,
             auto locked_index = index_ptr.Lock();
             locked_index->ProvideIndexData(index_data_proto);
             locked_index->PollQueryResults(&query_results);
+            locked_index->PollConflictQueryResults(&conflict_results);
         }
     }
     ProcessIndexQueryResults(query_results);
+    ProcessConflictQueryResults(conflict_results);
 }
 
 #undef ONHOLD_IF_FROM_FUTURE_VIEW
@@ -1418,6 +1566,24 @@ Engine::ProcessIndexContinueResult(const IndexQueryResult& query_result,
     }
 }
 
+void
+Engine::ProcessConflictQueryResults(const Index::ConflictResultVec& results)
+{
+    for (const ConflictQueryResult& result: results) {
+        LocalOp* op = onging_reads_.PollChecked(result.original_query.client_data);
+        if (result.state == ConflictQueryResult::kIncomplete) {
+            FinishLocalOpWithFailure(op,
+                                     SharedLogResultType::UNSUPPORTED,
+                                     result.metalog_progress);
+            continue;
+        }
+        Message response = MessageHelper::NewSharedLogOpSucceeded(
+            SharedLogResultType::CHECK_CONFLICT_OK, op->seqnum);
+        MessageHelper::AppendInlineData(&response, VECTOR_AS_SPAN(result.seqnums));
+        FinishLocalOpWithResponse(op, &response, result.metalog_progress);
+    }
+}
+
 void
 Engine::ProcessIndexQueryResults(const Index::QueryResultVec& results)
 {
@@ -175,6 +175,10 @@ private:
     absl::Mutex view_mu_;
     const View* current_view_ ABSL_GUARDED_BY(view_mu_);
     bool current_view_active_ ABSL_GUARDED_BY(view_mu_);
+    // Appends are discarded from freezing the current view until the next
+    // view is created, the stall is sampled once per reconfiguration
+    int64_t view_frozen_timestamp_ ABSL_GUARDED_BY(view_mu_);
+    stat::StatisticsCollector<int> append_stall_stat_ ABSL_GUARDED_BY(view_mu_);
     std::vector<const View*> views_ ABSL_GUARDED_BY(view_mu_);
     LogSpaceCollection<LogProducer> producer_collection_ ABSL_GUARDED_BY(view_mu_);
     LogSpaceCollection<Index> index_collection_ ABSL_GUARDED_BY(view_mu_);
@@ -197,6 +201,7 @@ private:
     void HandleRemoteRead(const protocol::SharedLogMessage& request) override;
     void HandleLocalTrim(LocalOp* op) override;
     void HandleLocalSetAuxData(LocalOp* op) override;
+    void HandleLocalCheckConflict(LocalOp* op) override;
 
     void HandleLocalCCTxnCommit(LocalOp* op) override;
     void HandleLocalCCTxnWrite(LocalOp* op) override;
@@ -207,6 +212,7 @@ private:
                          std::span<const char> payload);
     void TxnEngineRecvMetaLog(const protocol::SharedLogMessage& message,
                               std::span<const char> payload);
+    void FetchMissingMetaLogs() override;
 
     void OnRecvNewIndexData(const protocol::SharedLogMessage& message,
                             std::span<const char> payload) override;
@@ -224,6 +230,7 @@ private:
 
     void ProcessAppendResults(const LogProducer::AppendResultVec& results);
     void ProcessIndexQueryResults(const Index::QueryResultVec& results);
+    void ProcessConflictQueryResults(const Index::ConflictResultVec& results);
     void ProcessRequests(const std::vector<SharedLogRequest>& requests);
 
     void ProcessIndexFoundResult(const IndexQueryResult& query_result);
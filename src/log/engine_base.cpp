@@ -9,6 +9,7 @@
 #include "log/utils.h"
 #include "server/constants.h"
 #include "utils/bits.h"
+#include "utils/random.h"
 #include <string>
 
 #define log_header_ "LogEngineBase: "
@@ -27,6 +28,7 @@ using protocol::SharedLogResultType;
 EngineBase::EngineBase(engine::Engine* engine)
     : node_id_(engine->node_id_),
       engine_(engine),
+      metalog_drop_rate_(absl::GetFlag(FLAGS_slog_debug_metalog_drop_rate)),
       next_local_op_id_(0)
 {
     use_txn_engine_ = absl::GetFlag(FLAGS_use_txn_engine);
@@ -71,7 +73,15 @@ EngineBase::SetupZKWatchers()
 
 void
 EngineBase::SetupTimers()
-{}
+{
+    int gap_check_interval_ms = absl::GetFlag(FLAGS_slog_metalog_gap_check_interval_ms);
+    if (!use_txn_engine_ && gap_check_interval_ms > 0) {
+        engine_->CreatePeriodicTimer(
+            kMetaLogGapTimerId,
+            absl::Milliseconds(gap_check_interval_ms),
+            [this]() { this->FetchMissingMetaLogs(); });
+    }
+}
 
 void
 EngineBase::OnNewExternalFuncCall(const FuncCall& func_call, uint32_t log_space)
@@ -141,6 +151,9 @@ EngineBase::LocalOpHandler(LocalOp* op)
     case SharedLogOpType::CC_TXN_COMMIT:
         HandleLocalCCTxnCommit(op);
         break;
+    case SharedLogOpType::CHECK_CONFLICT:
+        HandleLocalCheckConflict(op);
+        break;
     default:
         UNREACHABLE();
     }
@@ -160,6 +173,7 @@ EngineBase::MessageHandler(const SharedLogMessage& message,
         OnRecvNewIndexData(message, payload);
         break;
     case SharedLogOpType::METALOG:
+    case SharedLogOpType::METALOGS:
         OnRecvNewMetaLog(message, payload);
         break;
     case SharedLogOpType::RESPONSE:
@@ -212,6 +226,7 @@ EngineBase::OnMessageFromFuncWorker(const Message& message)
     op->metalog_progress = ctx.metalog_progress;
     op->type = MessageHelper::GetSharedLogOpType(message);
     op->seqnum = kInvalidLogSeqNum;
+    op->from_seqnum = kInvalidLogSeqNum;
     op->query_tag = kInvalidLogTag;
     op->user_tags.clear();
     op->data.Reset();
@@ -261,6 +276,17 @@ EngineBase::OnMessageFromFuncWorker(const Message& message)
         op->cond_pos = message.cond_pos;
         op->data.AppendData(MessageHelper::GetInlineData(message));
         break;
+    case SharedLogOpType::CHECK_CONFLICT:
+        // Logs with any of user_tags in [from_seqnum, seqnum)
+        op->seqnum = message.log_seqnum;
+        op->from_seqnum = message.log_from_seqnum;
+        if (message.log_num_tags > 0) {
+            op->user_tags.resize(message.log_num_tags);
+            memcpy(op->user_tags.data(),
+                   MessageHelper::GetInlineData(message).data(),
+                   message.log_num_tags * sizeof(uint64_t));
+        }
+        break;
     default:
         HLOG(FATAL) << "Unknown shared log op type: " << message.log_op;
     }
@@ -280,6 +306,10 @@ EngineBase::OnRecvSharedLogMessage(int conn_type,
     SharedLogOpType op_type = SharedLogMessageHelper::GetOpType(message);
     DCHECK((conn_type == kSequencerIngressTypeId &&
             op_type == SharedLogOpType::METALOG) ||
+           (conn_type == kSequencerIngressTypeId &&
+            op_type == SharedLogOpType::METALOGS) ||
+           (conn_type == kEngineIngressTypeId &&
+            op_type == SharedLogOpType::METALOG) ||
            (conn_type == kEngineIngressTypeId &&
             op_type == SharedLogOpType::READ_NEXT) ||
            (conn_type == kEngineIngressTypeId &&
@@ -295,6 +325,14 @@ EngineBase::OnRecvSharedLogMessage(int conn_type,
     // HVLOG(1) << fmt::format("recv shared log msg conn_type={:#x}, op_type={:#x}",
     //                        conn_type,
     //                        message.op_type);
+    if (metalog_drop_rate_ > 0 && op_type == SharedLogOpType::METALOG &&
+        utils::GetRandomDouble() < metalog_drop_rate_)
+    {
+        HVLOG_F(1,
+                "Drop metalog message of logspace {}",
+                bits::HexStr0x(message.logspace_id));
+        return;
+    }
     MessageHandler(message, payload);
 }
 
@@ -353,6 +391,8 @@ EngineBase::PropagateAuxData(const View* view,
     const View::Engine* engine_node = view->GetEngineNode(engine_id);
     SharedLogMessage message =
         SharedLogMessageHelper::NewSetAuxDataMessage(log_metadata.seqnum);
+    // Storage nodes keep the aux data of the latest version
+    message.aux_data_version = gsl::narrow_cast<uint64_t>(GetRealtimeNanoTimestamp());
     message.origin_node_id = node_id_;
     message.payload_size = gsl::narrow_cast<uint32_t>(aux_data.size());
     for (uint16_t storage_id: engine_node->GetStorageNodes()) {
@@ -363,6 +403,54 @@ EngineBase::PropagateAuxData(const View* view,
     }
 }
 
+void
+EngineBase::ForwardMetaLog(const View* view,
+                           const SharedLogMessage& message,
+                           std::span<const char> payload)
+{
+    DCHECK((message.flags & protocol::kMetaLogForwardFlag) != 0);
+    if (!view->contains_engine_node(node_id_)) {
+        return;
+    }
+    const View::Engine* engine_node = view->GetEngineNode(node_id_);
+    size_t fanout = size_t{message.metalog_fanout};
+    // Children of offline children are adopted, as well as their storage nodes
+    std::vector<uint16_t> engine_nodes;
+    std::vector<uint16_t> storage_nodes(engine_node->GetMetaLogStorageNodes().begin(),
+                                        engine_node->GetMetaLogStorageNodes().end());
+    view->ResolveMetaLogFanoutTargets(
+        fanout, engine_node->GetMetaLogFanoutChildren(fanout),
+        [this] (uint16_t engine_id) {
+            return !engine_->node_watcher()->IsNodeOnline(
+                server::NodeWatcher::kEngineNode, engine_id);
+        },
+        &engine_nodes, &storage_nodes);
+    for (uint16_t engine_id: engine_nodes) {
+        bool success =
+            engine_->SendSharedLogMessage(protocol::ConnType::SLOG_ENGINE_TO_ENGINE,
+                                          engine_id,
+                                          message,
+                                          payload);
+        if (!success) {
+            HLOG_F(ERROR, "Failed to forward metalog to engine {}", engine_id);
+        }
+    }
+    SharedLogMessage storage_message = message;
+    storage_message.flags = gsl::narrow_cast<uint16_t>(
+        storage_message.flags & ~protocol::kMetaLogForwardFlag);
+    storage_message.metalog_fanout = 0;
+    for (uint16_t storage_id: storage_nodes) {
+        bool success =
+            engine_->SendSharedLogMessage(protocol::ConnType::ENGINE_TO_STORAGE,
+                                          storage_id,
+                                          storage_message,
+                                          payload);
+        if (!success) {
+            HLOG_F(ERROR, "Failed to forward metalog to storage {}", storage_id);
+        }
+    }
+}
+
 void
 EngineBase::FinishLocalOpWithResponse(LocalOp* op,
                                       Message* response,
@@ -34,6 +34,7 @@ struct LocalOp {
     uint64_t localid;
     uint64_t query_tag;
     uint64_t seqnum;
+    uint64_t from_seqnum;  // Only used by CHECK_CONFLICT
     uint64_t client_data;
     uint64_t metalog_progress;
     uint64_t id;
@@ -163,6 +164,9 @@ protected:
                                     std::span<const char> payload) = 0;
     virtual void OnRecvResponse(const protocol::SharedLogMessage& message,
                                 std::span<const char> payload) = 0;
+    // Fetch missing metalogs from sequencers, if pending metalogs of some
+    // logspace are blocked by them
+    virtual void FetchMissingMetaLogs() = 0;
 
     void MessageHandler(const protocol::SharedLogMessage& message,
                         std::span<const char> payload);
@@ -171,6 +175,7 @@ protected:
     virtual void HandleLocalTrim(LocalOp* op) = 0;
     virtual void HandleLocalRead(LocalOp* op) = 0;
     virtual void HandleLocalSetAuxData(LocalOp* op) = 0;
+    virtual void HandleLocalCheckConflict(LocalOp* op) = 0;
 
     // virtual void HandleLocalCCTxnStart(LocalOp* op) = 0;
     virtual void HandleLocalCCTxnCommit(LocalOp* op) = 0;
@@ -186,6 +191,11 @@ protected:
     void PropagateAuxData(const View* view,
                           const LogMetaData& log_metadata,
                           std::span<const char> aux_data);
+    // Forward a metalog received with kMetaLogForwardFlag to child engine
+    // nodes in the fan-out tree, and to storage nodes assigned to this engine
+    void ForwardMetaLog(const View* view,
+                        const protocol::SharedLogMessage& message,
+                        std::span<const char> payload);
 
     void FinishLocalOpWithResponse(LocalOp* op,
                                    protocol::Message* response,
@@ -223,6 +233,7 @@ protected:
 private:
     const uint16_t node_id_;
     engine::Engine* engine_;
+    const double metalog_drop_rate_;
 
     ViewWatcher view_watcher_;
 
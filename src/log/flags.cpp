@@ -3,8 +3,38 @@
 
 ABSL_FLAG(int, slog_local_cut_interval_us, 1000, "");
 ABSL_FLAG(int, slog_global_cut_interval_us, 1000, "");
+ABSL_FLAG(bool, slog_global_cut_adaptive, false, "");
+ABSL_FLAG(int, slog_global_cut_max_interval_us, 20000, "");
+ABSL_FLAG(int, slog_global_cut_max_delay_us, 2000, "");
+ABSL_FLAG(size_t, slog_global_cut_max_pending_records, 64, "");
+ABSL_FLAG(size_t, slog_global_cut_max_pending_bytes, 65536, "");
 ABSL_FLAG(size_t, slog_log_space_hash_tokens, 128, "");
 ABSL_FLAG(size_t, slog_num_tail_metalog_entries, 32, "");
+ABSL_FLAG(size_t, slog_max_inflight_metalogs, 1, "");
+ABSL_FLAG(size_t, slog_metalog_fanout, 0, "");
+ABSL_FLAG(std::string, slog_sequencer_journal_dir, "", "");
+ABSL_FLAG(bool, slog_planned_reconfig, false, "");
+ABSL_FLAG(bool, slog_seal_tail_digests, true, "");
+// Fetch the tail from the next agreeing replica if no answer within this
+// time, 0 only falls back when the replica goes offline
+ABSL_FLAG(int, slog_seal_tail_fetch_timeout_ms, 1000, "");
+// With planned reconfiguration, publish tails to ZooKeeper as in an
+// unplanned one, if the view is not finalized within this time after
+// handing them off, e.g. the successor is down. 0 never falls back.
+ABSL_FLAG(int, slog_tail_handoff_timeout_ms, 1000, "");
+ABSL_FLAG(int, slog_log_space_load_report_interval_ms, 5000, "");
+ABSL_FLAG(bool, slog_load_aware_placement, false, "");
+ABSL_FLAG(size_t, slog_max_placed_log_spaces, 1024, "");
+ABSL_FLAG(bool, slog_delta_shard_progress, true, "");
+ABSL_FLAG(size_t, slog_shard_progress_full_interval, 64, "");
+ABSL_FLAG(int, slog_metalog_gap_check_interval_ms, 100, "");
+ABSL_FLAG(size_t, slog_metalog_fetch_max_batch, 128, "");
+// Probe for lost tail metalogs after metalog_position stays for this many
+// gap checks, 0 disables probing
+ABSL_FLAG(size_t, slog_metalog_stale_gap_checks, 10, "");
+// Engine and storage nodes drop received METALOG messages with this
+// probability, for testing metalog fetching
+ABSL_FLAG(double, slog_debug_metalog_drop_rate, 0.0, "");
 
 ABSL_FLAG(bool, slog_enable_statecheck, false, "");
 ABSL_FLAG(int, slog_statecheck_interval_sec, 10, "");
@@ -22,6 +52,8 @@ ABSL_FLAG(std::string,
           "rocskdb, tkrzw_hash, tkrzw_tree, or tkrzw_skip");
 ABSL_FLAG(int, slog_storage_bgthread_interval_ms, 1, "");
 ABSL_FLAG(size_t, slog_storage_max_live_entries, 65536, "");
+ABSL_FLAG(bool, slog_storage_persist_auxdata, true, "");
+ABSL_FLAG(size_t, slog_storage_max_auxdata_size, 2048, "");
 
 // ABSL_FLAG(size_t, cc_reorder_batch_size, 64, "Batch size for CC reorder");
 // ABSL_FLAG(size_t, cc_reorder_quickselect, 1, "k of Quickselect in removing cycles");
@@ -5,8 +5,29 @@
 
 ABSL_DECLARE_FLAG(int, slog_local_cut_interval_us);
 ABSL_DECLARE_FLAG(int, slog_global_cut_interval_us);
+ABSL_DECLARE_FLAG(bool, slog_global_cut_adaptive);
+ABSL_DECLARE_FLAG(int, slog_global_cut_max_interval_us);
+ABSL_DECLARE_FLAG(int, slog_global_cut_max_delay_us);
+ABSL_DECLARE_FLAG(size_t, slog_global_cut_max_pending_records);
+ABSL_DECLARE_FLAG(size_t, slog_global_cut_max_pending_bytes);
 ABSL_DECLARE_FLAG(size_t, slog_log_space_hash_tokens);
 ABSL_DECLARE_FLAG(size_t, slog_num_tail_metalog_entries);
+ABSL_DECLARE_FLAG(size_t, slog_max_inflight_metalogs);
+ABSL_DECLARE_FLAG(size_t, slog_metalog_fanout);
+ABSL_DECLARE_FLAG(std::string, slog_sequencer_journal_dir);
+ABSL_DECLARE_FLAG(bool, slog_planned_reconfig);
+ABSL_DECLARE_FLAG(bool, slog_seal_tail_digests);
+ABSL_DECLARE_FLAG(int, slog_seal_tail_fetch_timeout_ms);
+ABSL_DECLARE_FLAG(int, slog_tail_handoff_timeout_ms);
+ABSL_DECLARE_FLAG(int, slog_log_space_load_report_interval_ms);
+ABSL_DECLARE_FLAG(bool, slog_load_aware_placement);
+ABSL_DECLARE_FLAG(size_t, slog_max_placed_log_spaces);
+ABSL_DECLARE_FLAG(bool, slog_delta_shard_progress);
+ABSL_DECLARE_FLAG(size_t, slog_shard_progress_full_interval);
+ABSL_DECLARE_FLAG(int, slog_metalog_gap_check_interval_ms);
+ABSL_DECLARE_FLAG(size_t, slog_metalog_fetch_max_batch);
+ABSL_DECLARE_FLAG(size_t, slog_metalog_stale_gap_checks);
+ABSL_DECLARE_FLAG(double, slog_debug_metalog_drop_rate);
 
 ABSL_DECLARE_FLAG(bool, slog_enable_statecheck);
 ABSL_DECLARE_FLAG(int, slog_statecheck_interval_sec);
@@ -21,6 +42,8 @@ ABSL_DECLARE_FLAG(int, slog_storage_cache_cap_mb);
 ABSL_DECLARE_FLAG(std::string, slog_storage_backend);
 ABSL_DECLARE_FLAG(int, slog_storage_bgthread_interval_ms);
 ABSL_DECLARE_FLAG(size_t, slog_storage_max_live_entries);
+ABSL_DECLARE_FLAG(bool, slog_storage_persist_auxdata);
+ABSL_DECLARE_FLAG(size_t, slog_storage_max_auxdata_size);
 
 // ABSL_DECLARE_FLAG(size_t, cc_reorder_batch_size);
 // ABSL_DECLARE_FLAG(size_t, cc_reorder_quickselect);
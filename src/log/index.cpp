@@ -68,6 +68,10 @@ public:
                   uint64_t user_tag,
                   uint64_t* seqnum,
                   uint16_t* engine_id) const;
+    void FindInRange(uint64_t user_tag,
+                     uint64_t from_seqnum,
+                     uint64_t to_seqnum,
+                     std::vector<uint64_t>* seqnums) const;
 
 private:
     uint32_t logspace_id_;
@@ -159,6 +163,32 @@ Index::PerSpaceIndex::FindNext(uint64_t query_seqnum,
     return true;
 }
 
+void
+Index::PerSpaceIndex::FindInRange(uint64_t user_tag,
+                                  uint64_t from_seqnum,
+                                  uint64_t to_seqnum,
+                                  std::vector<uint64_t>* seqnums) const
+{
+    DCHECK_NE(user_tag, kEmptyLogTag);
+    if (!seqnums_by_tag_.contains(user_tag)) {
+        return;
+    }
+    const std::vector<uint32_t>& tag_seqnums = seqnums_by_tag_.at(user_tag);
+    auto iter = absl::c_lower_bound(
+        tag_seqnums,
+        from_seqnum,
+        [logspace_id = logspace_id_](uint32_t lhs, uint64_t rhs) {
+            return bits::JoinTwo32(logspace_id, lhs) < rhs;
+        });
+    for (; iter != tag_seqnums.end(); iter++) {
+        uint64_t seqnum = bits::JoinTwo32(logspace_id_, *iter);
+        if (seqnum >= to_seqnum) {
+            break;
+        }
+        seqnums->push_back(seqnum);
+    }
+}
+
 bool
 Index::PerSpaceIndex::FindPrev(const std::vector<uint32_t>& seqnums,
                                uint64_t query_seqnum,
@@ -301,6 +331,41 @@ Index::PollQueryResults(QueryResultVec* results)
     pending_query_results_.clear();
 }
 
+void
+Index::MakeConflictQuery(const ConflictQuery& query)
+{
+    uint16_t view_id = log_utils::GetViewId(query.metalog_progress);
+    if (view_id > view_->id()) {
+        HLOG_F(FATAL,
+               "Cannot process conflict query with metalog_progress from the future: "
+               "metalog_progress={}, my_view_id={}",
+               bits::HexStr0x(query.metalog_progress),
+               bits::HexStr0x(view_->id()));
+    }
+    uint32_t position = bits::LowHalf64(query.metalog_progress);
+    if (view_id < view_->id() || finalized() || position <= indexed_metalog_position_) {
+        ProcessConflictQuery(query);
+    } else {
+        pending_conflict_queries_.insert(std::make_pair(position, query));
+    }
+}
+
+void
+Index::PollConflictQueryResults(ConflictResultVec* results)
+{
+    if (pending_conflict_results_.empty()) {
+        return;
+    }
+    if (results->empty()) {
+        *results = std::move(pending_conflict_results_);
+    } else {
+        results->insert(results->end(),
+                        std::make_move_iterator(pending_conflict_results_.begin()),
+                        std::make_move_iterator(pending_conflict_results_.end()));
+    }
+    pending_conflict_results_.clear();
+}
+
 void
 Index::OnMetaLogApplied(const MetaLogProto& meta_log_proto)
 {
@@ -325,6 +390,10 @@ Index::OnFinalized(uint32_t metalog_position)
         ProcessQuery(query);
         iter = pending_queries_.erase(iter);
     }
+    for (const auto& [position, query]: pending_conflict_queries_) {
+        ProcessConflictQuery(query);
+    }
+    pending_conflict_queries_.clear();
 }
 
 void
@@ -378,6 +447,14 @@ Index::AdvanceIndexProgress()
         ProcessQuery(query);
         iter = pending_queries_.erase(iter);
     }
+    auto conflict_iter = pending_conflict_queries_.begin();
+    while (conflict_iter != pending_conflict_queries_.end()) {
+        if (conflict_iter->first > indexed_metalog_position_) {
+            break;
+        }
+        ProcessConflictQuery(conflict_iter->second);
+        conflict_iter = pending_conflict_queries_.erase(conflict_iter);
+    }
 }
 
 Index::PerSpaceIndex*
@@ -510,6 +587,47 @@ Index::ProcessBlockingQuery(const IndexQuery& query)
     }
 }
 
+void
+Index::ProcessConflictQuery(const ConflictQuery& query)
+{
+    HVLOG_F(1,
+            "ProcessConflictQuery: range=[{}, {}), logspace={}, num_tags={}",
+            bits::HexStr0x(query.from_seqnum),
+            bits::HexStr0x(query.to_seqnum),
+            query.user_logspace,
+            query.user_tags.size());
+    ConflictQueryResult result = {
+        .state = ConflictQueryResult::kFound,
+        .metalog_progress = index_metalog_progress(),
+        .original_query = query,
+        .seqnums = {}
+    };
+    // Logs of previous views are not in this index
+    if (bits::HighHalf64(query.from_seqnum) != identifier() ||
+        bits::HighHalf64(query.to_seqnum) != identifier() ||
+        bits::LowHalf64(query.to_seqnum) > indexed_seqnum_position_)
+    {
+        result.state = ConflictQueryResult::kIncomplete;
+        pending_conflict_results_.push_back(std::move(result));
+        return;
+    }
+    if (index_.contains(query.user_logspace)) {
+        const PerSpaceIndex* index = index_.at(query.user_logspace).get();
+        for (uint64_t user_tag: query.user_tags) {
+            index->FindInRange(user_tag, query.from_seqnum, query.to_seqnum,
+                               &result.seqnums);
+        }
+    }
+    absl::c_sort(result.seqnums, std::greater<uint64_t>());
+    result.seqnums.erase(absl::c_unique(result.seqnums), result.seqnums.end());
+    if (result.seqnums.size() > kMaxConflictSeqnums) {
+        result.state = ConflictQueryResult::kIncomplete;
+        result.seqnums.clear();
+    }
+    HVLOG_F(1, "ProcessConflictQuery: found {} logs", result.seqnums.size());
+    pending_conflict_results_.push_back(std::move(result));
+}
+
 bool
 Index::IndexFindNext(const IndexQuery& query, uint64_t* seqnum, uint16_t* engine_id)
 {
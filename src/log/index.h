@@ -42,6 +42,28 @@ struct IndexQueryResult {
     IndexFoundResult found_result;
 };
 
+// Finds logs with any of user_tags within [from_seqnum, to_seqnum),
+// which conflict with a txn started at from_seqnum and committed at to_seqnum
+struct ConflictQuery {
+    uint64_t client_data;
+    uint32_t user_logspace;
+    UserTagVec user_tags;
+    uint64_t from_seqnum;
+    uint64_t to_seqnum;
+    uint64_t metalog_progress;
+};
+
+struct ConflictQueryResult {
+    // kIncomplete if the range is not fully covered by this index,
+    // or too many logs are found
+    enum State { kFound, kIncomplete };
+    State state;
+    uint64_t metalog_progress;
+
+    ConflictQuery original_query;
+    std::vector<uint64_t> seqnums;  // In descending order
+};
+
 class Index final: public LogSpaceBase {
 public:
     static constexpr absl::Duration kBlockingQueryTimeout = absl::Seconds(1);
@@ -56,6 +78,15 @@ public:
     using QueryResultVec = absl::InlinedVector<IndexQueryResult, 4>;
     void PollQueryResults(QueryResultVec* results);
 
+    // Results must fit in the inline data of a response message
+    static constexpr size_t kMaxConflictSeqnums =
+        MESSAGE_INLINE_DATA_SIZE / sizeof(uint64_t);
+
+    void MakeConflictQuery(const ConflictQuery& query);
+
+    using ConflictResultVec = std::vector<ConflictQueryResult>;
+    void PollConflictQueryResults(ConflictResultVec* results);
+
 private:
     class PerSpaceIndex;
     absl::flat_hash_map</* user_logspace */ uint32_t, std::unique_ptr<PerSpaceIndex>>
@@ -69,6 +100,10 @@ private:
         blocking_reads_;
     QueryResultVec pending_query_results_;
 
+    std::multimap</* metalog_position */ uint32_t, ConflictQuery>
+        pending_conflict_queries_;
+    ConflictResultVec pending_conflict_results_;
+
     std::deque<std::pair</* metalog_seqnum */ uint32_t,
                          /* end_seqnum */ uint32_t>>
         cuts_;
@@ -97,6 +132,7 @@ private:
     void ProcessReadNext(const IndexQuery& query);
     void ProcessReadPrev(const IndexQuery& query);
     bool ProcessBlockingQuery(const IndexQuery& query);
+    void ProcessConflictQuery(const ConflictQuery& query);
 
     bool IndexFindNext(const IndexQuery& query,
                        uint64_t* seqnum,
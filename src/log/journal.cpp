@@ -0,0 +1,268 @@
+#include "log/journal.h"
+
+#include "common/time.h"
+#include "utils/fs.h"
+#include "utils/hash.h"
+
+#include <fcntl.h>
+
+namespace faas { namespace log {
+
+MetaLogJournal::MetaLogJournal(uint32_t logspace_id,
+                               std::string_view file_path,
+                               server::IOWorker* io_worker,
+                               PersistedCallback persisted_cb)
+    : logspace_id_(logspace_id),
+      file_path_(file_path),
+      io_worker_(io_worker),
+      persisted_cb_(persisted_cb),
+      log_header_(fmt::format("MetaLogJournal[{}]: ", bits::HexStr0x(logspace_id))),
+      fd_(-1),
+      fd_registered_(false),
+      file_size_(0),
+      buffered_position_(0),
+      flush_inflight_(false),
+      flushing_offset_(0),
+      flushing_position_(0),
+      persisted_position_(0),
+      flush_delay_stat_(stat::StatisticsCollector<int>::StandardReportCallback(
+          "metalog_journal_flush_delay")),
+      flush_size_stat_(stat::StatisticsCollector<uint32_t>::StandardReportCallback(
+          "metalog_journal_flush_size")),
+      flush_start_timestamp_(0)
+{}
+
+MetaLogJournal::~MetaLogJournal()
+{
+    // Registered fds are closed by IOUring
+    if (fd_ != -1 && !fd_registered_) {
+        PCHECK(close(fd_) == 0) << "Failed to close journal file";
+    }
+}
+
+std::string
+MetaLogJournal::FilePath(std::string_view dir, uint32_t logspace_id)
+{
+    return fs_utils::JoinPath(dir, fmt::format("metalog_{:08x}", logspace_id));
+}
+
+uint32_t
+MetaLogJournal::ComputeChecksum(std::span<const char> data)
+{
+    return bits::LowHalf64(
+        XXH64(data.data(), data.size(), hash::kDefaultHashSeed64));
+}
+
+bool
+MetaLogJournal::Open(std::vector<MetaLogProto>* metalogs)
+{
+    DCHECK_EQ(fd_, -1);
+    metalogs->clear();
+    if (fs_utils::Exists(file_path_)) {
+        std::string contents;
+        if (!fs_utils::ReadContents(file_path_, &contents)) {
+            return false;
+        }
+        size_t pos = 0;
+        while (pos + sizeof(RecordHeader) <= contents.size()) {
+            RecordHeader header;
+            memcpy(&header, contents.data() + pos, sizeof(RecordHeader));
+            if (pos + sizeof(RecordHeader) + header.size > contents.size()) {
+                break;
+            }
+            std::span<const char> data(contents.data() + pos + sizeof(RecordHeader),
+                                       header.size);
+            if (ComputeChecksum(data) != header.checksum) {
+                HLOG_F(WARNING, "Checksum mismatch at offset {}", pos);
+                break;
+            }
+            MetaLogProto metalog;
+            if (!metalog.ParseFromArray(data.data(), static_cast<int>(data.size()))) {
+                HLOG_F(WARNING, "Failed to parse metalog at offset {}", pos);
+                break;
+            }
+            if (metalog.logspace_id() != logspace_id_ ||
+                metalog.metalog_seqnum() != metalogs->size()) {
+                HLOG_F(ERROR,
+                       "Unexpected metalog at offset {}: logspace_id={}, seqnum={}",
+                       pos,
+                       bits::HexStr0x(metalog.logspace_id()),
+                       metalog.metalog_seqnum());
+                return false;
+            }
+            metalogs->push_back(std::move(metalog));
+            pos += sizeof(RecordHeader) + header.size;
+        }
+        if (pos < contents.size()) {
+            HLOG_F(WARNING,
+                   "Truncate torn tail: file_size={}, valid_size={}",
+                   contents.size(),
+                   pos);
+            if (truncate(file_path_.c_str(), static_cast<off_t>(pos)) != 0) {
+                PLOG(ERROR) << "Failed to truncate " << file_path_;
+                return false;
+            }
+        }
+        file_size_ = pos;
+        auto fd = fs_utils::Open(file_path_, O_WRONLY);
+        if (!fd.has_value()) {
+            return false;
+        }
+        fd_ = *fd;
+    } else {
+        auto fd = fs_utils::Create(file_path_);
+        if (!fd.has_value()) {
+            return false;
+        }
+        fd_ = *fd;
+    }
+    absl::MutexLock lk(&mu_);
+    buffered_position_ = gsl::narrow_cast<uint32_t>(metalogs->size());
+    flushing_position_ = buffered_position_;
+    persisted_position_.store(buffered_position_, std::memory_order_release);
+    HLOG_F(INFO,
+           "Opened {}: {} metalogs, {} bytes",
+           file_path_,
+           metalogs->size(),
+           file_size_);
+    return true;
+}
+
+void
+MetaLogJournal::Append(const MetaLogProto& metalog)
+{
+    DCHECK_EQ(metalog.logspace_id(), logspace_id_);
+    std::string data;
+    CHECK(metalog.SerializeToString(&data));
+    RecordHeader header = {
+        .size = gsl::narrow_cast<uint32_t>(data.size()),
+        .checksum = ComputeChecksum(STRING_AS_SPAN(data)),
+    };
+    absl::MutexLock lk(&mu_);
+    DCHECK_EQ(metalog.metalog_seqnum(), buffered_position_);
+    buffer_.append(reinterpret_cast<const char*>(&header), sizeof(RecordHeader));
+    buffer_.append(data);
+    buffered_position_ = metalog.metalog_seqnum() + 1;
+}
+
+void
+MetaLogJournal::Flush()
+{
+    DCHECK(io_worker_->WithinMyEventLoopThread());
+    DCHECK_NE(fd_, -1);
+    if (flush_inflight_) {
+        // Appends during an inflight flush are picked up once it finishes
+        return;
+    }
+    bool buffer_empty = false;
+    {
+        absl::MutexLock lk(&mu_);
+        if (buffer_.empty()) {
+            buffer_empty = true;
+        } else {
+            flushing_data_.clear();
+            flushing_data_.swap(buffer_);
+            flushing_position_ = buffered_position_;
+        }
+    }
+    if (buffer_empty) {
+        if (close_cb_) {
+            CloseFile();
+        }
+        return;
+    }
+    if (!fd_registered_) {
+        URING_CHECK_OK(io_worker_->io_uring()->RegisterFd(fd_));
+        fd_registered_ = true;
+    }
+    flush_inflight_ = true;
+    flushing_offset_ = 0;
+    flush_start_timestamp_ = GetMonotonicMicroTimestamp();
+    flush_size_stat_.AddSample(gsl::narrow_cast<uint32_t>(flushing_data_.size()));
+    WriteFlushingData();
+}
+
+void
+MetaLogJournal::WriteFlushingData()
+{
+    DCHECK_LT(flushing_offset_, flushing_data_.size());
+    std::span<const char> data(flushing_data_.data() + flushing_offset_,
+                               flushing_data_.size() - flushing_offset_);
+    URING_CHECK_OK(io_worker_->io_uring()->WriteAt(
+        fd_, file_size_, data,
+        [this] (int status, size_t nwrite) {
+            if (status != 0) {
+                PLOG(FATAL) << "Failed to write " << file_path_;
+            }
+            file_size_ += nwrite;
+            flushing_offset_ += nwrite;
+            if (flushing_offset_ < flushing_data_.size()) {
+                WriteFlushingData();
+            } else {
+                SyncFlushingData();
+            }
+        }));
+}
+
+void
+MetaLogJournal::SyncFlushingData()
+{
+    URING_CHECK_OK(io_worker_->io_uring()->Fsync(
+        fd_, /* datasync= */ true,
+        [this] (int status) {
+            if (status != 0) {
+                PLOG(FATAL) << "Failed to fdatasync " << file_path_;
+            }
+            OnFlushFinished();
+        }));
+}
+
+void
+MetaLogJournal::OnFlushFinished()
+{
+    flush_delay_stat_.AddSample(gsl::narrow_cast<int>(
+        GetMonotonicMicroTimestamp() - flush_start_timestamp_));
+    flush_inflight_ = false;
+    uint32_t start_position = persisted_position_.load(std::memory_order_relaxed);
+    HVLOG_F(1,
+            "Persisted metalogs: start_position={}, end_position={}",
+            start_position,
+            flushing_position_);
+    persisted_position_.store(flushing_position_, std::memory_order_release);
+    persisted_cb_(start_position, flushing_position_);
+    Flush();
+}
+
+void
+MetaLogJournal::Close(std::function<void()> cb)
+{
+    DCHECK(io_worker_->WithinMyEventLoopThread());
+    DCHECK(!close_cb_);
+    close_cb_ = cb;
+    // Closed once buffered metalogs are persisted
+    Flush();
+}
+
+void
+MetaLogJournal::CloseFile()
+{
+    DCHECK(!flush_inflight_);
+    auto on_closed = [this] () {
+        fd_ = -1;
+        fd_registered_ = false;
+        if (!fs_utils::Remove(file_path_)) {
+            HLOG_F(WARNING, "Failed to remove {}", file_path_);
+        }
+        HLOG_F(INFO, "Closed {}", file_path_);
+        std::function<void()> cb = std::move(close_cb_);
+        cb();
+    };
+    if (fd_registered_) {
+        URING_CHECK_OK(io_worker_->io_uring()->Close(fd_, on_closed));
+    } else {
+        PCHECK(close(fd_) == 0) << "Failed to close journal file";
+        on_closed();
+    }
+}
+
+}} // namespace faas::log
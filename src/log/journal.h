@@ -0,0 +1,96 @@
+#pragma once
+
+#include "common/stat.h"
+#include "log/common.h"
+#include "server/io_worker.h"
+
+namespace faas { namespace log {
+
+// Append-only on-disk copy of metalogs of one LogSpace. Appended metalogs
+// are buffered, and written out by Flush with a single fdatasync covering
+// all of them (group commit). Each record is a RecordHeader followed by
+// the serialized MetaLogProto.
+class MetaLogJournal {
+public:
+    // Called within the owner IOWorker, once metalogs with seqnums in
+    // [start_position, end_position) are persisted
+    using PersistedCallback = std::function<void(uint32_t /* start_position */,
+                                                 uint32_t /* end_position */)>;
+
+    MetaLogJournal(uint32_t logspace_id,
+                   std::string_view file_path,
+                   server::IOWorker* io_worker,
+                   PersistedCallback persisted_cb);
+    ~MetaLogJournal();
+
+    uint32_t logspace_id() const { return logspace_id_; }
+    server::IOWorker* io_worker() const { return io_worker_; }
+    // Thread-safe
+    uint32_t persisted_position() const {
+        return persisted_position_.load(std::memory_order_acquire);
+    }
+
+    // Read back metalogs from the journal file, and open it for further
+    // appends. A torn record at the tail is truncated away.
+    bool Open(std::vector<MetaLogProto>* metalogs);
+
+    // Thread-safe, metalogs must be appended in order of metalog_seqnum
+    void Append(const MetaLogProto& metalog);
+
+    // Must be called within the owner IOWorker
+    void Flush();
+
+    // Must be called within the owner IOWorker. Buffered metalogs are
+    // flushed first, then the file is closed and removed, and `cb` runs.
+    // The journal can be deleted within `cb`.
+    void Close(std::function<void()> cb);
+
+    // Logspace ids include the view id, and metalog seqnums restart from 0
+    // in every view. Thus a journal is only replayed by a sequencer that
+    // restarts within the same view, and is closed once the view is
+    // finalized.
+    static std::string FilePath(std::string_view dir, uint32_t logspace_id);
+
+private:
+    struct RecordHeader {
+        uint32_t size;
+        uint32_t checksum;
+    } __attribute__((packed));
+
+    const uint32_t logspace_id_;
+    const std::string file_path_;
+    server::IOWorker* io_worker_;
+    PersistedCallback persisted_cb_;
+    std::string log_header_;
+
+    int fd_;
+    bool fd_registered_;
+    uint64_t file_size_;
+
+    absl::Mutex mu_;
+    std::string buffer_ ABSL_GUARDED_BY(mu_);
+    uint32_t buffered_position_ ABSL_GUARDED_BY(mu_);
+
+    // Only accessed within the owner IOWorker
+    bool flush_inflight_;
+    std::string flushing_data_;
+    size_t flushing_offset_;
+    uint32_t flushing_position_;
+    std::atomic<uint32_t> persisted_position_;
+    std::function<void()> close_cb_;
+
+    stat::StatisticsCollector<int> flush_delay_stat_;
+    stat::StatisticsCollector<uint32_t> flush_size_stat_;
+    int64_t flush_start_timestamp_;
+
+    void WriteFlushingData();
+    void SyncFlushingData();
+    void OnFlushFinished();
+    void CloseFile();
+
+    static uint32_t ComputeChecksum(std::span<const char> data);
+
+    DISALLOW_COPY_AND_ASSIGN(MetaLogJournal);
+};
+
+}} // namespace faas::log
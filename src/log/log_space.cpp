@@ -12,6 +12,11 @@
 #include <cstdint>
 #include <optional>
 
+__BEGIN_THIRD_PARTY_HEADERS
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+__END_THIRD_PARTY_HEADERS
+
 namespace faas { namespace log {
 
 template <>
@@ -44,6 +49,8 @@ ProtoBuffer<PerEngineIndexProto>::nextPosition(PerEngineIndexProto* proto)
 
 MetaLogPrimary::MetaLogPrimary(const View* view, uint16_t sequencer_id)
     : LogSpaceBase(LogSpaceBase::kFullMode, view, sequencer_id),
+      metalog_progresses_(sequencer_node_->GetReplicaSequencerNodes().size() -
+                          sequencer_node_->GetReplicaSequencerNodes().size() / 2),
       replicated_metalog_position_(0)
 {
     for (uint16_t engine_id: view_->GetEngineNodes()) {
@@ -55,7 +62,7 @@ MetaLogPrimary::MetaLogPrimary(const View* view, uint16_t sequencer_id)
         last_cut_[engine_id] = 0;
     }
     for (uint16_t sequencer_id: sequencer_node_->GetReplicaSequencerNodes()) {
-        metalog_progresses_[sequencer_id] = 0;
+        metalog_progresses_.Add(sequencer_id, 0);
     }
     log_header_ = fmt::format("MetaLogPrimary[{}]: ", view->id());
     if (metalog_progresses_.empty()) {
@@ -68,7 +75,7 @@ MetaLogPrimary::~MetaLogPrimary() {}
 
 void
 MetaLogPrimary::UpdateStorageProgress(uint16_t storage_id,
-                                      const std::vector<uint32_t>& progress)
+                                      std::span<const char> progress)
 {
     if (!view_->contains_storage_node(storage_id)) {
         HLOG_F(FATAL,
@@ -78,29 +85,178 @@ MetaLogPrimary::UpdateStorageProgress(uint16_t storage_id,
     }
     const View::Storage* storage_node = view_->GetStorageNode(storage_id);
     const View::NodeIdVec& engine_node_ids = storage_node->GetSourceEngineNodes();
-    if (progress.size() != engine_node_ids.size()) {
+    size_t num_shards = progress.size() / sizeof(uint32_t);
+    if (num_shards != engine_node_ids.size()) {
         HLOG_F(FATAL,
                "Size does not match: have={}, expected={}",
-               progress.size(),
+               num_shards,
                engine_node_ids.size());
     }
-    for (size_t i = 0; i < progress.size(); i++) {
-        uint16_t engine_id = engine_node_ids[i];
-        auto pair = std::make_pair(engine_id, storage_id);
-        DCHECK(shard_progrsses_.contains(pair));
-        if (progress[i] > shard_progrsses_[pair]) {
-            shard_progrsses_[pair] = progress[i];
-            uint32_t current_position = GetShardReplicatedPosition(engine_id);
-            DCHECK_GE(current_position, last_cut_.at(engine_id));
-            if (current_position > last_cut_.at(engine_id)) {
-                HVLOG_F(1,
-                        "Store progress from storage {} for engine {}: {}",
-                        storage_id,
-                        engine_id,
-                        bits::HexStr0x(current_position));
-                dirty_shards_.insert(engine_id);
+    for (size_t i = 0; i < num_shards; i++) {
+        uint32_t shard_progress;
+        memcpy(&shard_progress, progress.data() + i * sizeof(uint32_t), sizeof(uint32_t));
+        UpdateShardProgress(engine_node_ids[i], storage_id, shard_progress);
+    }
+}
+
+namespace {
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::internal::WireFormatLite;
+
+// Calls `fn` on every element of a repeated uint32 field, packed or not,
+// whose `tag` is just read
+template <class Fn>
+bool ReadRepeatedUint32(CodedInputStream* input, uint32_t tag, Fn&& fn)
+{
+    uint32_t value;
+    switch (WireFormatLite::GetTagWireType(tag)) {
+    case WireFormatLite::WIRETYPE_VARINT:
+        if (!input->ReadVarint32(&value)) {
+            return false;
+        }
+        fn(value);
+        return true;
+    case WireFormatLite::WIRETYPE_LENGTH_DELIMITED: {
+        uint32_t length;
+        if (!input->ReadVarint32(&length)) {
+            return false;
+        }
+        auto limit = input->PushLimit(static_cast<int>(length));
+        while (input->BytesUntilLimit() > 0) {
+            if (!input->ReadVarint32(&value)) {
+                return false;
+            }
+            fn(value);
+        }
+        input->PopLimit(limit);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+} // namespace
+
+void
+MetaLogPrimary::UpdateStorageProgressDelta(uint16_t storage_id,
+                                           std::span<const char> payload,
+                                           std::vector<uint32_t>* logspace_loads)
+{
+    if (!view_->contains_storage_node(storage_id)) {
+        HLOG_F(FATAL,
+               "View {} does not has storage node {}",
+               view_->id(),
+               storage_id);
+    }
+    const View::Storage* storage_node = view_->GetStorageNode(storage_id);
+    const View::NodeIdVec& engine_node_ids = storage_node->GetSourceEngineNodes();
+    // Fields are read in place from the wire format, in any order and with
+    // unknown ones skipped. The first pass only reads report_seqnum and full,
+    // so that nothing of a rejected report is applied or recorded.
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(payload.data());
+    int size = static_cast<int>(payload.size());
+    uint32_t report_seqnum = 0;
+    bool full = false;
+    {
+        CodedInputStream input(data, size);
+        bool malformed = false;
+        while (uint32_t tag = input.ReadTag()) {
+            uint32_t value = 0;
+            switch (WireFormatLite::GetTagFieldNumber(tag)) {
+            case ShardProgressDeltaProto::kReportSeqnumFieldNumber:
+                malformed = !input.ReadVarint32(&report_seqnum);
+                break;
+            case ShardProgressDeltaProto::kFullFieldNumber:
+                malformed = !input.ReadVarint32(&value);
+                full = (value != 0);
+                break;
+            default:
+                malformed = !WireFormatLite::SkipField(&input, tag);
+            }
+            if (malformed) {
+                break;
             }
         }
+        if (malformed || !input.ConsumedEntireMessage()) {
+            HLOG_F(ERROR, "Failed to parse shard progress from storage {}", storage_id);
+            return;
+        }
+    }
+    if (!full && !(next_report_seqnums_.contains(storage_id) &&
+                   next_report_seqnums_.at(storage_id) == report_seqnum)) {
+        HLOG_F(WARNING,
+               "Missed shard progress reports from storage {}, "
+               "wait for the next full report: received={}",
+               storage_id,
+               report_seqnum);
+        return;
+    }
+    size_t idx = 0;
+    std::optional<uint32_t> skipped;
+    auto apply_update = [&, this] (uint32_t value) {
+        if (!skipped.has_value()) {
+            skipped = value;
+            return;
+        }
+        idx += *skipped;
+        skipped.reset();
+        if (idx >= engine_node_ids.size()) {
+            HLOG_F(FATAL,
+                   "Shard index out of range: have={}, expected<{}",
+                   idx,
+                   engine_node_ids.size());
+        }
+        uint16_t engine_id = engine_node_ids[idx];
+        uint32_t base = full ? 0 : shard_progrsses_.at(
+            std::make_pair(engine_id, storage_id));
+        UpdateShardProgress(engine_id, storage_id, base + value);
+        idx++;
+    };
+    auto record_load = [logspace_loads] (uint32_t value) {
+        logspace_loads->push_back(value);
+    };
+    CodedInputStream input(data, size);
+    while (uint32_t tag = input.ReadTag()) {
+        bool ok;
+        switch (WireFormatLite::GetTagFieldNumber(tag)) {
+        case ShardProgressDeltaProto::kShardUpdatesFieldNumber:
+            ok = ReadRepeatedUint32(&input, tag, apply_update);
+            break;
+        case ShardProgressDeltaProto::kLogspaceLoadsFieldNumber:
+            ok = ReadRepeatedUint32(&input, tag, record_load);
+            break;
+        default:
+            ok = WireFormatLite::SkipField(&input, tag);
+        }
+        if (!ok) {
+            HLOG_F(FATAL, "Malformed shard progress from storage {}", storage_id);
+        }
+    }
+    if (skipped.has_value()) {
+        HLOG_F(FATAL, "Malformed shard progress from storage {}", storage_id);
+    }
+    next_report_seqnums_[storage_id] = report_seqnum + 1;
+}
+
+void
+MetaLogPrimary::UpdateShardProgress(uint16_t engine_id,
+                                    uint16_t storage_id,
+                                    uint32_t progress)
+{
+    auto pair = std::make_pair(engine_id, storage_id);
+    DCHECK(shard_progrsses_.contains(pair));
+    if (progress > shard_progrsses_[pair]) {
+        shard_progrsses_[pair] = progress;
+        uint32_t current_position = GetShardReplicatedPosition(engine_id);
+        DCHECK_GE(current_position, last_cut_.at(engine_id));
+        if (current_position > last_cut_.at(engine_id)) {
+            HVLOG_F(1,
+                    "Store progress from storage {} for engine {}: {}",
+                    storage_id,
+                    engine_id,
+                    bits::HexStr0x(current_position));
+            dirty_shards_.insert(engine_id);
+        }
     }
 }
 
@@ -119,17 +275,30 @@ MetaLogPrimary::UpdateReplicaProgress(uint16_t sequencer_id,
                metalog_position,
                metalog_position_);
     }
-    DCHECK(metalog_progresses_.contains(sequencer_id));
-    if (metalog_position > metalog_progresses_[sequencer_id]) {
+    std::optional<uint32_t> progress = metalog_progresses_.Get(sequencer_id);
+    DCHECK(progress.has_value());
+    if (metalog_position > *progress) {
         HVLOG(1) << fmt::format("Replica {} progress: {} -> {}",
                                 sequencer_id,
-                                metalog_progresses_[sequencer_id],
+                                *progress,
                                 metalog_position);
-        metalog_progresses_[sequencer_id] = metalog_position;
+        metalog_progresses_.Update(sequencer_id, metalog_position);
         UpdateMetaLogReplicatedPosition();
     }
 }
 
+uint32_t
+MetaLogPrimary::GetLowestReplicaPosition() const
+{
+    uint32_t position = metalog_position_;
+    for (uint16_t sequencer_id: sequencer_node_->GetReplicaSequencerNodes()) {
+        std::optional<uint32_t> progress = metalog_progresses_.Get(sequencer_id);
+        DCHECK(progress.has_value());
+        position = std::min(position, *progress);
+    }
+    return position;
+}
+
 std::optional<MetaLogProto>
 MetaLogPrimary::MarkNextCut()
 {
@@ -177,22 +346,34 @@ MetaLogPrimary::UpdateMetaLogReplicatedPosition()
     if (metalog_progresses_.empty()) {
         return;
     }
-    std::vector<uint32_t> tmp;
-    tmp.reserve(metalog_progresses_.size());
-    std::string progress_str = "metalog progress: ";
-    for (const auto& [sequencer_id, progress]: metalog_progresses_) {
-        tmp.push_back(progress);
-        progress_str += fmt::format("{}:{} ", sequencer_id, progress);
-    }
-    absl::c_sort(tmp);
-    uint32_t progress = tmp.at(tmp.size() / 2);
+    uint32_t progress = metalog_progresses_.kth_largest();
     DCHECK_GE(progress, replicated_metalog_position_);
     DCHECK_LE(progress, metalog_position_);
     replicated_metalog_position_ = progress;
-    HVLOG(1) << progress_str
-             << fmt::format("replicated {}/{}",
-                            replicated_metalog_position_,
-                            metalog_position_);
+    HVLOG_F(1,
+            "metalog progress: replicated {}/{}",
+            replicated_metalog_position_,
+            metalog_position_);
+}
+
+void
+MetaLogPrimary::OnNewLogs(uint32_t metalog_seqnum,
+                          uint64_t start_seqnum,
+                          uint64_t start_localid,
+                          uint32_t delta)
+{
+    uint16_t engine_id = gsl::narrow_cast<uint16_t>(bits::HighHalf64(start_localid));
+    uint32_t end_position = bits::LowHalf64(start_localid) + delta;
+    DCHECK(last_cut_.contains(engine_id));
+    if (end_position <= last_cut_.at(engine_id)) {
+        return;
+    }
+    last_cut_[engine_id] = end_position;
+    const View::Engine* engine_node = view_->GetEngineNode(engine_id);
+    for (uint16_t storage_id: engine_node->GetStorageNodes()) {
+        auto pair = std::make_pair(engine_id, storage_id);
+        shard_progrsses_[pair] = std::max(shard_progrsses_[pair], end_position);
+    }
 }
 
 uint32_t
@@ -285,6 +466,9 @@ LogStorage::LogStorage(uint16_t storage_id, const View* view, uint16_t sequencer
     : LogSpaceBase(LogSpaceBase::kLiteMode, view, sequencer_id),
       storage_node_(view_->GetStorageNode(storage_id)),
       shard_progrss_dirty_(false),
+      delta_shard_progress_(false),
+      next_report_seqnum_(0),
+      sent_shard_progress_(storage_node_->GetSourceEngineNodes().size(), 0),
       persisted_seqnum_position_(0)
 {
     for (uint16_t engine_id: storage_node_->GetSourceEngineNodes()) {
@@ -322,6 +506,7 @@ LogStorage::Store(const LogMetaData& log_metadata,
         .user_tags = UserTagVec(user_tags.begin(), user_tags.end()),
         .data = std::string(log_data.data(), log_data.size()),
     });
+    logspace_appends_[log_metadata.user_logspace]++;
     AdvanceShardProgress(engine_id);
     return true;
 }
@@ -413,6 +598,54 @@ LogStorage::GrabShardProgressForSending()
     return progress;
 }
 
+std::optional<std::string>
+LogStorage::GrabShardProgressDeltaForSending(size_t full_interval)
+{
+    if (!shard_progrss_dirty_) {
+        return std::nullopt;
+    }
+    DCHECK_GT(full_interval, 0U);
+    bool full = (next_report_seqnum_ % full_interval == 0);
+    ShardProgressDeltaProto delta_proto;
+    delta_proto.set_report_seqnum(next_report_seqnum_++);
+    delta_proto.set_full(full);
+    const View::NodeIdVec& engine_node_ids = storage_node_->GetSourceEngineNodes();
+    uint32_t skipped = 0;
+    for (size_t i = 0; i < engine_node_ids.size(); i++) {
+        uint32_t progress = shard_progrsses_[engine_node_ids[i]];
+        uint32_t base = full ? 0 : sent_shard_progress_[i];
+        if (full || progress > base) {
+            delta_proto.add_shard_updates(skipped);
+            delta_proto.add_shard_updates(progress - base);
+            skipped = 0;
+        } else {
+            skipped++;
+        }
+        sent_shard_progress_[i] = progress;
+    }
+    for (const auto& [user_logspace, appends]: logspace_appends_) {
+        delta_proto.add_logspace_loads(user_logspace);
+        delta_proto.add_logspace_loads(appends);
+    }
+    logspace_appends_.clear();
+    shard_progrss_dirty_ = false;
+    std::string payload;
+    CHECK(delta_proto.SerializeToString(&payload));
+    return payload;
+}
+
+size_t
+LogStorage::GrabLogSpaceLoadsForSending(std::vector<uint32_t>* loads)
+{
+    size_t count = logspace_appends_.size();
+    for (const auto& [user_logspace, appends]: logspace_appends_) {
+        loads->push_back(user_logspace);
+        loads->push_back(appends);
+    }
+    logspace_appends_.clear();
+    return count;
+}
+
 void
 LogStorage::OnNewLogs(uint32_t metalog_seqnum,
                       uint64_t start_seqnum,
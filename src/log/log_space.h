@@ -6,6 +6,7 @@
 #include "proto/shared_log.pb.h"
 #include "log/engine_base.h"
 #include "utils/object_pool.h"
+#include "utils/kth_largest.h"
 #include <cstdint>
 #include <deque>
 #include <memory>
@@ -106,11 +107,23 @@ public:
     {
         return replicated_metalog_position_ == metalog_position();
     }
+    uint32_t num_inflight_metalogs() const
+    {
+        return metalog_position() - replicated_metalog_position_;
+    }
 
-    void UpdateStorageProgress(uint16_t storage_id,
-                               const std::vector<uint32_t>& progress);
+    // `progress` holds one uint32_t per source engine of the storage node
+    void UpdateStorageProgress(uint16_t storage_id, std::span<const char> progress);
+    // Parses a ShardProgressDeltaProto, and appends its
+    // (user_logspace, appends) pairs to `logspace_loads`
+    void UpdateStorageProgressDelta(uint16_t storage_id,
+                                    std::span<const char> payload,
+                                    std::vector<uint32_t>* logspace_loads);
     void UpdateReplicaProgress(uint16_t sequencer_id, uint32_t metalog_position);
     std::optional<MetaLogProto> MarkNextCut();
+    // Lowest metalog position acknowledged by any replica. A replica may
+    // lack every metalog from this position.
+    uint32_t GetLowestReplicaPosition() const;
 
 private:
     absl::flat_hash_set</* engine_id */ uint16_t> dirty_shards_;
@@ -119,12 +132,24 @@ private:
                                   /* storage_id */ uint16_t>,
                         uint32_t>
         shard_progrsses_;
+    // Expected report_seqnum of the next delta-encoded report
+    absl::flat_hash_map</* storage_id */ uint16_t, uint32_t> next_report_seqnums_;
 
-    absl::flat_hash_map</* sequencer_id */ uint16_t, uint32_t> metalog_progresses_;
+    // Replicated position is the median of replica progresses
+    utils::KthLargestTracker</* sequencer_id */ uint16_t, uint32_t>
+        metalog_progresses_;
     uint32_t replicated_metalog_position_;
 
     uint32_t GetShardReplicatedPosition(uint16_t engine_id) const;
     void UpdateMetaLogReplicatedPosition();
+    void UpdateShardProgress(uint16_t engine_id, uint16_t storage_id, uint32_t progress);
+
+    // No-op for cuts made by MarkNextCut, but restores cut positions
+    // when metalogs are replayed from the journal
+    void OnNewLogs(uint32_t metalog_seqnum,
+                   uint64_t start_seqnum,
+                   uint64_t start_localid,
+                   uint32_t delta) override;
 
     DISALLOW_COPY_AND_ASSIGN(MetaLogPrimary);
 };
@@ -200,6 +225,16 @@ public:
 
     std::optional<IndexDataProto> PollIndexData();
     std::optional<std::vector<uint32_t>> GrabShardProgressForSending();
+    // Appends (user_logspace, count) pairs of logs stored since last call
+    // to `loads`, which are sent along with shard progress
+    size_t GrabLogSpaceLoadsForSending(std::vector<uint32_t>* loads);
+
+    // Set once the primary sequencer advertises kShardProgDeltaFlag
+    bool delta_shard_progress() const { return delta_shard_progress_; }
+    void EnableDeltaShardProgress() { delta_shard_progress_ = true; }
+    // Returns a serialized ShardProgressDeltaProto, which also carries
+    // loads of user logspaces. Every `full_interval`-th report is full.
+    std::optional<std::string> GrabShardProgressDeltaForSending(size_t full_interval);
 
 private:
     const View::Storage* storage_node_;
@@ -209,6 +244,13 @@ private:
                         /* localid */ uint32_t>
         shard_progrsses_;
 
+    bool delta_shard_progress_;
+    uint32_t next_report_seqnum_;
+    // Progress of source engines in the last delta-encoded report
+    std::vector<uint32_t> sent_shard_progress_;
+    absl::flat_hash_map</* user_logspace */ uint32_t, /* appends */ uint32_t>
+        logspace_appends_;
+
     uint64_t persisted_seqnum_position_;
     std::deque<uint64_t> live_seqnums_;
     absl::flat_hash_map</* seqnum */ uint64_t, std::shared_ptr<const LogEntry>>
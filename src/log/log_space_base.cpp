@@ -1,7 +1,14 @@
 #include "log/log_space_base.h"
 
+#include "log/flags.h"
 #include "utils/bits.h"
 
+__BEGIN_THIRD_PARTY_HEADERS
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
+__END_THIRD_PARTY_HEADERS
+
 namespace faas { namespace log {
 
 LogSpaceBase::LogSpaceBase(Mode mode, const View* view, uint16_t sequencer_id)
@@ -12,7 +19,13 @@ LogSpaceBase::LogSpaceBase(Mode mode, const View* view, uint16_t sequencer_id)
       metalog_position_(0),
       log_header_(fmt::format("LogSpace[{}-{}]: ", view->id(), sequencer_id)),
       shard_progrsses_(view->num_engine_nodes(), 0),
-      seqnum_position_(0)
+      seqnum_position_(0),
+      gap_position_(0),
+      gap_checks_(0),
+      stale_gap_checks_(absl::GetFlag(FLAGS_slog_metalog_stale_gap_checks)),
+      stale_position_(0),
+      stale_checks_(0),
+      stale_backoff_(1)
 {}
 
 LogSpaceBase::~LogSpaceBase() {}
@@ -38,6 +51,32 @@ LogSpaceBase::GetMetaLog(uint32_t pos) const
     return *applied_metalogs_.at(pos);
 }
 
+uint32_t
+LogSpaceBase::SerializeMetaLogs(uint32_t start_position,
+                                uint32_t end_position,
+                                std::string* payload) const
+{
+    using google::protobuf::internal::WireFormatLite;
+    DCHECK(mode_ == kFullMode);
+    end_position = std::min(end_position, metalog_position_);
+    if (start_position >= end_position) {
+        return 0;
+    }
+    google::protobuf::io::StringOutputStream stream(payload);
+    google::protobuf::io::CodedOutputStream output(&stream);
+    WireFormatLite::WriteUInt32(MetaLogsProto::kLogspaceIdFieldNumber,
+                                identifier(), &output);
+    for (uint32_t pos = start_position; pos < end_position; pos++) {
+        const MetaLogProto* metalog = applied_metalogs_.at(pos);
+        output.WriteTag(WireFormatLite::MakeTag(
+            MetaLogsProto::kMetalogsFieldNumber,
+            WireFormatLite::WIRETYPE_LENGTH_DELIMITED));
+        output.WriteVarint32(gsl::narrow_cast<uint32_t>(metalog->ByteSizeLong()));
+        metalog->SerializeWithCachedSizes(&output);
+    }
+    return end_position - start_position;
+}
+
 bool
 LogSpaceBase::ProvideMetaLog(const MetaLogProto& meta_log)
 {
@@ -60,6 +99,59 @@ LogSpaceBase::ProvideMetaLog(const MetaLogProto& meta_log)
     return metalog_position_ > prev_metalog_position;
 }
 
+std::optional<LogSpaceBase::MetaLogGap>
+LogSpaceBase::CheckMetaLogGap()
+{
+    if (pending_metalogs_.empty()) {
+        gap_checks_ = 0;
+        return CheckMetaLogStaleness();
+    }
+    stale_checks_ = 0;
+    if (pending_metalogs_.begin()->first <= metalog_position_) {
+        gap_checks_ = 0;
+        return std::nullopt;
+    }
+    if (gap_checks_ == 0 || gap_position_ != metalog_position_) {
+        // Give in-flight metalogs one more interval to arrive
+        gap_position_ = metalog_position_;
+        gap_checks_ = 1;
+        return std::nullopt;
+    }
+    const View::NodeIdVec& replicas = sequencer_node_->GetReplicaSequencerNodes();
+    size_t idx = (gap_checks_++ - 1) % (replicas.size() + 1);
+    return MetaLogGap {
+        .start_position = metalog_position_,
+        .end_position = pending_metalogs_.begin()->first,
+        .sequencer_id = idx == 0 ? sequencer_id() : replicas.at(idx - 1),
+    };
+}
+
+std::optional<LogSpaceBase::MetaLogGap>
+LogSpaceBase::CheckMetaLogStaleness()
+{
+    // An idle logspace is probed every 1, 2, .., up to 8 stale periods
+    static constexpr size_t kMaxStaleBackoff = 8;
+    if (stale_gap_checks_ == 0) {
+        return std::nullopt;
+    }
+    if (stale_position_ != metalog_position_) {
+        stale_position_ = metalog_position_;
+        stale_checks_ = 0;
+        stale_backoff_ = 1;
+        return std::nullopt;
+    }
+    if (++stale_checks_ < stale_gap_checks_ * stale_backoff_) {
+        return std::nullopt;
+    }
+    stale_checks_ = 0;
+    stale_backoff_ = std::min(stale_backoff_ * 2, kMaxStaleBackoff);
+    return MetaLogGap {
+        .start_position = metalog_position_,
+        .end_position = kUnknownEndPosition,
+        .sequencer_id = sequencer_id(),
+    };
+}
+
 void
 LogSpaceBase::Freeze()
 {
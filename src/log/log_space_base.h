@@ -26,10 +26,34 @@ public:
     }
 
     std::optional<MetaLogProto> GetMetaLog(uint32_t pos) const;
+    // Serializes metalogs in [start_position, end_position) as a MetaLogsProto
+    // appended to `payload`, right from applied metalogs without copying them
+    // into a message first. Returns the number of serialized metalogs.
+    uint32_t SerializeMetaLogs(uint32_t start_position,
+                               uint32_t end_position,
+                               std::string* payload) const;
 
     // Return true if metalog_position changed
     bool ProvideMetaLog(const MetaLogProto& meta_log_proto);
 
+    // Metalogs in [start_position, end_position) are missing, and block
+    // pending ones from being applied. When metalog_position goes stale
+    // with nothing pending, trailing metalogs may be lost with no later one
+    // to reveal them, and the gap is open-ended.
+    static constexpr uint32_t kUnknownEndPosition = std::numeric_limits<uint32_t>::max();
+    struct MetaLogGap {
+        uint32_t start_position;
+        uint32_t end_position;
+        // The primary sequencer on the first attempt, and its replicas
+        // on retries
+        uint16_t sequencer_id;
+    };
+    // Called periodically by engine and storage nodes. Returns the gap
+    // only if metalog_position has not moved since the previous call, or
+    // an open-ended one once it stays for --slog_metalog_stale_gap_checks
+    // calls. Open-ended probes back off while nothing is found.
+    std::optional<MetaLogGap> CheckMetaLogGap();
+
     bool frozen() const { return state_ == kFrozen; }
     bool finalized() const { return state_ == kFinalized; }
 
@@ -72,6 +96,15 @@ private:
     absl::FixedArray<uint32_t> shard_progrsses_;
     uint32_t seqnum_position_;
 
+    uint32_t gap_position_;
+    size_t gap_checks_;
+    const size_t stale_gap_checks_;
+    uint32_t stale_position_;
+    size_t stale_checks_;
+    size_t stale_backoff_;
+
+    std::optional<MetaLogGap> CheckMetaLogStaleness();
+
     utils::ProtobufMessagePool<MetaLogProto> metalog_pool_;
     std::vector<MetaLogProto*> applied_metalogs_;
     std::map</* metalog_seqnum */ uint32_t, MetaLogProto*> pending_metalogs_;
@@ -1,5 +1,6 @@
 #include "log/sequencer.h"
 
+#include "common/time.h"
 #include "log/flags.h"
 #include "utils/bits.h"
 
@@ -12,11 +13,42 @@ using protocol::SharedLogOpType;
 Sequencer::Sequencer(uint16_t node_id)
     : SequencerBase(node_id),
       log_header_(fmt::format("Sequencer[{}-N]: ", node_id)),
-      current_view_(nullptr)
-{}
+      max_inflight_metalogs_(gsl::narrow_cast<uint32_t>(
+          absl::GetFlag(FLAGS_slog_max_inflight_metalogs))),
+      metalog_fetch_max_batch_(gsl::narrow_cast<uint32_t>(
+          absl::GetFlag(FLAGS_slog_metalog_fetch_max_batch))),
+      seal_tail_digests_(absl::GetFlag(FLAGS_slog_seal_tail_digests)),
+      current_view_(nullptr),
+      staged_view_(nullptr),
+      handoff_deadline_(0)
+{
+    CHECK_GT(max_inflight_metalogs_, 0U);
+    CHECK_GT(metalog_fetch_max_batch_, 0U);
+}
 
 Sequencer::~Sequencer() {}
 
+template <class T>
+std::unique_ptr<T>
+Sequencer::CreateLogSpace(const View* view, uint16_t sequencer_id)
+{
+    auto logspace = std::make_unique<T>(view, sequencer_id);
+    if (journal_enabled()) {
+        std::vector<MetaLogProto> metalogs =
+            OpenMetaLogJournal(logspace->identifier());
+        for (const MetaLogProto& metalog: metalogs) {
+            logspace->ProvideMetaLog(metalog);
+        }
+        if (!metalogs.empty()) {
+            HLOG_F(INFO,
+                   "Replayed {} metalogs for logspace {}",
+                   metalogs.size(),
+                   bits::HexStr0x(logspace->identifier()));
+        }
+    }
+    return logspace;
+}
+
 void
 Sequencer::OnViewCreated(const View* view)
 {
@@ -27,12 +59,14 @@ Sequencer::OnViewCreated(const View* view)
         HLOG_F(WARNING, "View {} does not include myself", view->id());
     }
     std::vector<SharedLogRequest> ready_requests;
+    bool primary_replayed = false;
     {
         absl::MutexLock view_lk(&view_mu_);
         if (contains_myself) {
             if (view->is_active_phylog(my_node_id())) {
-                primary_collection_.InstallLogSpace(
-                    std::make_unique<MetaLogPrimary>(view, my_node_id()));
+                auto primary = CreateLogSpace<MetaLogPrimary>(view, my_node_id());
+                primary_replayed = primary->metalog_position() > 0;
+                primary_collection_.InstallLogSpace(std::move(primary));
             }
             for (uint16_t id: view->GetSequencerNodes()) {
                 if (!view->is_active_phylog(id)) {
@@ -41,7 +75,7 @@ Sequencer::OnViewCreated(const View* view)
                 if (view->GetSequencerNode(id)->IsReplicaSequencerNode(my_node_id()))
                 {
                     backup_collection_.InstallLogSpace(
-                        std::make_unique<MetaLogBackup>(view, id));
+                        CreateLogSpace<MetaLogBackup>(view, id));
                 }
             }
         }
@@ -50,8 +84,13 @@ Sequencer::OnViewCreated(const View* view)
         future_requests_.OnNewView(view,
                                    contains_myself ? &ready_requests : nullptr);
         current_view_ = view;
+        staged_view_ = nullptr;
         log_header_ = fmt::format("Sequencer[{}-{}]: ", my_node_id(), view->id());
     }
+    if (primary_replayed) {
+        SomeIOWorker()->ScheduleFunction(
+            nullptr, [this, view] { ReplicateReplayedMetaLogs(view); });
+    }
     if (!ready_requests.empty()) {
         HLOG_F(INFO, "{} requests for the new view", ready_requests.size());
         SomeIOWorker()->ScheduleFunction(
@@ -63,25 +102,60 @@ Sequencer::OnViewCreated(const View* view)
 }
 
 namespace {
+// With `from_lowest_replica`, the tail of a primary extends back to the
+// lowest position acknowledged by its replicas
 template <class T>
 void
-FreezeLogSpace(LockablePtr<T> logspace_ptr, MetaLogsProto* tail_metalogs)
+FreezeLogSpace(LockablePtr<T> logspace_ptr,
+               uint32_t num_entries,
+               bool from_lowest_replica,
+               MetaLogsProto* tail_metalogs)
 {
     auto locked_logspace = logspace_ptr.Lock();
     locked_logspace->Freeze();
     tail_metalogs->set_logspace_id(locked_logspace->identifier());
-    uint32_t num_entries = gsl::narrow_cast<uint32_t>(
-        absl::GetFlag(FLAGS_slog_num_tail_metalog_entries));
     uint32_t end_pos = locked_logspace->metalog_position();
     uint32_t start_pos = end_pos - std::min(num_entries, end_pos);
+    if constexpr (std::is_same_v<T, MetaLogPrimary>) {
+        if (from_lowest_replica) {
+            start_pos = std::min(start_pos, locked_logspace->GetLowestReplicaPosition());
+        }
+    }
     for (uint32_t pos = start_pos; pos < end_pos; pos++) {
         auto metalog = locked_logspace->GetMetaLog(pos);
         CHECK(metalog.has_value());
         tail_metalogs->add_metalogs()->CopyFrom(*metalog);
     }
 }
+
+// Tails of an old phylog are handed off to the sequencer running the same
+// phylog in the staged view, or to a deterministically chosen one
+uint16_t
+SuccessorSequencer(const View* staged_view, uint16_t sequencer_id)
+{
+    if (staged_view->is_active_phylog(sequencer_id)) {
+        return sequencer_id;
+    }
+    std::vector<uint16_t> phylogs;
+    for (uint16_t id: staged_view->GetSequencerNodes()) {
+        if (staged_view->is_active_phylog(id)) {
+            phylogs.push_back(id);
+        }
+    }
+    DCHECK(!phylogs.empty());
+    return phylogs.at(sequencer_id % phylogs.size());
+}
 } // namespace
 
+void
+Sequencer::OnViewStaged(const View* view)
+{
+    DCHECK(zk_session()->WithinMyEventLoopThread());
+    HLOG_F(INFO, "View {} staged", view->id());
+    absl::MutexLock view_lk(&view_mu_);
+    staged_view_ = view;
+}
+
 void
 Sequencer::OnViewFrozen(const View* view)
 {
@@ -90,27 +164,197 @@ Sequencer::OnViewFrozen(const View* view)
     FrozenSequencerProto frozen_proto;
     frozen_proto.set_view_id(view->id());
     frozen_proto.set_sequencer_id(my_node_id());
+    const View* staged_view = nullptr;
     {
         absl::MutexLock view_lk(&view_mu_);
         DCHECK_EQ(view->id(), current_view_->id());
+        if (staged_view_ != nullptr && staged_view_->id() == view->id() + 1) {
+            staged_view = staged_view_;
+        }
+        // The primary never has more than max_inflight_metalogs_ metalogs
+        // beyond its replicated position, and replicated metalogs are already
+        // propagated. With a planned reconfiguration, the seal only has to
+        // cover these last in-flight cuts, and whatever replicas behind the
+        // replicated position still lack, which the primary hands off.
+        bool handoff = staged_view != nullptr;
+        uint32_t num_entries = gsl::narrow_cast<uint32_t>(
+            handoff ? max_inflight_metalogs_
+                    : absl::GetFlag(FLAGS_slog_num_tail_metalog_entries));
         if (current_primary_ != nullptr) {
             FreezeLogSpace<MetaLogPrimary>(current_primary_,
+                                           num_entries,
+                                           /* from_lowest_replica= */ handoff,
                                            frozen_proto.add_tail_metalogs());
         }
         backup_collection_.ForEachActiveLogSpace(
             view,
-            [&frozen_proto](uint32_t, LockablePtr<MetaLogBackup> logspace_ptr) {
+            [num_entries, &frozen_proto](uint32_t,
+                                         LockablePtr<MetaLogBackup> logspace_ptr) {
                 FreezeLogSpace<MetaLogBackup>(std::move(logspace_ptr),
+                                              num_entries,
+                                              /* from_lowest_replica= */ false,
                                               frozen_proto.add_tail_metalogs());
             });
     }
     if (frozen_proto.tail_metalogs().empty()) {
         return;
     }
+    if (staged_view != nullptr) {
+        HandoffTailMetaLogs(view, staged_view, frozen_proto);
+    } else if (seal_tail_digests_) {
+        PublishTailDigests(&frozen_proto);
+    } else {
+        PublishFreezeData(frozen_proto);
+    }
+}
+
+void
+Sequencer::PublishTailDigests(FrozenSequencerProto* frozen_proto)
+{
+    FrozenSequencerProto digest_proto;
+    digest_proto.set_view_id(frozen_proto->view_id());
+    digest_proto.set_sequencer_id(frozen_proto->sequencer_id());
+    {
+        absl::MutexLock lk(&frozen_tails_mu_);
+        for (MetaLogsProto& tail_metalogs: *frozen_proto->mutable_tail_metalogs()) {
+            log_utils::SealReport report =
+                log_utils::BuildSealReport(my_node_id(), tail_metalogs);
+            TailDigestProto* tail_digest = digest_proto.add_tail_digests();
+            tail_digest->set_logspace_id(tail_metalogs.logspace_id());
+            tail_digest->set_metalog_position(report.metalog_position);
+            tail_digest->set_digest(report.digest);
+            frozen_tails_[tail_metalogs.logspace_id()] = std::move(tail_metalogs);
+        }
+    }
+    PublishFreezeData(digest_proto);
+}
+
+void
+Sequencer::OnTailFetchRequested(const View* view,
+                                const TailFetchProto& tail_fetch_proto)
+{
+    DCHECK(zk_session()->WithinMyEventLoopThread());
+    if (tail_fetch_proto.sequencer_id() != my_node_id()) {
+        return;
+    }
+    HLOG_F(INFO,
+           "Controller fetches {} tails of view {}",
+           tail_fetch_proto.logspace_ids_size(),
+           view->id());
+    FrozenSequencerProto frozen_proto;
+    frozen_proto.set_view_id(view->id());
+    frozen_proto.set_sequencer_id(my_node_id());
+    frozen_proto.set_fetched(true);
+    {
+        absl::MutexLock lk(&frozen_tails_mu_);
+        for (uint32_t logspace_id: tail_fetch_proto.logspace_ids()) {
+            if (!frozen_tails_.contains(logspace_id)) {
+                HLOG_F(ERROR,
+                       "Cannot find frozen tail of logspace {}",
+                       bits::HexStr0x(logspace_id));
+                continue;
+            }
+            frozen_proto.add_tail_metalogs()->CopyFrom(frozen_tails_.at(logspace_id));
+        }
+    }
+    if (frozen_proto.tail_metalogs().empty()) {
+        return;
+    }
+    PublishFreezeData(frozen_proto);
+}
+
+void
+Sequencer::HandoffTailMetaLogs(const View* view,
+                               const View* staged_view,
+                               const FrozenSequencerProto& frozen_proto)
+{
+    struct Handoff {
+        uint16_t successor;
+        uint32_t logspace_id;
+        std::string payload;
+    };
+    std::vector<Handoff> handoffs;
+    for (const MetaLogsProto& tail_metalogs: frozen_proto.tail_metalogs()) {
+        FrozenSequencerProto handoff_proto;
+        handoff_proto.set_view_id(frozen_proto.view_id());
+        handoff_proto.set_sequencer_id(frozen_proto.sequencer_id());
+        handoff_proto.add_tail_metalogs()->CopyFrom(tail_metalogs);
+        Handoff handoff;
+        handoff.logspace_id = tail_metalogs.logspace_id();
+        handoff.successor = SuccessorSequencer(
+            staged_view, bits::LowHalf32(handoff.logspace_id));
+        CHECK(handoff_proto.SerializeToString(&handoff.payload));
+        handoffs.push_back(std::move(handoff));
+    }
+    uint32_t quorum = gsl::narrow_cast<uint32_t>((view->metalog_replicas() + 1) / 2);
+    int handoff_timeout_ms = absl::GetFlag(FLAGS_slog_tail_handoff_timeout_ms);
+    if (handoff_timeout_ms > 0) {
+        absl::MutexLock lk(&handoff_mu_);
+        handed_off_tails_ = frozen_proto;
+        handoff_deadline_ = GetMonotonicMicroTimestamp()
+                          + int64_t{handoff_timeout_ms} * 1000;
+    }
+    SomeIOWorker()->ScheduleFunction(
+        nullptr,
+        [this, quorum, handoffs = std::move(handoffs)] {
+            for (const Handoff& handoff: handoffs) {
+                SharedLogMessage message =
+                    SharedLogMessageHelper::NewTailHandoffMessage(
+                        handoff.logspace_id, quorum);
+                HVLOG_F(1,
+                        "Hand off tail of logspace {} to sequencer {}",
+                        bits::HexStr0x(handoff.logspace_id),
+                        handoff.successor);
+                if (handoff.successor == my_node_id()) {
+                    message.origin_node_id = my_node_id();
+                    message.payload_size =
+                        gsl::narrow_cast<uint32_t>(handoff.payload.size());
+                    OnRecvTailHandoff(message, STRING_AS_SPAN(handoff.payload));
+                } else if (!SendSequencerMessage(handoff.successor,
+                                                 &message,
+                                                 STRING_AS_SPAN(handoff.payload)))
+                {
+                    HLOG_F(ERROR,
+                           "Failed to hand off tail to sequencer {}",
+                           handoff.successor);
+                }
+            }
+        });
+}
+
+void
+Sequencer::OnTailHandoffTimerTick()
+{
+    FrozenSequencerProto frozen_proto;
+    {
+        absl::MutexLock lk(&handoff_mu_);
+        if (!handed_off_tails_.has_value()
+              || GetMonotonicMicroTimestamp() < handoff_deadline_) {
+            return;
+        }
+        frozen_proto = std::move(*handed_off_tails_);
+        handed_off_tails_.reset();
+    }
+    // Handed off tails start from the lowest acknowledged position, so they
+    // cover what an unplanned seal needs as well
+    HLOG_F(WARNING,
+           "View {} is not sealed in time after handing off tails, "
+           "fall back to publishing them",
+           frozen_proto.view_id());
+    if (seal_tail_digests_) {
+        PublishTailDigests(&frozen_proto);
+    } else {
+        PublishFreezeData(frozen_proto);
+    }
+}
+
+void
+Sequencer::PublishFreezeData(const FrozenSequencerProto& frozen_proto)
+{
     std::string serialized;
     CHECK(frozen_proto.SerializeToString(&serialized));
     zk_session()->Create(
-        fmt::format("freeze/{}-{}", view->id(), my_node_id()),
+        fmt::format("freeze/{}-{}", frozen_proto.view_id(), my_node_id()),
         STRING_AS_SPAN(serialized),
         zk::ZKCreateMode::kPersistentSequential,
         [this](zk::ZKStatus status, const zk::ZKResult& result, bool*) {
@@ -127,18 +371,51 @@ Sequencer::OnViewFinalized(const FinalizedView* finalized_view)
 {
     DCHECK(zk_session()->WithinMyEventLoopThread());
     HLOG_F(INFO, "View {} finalized", finalized_view->view()->id());
-    absl::MutexLock view_lk(&view_mu_);
-    DCHECK_EQ(finalized_view->view()->id(), current_view_->id());
-    if (current_primary_ != nullptr) {
-        log_utils::FinalizedLogSpace<MetaLogPrimary>(current_primary_,
-                                                     finalized_view);
-    }
-    backup_collection_.ForEachActiveLogSpace(
-        finalized_view->view(),
-        [finalized_view](uint32_t, LockablePtr<MetaLogBackup> logspace_ptr) {
-            log_utils::FinalizedLogSpace<MetaLogBackup>(std::move(logspace_ptr),
-                                                        finalized_view);
-        });
+    {
+        absl::MutexLock lk(&handoff_mu_);
+        uint16_t view_id = finalized_view->view()->id();
+        if (handed_off_tails_.has_value() && handed_off_tails_->view_id() == view_id) {
+            handed_off_tails_.reset();
+        }
+        auto iter = tail_handoffs_.begin();
+        while (iter != tail_handoffs_.end()) {
+            if (bits::HighHalf32(iter->first) == view_id) {
+                tail_handoffs_.erase(iter++);
+            } else {
+                iter++;
+            }
+        }
+    }
+    {
+        absl::MutexLock lk(&frozen_tails_mu_);
+        uint16_t view_id = finalized_view->view()->id();
+        auto iter = frozen_tails_.begin();
+        while (iter != frozen_tails_.end()) {
+            if (bits::HighHalf32(iter->first) == view_id) {
+                frozen_tails_.erase(iter++);
+            } else {
+                iter++;
+            }
+        }
+    }
+    {
+        absl::MutexLock view_lk(&view_mu_);
+        DCHECK_EQ(finalized_view->view()->id(), current_view_->id());
+        if (current_primary_ != nullptr) {
+            log_utils::FinalizedLogSpace<MetaLogPrimary>(current_primary_,
+                                                         finalized_view);
+        }
+        backup_collection_.ForEachActiveLogSpace(
+            finalized_view->view(),
+            [finalized_view](uint32_t, LockablePtr<MetaLogBackup> logspace_ptr) {
+                log_utils::FinalizedLogSpace<MetaLogBackup>(std::move(logspace_ptr),
+                                                            finalized_view);
+            });
+    }
+    // Finalized logspaces take no more metalogs
+    if (journal_enabled()) {
+        CloseMetaLogJournals(finalized_view->view()->id());
+    }
 }
 
 #define ONHOLD_IF_FROM_FUTURE_VIEW(MESSAGE_VAR, PAYLOAD_VAR) \
@@ -238,30 +515,54 @@ Sequencer::OnRecvShardProgress(const SharedLogMessage& message,
 {
     DCHECK(SharedLogMessageHelper::GetOpType(message) ==
            SharedLogOpType::SHARD_PROG);
+    const View* view = nullptr;
+    std::vector<uint32_t> logspace_loads;
     {
         absl::ReaderMutexLock view_lk(&view_mu_);
         ONHOLD_IF_FROM_FUTURE_VIEW(message, payload);
         IGNORE_IF_FROM_PAST_VIEW(message);
+        view = current_view_;
         auto logspace_ptr =
             primary_collection_.GetLogSpaceChecked(message.logspace_id);
         {
             auto locked_logspace = logspace_ptr.Lock();
             RETURN_IF_LOGSPACE_INACTIVE(locked_logspace);
-            std::vector<uint32_t> progress(payload.size() / sizeof(uint32_t), 0);
-            memcpy(progress.data(), payload.data(), payload.size());
-            locked_logspace->UpdateStorageProgress(message.origin_node_id, progress);
+            if ((message.flags & protocol::kShardProgDeltaFlag) != 0) {
+                locked_logspace->UpdateStorageProgressDelta(
+                    message.origin_node_id, payload, &logspace_loads);
+            } else {
+                // Shard progress is followed by (user_logspace, appends) pairs
+                size_t loads_size =
+                    size_t{message.num_logspace_loads} * 2 * sizeof(uint32_t);
+                DCHECK_LE(loads_size, payload.size());
+                size_t progress_size = payload.size() - loads_size;
+                locked_logspace->UpdateStorageProgress(
+                    message.origin_node_id, payload.subspan(0, progress_size));
+                logspace_loads.resize(loads_size / sizeof(uint32_t));
+                memcpy(logspace_loads.data(), payload.data() + progress_size, loads_size);
+            }
         }
     }
+    if (!logspace_loads.empty()) {
+        RecordLogSpaceLoads(DCHECK_NOTNULL(view), logspace_loads);
+    }
 }
 
 void
 Sequencer::OnRecvNewMetaLog(const SharedLogMessage& message,
                             std::span<const char> payload)
 {
-    DCHECK(SharedLogMessageHelper::GetOpType(message) == SharedLogOpType::METALOG);
     uint32_t logspace_id = message.logspace_id;
-    MetaLogProto metalog_proto = log_utils::MetaLogFromPayload(payload);
-    DCHECK_EQ(metalog_proto.logspace_id(), logspace_id);
+    MetaLogsProto metalogs_proto;
+    if (SharedLogMessageHelper::GetOpType(message) == SharedLogOpType::METALOGS) {
+        metalogs_proto = log_utils::MetaLogsFromPayload(payload);
+    } else {
+        DCHECK(SharedLogMessageHelper::GetOpType(message) ==
+               SharedLogOpType::METALOG);
+        metalogs_proto.set_logspace_id(logspace_id);
+        *metalogs_proto.add_metalogs() = log_utils::MetaLogFromPayload(payload);
+    }
+    DCHECK_EQ(metalogs_proto.logspace_id(), logspace_id);
     uint32_t old_metalog_position;
     uint32_t new_metalog_position;
     {
@@ -273,23 +574,170 @@ Sequencer::OnRecvNewMetaLog(const SharedLogMessage& message,
             auto locked_logspace = logspace_ptr.Lock();
             RETURN_IF_LOGSPACE_INACTIVE(locked_logspace);
             old_metalog_position = locked_logspace->metalog_position();
-            // for (const MetaLogProto& metalog_proto: metalogs_proto.metalogs())
-            locked_logspace->ProvideMetaLog(metalog_proto);
+            for (const MetaLogProto& metalog_proto: metalogs_proto.metalogs()) {
+                locked_logspace->ProvideMetaLog(metalog_proto);
+            }
             new_metalog_position = locked_logspace->metalog_position();
+            if (journal_enabled()) {
+                for (uint32_t pos = old_metalog_position; pos < new_metalog_position;
+                     pos++) {
+                    PersistMetaLog(*locked_logspace->GetMetaLog(pos));
+                }
+            }
         }
     }
-    if (new_metalog_position > old_metalog_position) {
+    // With the journal, progress is reported once metalogs are persisted
+    if (!journal_enabled() && new_metalog_position > old_metalog_position) {
         SharedLogMessage response =
             SharedLogMessageHelper::NewMetaLogProgressMessage(logspace_id,
                                                               new_metalog_position);
         SendSequencerMessage(message.sequencer_id, &response);
     }
+    // Metalogs all received before are re-sent by a restarted primary,
+    // which needs current progress
+    int num_metalogs = metalogs_proto.metalogs_size();
+    if (num_metalogs > 0 && new_metalog_position == old_metalog_position
+          && metalogs_proto.metalogs(num_metalogs - 1).metalog_seqnum()
+               < old_metalog_position) {
+        uint32_t position = journal_enabled()
+                              ? GetPersistedMetaLogPosition(logspace_id)
+                              : old_metalog_position;
+        if (position > 0) {
+            SharedLogMessage response =
+                SharedLogMessageHelper::NewMetaLogProgressMessage(logspace_id, position);
+            SendSequencerMessage(message.sequencer_id, &response);
+        }
+    }
+}
+
+void
+Sequencer::OnRecvMetaLogFetch(const SharedLogMessage& request)
+{
+    DCHECK(SharedLogMessageHelper::GetOpType(request) ==
+           SharedLogOpType::METALOG_FETCH);
+    uint32_t logspace_id = request.logspace_id;
+    uint32_t start_position = request.metalog_position;
+    uint32_t end_position = std::min(request.metalog_end_position,
+                                     start_position + metalog_fetch_max_batch_);
+    std::string payload;
+    uint32_t num_metalogs = 0;
+    {
+        absl::ReaderMutexLock view_lk(&view_mu_);
+        // Frozen and finalized logspaces are served as well, as lagging
+        // nodes may still need their metalogs
+        if (request.sequencer_id == my_node_id()) {
+            auto logspace_ptr = primary_collection_.GetLogSpace(logspace_id);
+            if (logspace_ptr.not_null()) {
+                auto locked_logspace = logspace_ptr.Lock();
+                // Metalogs beyond this position are not propagated yet
+                end_position = std::min(
+                    end_position, locked_logspace->replicated_metalog_position());
+                num_metalogs = locked_logspace->SerializeMetaLogs(
+                    start_position, end_position, &payload);
+            }
+        } else {
+            auto logspace_ptr = backup_collection_.GetLogSpace(logspace_id);
+            if (logspace_ptr.not_null()) {
+                auto locked_logspace = logspace_ptr.Lock();
+                num_metalogs = locked_logspace->SerializeMetaLogs(
+                    start_position, end_position, &payload);
+            }
+        }
+    }
+    if (num_metalogs == 0) {
+        // Nodes probing for lost tail metalogs are usually up to date
+        if (request.metalog_end_position == LogSpaceBase::kUnknownEndPosition) {
+            HVLOG_F(1,
+                    "No metalogs from {} of logspace {} for node {}",
+                    request.metalog_position,
+                    bits::HexStr0x(logspace_id),
+                    request.origin_node_id);
+            return;
+        }
+        HLOG_F(WARNING,
+               "Cannot serve metalogs [{}, {}) of logspace {} to node {}",
+               request.metalog_position,
+               request.metalog_end_position,
+               bits::HexStr0x(logspace_id),
+               request.origin_node_id);
+        return;
+    }
+    HVLOG_F(1,
+            "Serve metalogs [{}, {}) of logspace {} to node {}",
+            start_position,
+            start_position + num_metalogs,
+            bits::HexStr0x(logspace_id),
+            request.origin_node_id);
+    if (!SendFetchedMetaLogs(request, logspace_id, STRING_AS_SPAN(payload))) {
+        HLOG_F(ERROR,
+               "Failed to send fetched metalogs to node {}",
+               request.origin_node_id);
+    }
 }
 
 #undef ONHOLD_IF_FROM_FUTURE_VIEW
 #undef PANIC_IF_FROM_FUTURE_VIEW
 #undef IGNORE_IF_FROM_PAST_VIEW
 
+namespace {
+void
+MergeTailMetaLogs(const absl::flat_hash_map<uint16_t, MetaLogsProto>& tails,
+                  MetaLogsProto* merged_tail)
+{
+    std::map<uint32_t, const MetaLogProto*> entries;
+    for (const auto& [sequencer_id, tail_metalogs]: tails) {
+        DCHECK_EQ(tail_metalogs.logspace_id(), merged_tail->logspace_id());
+        for (const MetaLogProto& metalog: tail_metalogs.metalogs()) {
+            entries[metalog.metalog_seqnum()] = &metalog;
+        }
+    }
+    for (const auto& [metalog_seqnum, metalog]: entries) {
+        merged_tail->add_metalogs()->CopyFrom(*metalog);
+    }
+}
+} // namespace
+
+void
+Sequencer::OnRecvTailHandoff(const SharedLogMessage& message,
+                             std::span<const char> payload)
+{
+    DCHECK(SharedLogMessageHelper::GetOpType(message) ==
+           SharedLogOpType::TAIL_HANDOFF);
+    FrozenSequencerProto handoff_proto;
+    if (!handoff_proto.ParseFromArray(payload.data(),
+                                      static_cast<int>(payload.size()))) {
+        HLOG(FATAL) << "Failed to parse FrozenSequencerProto";
+    }
+    DCHECK_EQ(handoff_proto.tail_metalogs_size(), 1);
+    uint32_t logspace_id = message.logspace_id;
+    FrozenSequencerProto sealed_proto;
+    {
+        absl::MutexLock lk(&handoff_mu_);
+        TailHandoff& handoff = tail_handoffs_[logspace_id];
+        if (handoff.sealed) {
+            return;
+        }
+        handoff.tails[message.origin_node_id] = handoff_proto.tail_metalogs(0);
+        if (handoff.tails.size() < message.handoff_quorum) {
+            return;
+        }
+        // Tails from a quorum of replicas cover every replicated metalog,
+        // so a single merged response seals this phylog
+        handoff.sealed = true;
+        sealed_proto.set_view_id(message.view_id);
+        sealed_proto.set_sequencer_id(my_node_id());
+        sealed_proto.set_merged(true);
+        MetaLogsProto* merged_tail = sealed_proto.add_tail_metalogs();
+        merged_tail->set_logspace_id(logspace_id);
+        MergeTailMetaLogs(handoff.tails, merged_tail);
+    }
+    HLOG_F(INFO,
+           "Merged tails of logspace {} from {} sequencers",
+           bits::HexStr0x(logspace_id),
+           message.handoff_quorum);
+    PublishFreezeData(sealed_proto);
+}
+
 void
 Sequencer::ProcessRequests(const std::vector<SharedLogRequest>& requests)
 {
@@ -303,6 +751,13 @@ Sequencer::MarkNextCutIfDoable()
 {
     const View* view = nullptr;
     std::optional<MetaLogProto> meta_log_proto;
+    bool cut_attempted = false;
+    // Otherwise a skipped early cut would suppress later ones
+    auto on_cut_skipped = gsl::finally([this, &cut_attempted] {
+        if (!cut_attempted) {
+            cut_scheduler()->OnCutSkipped();
+        }
+    });
     {
         absl::ReaderMutexLock view_lk(&view_mu_);
         if (current_primary_ == nullptr || current_view_ == nullptr) {
@@ -312,15 +767,98 @@ Sequencer::MarkNextCutIfDoable()
         {
             auto locked_logspace = current_primary_.Lock();
             RETURN_IF_LOGSPACE_INACTIVE(locked_logspace);
-            if (!locked_logspace->all_metalog_replicated()) {
-                HLOG(INFO) << "Not all meta log replicated, will not mark new cut";
+            if (locked_logspace->num_inflight_metalogs() >= max_inflight_metalogs_) {
+                HVLOG(1) << "Too many meta logs in flight, will not mark new cut";
                 return;
             }
             meta_log_proto = locked_logspace->MarkNextCut();
+            cut_attempted = true;
+            if (meta_log_proto.has_value() && journal_enabled()) {
+                PersistMetaLog(*meta_log_proto);
+            }
         }
     }
     if (meta_log_proto.has_value()) {
-        ReplicateMetaLog(view, *meta_log_proto);
+        uint32_t num_new_logs = 0;
+        for (uint32_t delta: meta_log_proto->new_logs_proto().shard_deltas()) {
+            num_new_logs += delta;
+        }
+        cut_scheduler()->OnCutMarked(num_new_logs);
+        // With the journal, only persisted metalogs are replicated
+        if (!journal_enabled()) {
+            ReplicateMetaLog(view, *meta_log_proto);
+        }
+    } else if (cut_attempted) {
+        cut_scheduler()->OnCutMarked(0);
+    }
+}
+
+void
+Sequencer::ReplicateReplayedMetaLogs(const View* view)
+{
+    MetaLogsProto tail_metalogs;
+    {
+        absl::ReaderMutexLock view_lk(&view_mu_);
+        if (current_view_ != view || current_primary_ == nullptr) {
+            return;
+        }
+        auto locked_logspace = current_primary_.Lock();
+        RETURN_IF_LOGSPACE_INACTIVE(locked_logspace);
+        // Metalogs before the tail were replicated before the restart,
+        // backups lagging further behind fetch them once acknowledged
+        uint32_t end_pos = locked_logspace->metalog_position();
+        uint32_t start_pos = end_pos - std::min(max_inflight_metalogs_, end_pos);
+        for (uint32_t pos = start_pos; pos < end_pos; pos++) {
+            auto metalog = locked_logspace->GetMetaLog(pos);
+            CHECK(metalog.has_value());
+            tail_metalogs.add_metalogs()->CopyFrom(*metalog);
+        }
+    }
+    HLOG_F(INFO, "Re-replicate {} replayed metalogs", tail_metalogs.metalogs_size());
+    for (const MetaLogProto& metalog: tail_metalogs.metalogs()) {
+        ReplicateMetaLog(view, metalog);
+    }
+}
+
+void
+Sequencer::OnMetaLogPersisted(uint32_t logspace_id,
+                              uint32_t start_position,
+                              uint32_t end_position)
+{
+    uint16_t sequencer_id = bits::LowHalf32(logspace_id);
+    if (sequencer_id != my_node_id()) {
+        SharedLogMessage response =
+            SharedLogMessageHelper::NewMetaLogProgressMessage(logspace_id,
+                                                              end_position);
+        SendSequencerMessage(sequencer_id, &response);
+        return;
+    }
+    const View* view = nullptr;
+    absl::InlinedVector<MetaLogProto, 4> persisted_metalogs;
+    {
+        absl::ReaderMutexLock view_lk(&view_mu_);
+        if (current_view_ == nullptr ||
+            bits::HighHalf32(logspace_id) != current_view_->id()) {
+            return;
+        }
+        view = current_view_;
+        auto logspace_ptr = primary_collection_.GetLogSpaceChecked(logspace_id);
+        {
+            auto locked_logspace = logspace_ptr.Lock();
+            RETURN_IF_LOGSPACE_INACTIVE(locked_logspace);
+            for (uint32_t pos = start_position; pos < end_position; pos++) {
+                if (auto metalog = locked_logspace->GetMetaLog(pos);
+                    metalog.has_value())
+                {
+                    persisted_metalogs.push_back(std::move(*metalog));
+                } else {
+                    HLOG_F(FATAL, "Cannot get meta log at position {}", pos);
+                }
+            }
+        }
+    }
+    for (const MetaLogProto& metalog_proto: persisted_metalogs) {
+        ReplicateMetaLog(DCHECK_NOTNULL(view), metalog_proto);
     }
 }
 
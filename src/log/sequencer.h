@@ -13,18 +13,52 @@ public:
 
 private:
     std::string log_header_;
+    const uint32_t max_inflight_metalogs_;
+    const uint32_t metalog_fetch_max_batch_;
+    const bool seal_tail_digests_;
 
     absl::Mutex view_mu_;
     const View* current_view_ ABSL_GUARDED_BY(view_mu_);
+    // Next view pre-staged by a planned reconfiguration
+    const View* staged_view_ ABSL_GUARDED_BY(view_mu_);
     LockablePtr<MetaLogPrimary> current_primary_ ABSL_GUARDED_BY(view_mu_);
     LogSpaceCollection<MetaLogPrimary> primary_collection_ ABSL_GUARDED_BY(view_mu_);
     LogSpaceCollection<MetaLogBackup> backup_collection_ ABSL_GUARDED_BY(view_mu_);
 
     log_utils::FutureRequests future_requests_;
 
+    // Tail metalogs handed off by frozen sequencers, when this sequencer is
+    // the successor of their phylogs
+    struct TailHandoff {
+        absl::flat_hash_map</* sequencer_id */ uint16_t, MetaLogsProto> tails;
+        bool sealed = false;
+    };
+    absl::Mutex handoff_mu_;
+    absl::flat_hash_map</* logspace_id */ uint32_t, TailHandoff>
+        tail_handoffs_ ABSL_GUARDED_BY(handoff_mu_);
+    // Tails this sequencer handed off, published as freeze data if the view
+    // is not finalized by `handoff_deadline_`
+    std::optional<FrozenSequencerProto> handed_off_tails_ ABSL_GUARDED_BY(handoff_mu_);
+    int64_t handoff_deadline_ ABSL_GUARDED_BY(handoff_mu_);
+
+    // Full tails of the frozen view, kept until the controller fetches them
+    // or the view is finalized, when sealing with tail digests only
+    absl::Mutex frozen_tails_mu_;
+    absl::flat_hash_map</* logspace_id */ uint32_t, MetaLogsProto>
+        frozen_tails_ ABSL_GUARDED_BY(frozen_tails_mu_);
+
     void OnViewCreated(const View* view) override;
     void OnViewFrozen(const View* view) override;
     void OnViewFinalized(const FinalizedView* finalized_view) override;
+    void OnViewStaged(const View* view) override;
+    void OnTailFetchRequested(const View* view,
+                              const TailFetchProto& tail_fetch_proto) override;
+
+    void HandoffTailMetaLogs(const View* view,
+                             const View* staged_view,
+                             const FrozenSequencerProto& frozen_proto);
+    void PublishTailDigests(FrozenSequencerProto* frozen_proto);
+    void PublishFreezeData(const FrozenSequencerProto& frozen_proto);
 
     void HandleTrimRequest(const protocol::SharedLogMessage& request) override;
     void OnRecvMetaLogProgress(const protocol::SharedLogMessage& message) override;
@@ -32,10 +66,23 @@ private:
                              std::span<const char> payload) override;
     void OnRecvNewMetaLog(const protocol::SharedLogMessage& message,
                           std::span<const char> payload) override;
+    void OnRecvTailHandoff(const protocol::SharedLogMessage& message,
+                           std::span<const char> payload) override;
+    void OnRecvMetaLogFetch(const protocol::SharedLogMessage& request) override;
 
     void ProcessRequests(const std::vector<SharedLogRequest>& requests);
 
     void MarkNextCutIfDoable() override;
+    void OnTailHandoffTimerTick() override;
+    void OnMetaLogPersisted(uint32_t logspace_id,
+                            uint32_t start_position,
+                            uint32_t end_position) override;
+
+    template <class T>
+    std::unique_ptr<T> CreateLogSpace(const View* view, uint16_t sequencer_id);
+    // Replica progresses are lost with a restart. Re-sends the tail of the
+    // replayed metalogs, so that backups acknowledge their positions.
+    void ReplicateReplayedMetaLogs(const View* view);
 
     DISALLOW_COPY_AND_ASSIGN(Sequencer);
 };
@@ -1,8 +1,10 @@
 #include "log/sequencer_base.h"
 
+#include "common/time.h"
 #include "log/common.h"
 #include "log/flags.h"
 #include "server/constants.h"
+#include "utils/fs.h"
 #include "utils/bits.h"
 
 #define log_header_ "SequencerBase: "
@@ -21,7 +23,18 @@ using server::NodeWatcher;
 
 SequencerBase::SequencerBase(uint16_t node_id)
     : ServerBase(fmt::format("sequencer_{}", node_id)),
-      node_id_(node_id)
+      node_id_(node_id),
+      metalog_fanout_(absl::GetFlag(FLAGS_slog_metalog_fanout)),
+      journal_dir_(absl::GetFlag(FLAGS_slog_sequencer_journal_dir)),
+      delta_shard_progress_(absl::GetFlag(FLAGS_slog_delta_shard_progress)),
+      replication_flush_scheduled_(false),
+      load_view_id_(0),
+      load_userlog_replicas_(1),
+      load_report_timestamp_(0),
+      load_znode_created_(false),
+      metalog_egress_bytes_stat_(
+          stat::StatisticsCollector<uint32_t>::StandardReportCallback(
+              "metalog_egress_bytes"))
 {}
 
 SequencerBase::~SequencerBase() {}
@@ -29,6 +42,9 @@ SequencerBase::~SequencerBase() {}
 void
 SequencerBase::StartInternal()
 {
+    if (journal_enabled() && !fs_utils::IsDirectory(journal_dir_)) {
+        HLOG_F(FATAL, "Journal directory {} does not exist", journal_dir_);
+    }
     SetupZKWatchers();
     SetupTimers();
 }
@@ -44,6 +60,12 @@ SequencerBase::SetupZKWatchers()
         [this](const View* view) { this->OnViewCreated(view); });
     view_watcher_.SetViewFrozenCallback(
         [this](const View* view) { this->OnViewFrozen(view); });
+    view_watcher_.SetViewStagedCallback(
+        [this](const View* view) { this->OnViewStaged(view); });
+    view_watcher_.SetTailFetchCallback(
+        [this](const View* view, const TailFetchProto& tail_fetch_proto) {
+            this->OnTailFetchRequested(view, tail_fetch_proto);
+        });
     view_watcher_.SetViewFinalizedCallback(
         [this](const FinalizedView* finalized_view) {
             this->OnViewFinalized(finalized_view);
@@ -57,7 +79,192 @@ SequencerBase::SetupTimers()
     CreatePeriodicTimer(
         kMetaLogCutTimerId,
         absl::Microseconds(absl::GetFlag(FLAGS_slog_global_cut_interval_us)),
-        [this]() { this->MarkNextCutIfDoable(); });
+        [this]() { this->OnCutTimerTick(); });
+    int load_report_interval_ms =
+        absl::GetFlag(FLAGS_slog_log_space_load_report_interval_ms);
+    if (load_report_interval_ms > 0) {
+        {
+            absl::MutexLock lk(&load_mu_);
+            load_report_timestamp_ = GetMonotonicMicroTimestamp();
+        }
+        CreatePeriodicTimer(
+            kLogSpaceLoadTimerId,
+            absl::Milliseconds(load_report_interval_ms),
+            [this]() { this->OnLoadReportTimerTick(); });
+    }
+    int handoff_timeout_ms = absl::GetFlag(FLAGS_slog_tail_handoff_timeout_ms);
+    if (absl::GetFlag(FLAGS_slog_planned_reconfig) && handoff_timeout_ms > 0) {
+        CreatePeriodicTimer(
+            kTailHandoffTimerId,
+            absl::Milliseconds(handoff_timeout_ms) / 4,
+            [this]() { this->OnTailHandoffTimerTick(); });
+    }
+}
+
+void
+SequencerBase::OnCutTimerTick()
+{
+    if (cut_scheduler_.ShouldMarkCut()) {
+        MarkNextCutIfDoable();
+    }
+    if (journal_enabled()) {
+        FlushMetaLogJournals();
+    }
+}
+
+void
+SequencerBase::RecordLogSpaceLoads(const View* view, std::span<const uint32_t> loads)
+{
+    DCHECK_EQ(loads.size() % 2, 0U);
+    absl::MutexLock lk(&load_mu_);
+    load_view_id_ = view->id();
+    load_userlog_replicas_ = std::max<size_t>(view->userlog_replicas(), 1);
+    for (size_t i = 0; i + 1 < loads.size(); i += 2) {
+        logspace_appends_[loads[i]] += loads[i + 1];
+    }
+}
+
+void
+SequencerBase::OnLoadReportTimerTick()
+{
+    LogSpaceLoadProto load_proto;
+    load_proto.set_sequencer_id(node_id_);
+    {
+        absl::MutexLock lk(&load_mu_);
+        int64_t now = GetMonotonicMicroTimestamp();
+        double elapsed_sec = static_cast<double>(now - load_report_timestamp_) / 1e6;
+        load_report_timestamp_ = now;
+        if (elapsed_sec <= 0) {
+            return;
+        }
+        load_proto.set_view_id(load_view_id_);
+        // Each append is stored on `userlog_replicas` storage nodes,
+        // all of which report it
+        double scale = elapsed_sec * static_cast<double>(load_userlog_replicas_);
+        for (const auto& [user_logspace, appends]: logspace_appends_) {
+            load_proto.add_user_logspaces(user_logspace);
+            load_proto.add_append_rates(
+                static_cast<float>(static_cast<double>(appends) / scale));
+        }
+        logspace_appends_.clear();
+    }
+    std::string serialized;
+    CHECK(load_proto.SerializeToString(&serialized));
+    std::string path = fmt::format("load/{}", node_id_);
+    if (load_znode_created_.load()) {
+        zk_session()->Set(
+            path, STRING_AS_SPAN(serialized),
+            [this](zk::ZKStatus status, const zk::ZKResult& result, bool*) {
+                if (!status.ok()) {
+                    HLOG(ERROR) << "Failed to publish log space loads: "
+                                << status.ToString();
+                }
+            });
+        return;
+    }
+    // Ephemeral, so loads of a crashed sequencer disappear with it
+    zk_session()->Create(
+        path, STRING_AS_SPAN(serialized), zk::ZKCreateMode::kEphemeral,
+        [this](zk::ZKStatus status, const zk::ZKResult& result, bool*) {
+            if (status.ok() || status.IsNodeExist()) {
+                load_znode_created_.store(true);
+            } else if (status.IsNoNode()) {
+                HLOG(WARNING) << "Directory for log space loads does not exist";
+            } else {
+                HLOG(ERROR) << "Failed to publish log space loads: "
+                            << status.ToString();
+            }
+        });
+}
+
+std::vector<MetaLogProto>
+SequencerBase::OpenMetaLogJournal(uint32_t logspace_id)
+{
+    DCHECK(journal_enabled());
+    auto journal = std::make_unique<MetaLogJournal>(
+        logspace_id,
+        MetaLogJournal::FilePath(journal_dir_, logspace_id),
+        SomeIOWorker(),
+        [this, logspace_id] (uint32_t start_position, uint32_t end_position) {
+            OnMetaLogPersisted(logspace_id, start_position, end_position);
+        });
+    std::vector<MetaLogProto> metalogs;
+    if (!journal->Open(&metalogs)) {
+        HLOG_F(FATAL,
+               "Failed to open metalog journal for logspace {}",
+               bits::HexStr0x(logspace_id));
+    }
+    absl::MutexLock lk(&journal_mu_);
+    DCHECK(!journals_.contains(logspace_id));
+    journals_[logspace_id] = std::move(journal);
+    return metalogs;
+}
+
+void
+SequencerBase::PersistMetaLog(const MetaLogProto& metalog)
+{
+    DCHECK(journal_enabled());
+    MetaLogJournal* journal = nullptr;
+    {
+        absl::ReaderMutexLock lk(&journal_mu_);
+        if (!journals_.contains(metalog.logspace_id())) {
+            HLOG_F(FATAL,
+                   "Cannot find metalog journal for logspace {}",
+                   bits::HexStr0x(metalog.logspace_id()));
+        }
+        journal = journals_.at(metalog.logspace_id()).get();
+    }
+    journal->Append(metalog);
+}
+
+uint32_t
+SequencerBase::GetPersistedMetaLogPosition(uint32_t logspace_id)
+{
+    DCHECK(journal_enabled());
+    absl::ReaderMutexLock lk(&journal_mu_);
+    if (!journals_.contains(logspace_id)) {
+        return 0;
+    }
+    return journals_.at(logspace_id)->persisted_position();
+}
+
+void
+SequencerBase::CloseMetaLogJournals(uint16_t view_id)
+{
+    DCHECK(journal_enabled());
+    std::vector<std::unique_ptr<MetaLogJournal>> closed_journals;
+    {
+        absl::MutexLock lk(&journal_mu_);
+        auto iter = journals_.begin();
+        while (iter != journals_.end()) {
+            if (bits::HighHalf32(iter->first) == view_id) {
+                closed_journals.push_back(std::move(iter->second));
+                journals_.erase(iter++);
+            } else {
+                iter++;
+            }
+        }
+    }
+    for (std::unique_ptr<MetaLogJournal>& journal: closed_journals) {
+        // Flushes scheduled before run first, as they are scheduled to the
+        // same IOWorker while the journal is still in journals_
+        MetaLogJournal* journal_ptr = journal.release();
+        journal_ptr->io_worker()->ScheduleFunction(
+            nullptr, [journal_ptr] {
+                journal_ptr->Close([journal_ptr] { delete journal_ptr; });
+            });
+    }
+}
+
+void
+SequencerBase::FlushMetaLogJournals()
+{
+    absl::ReaderMutexLock lk(&journal_mu_);
+    for (const auto& [logspace_id, journal]: journals_) {
+        MetaLogJournal* journal_ptr = journal.get();
+        journal_ptr->io_worker()->ScheduleFunction(
+            nullptr, [journal_ptr] { journal_ptr->Flush(); });
+    }
 }
 
 void
@@ -73,10 +280,21 @@ SequencerBase::MessageHandler(const SharedLogMessage& message,
         break;
     case SharedLogOpType::SHARD_PROG:
         OnRecvShardProgress(message, payload);
+        if (cut_scheduler_.OnShardProgress(
+                payload.size() - message.num_logspace_loads * 2 * sizeof(uint32_t))) {
+            MarkNextCutIfDoable();
+        }
         break;
     case SharedLogOpType::METALOG:
+    case SharedLogOpType::METALOGS:
         OnRecvNewMetaLog(message, payload);
         break;
+    case SharedLogOpType::TAIL_HANDOFF:
+        OnRecvTailHandoff(message, payload);
+        break;
+    case SharedLogOpType::METALOG_FETCH:
+        OnRecvMetaLogFetch(message);
+        break;
     default:
         UNREACHABLE();
     }
@@ -102,22 +320,56 @@ SequencerBase::ReplicateMetaLog(const View* view, const MetaLogProto& metalog)
 {
     uint32_t logspace_id = metalog.logspace_id();
     DCHECK_EQ(bits::LowHalf32(logspace_id), my_node_id());
-    SharedLogMessage message =
-        SharedLogMessageHelper::NewMetaLogMessage(logspace_id);
-    std::string payload = SerializedMetaLog(metalog);
-    message.origin_node_id = node_id_;
-    message.payload_size = gsl::narrow_cast<uint32_t>(payload.size());
-    const View::Sequencer* sequencer_node = view->GetSequencerNode(my_node_id());
-    for (uint16_t sequencer_id: sequencer_node->GetReplicaSequencerNodes()) {
-        bool success =
-            SendSharedLogMessage(protocol::ConnType::SEQUENCER_TO_SEQUENCER,
-                                 sequencer_id,
-                                 message,
-                                 STRING_AS_SPAN(payload));
-        if (!success) {
-            HLOG_F(ERROR,
-                   "Failed to send metalog message to sequencer {}",
-                   sequencer_id);
+    bool need_flush = false;
+    {
+        absl::MutexLock lk(&replication_mu_);
+        if (!pending_replications_.contains(logspace_id)) {
+            PendingReplication& replication = pending_replications_[logspace_id];
+            replication.view = view;
+            replication.metalogs.set_logspace_id(logspace_id);
+        }
+        pending_replications_[logspace_id].metalogs.add_metalogs()->CopyFrom(metalog);
+        if (!replication_flush_scheduled_) {
+            replication_flush_scheduled_ = true;
+            need_flush = true;
+        }
+    }
+    if (need_flush) {
+        CurrentIOWorkerChecked()->ScheduleIdleFunction(
+            nullptr, [this] { FlushMetaLogReplication(); });
+    }
+}
+
+void
+SequencerBase::FlushMetaLogReplication()
+{
+    absl::flat_hash_map</* logspace_id */ uint32_t, PendingReplication> replications;
+    {
+        absl::MutexLock lk(&replication_mu_);
+        replications = std::move(pending_replications_);
+        pending_replications_.clear();
+        replication_flush_scheduled_ = false;
+    }
+    for (const auto& [logspace_id, replication]: replications) {
+        SharedLogMessage message =
+            SharedLogMessageHelper::NewMetaLogsMessage(logspace_id);
+        std::string payload;
+        CHECK(replication.metalogs.SerializeToString(&payload));
+        message.origin_node_id = node_id_;
+        message.payload_size = gsl::narrow_cast<uint32_t>(payload.size());
+        const View::Sequencer* sequencer_node =
+            replication.view->GetSequencerNode(my_node_id());
+        for (uint16_t sequencer_id: sequencer_node->GetReplicaSequencerNodes()) {
+            bool success =
+                SendSharedLogMessage(protocol::ConnType::SEQUENCER_TO_SEQUENCER,
+                                     sequencer_id,
+                                     message,
+                                     STRING_AS_SPAN(payload));
+            if (!success) {
+                HLOG_F(ERROR,
+                       "Failed to send metalogs message to sequencer {}",
+                       sequencer_id);
+            }
         }
     }
 }
@@ -127,56 +379,91 @@ SequencerBase::PropagateMetaLog(const View* view, const MetaLogProto& metalog)
 {
     uint32_t logspace_id = metalog.logspace_id();
     DCHECK_EQ(bits::LowHalf32(logspace_id), my_node_id());
+    SharedLogMessage message =
+        SharedLogMessageHelper::NewMetaLogMessage(metalog.logspace_id());
     absl::flat_hash_set<uint16_t> engine_nodes;
     absl::flat_hash_set<uint16_t> storage_nodes;
-    switch (metalog.type()) {
-    case MetaLogProto::NEW_LOGS:
-        for (size_t i = 0; i < view->num_engine_nodes(); i++) {
-            uint16_t engine_id = view->GetEngineNodes().at(i);
-            const View::Engine* engine_node = view->GetEngineNode(engine_id);
-            uint32_t shard_delta =
-                metalog.new_logs_proto().shard_deltas(static_cast<int>(i));
-            if (shard_delta > 0) {
-                engine_nodes.insert(engine_id);
-                for (uint16_t storage_id: engine_node->GetStorageNodes()) {
-                    storage_nodes.insert(storage_id);
+    if (metalog_fanout_ > 0) {
+        // Engine nodes forward the metalog down the fan-out tree,
+        // and to storage nodes on behalf of the sequencer
+        message.flags |= protocol::kMetaLogForwardFlag;
+        message.metalog_fanout = gsl::narrow_cast<uint32_t>(metalog_fanout_);
+        // Subtrees of offline roots are sent to directly
+        std::vector<uint16_t> fanout_engines;
+        std::vector<uint16_t> orphaned_storages;
+        view->ResolveMetaLogFanoutTargets(
+            metalog_fanout_, view->GetMetaLogFanoutRoots(metalog_fanout_),
+            [this] (uint16_t engine_id) {
+                return !node_watcher()->IsNodeOnline(NodeWatcher::kEngineNode, engine_id);
+            },
+            &fanout_engines, &orphaned_storages);
+        engine_nodes.insert(fanout_engines.begin(), fanout_engines.end());
+        storage_nodes.insert(orphaned_storages.begin(), orphaned_storages.end());
+    } else {
+        switch (metalog.type()) {
+        case MetaLogProto::NEW_LOGS:
+            for (size_t i = 0; i < view->num_engine_nodes(); i++) {
+                uint16_t engine_id = view->GetEngineNodes().at(i);
+                const View::Engine* engine_node = view->GetEngineNode(engine_id);
+                uint32_t shard_delta =
+                    metalog.new_logs_proto().shard_deltas(static_cast<int>(i));
+                if (shard_delta > 0) {
+                    engine_nodes.insert(engine_id);
+                    for (uint16_t storage_id: engine_node->GetStorageNodes()) {
+                        storage_nodes.insert(storage_id);
+                    }
+                } else if (engine_node->HasIndexFor(my_node_id())) {
+                    engine_nodes.insert(engine_id);
                 }
-            } else if (engine_node->HasIndexFor(my_node_id())) {
-                engine_nodes.insert(engine_id);
             }
+            break;
+        case MetaLogProto::TRIM:
+            NOT_IMPLEMENTED();
+            break;
+        default:
+            UNREACHABLE();
         }
-        break;
-    case MetaLogProto::TRIM:
-        NOT_IMPLEMENTED();
-        break;
-    default:
-        UNREACHABLE();
     }
-    SharedLogMessage message =
-        SharedLogMessageHelper::NewMetaLogMessage(metalog.logspace_id());
+    if (delta_shard_progress_) {
+        // Advertise to storage nodes, which switch to delta-encoded SHARD_PROG
+        message.flags |= protocol::kShardProgDeltaFlag;
+    }
     std::string payload = SerializedMetaLog(metalog);
     message.origin_node_id = node_id_;
     message.payload_size = gsl::narrow_cast<uint32_t>(payload.size());
+    // Storage nodes never forward
+    SharedLogMessage storage_message = message;
+    storage_message.flags = gsl::narrow_cast<uint16_t>(
+        storage_message.flags & ~protocol::kMetaLogForwardFlag);
+    storage_message.metalog_fanout = 0;
+    size_t num_sent = 0;
     for (uint16_t engine_id: engine_nodes) {
         bool success = SendSharedLogMessage(protocol::ConnType::SEQUENCER_TO_ENGINE,
                                             engine_id,
                                             message,
                                             STRING_AS_SPAN(payload));
-        if (!success) {
+        if (success) {
+            num_sent++;
+        } else {
             HLOG_F(ERROR, "Failed to send metalog message to engine {}", engine_id);
         }
     }
     for (uint16_t storage_id: storage_nodes) {
         bool success = SendSharedLogMessage(protocol::ConnType::SEQUENCER_TO_STORAGE,
                                             storage_id,
-                                            message,
+                                            storage_message,
                                             STRING_AS_SPAN(payload));
-        if (!success) {
+        if (success) {
+            num_sent++;
+        } else {
             HLOG_F(ERROR,
                    "Failed to send metalog message to storage {}",
                    storage_id);
         }
     }
+    absl::MutexLock stat_lk(&stat_mu_);
+    metalog_egress_bytes_stat_.AddSample(gsl::narrow_cast<uint32_t>(
+        num_sent * (sizeof(SharedLogMessage) + payload.size())));
 }
 
 bool
@@ -207,6 +494,25 @@ SequencerBase::SendEngineResponse(const SharedLogMessage& request,
                                 payload);
 }
 
+bool
+SequencerBase::SendFetchedMetaLogs(const SharedLogMessage& request,
+                                   uint32_t logspace_id,
+                                   std::span<const char> payload)
+{
+    SharedLogMessage message =
+        SharedLogMessageHelper::NewMetaLogsMessage(logspace_id);
+    message.origin_node_id = node_id_;
+    message.payload_size = gsl::narrow_cast<uint32_t>(payload.size());
+    protocol::ConnType conn_type =
+        (request.flags & protocol::kMetaLogFetchFromStorageFlag) != 0
+            ? protocol::ConnType::SEQUENCER_TO_STORAGE
+            : protocol::ConnType::SEQUENCER_TO_ENGINE;
+    return SendSharedLogMessage(conn_type,
+                                request.origin_node_id,
+                                message,
+                                payload);
+}
+
 void
 SequencerBase::OnRecvSharedLogMessage(int conn_type,
                                       uint16_t src_node_id,
@@ -216,9 +522,17 @@ SequencerBase::OnRecvSharedLogMessage(int conn_type,
     SharedLogOpType op_type = SharedLogMessageHelper::GetOpType(message);
     DCHECK((conn_type == kSequencerIngressTypeId &&
             op_type == SharedLogOpType::METALOG) ||
+           (conn_type == kSequencerIngressTypeId &&
+            op_type == SharedLogOpType::METALOGS) ||
            (conn_type == kSequencerIngressTypeId &&
             op_type == SharedLogOpType::META_PROG) ||
+           (conn_type == kSequencerIngressTypeId &&
+            op_type == SharedLogOpType::TAIL_HANDOFF) ||
            (conn_type == kEngineIngressTypeId && op_type == SharedLogOpType::TRIM) ||
+           (conn_type == kEngineIngressTypeId &&
+            op_type == SharedLogOpType::METALOG_FETCH) ||
+           (conn_type == kStorageIngressTypeId &&
+            op_type == SharedLogOpType::METALOG_FETCH) ||
            (conn_type == kStorageIngressTypeId &&
             op_type == SharedLogOpType::SHARD_PROG))
         << fmt::format("Invalid combination: conn_type={:#x}, op_type={:#x}",
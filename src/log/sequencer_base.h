@@ -1,6 +1,8 @@
 #pragma once
 
 #include "log/common.h"
+#include "log/journal.h"
+#include "log/utils.h"
 #include "log/view.h"
 #include "log/view_watcher.h"
 #include "server/server_base.h"
@@ -20,6 +22,9 @@ protected:
     virtual void OnViewCreated(const View* view) = 0;
     virtual void OnViewFrozen(const View* view) = 0;
     virtual void OnViewFinalized(const FinalizedView* finalized_view) = 0;
+    virtual void OnViewStaged(const View* view) = 0;
+    virtual void OnTailFetchRequested(const View* view,
+                                      const TailFetchProto& tail_fetch_proto) = 0;
 
     virtual void HandleTrimRequest(const protocol::SharedLogMessage& message) = 0;
     virtual void OnRecvMetaLogProgress(
@@ -28,26 +33,65 @@ protected:
                                      std::span<const char> payload) = 0;
     virtual void OnRecvNewMetaLog(const protocol::SharedLogMessage& message,
                                   std::span<const char> payload) = 0;
+    virtual void OnRecvTailHandoff(const protocol::SharedLogMessage& message,
+                                   std::span<const char> payload) = 0;
+    virtual void OnRecvMetaLogFetch(const protocol::SharedLogMessage& request) = 0;
 
     virtual void MarkNextCutIfDoable() = 0;
+    // Called periodically with planned reconfiguration, to fall back from
+    // handed off tails the successor does not seal
+    virtual void OnTailHandoffTimerTick() = 0;
+    // Metalogs in [start_position, end_position) are persisted
+    virtual void OnMetaLogPersisted(uint32_t logspace_id,
+                                    uint32_t start_position,
+                                    uint32_t end_position) = 0;
+
+    log_utils::CutScheduler* cut_scheduler() { return &cut_scheduler_; }
 
     void MessageHandler(const protocol::SharedLogMessage& message,
                         std::span<const char> payload);
 
+    // Metalogs replicated within one event loop iteration are sent
+    // to replica sequencers as a single METALOGS message
     void ReplicateMetaLog(const View* view, const MetaLogProto& metalog);
     void PropagateMetaLog(const View* view, const MetaLogProto& metalog);
 
+    // Durable metalogs are enabled by --slog_sequencer_journal_dir. Journals
+    // are flushed on cut timer ticks, and OnMetaLogPersisted is called once
+    // appended metalogs reach the disk.
+    bool journal_enabled() const { return !journal_dir_.empty(); }
+    // Returns metalogs read back from an existing journal
+    std::vector<MetaLogProto> OpenMetaLogJournal(uint32_t logspace_id);
+    void PersistMetaLog(const MetaLogProto& metalog);
+    uint32_t GetPersistedMetaLogPosition(uint32_t logspace_id);
+    // Closes and removes journals of logspaces of a finalized view
+    void CloseMetaLogJournals(uint16_t view_id);
+
+    // Appends of user logspaces, as (user_logspace, count) pairs reported by
+    // storage nodes along with shard progress. Append rates are published
+    // to ZooKeeper as "load/<node_id>" for load-aware placement.
+    void RecordLogSpaceLoads(const View* view, std::span<const uint32_t> loads);
+
     bool SendSequencerMessage(uint16_t sequencer_id,
                               protocol::SharedLogMessage* message,
                               std::span<const char> payload = EMPTY_CHAR_SPAN);
     bool SendEngineResponse(const protocol::SharedLogMessage& request,
                             protocol::SharedLogMessage* response,
                             std::span<const char> payload = EMPTY_CHAR_SPAN);
+    // Reply a METALOG_FETCH request with a METALOGS message, whose payload
+    // is a serialized MetaLogsProto
+    bool SendFetchedMetaLogs(const protocol::SharedLogMessage& request,
+                             uint32_t logspace_id,
+                             std::span<const char> payload);
 
 private:
     const uint16_t node_id_;
+    const size_t metalog_fanout_;
+    const std::string journal_dir_;
+    const bool delta_shard_progress_;
 
     ViewWatcher view_watcher_;
+    log_utils::CutScheduler cut_scheduler_;
 
     absl::flat_hash_map</* id */ int, std::unique_ptr<server::IngressConnection>>
         ingress_conns_;
@@ -56,8 +100,38 @@ private:
     absl::flat_hash_map</* id */ int, std::unique_ptr<server::EgressHub>>
         egress_hubs_ ABSL_GUARDED_BY(conn_mu_);
 
+    struct PendingReplication {
+        const View* view;
+        MetaLogsProto metalogs;
+    };
+    absl::Mutex replication_mu_;
+    absl::flat_hash_map</* logspace_id */ uint32_t, PendingReplication>
+        pending_replications_ ABSL_GUARDED_BY(replication_mu_);
+    bool replication_flush_scheduled_ ABSL_GUARDED_BY(replication_mu_);
+
+    absl::Mutex journal_mu_;
+    absl::flat_hash_map</* logspace_id */ uint32_t, std::unique_ptr<MetaLogJournal>>
+        journals_ ABSL_GUARDED_BY(journal_mu_);
+
+    absl::Mutex load_mu_;
+    absl::flat_hash_map</* user_logspace */ uint32_t, /* appends */ uint64_t>
+        logspace_appends_ ABSL_GUARDED_BY(load_mu_);
+    uint16_t load_view_id_ ABSL_GUARDED_BY(load_mu_);
+    size_t load_userlog_replicas_ ABSL_GUARDED_BY(load_mu_);
+    int64_t load_report_timestamp_ ABSL_GUARDED_BY(load_mu_);
+    std::atomic<bool> load_znode_created_;
+
+    absl::Mutex stat_mu_;
+    // Bytes sent to engine and storage nodes when propagating one metalog
+    stat::StatisticsCollector<uint32_t> metalog_egress_bytes_stat_
+        ABSL_GUARDED_BY(stat_mu_);
+
     void SetupZKWatchers();
     void SetupTimers();
+    void OnCutTimerTick();
+    void FlushMetaLogReplication();
+    void FlushMetaLogJournals();
+    void OnLoadReportTimerTick();
 
     void StartInternal() override;
     void StopInternal() override;
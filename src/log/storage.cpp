@@ -280,6 +280,9 @@ CCStorage::PollShardProgress(std::vector<uint32_t>& progress)
 Storage::Storage(uint16_t node_id)
     : StorageBase(node_id),
       log_header_(fmt::format("Storage[{}-N]: ", node_id)),
+      delta_shard_progress_(absl::GetFlag(FLAGS_slog_delta_shard_progress)),
+      persist_auxdata_(absl::GetFlag(FLAGS_slog_storage_persist_auxdata)),
+      max_auxdata_size_(absl::GetFlag(FLAGS_slog_storage_max_auxdata_size)),
       current_view_(nullptr),
       view_finalized_(false)
 {}
@@ -352,14 +355,13 @@ Storage::OnViewFinalized(const FinalizedView* finalized_view)
             });
         view_finalized_ = true;
     }
+    absl::InlinedVector<server::IOWorker::Function, 2> fns;
     if (!results.empty()) {
-        SomeIOWorker()->ScheduleFunction(
-            nullptr,
+        fns.push_back(
             [this, results = std::move(results)] { ProcessReadResults(results); });
     }
     if (!index_data_vec.empty()) {
-        SomeIOWorker()->ScheduleFunction(
-            nullptr,
+        fns.push_back(
             [this,
              view = finalized_view->view(),
              index_data_vec = std::move(index_data_vec)] {
@@ -368,6 +370,8 @@ Storage::OnViewFinalized(const FinalizedView* finalized_view)
                 }
             });
     }
+    SomeIOWorker()->ScheduleFunctions(
+        nullptr, std::span<server::IOWorker::Function>(fns.data(), fns.size()));
 }
 
 #define ONHOLD_IF_FROM_FUTURE_VIEW(MESSAGE_VAR, PAYLOAD_VAR) \
@@ -627,9 +631,17 @@ void
 Storage::SLogRecvMetaLog(const SharedLogMessage& message,
                          std::span<const char> payload)
 {
-    DCHECK(SharedLogMessageHelper::GetOpType(message) == SharedLogOpType::METALOG);
-    MetaLogProto metalog_proto = log_utils::MetaLogFromPayload(payload);
-    DCHECK_EQ(metalog_proto.logspace_id(), message.logspace_id);
+    MetaLogsProto metalogs_proto;
+    if (SharedLogMessageHelper::GetOpType(message) == SharedLogOpType::METALOGS) {
+        // Fetched from a sequencer
+        metalogs_proto = log_utils::MetaLogsFromPayload(payload);
+    } else {
+        DCHECK(SharedLogMessageHelper::GetOpType(message) ==
+               SharedLogOpType::METALOG);
+        metalogs_proto.set_logspace_id(message.logspace_id);
+        *metalogs_proto.add_metalogs() = log_utils::MetaLogFromPayload(payload);
+    }
+    DCHECK_EQ(metalogs_proto.logspace_id(), message.logspace_id);
     const View* view = nullptr;
     LogStorage::ReadResultVec results;
     std::optional<IndexDataProto> index_data;
@@ -643,8 +655,18 @@ Storage::SLogRecvMetaLog(const SharedLogMessage& message,
         {
             auto locked_storage = storage_ptr.Lock();
             RETURN_IF_LOGSPACE_FINALIZED(locked_storage);
-            // for (const MetaLogProto& metalog_proto: metalogs_proto.metalogs())
-            locked_storage->ProvideMetaLog(metalog_proto);
+            if (delta_shard_progress_ &&
+                (message.flags & protocol::kShardProgDeltaFlag) != 0 &&
+                !locked_storage->delta_shard_progress())
+            {
+                HLOG_F(INFO,
+                       "Switch to delta-encoded shard progress for logspace {}",
+                       bits::HexStr0x(message.logspace_id));
+                locked_storage->EnableDeltaShardProgress();
+            }
+            for (const MetaLogProto& metalog_proto: metalogs_proto.metalogs()) {
+                locked_storage->ProvideMetaLog(metalog_proto);
+            }
             locked_storage->PollReadResults(&results);
             index_data = locked_storage->PollIndexData();
         }
@@ -662,6 +684,35 @@ Storage::OnRecvLogAuxData(const protocol::SharedLogMessage& message,
     DCHECK(SharedLogMessageHelper::GetOpType(message) ==
            SharedLogOpType::SET_AUXDATA);
     uint64_t seqnum = bits::JoinTwo32(message.logspace_id, message.seqnum_lowhalf);
+    if (payload.size() > max_auxdata_size_) {
+        HLOG_F(WARNING,
+               "Drop aux data of log (seqnum {}): size {} exceeds limit {}",
+               bits::HexStr0x(seqnum),
+               payload.size(),
+               max_auxdata_size_);
+        return;
+    }
+    if (!persist_auxdata_) {
+        LogCachePutAuxData(seqnum, payload);
+        return;
+    }
+    absl::MutexLock lk(&auxdata_mu_);
+    // Aux data of an older version than the latest one is dropped. Versions
+    // already flushed, or from before a restart, are checked when flushing
+    // to the DB.
+    auto iter = auxdata_versions_.find(seqnum);
+    if (iter != auxdata_versions_.end() && iter->second > message.aux_data_version) {
+        HVLOG_F(1, "Drop stale aux data of log (seqnum {})", bits::HexStr0x(seqnum));
+        return;
+    }
+    auxdata_versions_[seqnum] = message.aux_data_version;
+    pending_auxdata_[seqnum] = PendingAuxData {
+        .version = message.aux_data_version,
+        .data = std::string(payload.data(), payload.size())
+    };
+    // Within the lock, so that the cache never goes back to an older version
+    // known here. Stale versions of flushed aux data are replaced by the one
+    // in the DB on the next flush.
     LogCachePutAuxData(seqnum, payload);
 }
 
@@ -784,6 +835,9 @@ Storage::SendEngineLogResult(const protocol::SharedLogMessage& request,
     uint64_t seqnum =
         bits::JoinTwo32(response->logspace_id, response->seqnum_lowhalf);
     std::optional<std::string> cached_aux_data = LogCacheGetAuxData(seqnum);
+    if (!cached_aux_data.has_value() && persist_auxdata_) {
+        cached_aux_data = GetPersistedAuxData(seqnum);
+    }
     std::span<const char> aux_data;
     if (cached_aux_data.has_value()) {
         size_t full_size =
@@ -805,6 +859,32 @@ Storage::SendEngineLogResult(const protocol::SharedLogMessage& request,
     SendEngineResponse(request, response, tags_data, log_data, aux_data);
 }
 
+std::optional<std::string>
+Storage::GetPersistedAuxData(uint64_t seqnum)
+{
+    {
+        absl::MutexLock lk(&auxdata_mu_);
+        auto iter = pending_auxdata_.find(seqnum);
+        if (iter != pending_auxdata_.end()) {
+            return iter->second.data;
+        }
+        // Most logs have no aux data, which is known without the DB, unless
+        // their logspaces have aux data flushed, or written before a restart
+        uint32_t logspace_id = bits::HighHalf64(seqnum);
+        if (!auxdata_versions_.contains(seqnum)
+              && !logspaces_with_auxdata_.contains(logspace_id)
+              && !IsReopenedLogSpaceInDB(logspace_id)) {
+            return std::nullopt;
+        }
+    }
+    // Evicted from the cache, or lost with a restart
+    std::optional<std::string> aux_data = GetAuxDataFromDB(seqnum);
+    if (aux_data.has_value()) {
+        LogCachePutAuxData(seqnum, STRING_AS_SPAN(*aux_data));
+    }
+    return aux_data;
+}
+
 void
 Storage::BackgroundThreadMain()
 {
@@ -867,7 +947,17 @@ Storage::CCSendShardProgress()
 void
 Storage::SLogSendShardProgress()
 {
-    std::vector<std::pair<uint32_t, std::vector<uint32_t>>> progress_to_send;
+    // Without delta encoding, shard progress is followed by
+    // (user_logspace, appends) pairs
+    struct ProgressToSend {
+        uint32_t logspace_id;
+        std::vector<uint32_t> payload;
+        size_t num_logspace_loads;
+        std::string delta_payload;
+        bool delta;
+    };
+    std::vector<ProgressToSend> progress_to_send;
+    size_t full_interval = absl::GetFlag(FLAGS_slog_shard_progress_full_interval);
     {
         absl::ReaderMutexLock view_lk(&view_mu_);
         if (current_view_ == nullptr || view_finalized_) {
@@ -875,25 +965,92 @@ Storage::SLogSendShardProgress()
         }
         storage_collection_.ForEachActiveLogSpace(
             current_view_,
-            [&progress_to_send](uint32_t logspace_id,
-                                LockablePtr<LogStorage> storage_ptr) {
+            [&progress_to_send, full_interval](uint32_t logspace_id,
+                                               LockablePtr<LogStorage> storage_ptr) {
                 auto locked_storage = storage_ptr.Lock();
-                if (!locked_storage->frozen() && !locked_storage->finalized()) {
+                if (locked_storage->frozen() || locked_storage->finalized()) {
+                    return;
+                }
+                if (locked_storage->delta_shard_progress()) {
+                    auto payload =
+                        locked_storage->GrabShardProgressDeltaForSending(full_interval);
+                    if (payload.has_value()) {
+                        progress_to_send.push_back(ProgressToSend{
+                            .logspace_id = logspace_id,
+                            .payload = {},
+                            .num_logspace_loads = 0,
+                            .delta_payload = std::move(*payload),
+                            .delta = true,
+                        });
+                    }
+                } else {
                     auto progress = locked_storage->GrabShardProgressForSending();
                     if (progress.has_value()) {
-                        progress_to_send.emplace_back(logspace_id,
-                                                      std::move(*progress));
+                        size_t num_loads =
+                            locked_storage->GrabLogSpaceLoadsForSending(&*progress);
+                        progress_to_send.push_back(ProgressToSend{
+                            .logspace_id = logspace_id,
+                            .payload = std::move(*progress),
+                            .num_logspace_loads = num_loads,
+                            .delta_payload = {},
+                            .delta = false,
+                        });
                     }
                 }
             });
     }
     for (const auto& entry: progress_to_send) {
-        uint32_t logspace_id = entry.first;
+        uint32_t logspace_id = entry.logspace_id;
         SharedLogMessage message =
             SharedLogMessageHelper::NewShardProgressMessage(logspace_id);
+        if (entry.delta) {
+            message.flags |= protocol::kShardProgDeltaFlag;
+            SendSequencerMessage(bits::LowHalf32(logspace_id),
+                                 &message,
+                                 STRING_AS_SPAN(entry.delta_payload));
+            continue;
+        }
+        message.num_logspace_loads =
+            gsl::narrow_cast<uint32_t>(entry.num_logspace_loads);
         SendSequencerMessage(bits::LowHalf32(logspace_id),
                              &message,
-                             VECTOR_AS_CHAR_SPAN(entry.second));
+                             VECTOR_AS_CHAR_SPAN(entry.payload));
+    }
+}
+
+void
+Storage::FetchMissingMetaLogs()
+{
+    std::vector<std::pair</* logspace_id */ uint32_t, LogStorage::MetaLogGap>> gaps;
+    {
+        absl::ReaderMutexLock view_lk(&view_mu_);
+        storage_collection_.ForEachActiveLogSpace(
+            [&gaps](uint32_t logspace_id, LockablePtr<LogStorage> storage_ptr) {
+                auto locked_storage = storage_ptr.Lock();
+                if (auto gap = locked_storage->CheckMetaLogGap(); gap.has_value()) {
+                    gaps.emplace_back(logspace_id, *gap);
+                }
+            });
+    }
+    for (const auto& [logspace_id, gap]: gaps) {
+        if (gap.end_position == LogSpaceBase::kUnknownEndPosition) {
+            HVLOG_F(1,
+                    "Probe metalogs from {} of logspace {} at sequencer {}",
+                    gap.start_position,
+                    bits::HexStr0x(logspace_id),
+                    gap.sequencer_id);
+        } else {
+            HLOG_F(WARNING,
+                   "Fetch missing metalogs [{}, {}) of logspace {} from sequencer {}",
+                   gap.start_position,
+                   gap.end_position,
+                   bits::HexStr0x(logspace_id),
+                   gap.sequencer_id);
+        }
+        SharedLogMessage message = SharedLogMessageHelper::NewMetaLogFetchMessage(
+            logspace_id, gap.start_position, gap.end_position);
+        message.flags |= protocol::kMetaLogFetchFromStorageFlag;
+        SendSequencerMessage(gap.sequencer_id, &message, EMPTY_CHAR_SPAN);
     }
 }
 
@@ -905,6 +1062,45 @@ Storage::FlushLogEntries()
     } else {
         SLogFlushToDB();
     }
+    FlushAuxData();
+}
+
+void
+Storage::FlushAuxData()
+{
+    std::vector<std::pair<uint64_t, PendingAuxData>> items;
+    {
+        absl::MutexLock lk(&auxdata_mu_);
+        if (pending_auxdata_.empty()) {
+            return;
+        }
+        // Copied, so that reads find them until written
+        items.assign(pending_auxdata_.begin(), pending_auxdata_.end());
+    }
+    for (const auto& [seqnum, item]: items) {
+        if (PutAuxDataToDB(seqnum, item.version, STRING_AS_SPAN(item.data))) {
+            continue;
+        }
+        // Written before a restart with a newer version
+        uint64_t stored_version = 0;
+        std::optional<std::string> stored = GetAuxDataFromDB(seqnum, &stored_version);
+        absl::MutexLock lk(&auxdata_mu_);
+        if (stored.has_value() && auxdata_versions_[seqnum] <= stored_version) {
+            auxdata_versions_[seqnum] = stored_version;
+            LogCachePutAuxData(seqnum, STRING_AS_SPAN(*stored));
+        }
+    }
+    absl::MutexLock lk(&auxdata_mu_);
+    for (const auto& [seqnum, item]: items) {
+        auto iter = pending_auxdata_.find(seqnum);
+        // Newer aux data may have arrived while writing
+        if (iter != pending_auxdata_.end() && iter->second.version == item.version) {
+            pending_auxdata_.erase(iter);
+            // The DB keeps the version from now on
+            logspaces_with_auxdata_.insert(bits::HighHalf64(seqnum));
+            auxdata_versions_.erase(seqnum);
+        }
+    }
 }
 
 void
@@ -136,6 +136,9 @@ public:
 
 private:
     std::string log_header_;
+    const bool delta_shard_progress_;
+    const bool persist_auxdata_;
+    const size_t max_auxdata_size_;
 
     absl::Mutex view_mu_;
     const View* current_view_ ABSL_GUARDED_BY(view_mu_);
@@ -144,6 +147,22 @@ private:
 
     log_utils::FutureRequests future_requests_;
 
+    struct PendingAuxData {
+        uint64_t version;
+        std::string data;
+    };
+    absl::Mutex auxdata_mu_;
+    // Versions of aux data not flushed to the DB yet. Once flushed, the DB
+    // keeps the version, and only its logspace is remembered, to tell
+    // whether a log may have aux data in the DB.
+    absl::flat_hash_map</* seqnum */ uint64_t, /* version */ uint64_t>
+        auxdata_versions_ ABSL_GUARDED_BY(auxdata_mu_);
+    absl::flat_hash_set</* logspace_id */ uint32_t>
+        logspaces_with_auxdata_ ABSL_GUARDED_BY(auxdata_mu_);
+    // Written to the DB with log entries by the background thread
+    absl::flat_hash_map</* seqnum */ uint64_t, PendingAuxData>
+        pending_auxdata_ ABSL_GUARDED_BY(auxdata_mu_);
+
     void OnViewCreated(const View* view) override;
     void OnViewFinalized(const FinalizedView* finalized_view) override;
 
@@ -182,14 +201,17 @@ private:
                              protocol::SharedLogMessage* response,
                              std::span<const char> tags_data,
                              std::span<const char> log_data);
+    std::optional<std::string> GetPersistedAuxData(uint64_t seqnum);
 
     void SendShardProgressIfNeeded() override;
     void SLogSendShardProgress();
     void CCSendShardProgress();
+    void FetchMissingMetaLogs() override;
 
     void FlushLogEntries();
     void SLogFlushToDB();
     void CCFlushToDB();
+    void FlushAuxData();
 
     void BackgroundThreadMain() override;
 
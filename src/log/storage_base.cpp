@@ -4,6 +4,7 @@
 #include "log/utils.h"
 #include "server/constants.h"
 #include "utils/fs.h"
+#include "utils/random.h"
 #include <cstdint>
 #include <sys/types.h>
 
@@ -24,6 +25,7 @@ using server::NodeWatcher;
 StorageBase::StorageBase(uint16_t node_id)
     : ServerBase(fmt::format("storage_{}", node_id)),
       node_id_(node_id),
+      metalog_drop_rate_(absl::GetFlag(FLAGS_slog_debug_metalog_drop_rate)),
       db_(nullptr),
       background_thread_("BG", [this] { this->BackgroundThreadMain(); })
 {
@@ -94,6 +96,13 @@ StorageBase::SetupTimers()
         kSendShardProgressTimerId,
         absl::Microseconds(absl::GetFlag(FLAGS_slog_local_cut_interval_us)),
         [this]() { this->SendShardProgressIfNeeded(); });
+    int gap_check_interval_ms = absl::GetFlag(FLAGS_slog_metalog_gap_check_interval_ms);
+    if (!use_txn_engine_ && gap_check_interval_ms > 0) {
+        CreatePeriodicTimer(
+            kMetaLogGapTimerId,
+            absl::Milliseconds(gap_check_interval_ms),
+            [this]() { this->FetchMissingMetaLogs(); });
+    }
 }
 
 void
@@ -122,6 +131,7 @@ StorageBase::MessageHandler(const SharedLogMessage& message,
         HandleCCTxnWriteRequest(message, payload);
         break;
     case SharedLogOpType::METALOG:
+    case SharedLogOpType::METALOGS:
         OnRecvNewMetaLog(message, payload);
         break;
     case SharedLogOpType::SET_AUXDATA:
@@ -207,6 +217,26 @@ StorageBase::PutKVToDB(uint64_t seqnum, uint64_t key, const std::string& value)
     db_->PutKV(seqnum, key, STRING_AS_SPAN(value));
 }
 
+std::optional<std::string>
+StorageBase::GetAuxDataFromDB(uint64_t seqnum, uint64_t* version)
+{
+    return db_->GetAuxData(seqnum, version);
+}
+
+bool
+StorageBase::PutAuxDataToDB(uint64_t seqnum,
+                            uint64_t version,
+                            std::span<const char> data)
+{
+    return db_->PutAuxData(seqnum, version, data);
+}
+
+bool
+StorageBase::IsReopenedLogSpaceInDB(uint32_t logspace_id)
+{
+    return db_->IsReopenedLogSpace(logspace_id);
+}
+
 void
 StorageBase::LogCachePutAuxData(uint64_t seqnum, std::span<const char> data)
 {
@@ -308,6 +338,9 @@ StorageBase::OnRecvSharedLogMessage(int conn_type,
     DCHECK(
         (conn_type == kSequencerIngressTypeId &&
          op_type == SharedLogOpType::METALOG) ||
+        (conn_type == kSequencerIngressTypeId &&
+         op_type == SharedLogOpType::METALOGS) ||
+        (conn_type == kEngineIngressTypeId && op_type == SharedLogOpType::METALOG) ||
         (conn_type == kEngineIngressTypeId && op_type == SharedLogOpType::READ_AT) ||
         (conn_type == kEngineIngressTypeId &&
          op_type == SharedLogOpType::REPLICATE) ||
@@ -316,6 +349,14 @@ StorageBase::OnRecvSharedLogMessage(int conn_type,
         << fmt::format("Invalid combination: conn_type={:#x}, op_type={:#x}",
                        conn_type,
                        message.op_type);
+    if (metalog_drop_rate_ > 0 && op_type == SharedLogOpType::METALOG &&
+        utils::GetRandomDouble() < metalog_drop_rate_)
+    {
+        HVLOG_F(1,
+                "Drop metalog message of logspace {}",
+                bits::HexStr0x(message.logspace_id));
+        return;
+    }
     MessageHandler(message, payload);
 }
 
@@ -34,6 +34,9 @@ protected:
 
     virtual void BackgroundThreadMain() = 0;
     virtual void SendShardProgressIfNeeded() = 0;
+    // Fetch missing metalogs from sequencers, if pending metalogs of some
+    // logspace are blocked by them
+    virtual void FetchMissingMetaLogs() = 0;
 
     void MessageHandler(const protocol::SharedLogMessage& message,
                         std::span<const char> payload);
@@ -68,6 +71,12 @@ protected:
     std::optional<std::string> GetKVFromDB(uint64_t seqnum, uint64_t key);
     void PutKVToDB(uint64_t seqnum, uint64_t key, const std::string& value);
 
+    std::optional<std::string> GetAuxDataFromDB(uint64_t seqnum,
+                                                uint64_t* version = nullptr);
+    // Returns false if aux data of a newer version is persisted
+    bool PutAuxDataToDB(uint64_t seqnum, uint64_t version, std::span<const char> data);
+    bool IsReopenedLogSpaceInDB(uint32_t logspace_id);
+
     void SLogSendIndexData(const View* view, const IndexDataProto& index_data_proto);
     void CCSendIndexData(const View* view,
                          uint32_t logspace_id,
@@ -84,6 +93,7 @@ protected:
 
 private:
     const uint16_t node_id_;
+    const double metalog_drop_rate_;
 
     ViewWatcher view_watcher_;
 
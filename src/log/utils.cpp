@@ -3,9 +3,12 @@
 #include "base/logging.h"
 #include "base/std_span.h"
 #include "common/protocol.h"
+#include "common/time.h"
 #include "log/common.h"
+#include "log/flags.h"
 #include "proto/shared_log.pb.h"
 #include "utils/bits.h"
+#include "utils/hash.h"
 #include <cstdint>
 #include <string>
 
@@ -16,7 +19,7 @@ using log::SharedLogRequest;
 using log::LogMetaData;
 using log::LogEntryProto;
 using log::MetaLogProto;
-// using log::MetaLogsProto;
+using log::MetaLogsProto;
 using protocol::SharedLogMessage;
 
 using protocol::SharedLogOpType;
@@ -68,6 +71,333 @@ FutureRequests::OnHoldRequest(uint16_t view_id, SharedLogRequest request)
     onhold_requests_[view_id].push_back(std::move(request));
 }
 
+CutScheduler::CutScheduler()
+    : adaptive_(absl::GetFlag(FLAGS_slog_global_cut_adaptive)),
+      min_interval_us_(absl::GetFlag(FLAGS_slog_global_cut_interval_us)),
+      max_interval_us_(std::max<int64_t>(
+          min_interval_us_,
+          absl::GetFlag(FLAGS_slog_global_cut_max_interval_us))),
+      max_delay_us_(absl::GetFlag(FLAGS_slog_global_cut_max_delay_us)),
+      max_pending_records_(absl::GetFlag(FLAGS_slog_global_cut_max_pending_records)),
+      max_pending_bytes_(absl::GetFlag(FLAGS_slog_global_cut_max_pending_bytes)),
+      interval_us_(min_interval_us_),
+      last_attempt_timestamp_(GetMonotonicMicroTimestamp()),
+      first_pending_timestamp_(0),
+      pending_records_(0),
+      pending_bytes_(0),
+      early_cut_triggered_(false),
+      cut_interval_stat_(stat::StatisticsCollector<int>::StandardReportCallback(
+          "global_cut_interval_us")),
+      cut_records_stat_(stat::StatisticsCollector<uint32_t>::StandardReportCallback(
+          "global_cut_progress_records")),
+      cut_size_stat_(stat::StatisticsCollector<uint32_t>::StandardReportCallback(
+          "global_cut_new_logs"))
+{
+    CHECK_GT(min_interval_us_, 0);
+}
+
+CutScheduler::~CutScheduler() {}
+
+bool
+CutScheduler::OnShardProgress(size_t payload_size)
+{
+    if (!adaptive_) {
+        return false;
+    }
+    absl::MutexLock lk(&mu_);
+    if (pending_records_ == 0) {
+        first_pending_timestamp_ = GetMonotonicMicroTimestamp();
+    }
+    pending_records_++;
+    pending_bytes_ += payload_size;
+    if (early_cut_triggered_) {
+        return false;
+    }
+    if (pending_records_ >= max_pending_records_ ||
+        pending_bytes_ >= max_pending_bytes_)
+    {
+        early_cut_triggered_ = true;
+        return true;
+    }
+    return false;
+}
+
+bool
+CutScheduler::ShouldMarkCut()
+{
+    if (!adaptive_) {
+        return true;
+    }
+    absl::MutexLock lk(&mu_);
+    int64_t now = GetMonotonicMicroTimestamp();
+    if (pending_records_ == 0) {
+        // No shard progress since the last cut, nothing can change
+        if (now - last_attempt_timestamp_ >= interval_us_) {
+            BackOff(now);
+        }
+        return false;
+    }
+    if (now - first_pending_timestamp_ >= max_delay_us_) {
+        return true;
+    }
+    return now - last_attempt_timestamp_ >= interval_us_;
+}
+
+void
+CutScheduler::OnCutMarked(uint32_t num_new_logs)
+{
+    if (!adaptive_) {
+        return;
+    }
+    absl::MutexLock lk(&mu_);
+    int64_t now = GetMonotonicMicroTimestamp();
+    early_cut_triggered_ = false;
+    if (num_new_logs == 0) {
+        // Progress records did not advance any shard
+        pending_records_ = 0;
+        pending_bytes_ = 0;
+        BackOff(now);
+        return;
+    }
+    // Interval the cut is scheduled with, before resetting it
+    cut_interval_stat_.AddSample(gsl::narrow_cast<int>(interval_us_));
+    cut_records_stat_.AddSample(gsl::narrow_cast<uint32_t>(pending_records_));
+    cut_size_stat_.AddSample(num_new_logs);
+    interval_us_ = min_interval_us_;
+    last_attempt_timestamp_ = now;
+    pending_records_ = 0;
+    pending_bytes_ = 0;
+}
+
+void
+CutScheduler::OnCutSkipped()
+{
+    if (!adaptive_) {
+        return;
+    }
+    absl::MutexLock lk(&mu_);
+    early_cut_triggered_ = false;
+}
+
+void
+CutScheduler::BackOff(int64_t now)
+{
+    interval_us_ = std::min(interval_us_ * 2, max_interval_us_);
+    last_attempt_timestamp_ = now;
+    VLOG_F(1, "Global cut interval backs off to {}us", interval_us_);
+}
+
+std::vector<std::pair<uint32_t, uint16_t>>
+PlaceLogSpacesByLoad(const View* view, const LogSpaceLoads& loads, size_t max_placed)
+{
+    std::vector<std::pair</* load */ double, /* user_logspace */ uint32_t>> sorted;
+    sorted.reserve(loads.size());
+    for (const auto& [user_logspace, load]: loads) {
+        sorted.emplace_back(load, user_logspace);
+    }
+    // Heaviest first, ties broken by user logspace to be deterministic
+    std::sort(sorted.begin(),
+              sorted.end(),
+              [](const std::pair<double, uint32_t>& lhs,
+                 const std::pair<double, uint32_t>& rhs) -> bool {
+                  if (lhs.first != rhs.first) {
+                      return lhs.first > rhs.first;
+                  }
+                  return lhs.second < rhs.second;
+              });
+    std::vector<uint16_t> phylogs;
+    absl::flat_hash_map</* sequencer_id */ uint16_t, double> phylog_loads;
+    for (uint16_t sequencer_id: view->GetSequencerNodes()) {
+        if (view->is_active_phylog(sequencer_id)) {
+            phylogs.push_back(sequencer_id);
+            phylog_loads[sequencer_id] = 0;
+        }
+    }
+    size_t num_placed = std::min(max_placed, sorted.size());
+    for (size_t i = num_placed; i < sorted.size(); i++) {
+        phylog_loads[view->HashedSequencerNode(sorted[i].second)] += sorted[i].first;
+    }
+    std::vector<std::pair<uint32_t, uint16_t>> placement;
+    for (size_t i = 0; i < num_placed; i++) {
+        auto [load, user_logspace] = sorted[i];
+        // Stay on the hashed phylog unless another one is strictly lighter,
+        // so that balanced workloads see no placement changes
+        uint16_t hashed = view->HashedSequencerNode(user_logspace);
+        uint16_t target = hashed;
+        for (uint16_t sequencer_id: phylogs) {
+            if (phylog_loads[sequencer_id] < phylog_loads[target]) {
+                target = sequencer_id;
+            }
+        }
+        phylog_loads[target] += load;
+        if (target != hashed) {
+            placement.emplace_back(user_logspace, target);
+        }
+    }
+    return placement;
+}
+
+uint64_t
+MetaLogDigest(const MetaLogProto& metalog)
+{
+    std::string serialized;
+    CHECK(metalog.SerializeToString(&serialized));
+    return XXH64(serialized.data(), serialized.size(), hash::kDefaultHashSeed64);
+}
+
+SealReport
+BuildSealReport(uint16_t sequencer_id, const MetaLogsProto& tail)
+{
+    SealReport report = {
+        .sequencer_id = sequencer_id,
+        .metalog_position = 0,
+        .digest = 0,
+    };
+    if (!tail.metalogs().empty()) {
+        const MetaLogProto& last = *tail.metalogs().rbegin();
+        report.metalog_position = last.metalog_seqnum() + 1;
+        report.digest = MetaLogDigest(last);
+    }
+    return report;
+}
+
+std::optional<SealReport>
+PickSealTailSource(std::span<const SealReport> reports,
+                   const absl::flat_hash_set<uint16_t>& rejected)
+{
+    std::optional<SealReport> picked;
+    for (const SealReport& report: reports) {
+        if (rejected.contains(report.sequencer_id)) {
+            continue;
+        }
+        if (!picked.has_value()
+              || report.metalog_position > picked->metalog_position
+              || (report.metalog_position == picked->metalog_position
+                    && report.sequencer_id < picked->sequencer_id)) {
+            picked = report;
+        }
+    }
+    return picked;
+}
+
+size_t
+CountAgreeingReports(const MetaLogsProto& tail, std::span<const SealReport> reports,
+                     const absl::flat_hash_set<uint16_t>& rejected)
+{
+    uint32_t start_pos = 0;
+    uint32_t end_pos = 0;
+    if (!tail.metalogs().empty()) {
+        start_pos = tail.metalogs(0).metalog_seqnum();
+        end_pos = start_pos + gsl::narrow_cast<uint32_t>(tail.metalogs_size());
+    }
+    absl::flat_hash_set</* sequencer_id */ uint16_t> agreeing;
+    for (const SealReport& report: reports) {
+        if (rejected.contains(report.sequencer_id)) {
+            continue;
+        }
+        uint32_t pos = report.metalog_position;
+        if (pos > end_pos) {
+            continue;
+        }
+        if (pos == 0 || pos - 1 < start_pos) {
+            agreeing.insert(report.sequencer_id);
+            continue;
+        }
+        const MetaLogProto& metalog = tail.metalogs(static_cast<int>(pos - 1 - start_pos));
+        DCHECK_EQ(metalog.metalog_seqnum(), pos - 1);
+        if (MetaLogDigest(metalog) == report.digest) {
+            agreeing.insert(report.sequencer_id);
+        }
+    }
+    return agreeing.size();
+}
+
+PhylogSeal::PhylogSeal()
+    : fetch_timestamp_(0) {}
+
+PhylogSeal::~PhylogSeal() {}
+
+std::optional<uint16_t>
+PhylogSeal::pending_fetch() const
+{
+    if (fetching_.has_value() && !tails_.contains(*fetching_)) {
+        return fetching_;
+    }
+    return std::nullopt;
+}
+
+void
+PhylogSeal::AddReport(const SealReport& report)
+{
+    for (SealReport& existing: reports_) {
+        if (existing.sequencer_id == report.sequencer_id) {
+            existing = report;
+            return;
+        }
+    }
+    reports_.push_back(report);
+}
+
+void
+PhylogSeal::AddTail(uint16_t sequencer_id, const MetaLogsProto& tail)
+{
+    tails_[sequencer_id] = tail;
+}
+
+const MetaLogsProto*
+PhylogSeal::PickFinalTail(size_t quorum, std::optional<uint16_t>* fetch_source)
+{
+    fetch_source->reset();
+    if (reports_.size() < quorum) {
+        return nullptr;
+    }
+    // The longest tail contains all shorter ones, as long as it agrees with
+    // a quorum of reports. Otherwise, fall back to the next longest one.
+    while (true) {
+        // Metalogs missing from shorter tails may be on a quorum including
+        // rejected replicas, so falling back needs a quorum without them
+        size_t num_candidates = 0;
+        for (const SealReport& report: reports_) {
+            if (!rejected_.contains(report.sequencer_id)) {
+                num_candidates++;
+            }
+        }
+        if (num_candidates < quorum) {
+            return nullptr;
+        }
+        auto source = PickSealTailSource(reports_, rejected_);
+        if (!source.has_value()) {
+            LOG_F(ERROR, "No agreeing tail from {} replicas", reports_.size());
+            return nullptr;
+        }
+        auto iter = tails_.find(source->sequencer_id);
+        if (iter == tails_.end()) {
+            if (fetching_ != source->sequencer_id) {
+                fetching_ = source->sequencer_id;
+                fetch_timestamp_ = GetMonotonicMicroTimestamp();
+                *fetch_source = source->sequencer_id;
+            }
+            return nullptr;
+        }
+        if (CountAgreeingReports(iter->second, reports_, rejected_) < quorum) {
+            LOG_F(WARNING, "Tail from sequencer {} disagrees with other replicas",
+                  source->sequencer_id);
+            rejected_.insert(source->sequencer_id);
+            continue;
+        }
+        return &iter->second;
+    }
+}
+
+void
+PhylogSeal::AbortFetch()
+{
+    if (auto source = pending_fetch(); source.has_value()) {
+        rejected_.insert(*source);
+        fetching_.reset();
+    }
+}
+
 MetaLogProto
 MetaLogFromPayload(std::span<const char> payload)
 {
@@ -90,6 +420,28 @@ MetaLogFromPayload(std::span<const char> payload)
     return metalog_proto;
 }
 
+MetaLogsProto
+MetaLogsFromPayload(std::span<const char> payload)
+{
+    MetaLogsProto metalogs_proto;
+    if (!metalogs_proto.ParseFromArray(payload.data(),
+                                       static_cast<int>(payload.size())))
+    {
+        LOG(FATAL) << "Failed to parse MetaLogsProto";
+    }
+    if (metalogs_proto.metalogs_size() == 0) {
+        LOG(FATAL) << "Empty MetaLogsProto";
+    }
+    uint32_t logspace_id = metalogs_proto.logspace_id();
+    for (const MetaLogProto& metalog_proto: metalogs_proto.metalogs()) {
+        if (metalog_proto.logspace_id() != logspace_id) {
+            LOG(FATAL)
+                << "Meta logs in on MetaLogsProto must have the same logspace_id";
+        }
+    }
+    return metalogs_proto;
+}
+
 LogMetaData
 GetMetaDataFromMessage(const SharedLogMessage& message)
 {
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/synchronization/mutex.h"
 #include "common/protocol.h"
+#include "common/stat.h"
 #include "log/common.h"
 #include "log/view.h"
 #include "log/view_watcher.h"
@@ -41,6 +43,133 @@ private:
     DISALLOW_COPY_AND_ASSIGN(FutureRequests);
 };
 
+// Decides when the primary sequencer marks the next global cut.
+// Without `slog_global_cut_adaptive`, every timer tick marks a cut.
+// Otherwise a cut is marked early once pending shard progress passes the
+// record or byte threshold, the interval backs off when nothing changed,
+// and pending progress never waits longer than `slog_global_cut_max_delay_us`.
+class CutScheduler {
+public:
+    CutScheduler();
+    ~CutScheduler();
+
+    // All APIs are thread safe
+
+    // Returns true if a cut should be marked right away
+    bool OnShardProgress(size_t payload_size);
+    // Called on every cut timer tick
+    bool ShouldMarkCut();
+    // `num_new_logs` is 0 if the cut attempt found nothing new
+    void OnCutMarked(uint32_t num_new_logs);
+    // Called if no cut is attempted, e.g. too many metalogs are in flight
+    void OnCutSkipped();
+
+private:
+    const bool adaptive_;
+    const int64_t min_interval_us_;
+    const int64_t max_interval_us_;
+    const int64_t max_delay_us_;
+    const size_t max_pending_records_;
+    const size_t max_pending_bytes_;
+
+    absl::Mutex mu_;
+
+    int64_t interval_us_ ABSL_GUARDED_BY(mu_);
+    int64_t last_attempt_timestamp_ ABSL_GUARDED_BY(mu_);
+    int64_t first_pending_timestamp_ ABSL_GUARDED_BY(mu_);
+    size_t pending_records_ ABSL_GUARDED_BY(mu_);
+    size_t pending_bytes_ ABSL_GUARDED_BY(mu_);
+    bool early_cut_triggered_ ABSL_GUARDED_BY(mu_);
+
+    stat::StatisticsCollector<int> cut_interval_stat_ ABSL_GUARDED_BY(mu_);
+    stat::StatisticsCollector<uint32_t> cut_records_stat_ ABSL_GUARDED_BY(mu_);
+    stat::StatisticsCollector<uint32_t> cut_size_stat_ ABSL_GUARDED_BY(mu_);
+
+    void BackOff(int64_t now) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+    DISALLOW_COPY_AND_ASSIGN(CutScheduler);
+};
+
+using LogSpaceLoads = absl::flat_hash_map</* user_logspace */ uint32_t,
+                                          /* appends per second */ double>;
+
+// Load-aware placement of user logspaces onto physical logs of `view`.
+// The `max_placed` heaviest user logspaces are placed greedily, heaviest
+// first, each onto the phylog with the least load so far. Others keep the
+// hashed mapping, and count towards loads of their hashed phylogs.
+// Only placements differing from the hashed mapping are returned.
+std::vector<std::pair</* user_logspace */ uint32_t, /* sequencer_id */ uint16_t>>
+PlaceLogSpacesByLoad(const log::View* view, const LogSpaceLoads& loads,
+                     size_t max_placed);
+
+// Seal response of one replica of a phylog, when sequencers report
+// tail digests only (see `slog_seal_tail_digests`)
+struct SealReport {
+    uint16_t sequencer_id;
+    uint32_t metalog_position;
+    // Digest of the metalog at `metalog_position - 1`, zero if position is zero
+    uint64_t digest;
+};
+
+uint64_t MetaLogDigest(const log::MetaLogProto& metalog);
+// Builds the report of a replica from its (contiguous) tail metalogs
+SealReport BuildSealReport(uint16_t sequencer_id, const log::MetaLogsProto& tail);
+
+// Returns the report with the longest tail, skipping `rejected` replicas.
+// Ties are broken by sequencer_id to be deterministic.
+std::optional<SealReport> PickSealTailSource(
+    std::span<const SealReport> reports,
+    const absl::flat_hash_set</* sequencer_id */ uint16_t>& rejected);
+
+// Counts replicas agreeing with `tail`, i.e. whose last metalog is within
+// `tail` with the same digest. Reports ending before the first metalog of
+// `tail` cannot be checked, and are counted as agreeing. Each replica is
+// counted once, even if it reports more than once, and `rejected` replicas
+// are not counted.
+size_t CountAgreeingReports(
+    const log::MetaLogsProto& tail, std::span<const SealReport> reports,
+    const absl::flat_hash_set</* sequencer_id */ uint16_t>& rejected);
+
+// Seal state of one phylog. Replicas report (position, digest) of their
+// tails, and the full tail is fetched from the one with the longest tail.
+// Old sequencers send full tails right away, which count as both.
+class PhylogSeal {
+public:
+    PhylogSeal();
+    ~PhylogSeal();
+
+    size_t num_reports() const { return reports_.size(); }
+    // Replica whose full tail is being fetched, and not received yet
+    std::optional</* sequencer_id */ uint16_t> pending_fetch() const;
+    int64_t fetch_timestamp() const { return fetch_timestamp_; }
+
+    // A replica publishing its report again replaces the previous one
+    void AddReport(const SealReport& report);
+    void AddTail(uint16_t sequencer_id, const log::MetaLogsProto& tail);
+
+    // Returns the longest tail agreeing with a quorum of reports, falling back
+    // to shorter ones while a quorum of replicas is not rejected. Returns
+    // nullptr if no such tail is available yet, and sets `fetch_source` if it
+    // should be fetched from a new replica.
+    const log::MetaLogsProto* PickFinalTail(
+        size_t quorum, std::optional</* sequencer_id */ uint16_t>* fetch_source);
+    // The pending fetch does not complete, e.g. its replica is gone. The next
+    // call of PickFinalTail falls back to the next agreeing replica, or
+    // waits for more reports if the others are fewer than a quorum.
+    void AbortFetch();
+
+private:
+    std::vector<SealReport> reports_;
+    absl::flat_hash_map</* sequencer_id */ uint16_t, log::MetaLogsProto> tails_;
+    // Replicas whose tails do not agree with a quorum of reports, or fail to
+    // answer the fetch
+    absl::flat_hash_set</* sequencer_id */ uint16_t> rejected_;
+    std::optional</* sequencer_id */ uint16_t> fetching_;
+    int64_t fetch_timestamp_;
+
+    DISALLOW_COPY_AND_ASSIGN(PhylogSeal);
+};
+
 template <class T>
 class ThreadedMap {
 public:
@@ -163,6 +292,7 @@ ThreadedMap<T>::PollAllSorted(std::vector<std::pair<uint64_t, T*>>* values)
 }
 
 log::MetaLogProto MetaLogFromPayload(std::span<const char> payload);
+log::MetaLogsProto MetaLogsFromPayload(std::span<const char> payload);
 
 log::LogMetaData GetMetaDataFromMessage(const protocol::SharedLogMessage& message);
 void SplitPayloadForMessage(const protocol::SharedLogMessage& message,
@@ -79,12 +79,20 @@ View::View(const ViewProto& view_proto)
         }
     }
 
+    absl::flat_hash_map<uint16_t, std::vector<uint16_t>> metalog_storage_nodes;
+    for (const auto& [storage_node_id, engine_node_ids]: source_engine_nodes) {
+        metalog_storage_nodes[engine_node_ids.front()].push_back(storage_node_id);
+    }
+
     for (size_t i = 0; i < num_engine_nodes; i++) {
         uint16_t node_id = engine_node_ids_[i];
         engines_.push_back(Engine(
             this,
             node_id,
+            i,
             NodeIdVec(storage_nodes[node_id].begin(), storage_nodes[node_id].end()),
+            NodeIdVec(metalog_storage_nodes[node_id].begin(),
+                      metalog_storage_nodes[node_id].end()),
             NodeIdVec(index_sequencer_nodes[node_id].begin(),
                       index_sequencer_nodes[node_id].end())));
     }
@@ -128,20 +136,79 @@ View::View(const ViewProto& view_proto)
         DCHECK(sequencer_node_id_set.contains(node_id));
         log_space_hash_tokens_[i] = node_id;
     }
+
+    DCHECK_EQ(view_proto.placed_log_spaces_size(), view_proto.placed_sequencers_size());
+    for (int i = 0; i < view_proto.placed_log_spaces_size(); i++) {
+        uint16_t node_id = gsl::narrow_cast<uint16_t>(view_proto.placed_sequencers(i));
+        DCHECK(active_phylogs_.contains(node_id));
+        log_space_placement_[view_proto.placed_log_spaces(i)] = node_id;
+    }
+    if (!log_space_placement_.empty()) {
+        LOG_F(INFO, "View {} places {} user log spaces by load",
+              id_, log_space_placement_.size());
+    }
+}
+
+std::span<const uint16_t>
+View::GetMetaLogFanoutRoots(size_t fanout) const
+{
+    DCHECK_GT(fanout, 0U);
+    return std::span<const uint16_t>(engine_node_ids_.data(),
+                                     std::min(fanout, engine_node_ids_.size()));
+}
+
+void
+View::ResolveMetaLogFanoutTargets(size_t fanout,
+                                  std::span<const uint16_t> targets,
+                                  const std::function<bool(uint16_t)>& is_down,
+                                  std::vector<uint16_t>* engine_nodes,
+                                  std::vector<uint16_t>* storage_nodes) const
+{
+    DCHECK_GT(fanout, 0U);
+    std::vector<uint16_t> pending(targets.begin(), targets.end());
+    while (!pending.empty()) {
+        uint16_t engine_id = pending.back();
+        pending.pop_back();
+        if (!is_down(engine_id)) {
+            engine_nodes->push_back(engine_id);
+            continue;
+        }
+        const View::Engine* engine_node = GetEngineNode(engine_id);
+        for (uint16_t storage_id: engine_node->GetMetaLogStorageNodes()) {
+            storage_nodes->push_back(storage_id);
+        }
+        for (uint16_t child_id: engine_node->GetMetaLogFanoutChildren(fanout)) {
+            pending.push_back(child_id);
+        }
+    }
 }
 
 View::Engine::Engine(const View* view,
                      uint16_t node_id,
+                     size_t index,
                      const View::NodeIdVec& storage_nodes,
+                     const View::NodeIdVec& metalog_storage_nodes,
                      const View::NodeIdVec& index_sequencer_nodes)
     : view_(view),
       node_id_(node_id),
+      index_(index),
       storage_nodes_(storage_nodes),
+      metalog_storage_nodes_(metalog_storage_nodes),
       indexed_sequencer_node_set_(index_sequencer_nodes.begin(),
                                   index_sequencer_nodes.end()),
       next_storage_node_(0)
 {}
 
+std::span<const uint16_t>
+View::Engine::GetMetaLogFanoutChildren(size_t fanout) const
+{
+    DCHECK_GT(fanout, 0U);
+    const View::NodeIdVec& engine_node_ids = view_->GetEngineNodes();
+    size_t start = std::min((index_ + 1) * fanout, engine_node_ids.size());
+    size_t end = std::min(start + fanout, engine_node_ids.size());
+    return std::span<const uint16_t>(engine_node_ids.data() + start, end - start);
+}
+
 View::Sequencer::Sequencer(const View* view,
                            uint16_t node_id,
                            const View::NodeIdVec& replica_sequencer_nodes,
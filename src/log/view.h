@@ -47,14 +47,42 @@ public:
     }
 
     uint32_t LogSpaceIdentifier(uint32_t user_logspace) const {
-        uint64_t h = hash::xxHash64(user_logspace, /* seed= */ log_space_hash_seed_);
-        uint16_t node_id = log_space_hash_tokens_[h % log_space_hash_tokens_.size()];
+        uint16_t node_id;
+        if (auto iter = log_space_placement_.find(user_logspace);
+                iter != log_space_placement_.end()) {
+            node_id = iter->second;
+        } else {
+            node_id = HashedSequencerNode(user_logspace);
+        }
         DCHECK(sequencer_nodes_.contains(node_id));
         return bits::JoinTwo16(id_, node_id);
     }
 
+    // Sequencer node of `user_logspace` under the hashed mapping,
+    // ignoring load-aware placement
+    uint16_t HashedSequencerNode(uint32_t user_logspace) const {
+        uint64_t h = hash::xxHash64(user_logspace, /* seed= */ log_space_hash_seed_);
+        return log_space_hash_tokens_[h % log_space_hash_tokens_.size()];
+    }
+
     uint64_t log_space_hash_seed() const { return log_space_hash_seed_; }
     const NodeIdVec& log_space_hash_tokens() const { return log_space_hash_tokens_; }
+    size_t num_placed_log_spaces() const { return log_space_placement_.size(); }
+
+    // Metalogs can be propagated along a `fanout`-ary tree of engine nodes,
+    // where the sequencer only sends to the first `fanout` engine nodes.
+    // Also see Engine::GetMetaLogFanoutChildren.
+    std::span<const uint16_t> GetMetaLogFanoutRoots(size_t fanout) const;
+
+    // Resolves fan-out `targets` of a sender. Engine nodes for which
+    // `is_down` holds are replaced by their children, recursively, and
+    // storage nodes they would forward to go to `storage_nodes`, so that
+    // the sender adopts the orphaned subtree.
+    void ResolveMetaLogFanoutTargets(size_t fanout,
+                                     std::span<const uint16_t> targets,
+                                     const std::function<bool(uint16_t)>& is_down,
+                                     std::vector<uint16_t>* engine_nodes,
+                                     std::vector<uint16_t>* storage_nodes) const;
 
     class Engine {
     public:
@@ -77,18 +105,31 @@ public:
             return indexed_sequencer_node_set_.contains(sequencer_node_id);
         }
 
+        // Within the metalog fan-out tree, the i-th engine node forwards
+        // metalogs to engine nodes [(i+1)*fanout, (i+2)*fanout)
+        std::span<const uint16_t> GetMetaLogFanoutChildren(size_t fanout) const;
+
+        // Storage nodes that receive metalogs from this engine node in
+        // fan-out mode, i.e. those for which it is the first source engine
+        const View::NodeIdVec& GetMetaLogStorageNodes() const {
+            return metalog_storage_nodes_;
+        }
+
     private:
         friend class View;
         const View* view_;
         uint16_t node_id_;
+        size_t index_;
 
         View::NodeIdVec storage_nodes_;
+        View::NodeIdVec metalog_storage_nodes_;
         absl::flat_hash_set<uint16_t> indexed_sequencer_node_set_;
 
         mutable size_t next_storage_node_;
 
-        Engine(const View* view, uint16_t node_id,
+        Engine(const View* view, uint16_t node_id, size_t index,
                const View::NodeIdVec& storage_nodes,
+               const View::NodeIdVec& metalog_storage_nodes,
                const View::NodeIdVec& index_sequencer_nodes);
         DISALLOW_IMPLICIT_CONSTRUCTORS(Engine);
     };
@@ -208,6 +249,8 @@ private:
 
     uint64_t  log_space_hash_seed_;
     NodeIdVec log_space_hash_tokens_;
+    absl::flat_hash_map</* user_logspace */ uint32_t, /* sequencer_id */ uint16_t>
+        log_space_placement_;
 
     DISALLOW_COPY_AND_ASSIGN(View);
 };
@@ -26,21 +26,46 @@ void ViewWatcher::SetViewFrozenCallback(ViewCallback cb) {
     view_frozen_cb_ = cb;
 }
 
+void ViewWatcher::SetViewStagedCallback(ViewCallback cb) {
+    view_staged_cb_ = cb;
+}
+
 void ViewWatcher::SetViewFinalizedCallback(ViewFinalizedCallback cb) {
     view_finalized_cb_ = cb;
 }
 
+void ViewWatcher::SetTailFetchCallback(TailFetchCallback cb) {
+    tail_fetch_cb_ = cb;
+}
+
 void ViewWatcher::InstallNextView(const ViewProto& view_proto) {
     if (view_proto.view_id() != next_view_id()) {
         HLOG_F(FATAL, "Non-consecutive view_id {}", view_proto.view_id());
     }
-    View* view = new View(view_proto);
+    View* view = nullptr;
+    if (staged_view_ != nullptr && staged_view_->id() == view_proto.view_id()) {
+        // Pointers handed out on staging stay valid
+        view = staged_view_.release();
+    } else {
+        view = new View(view_proto);
+    }
+    staged_view_.reset();
     views_.emplace_back(view);
     if (view_created_cb_) {
         view_created_cb_(view);
     }
 }
 
+void ViewWatcher::StageNextView(const ViewProto& view_proto) {
+    if (view_proto.view_id() != next_view_id()) {
+        HLOG_F(FATAL, "Cannot stage view_id {}", view_proto.view_id());
+    }
+    staged_view_.reset(new View(view_proto));
+    if (view_staged_cb_) {
+        view_staged_cb_(staged_view_.get());
+    }
+}
+
 void ViewWatcher::FinalizeCurrentView(const FinalizedViewProto& finalized_view_proto) {
     const View* view = current_view();
     if (view == nullptr || finalized_view_proto.view_id() != view->id()) {
@@ -62,6 +87,13 @@ void ViewWatcher::OnZNodeCreated(std::string_view path, std::span<const char> co
             HLOG(FATAL) << "Failed to parse ViewProto";
         }
         InstallNextView(view_proto);
+    } else if (absl::StartsWith(path, "staged")) {
+        ViewProto view_proto;
+        if (!view_proto.ParseFromArray(contents.data(),
+                                       static_cast<int>(contents.size()))) {
+            HLOG(FATAL) << "Failed to parse ViewProto";
+        }
+        StageNextView(view_proto);
     } else if (absl::StartsWith(path, "freeze")) {
         int parsed;
         if (!absl::SimpleAtoi(std::string_view(contents.data(), contents.size()), &parsed)) {
@@ -81,6 +113,20 @@ void ViewWatcher::OnZNodeCreated(std::string_view path, std::span<const char> co
             HLOG(FATAL) << "Failed to parse FinalizedViewProto";
         }
         FinalizeCurrentView(finalized_view_proto);
+    } else if (absl::StartsWith(path, "fetch_tail")) {
+        TailFetchProto tail_fetch_proto;
+        if (!tail_fetch_proto.ParseFromArray(contents.data(),
+                                             static_cast<int>(contents.size()))) {
+            HLOG(FATAL) << "Failed to parse TailFetchProto";
+        }
+        const View* view = view_with_id(
+            gsl::narrow_cast<uint16_t>(tail_fetch_proto.view_id()));
+        if (view == nullptr) {
+            HLOG_F(FATAL, "Invalid view_id {}", tail_fetch_proto.view_id());
+        }
+        if (tail_fetch_cb_) {
+            tail_fetch_cb_(view, tail_fetch_proto);
+        }
     } else {
         HLOG_F(FATAL, "Unknown znode path {}", path);
     }
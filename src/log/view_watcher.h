@@ -24,19 +24,30 @@ public:
     using ViewCallback = std::function<void(const View*)>;
     void SetViewCreatedCallback(ViewCallback cb);
     void SetViewFrozenCallback(ViewCallback cb);
+    // Called when the next view is pre-staged by a planned reconfiguration,
+    // while the current view still serves appends
+    void SetViewStagedCallback(ViewCallback cb);
 
     using ViewFinalizedCallback = std::function<void(const FinalizedView*)>;
     void SetViewFinalizedCallback(ViewFinalizedCallback cb);
 
+    // Called when the controller asks a sequencer for full tail metalogs,
+    // during sealing with digests only
+    using TailFetchCallback = std::function<void(const View*, const TailFetchProto&)>;
+    void SetTailFetchCallback(TailFetchCallback cb);
+
 private:
     std::optional<zk_utils::DirWatcher> watcher_;
 
     std::vector<std::unique_ptr<View>> views_;
     std::vector<std::unique_ptr<FinalizedView>> finalized_views_;
+    std::unique_ptr<View> staged_view_;
 
     ViewCallback          view_created_cb_;
     ViewCallback          view_frozen_cb_;
+    ViewCallback          view_staged_cb_;
     ViewFinalizedCallback view_finalized_cb_;
+    TailFetchCallback     tail_fetch_cb_;
 
     inline uint16_t next_view_id() const {
         return gsl::narrow_cast<uint16_t>(views_.size());
@@ -51,6 +62,7 @@ private:
     }
 
     void InstallNextView(const ViewProto& view_proto);
+    void StageNextView(const ViewProto& view_proto);
     void FinalizeCurrentView(const FinalizedViewProto& finalized_view_proto);
     void OnZNodeCreated(std::string_view path, std::span<const char> contents);
 
@@ -21,6 +21,10 @@ constexpr int kSLogLocalCutTimerTypeId      = kTimerTypeId + 1;
 constexpr int kSLogStateCheckTimerTypeId    = kTimerTypeId + 2;
 constexpr int kSendShardProgressTimerId     = kTimerTypeId + 3;
 constexpr int kMetaLogCutTimerId            = kTimerTypeId + 3;
+constexpr int kLogSpaceLoadTimerId          = kTimerTypeId + 4;
+constexpr int kMetaLogGapTimerId            = kTimerTypeId + 5;
+constexpr int kIOWorkerBalanceTimerId       = kTimerTypeId + 6;
+constexpr int kTailHandoffTimerId           = kTimerTypeId + 7;
 
 // Used by Gateway
 constexpr int kHttpConnectionTypeId         = 0x20 << 16;
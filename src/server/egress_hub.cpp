@@ -11,7 +11,8 @@ EgressHub::EgressHub(int type, const struct sockaddr_in* addr, size_t num_conn)
       state_(kCreated),
       sockfds_(num_conn, -1),
       log_header_(GetLogHeader(type)),
-      send_fn_scheduled_(false)
+      send_fn_scheduled_(false),
+      zero_copy_threshold_(absl::GetFlag(FLAGS_egress_hub_zero_copy_threshold))
 {
     memcpy(&addr_, addr, sizeof(struct sockaddr_in));
 }
@@ -28,6 +29,9 @@ EgressHub::Start(IOWorker* io_worker)
     DCHECK(io_worker->WithinMyEventLoopThread());
     HVLOG(1) << fmt::format("starting egress conn type {:#x} id {}", type(), id());
     io_worker_ = io_worker;
+    if (zero_copy_threshold_ > 0) {
+        current_io_uring()->PrepareZeroCopyBuffers();
+    }
     for (size_t i = 0; i < sockfds_.size(); i++) {
         int sockfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
         PCHECK(sockfd >= 0) << "Failed to create socket";
@@ -77,7 +81,12 @@ EgressHub::SendMessage(std::span<const char> part1,
             << "Connection is closing or has closed, will not send this message";
         return;
     }
-    if (part1.size() + part2.size() + part3.size() + part4.size() == 0) {
+    size_t total_size = part1.size() + part2.size() + part3.size() + part4.size();
+    if (total_size == 0) {
+        return;
+    }
+    if (zero_copy_threshold_ > 0 && total_size >= zero_copy_threshold_
+          && SendMessageZeroCopy(part1, part2, part3, part4)) {
         return;
     }
     write_buffer_.AppendData(part1);
@@ -97,6 +106,43 @@ CopyToBuffer(std::span<char> buf, std::span<const char> data)
 }
 } // namespace
 
+bool
+EgressHub::SendMessageZeroCopy(std::span<const char> part1,
+                               std::span<const char> part2,
+                               std::span<const char> part3,
+                               std::span<const char> part4)
+{
+    int sockfd = -1;
+    if (!connections_for_pick_.PickNext(&sockfd)) {
+        return false;
+    }
+    // Messages buffered before go first on this socket
+    if (!write_buffer_.empty()) {
+        SendBufferedData(sockfd);
+    }
+    // Parts are only valid within SendMessage, so the message is still copied
+    // once here. What is saved is the copy into the socket buffer.
+    size_t total_size = part1.size() + part2.size() + part3.size() + part4.size();
+    std::span<char> buf = current_io_uring()->NewZeroCopyBuffer(total_size);
+    size_t pos = 0;
+    for (std::span<const char> part : {part1, part2, part3, part4}) {
+        CopyToBuffer(buf.subspan(pos), part);
+        pos += part.size();
+    }
+    // The buffer is returned only after the kernel no longer references it
+    URING_DCHECK_OK(current_io_uring()->SendZeroCopy(
+        sockfd,
+        std::span<const char>(buf.data(), total_size),
+        [this, buf, sockfd](int status) {
+            current_io_uring()->ReturnZeroCopyBuffer(buf);
+            if (status != 0) {
+                HPLOG(ERROR) << "Failed to send data";
+                RemoveSocket(sockfd);
+            }
+        }));
+    return true;
+}
+
 void
 EgressHub::OnSocketConnected(int sockfd, int status)
 {
@@ -217,7 +263,10 @@ EgressHub::SendPendingMessages()
     }
     DCHECK(send_fn_scheduled_);
     send_fn_scheduled_ = false;
-    DCHECK(!write_buffer_.empty());
+    if (write_buffer_.empty()) {
+        // Already sent ahead of a zero-copy message
+        return;
+    }
 
     int sockfd = -1;
     if (!connections_for_pick_.PickNext(&sockfd)) {
@@ -225,7 +274,12 @@ EgressHub::SendPendingMessages()
         return;
     }
     DCHECK(sockfd >= 0);
+    SendBufferedData(sockfd);
+}
 
+void
+EgressHub::SendBufferedData(int sockfd)
+{
     while (!write_buffer_.empty()) {
         std::span<char> buf;
         io_worker_->NewWriteBuffer(&buf);
@@ -40,12 +40,16 @@ private:
     std::string log_header_;
     utils::AppendableBuffer write_buffer_;
     bool send_fn_scheduled_;
+    const size_t zero_copy_threshold_;
 
     void OnSocketConnected(int sockfd, int status);
     void SocketReady(int sockfd);
     void RemoveSocket(int sockfd);
     void ScheduleSendFunction();
     void SendPendingMessages();
+    void SendBufferedData(int sockfd);
+    bool SendMessageZeroCopy(std::span<const char> part1, std::span<const char> part2,
+                             std::span<const char> part3, std::span<const char> part4);
 
     static std::string GetLogHeader(int type);
 
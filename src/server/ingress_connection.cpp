@@ -12,6 +12,7 @@ IngressConnection::IngressConnection(int type, int sockfd, size_t msghdr_size)
       state_(kCreated),
       sockfd_(sockfd),
       msghdr_size_(msghdr_size),
+      recv_bytes_(0),
       buf_group_(kDefaultIngressBufGroup),
       buf_size_(kDefaultBufSize),
       log_header_(GetLogHeader(type, sockfd))
@@ -50,6 +51,33 @@ IngressConnection::Start(IOWorker* io_worker)
     state_ = kRunning;
 }
 
+bool
+IngressConnection::ScheduleDetach(std::function<void()> cb)
+{
+    DCHECK(io_worker_->WithinMyEventLoopThread());
+    if (state_ != kRunning) {
+        return false;
+    }
+    state_ = kDetaching;
+    // Data received before the recv is cancelled is still handled here.
+    // Partial messages stay in `read_buffer_`, and continue on the new IOWorker
+    URING_DCHECK_OK(current_io_uring()->Detach(sockfd_, [this, cb]() {
+        DCHECK(state_ == kDetaching);
+        state_ = kCreated;
+        io_worker_ = nullptr;
+        cb();
+    }));
+    return true;
+}
+
+size_t
+IngressConnection::TakeRecvBytes()
+{
+    size_t recv_bytes = recv_bytes_;
+    recv_bytes_ = 0;
+    return recv_bytes;
+}
+
 void
 IngressConnection::ScheduleClose()
 {
@@ -100,6 +128,10 @@ bool
 IngressConnection::OnRecvData(int status, std::span<const char> data)
 {
     DCHECK(io_worker_->WithinMyEventLoopThread());
+    if (state_ == kDetaching && (status != 0 || data.size() == 0)) {
+        // Seen again once started on the new IOWorker
+        return false;
+    }
     if (status != 0) {
         HPLOG(ERROR) << "Read error, will close this connection";
         ScheduleClose();
@@ -109,6 +141,7 @@ IngressConnection::OnRecvData(int status, std::span<const char> data)
         ScheduleClose();
         return false;
     } else {
+        recv_bytes_ += data.size();
         read_buffer_.AppendData(data);
         ProcessMessages();
         return true;
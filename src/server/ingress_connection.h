@@ -17,6 +17,8 @@ public:
 
     void Start(IOWorker* io_worker) override;
     void ScheduleClose() override;
+    bool ScheduleDetach(std::function<void()> cb) override;
+    size_t TakeRecvBytes() override;
 
     void set_buffer_group(uint16_t buf_group, size_t buf_size) {
         buf_group_ = buf_group;
@@ -40,12 +42,13 @@ public:
                            std::span<const char> /* payload */)> cb);
 
 private:
-    enum State { kCreated, kRunning, kClosing, kClosed };
+    enum State { kCreated, kRunning, kDetaching, kClosing, kClosed };
 
     IOWorker* io_worker_;
     State state_;
     int sockfd_;
     size_t msghdr_size_;
+    size_t recv_bytes_;
 
     uint16_t buf_group_;
     size_t   buf_size_;
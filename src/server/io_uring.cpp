@@ -1,25 +1,59 @@
 #include "server/io_uring.h"
 
 #include "base/init.h"
+#include "base/thread.h"
 #include "common/time.h"
 
+#include <sys/mman.h>
+#include <limits.h>
+
 ABSL_FLAG(size_t, io_uring_entries, 2048, "");
 ABSL_FLAG(size_t, io_uring_fd_slots, 1024, "");
 ABSL_FLAG(bool, io_uring_sqpoll, false, "");
 ABSL_FLAG(uint32_t, io_uring_sq_thread_idle_ms, 1, "");
+ABSL_FLAG(std::string, io_uring_sq_thread_cpus, "",
+          "Comma-separated CPUs for SQPOLL threads, assigned to IOWorkers "
+          "in turn by worker id, as --io_worker_cpus");
+ABSL_FLAG(bool, io_uring_share_sq_thread, false,
+          "All SQPOLL rings share one SQ thread with IORING_SETUP_ATTACH_WQ");
+ABSL_FLAG(uint32_t, io_uring_cq_spin_us, 0,
+          "Spin on the CQ ring for this long before blocking for completions");
 ABSL_FLAG(uint32_t, io_uring_cq_nr_wait, 1, "");
 ABSL_FLAG(uint32_t, io_uring_cq_wait_timeout_us, 0, "");
+ABSL_FLAG(bool, io_uring_multishot_recv, true,
+          "Use multishot recv with kernel-provided buffer rings if supported");
+ABSL_FLAG(uint32_t, io_uring_buf_ring_entries, 64,
+          "Number of buffers in each buffer ring, must be a power of 2");
+ABSL_FLAG(size_t, io_uring_zc_buf_size, 256 * 1024, "");
+ABSL_FLAG(size_t, io_uring_zc_bufs, 16, "");
 
 #define ERRNO_LOGSTR(errno) fmt::format("{} [{}]", strerror(errno), errno)
 
 namespace faas { namespace server {
 
 std::atomic<int> IOUring::next_uring_id_{0};
+absl::Mutex IOUring::shared_sq_mu_;
+int IOUring::shared_sq_ring_fd_ = -1;
 
-IOUring::IOUring()
+IOUring::IOUring(int sq_thread_index)
     : uring_id_(next_uring_id_.fetch_add(1, std::memory_order_relaxed)),
       log_header_(fmt::format("io_uring[{}]: ", uring_id_)),
-      next_op_id_(1),
+      multishot_recv_(absl::GetFlag(FLAGS_io_uring_multishot_recv)),
+      buf_ring_entries_(absl::GetFlag(FLAGS_io_uring_buf_ring_entries)),
+      send_zc_supported_(false),
+      zc_bufs_base_(nullptr),
+      zc_buf_size_(0),
+      num_zc_bufs_(0),
+      zc_bufs_registered_(false),
+      msg_ring_supported_(false),
+      sqpoll_(absl::GetFlag(FLAGS_io_uring_sqpoll)),
+      owns_shared_sq_(false),
+      cq_spin_ns_(int64_t{absl::GetFlag(FLAGS_io_uring_cq_spin_us)} * 1000),
+      num_inflight_ops_(0),
+      io_uring_enter_count_(0),
+      io_uring_enter_time_ns_(0),
+      completed_cqe_count_(0),
+      submitted_sqe_count_(0),
       ev_loop_counter_(stat::Counter::VerboseLogReportCallback<2>(
           fmt::format("io_uring[{}] ev_loop", uring_id_))),
       wait_timeout_counter_(stat::Counter::VerboseLogReportCallback<2>(
@@ -40,10 +74,29 @@ IOUring::IOUring()
 {
     struct io_uring_params params;
     memset(&params, 0, sizeof(params));
-    if (absl::GetFlag(FLAGS_io_uring_sqpoll)) {
+    bool share_sq_thread = sqpoll_ && absl::GetFlag(FLAGS_io_uring_share_sq_thread);
+    if (sqpoll_) {
         LOG(INFO) << "Enable IORING_SETUP_SQPOLL";
         params.flags |= IORING_SETUP_SQPOLL;
         params.sq_thread_idle = absl::GetFlag(FLAGS_io_uring_sq_thread_idle_ms);
+        std::vector<int> sq_cpus =
+            base::Thread::ParseCpuList(absl::GetFlag(FLAGS_io_uring_sq_thread_cpus));
+        if (!sq_cpus.empty()) {
+            params.flags |= IORING_SETUP_SQ_AFF;
+            size_t index = static_cast<size_t>(
+                sq_thread_index >= 0 ? sq_thread_index : uring_id_);
+            params.sq_thread_cpu = gsl::narrow_cast<uint32_t>(
+                sq_cpus[index % sq_cpus.size()]);
+        }
+    }
+    // Held until the ring is set up, so that only one ring creates the shared SQ thread
+    std::optional<absl::MutexLock> shared_sq_lock;
+    if (share_sq_thread) {
+        shared_sq_lock.emplace(&shared_sq_mu_);
+        if (shared_sq_ring_fd_ != -1) {
+            params.flags |= IORING_SETUP_ATTACH_WQ;
+            params.wq_fd = gsl::narrow_cast<uint32_t>(shared_sq_ring_fd_);
+        }
     }
     int ret = io_uring_queue_init_params(
         gsl::narrow_cast<uint32_t>(absl::GetFlag(FLAGS_io_uring_entries)),
@@ -52,8 +105,28 @@ IOUring::IOUring()
     if (ret != 0) {
         LOG(FATAL) << "io_uring init failed: " << ERRNO_LOGSTR(-ret);
     }
+    if (share_sq_thread && shared_sq_ring_fd_ == -1) {
+        HLOG(INFO) << "Owns the SQ thread shared by later rings";
+        shared_sq_ring_fd_ = ring_.ring_fd;
+        owns_shared_sq_ = true;
+    }
+    shared_sq_lock.reset();
     CHECK((params.features & IORING_FEAT_FAST_POLL) != 0)
         << "IORING_FEAT_FAST_POLL not supported";
+    struct io_uring_probe* probe = io_uring_get_probe_ring(&ring_);
+    if (probe != nullptr) {
+        send_zc_supported_ = io_uring_opcode_supported(probe, IORING_OP_SEND_ZC);
+        msg_ring_supported_ = io_uring_opcode_supported(probe, IORING_OP_MSG_RING);
+        io_uring_free_probe(probe);
+    }
+    if (!send_zc_supported_) {
+        LOG(INFO) << "IORING_OP_SEND_ZC not supported, SendZeroCopy will copy";
+    }
+    if (multishot_recv_) {
+        CHECK(buf_ring_entries_ > 0 && buf_ring_entries_ <= 32768
+                && (buf_ring_entries_ & (buf_ring_entries_ - 1)) == 0)
+            << "io_uring_buf_ring_entries should be a power of 2 within 32768";
+    }
     memset(&cqe_wait_timeout_, 0, sizeof(cqe_wait_timeout_));
     uint32_t wait_timeout_us = absl::GetFlag(FLAGS_io_uring_cq_wait_timeout_us);
     if (wait_timeout_us != 0) {
@@ -81,13 +154,32 @@ IOUring::IOUring()
         free_fd_slots_.push_back(i);
     }
     absl::c_reverse(free_fd_slots_);
+    // One slot per SQE covers most workloads, more are added on demand
+    size_t n_op_slots = absl::GetFlag(FLAGS_io_uring_entries);
+    op_slots_.resize(n_op_slots);
+    free_op_slots_.reserve(n_op_slots);
+    for (size_t i = n_op_slots; i > 0; i--) {
+        op_slots_[i - 1].id = kInvalidOpId;
+        free_op_slots_.push_back(gsl::narrow_cast<uint32_t>(i - 1));
+    }
     base::ChainCleanupFn(absl::bind_front(&IOUring::CleanUpFn, this));
 }
 
 IOUring::~IOUring()
 {
-    CHECK(ops_.empty()) << "There are still inflight Ops";
+    CHECK_EQ(num_inflight_ops_, 0U) << "There are still inflight Ops";
+    if (owns_shared_sq_) {
+        // Rings attached earlier keep the SQ thread alive, later ones start a new one
+        absl::MutexLock lk(&shared_sq_mu_);
+        shared_sq_ring_fd_ = -1;
+    }
     io_uring_queue_exit(&ring_);
+    for (const auto& [gid, buf_ring]: buf_rings_) {
+        munmap(buf_ring.ring, buf_ring.entries * sizeof(struct io_uring_buf));
+    }
+    if (zc_bufs_base_ != nullptr) {
+        munmap(zc_bufs_base_, zc_buf_size_ * num_zc_bufs_);
+    }
 }
 
 void
@@ -114,6 +206,167 @@ IOUring::PrepareBuffers(uint16_t gid, size_t buf_size)
     buf_pools_[gid] = std::make_unique<utils::BufferPool>(
         fmt::format("IOUring[{}]-{}", uring_id_, gid),
         buf_size);
+    if (multishot_recv_ && !SetupBufRing(gid, buf_size)) {
+        HLOG(WARNING) << "Buffer rings not supported, fall back to single-shot recv";
+        multishot_recv_ = false;
+    }
+}
+
+bool
+IOUring::SetupBufRing(uint16_t gid, size_t buf_size)
+{
+    size_t ring_size = buf_ring_entries_ * sizeof(struct io_uring_buf);
+    void* ring = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE,
+                      MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring == MAP_FAILED) {
+        PLOG(ERROR) << "Failed to map buffer ring";
+        return false;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = buf_ring_entries_;
+    reg.bgid = gid;
+    int ret = io_uring_register_buf_ring(&ring_, &reg, 0);
+    if (ret != 0) {
+        HLOG_F(WARNING, "io_uring_register_buf_ring failed: {}", ERRNO_LOGSTR(-ret));
+        munmap(ring, ring_size);
+        return false;
+    }
+    BufRing& buf_ring = buf_rings_[gid];
+    buf_ring.ring = reinterpret_cast<struct io_uring_buf_ring*>(ring);
+    buf_ring.entries = buf_ring_entries_;
+    buf_ring.buf_size = buf_size;
+    buf_ring.bufs.resize(buf_ring_entries_);
+    // Freshly mapped memory is zeroed, thus the ring tail starts from 0
+    int mask = io_uring_buf_ring_mask(buf_ring_entries_);
+    for (uint32_t i = 0; i < buf_ring_entries_; i++) {
+        std::span<char> buf;
+        buf_pools_[gid]->Get(&buf);
+        buf_ring.bufs[i] = buf.data();
+        io_uring_buf_ring_add(buf_ring.ring, buf.data(),
+                              gsl::narrow_cast<unsigned int>(buf.size()),
+                              gsl::narrow_cast<unsigned short>(i),
+                              mask, gsl::narrow_cast<int>(i));
+    }
+    io_uring_buf_ring_advance(buf_ring.ring, gsl::narrow_cast<int>(buf_ring_entries_));
+    return true;
+}
+
+void
+IOUring::RecycleRingBuffer(uint16_t gid, uint16_t bid)
+{
+    DCHECK(buf_rings_.contains(gid));
+    BufRing& buf_ring = buf_rings_[gid];
+    DCHECK_LT(bid, buf_ring.entries);
+    io_uring_buf_ring_add(buf_ring.ring, buf_ring.bufs[bid],
+                          gsl::narrow_cast<unsigned int>(buf_ring.buf_size),
+                          bid, io_uring_buf_ring_mask(buf_ring.entries), 0);
+    io_uring_buf_ring_advance(buf_ring.ring, 1);
+}
+
+void
+IOUring::PrepareZeroCopyBuffers()
+{
+    if (zc_bufs_base_ != nullptr) {
+        return;
+    }
+    zc_buf_size_ = absl::GetFlag(FLAGS_io_uring_zc_buf_size);
+    num_zc_bufs_ = absl::GetFlag(FLAGS_io_uring_zc_bufs);
+    CHECK_GT(zc_buf_size_, 0U);
+    CHECK(num_zc_bufs_ > 0 && num_zc_bufs_ <= std::numeric_limits<uint16_t>::max());
+    void* base = mmap(nullptr, zc_buf_size_ * num_zc_bufs_, PROT_READ | PROT_WRITE,
+                      MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    PCHECK(base != MAP_FAILED) << "Failed to map zero-copy buffers";
+    zc_bufs_base_ = reinterpret_cast<char*>(base);
+    std::vector<struct iovec> iovecs(num_zc_bufs_);
+    for (size_t i = 0; i < num_zc_bufs_; i++) {
+        iovecs[i].iov_base = zc_bufs_base_ + i * zc_buf_size_;
+        iovecs[i].iov_len = zc_buf_size_;
+    }
+    for (size_t i = num_zc_bufs_; i > 0; i--) {
+        free_zc_bufs_.push_back(zc_bufs_base_ + (i - 1) * zc_buf_size_);
+    }
+    int ret = io_uring_register_buffers(&ring_, iovecs.data(),
+                                        gsl::narrow_cast<unsigned>(num_zc_bufs_));
+    if (ret != 0) {
+        // Likely limited by RLIMIT_MEMLOCK
+        HLOG_F(WARNING, "io_uring_register_buffers failed: {}, "
+                        "zero-copy sends will not use fixed buffers",
+               ERRNO_LOGSTR(-ret));
+    } else {
+        zc_bufs_registered_ = true;
+    }
+}
+
+namespace {
+static size_t
+ZeroCopyBufferSize(size_t size)
+{
+    size_t buf_size = 4096;
+    while (buf_size < size) {
+        buf_size <<= 1;
+    }
+    return buf_size;
+}
+} // namespace
+
+std::span<char>
+IOUring::NewZeroCopyBuffer(size_t size)
+{
+    if (size <= zc_buf_size_ && !free_zc_bufs_.empty()) {
+        std::span<char> buf(free_zc_bufs_.back(), zc_buf_size_);
+        free_zc_bufs_.pop_back();
+        return buf;
+    }
+    size_t buf_size = ZeroCopyBufferSize(size);
+    std::unique_ptr<utils::BufferPool>& buf_pool = zc_buf_pools_[buf_size];
+    if (buf_pool == nullptr) {
+        buf_pool = std::make_unique<utils::BufferPool>(
+            fmt::format("IOUring[{}]-zc{}", uring_id_, buf_size), buf_size);
+    }
+    std::span<char> buf;
+    buf_pool->Get(&buf);
+    return buf;
+}
+
+void
+IOUring::ReturnZeroCopyBuffer(std::span<char> buf)
+{
+    if (zc_bufs_base_ != nullptr && buf.data() >= zc_bufs_base_
+          && buf.data() < zc_bufs_base_ + zc_buf_size_ * num_zc_bufs_) {
+        free_zc_bufs_.push_back(buf.data());
+        return;
+    }
+    size_t buf_size = ZeroCopyBufferSize(buf.size());
+    DCHECK(zc_buf_pools_.contains(buf_size));
+    zc_buf_pools_[buf_size]->Return(buf.data());
+}
+
+size_t
+IOUring::resident_buffer_bytes() const
+{
+    size_t total = 0;
+    for (const auto& [gid, buf_pool]: buf_pools_) {
+        total += buf_pool->total_buffers() * buf_pool->buffer_size();
+    }
+    for (const auto& [buf_size, buf_pool]: zc_buf_pools_) {
+        total += buf_pool->total_buffers() * buf_size;
+    }
+    return total;
+}
+
+size_t
+IOUring::TrimBufferPools()
+{
+    size_t total = 0;
+    for (const auto& [gid, buf_pool]: buf_pools_) {
+        total += buf_pool->Trim() * buf_pool->buffer_size();
+    }
+    for (const auto& [buf_size, buf_pool]: zc_buf_pools_) {
+        total += buf_pool->Trim() * buf_size;
+    }
+    return total;
 }
 
 bool
@@ -169,7 +422,7 @@ IOUring::Connect(int fd,
 {
     GET_AND_CHECK_DESC(fd, desc);
     Op* op = AllocConnectOp(desc, addr, addrlen);
-    connect_cbs_[op->id] = cb;
+    op->status_cb = std::move(cb);
     EnqueueOp(op);
     return true;
 }
@@ -186,10 +439,17 @@ IOUring::StartReadInternal(int fd, uint16_t buf_gid, uint16_t flags, ReadCallbac
         HLOG_F(ERROR, "Invalid buf_gid {}", buf_gid);
         return false;
     }
-    std::span<char> buf;
-    buf_pools_[buf_gid]->Get(&buf);
-    Op* op = AllocReadOp(desc, buf_gid, buf, flags);
-    read_cbs_[op->id] = cb;
+    Op* op = nullptr;
+    if ((flags & kOpFlagUseRecv) != 0 && multishot_recv_ && buf_rings_.contains(buf_gid)) {
+        // Buffers are picked by the kernel from the buffer ring, so idle
+        // connections do not hold any buffer
+        op = AllocReadOp(desc, buf_gid, std::span<char>(), flags | kOpFlagMultishot);
+    } else {
+        std::span<char> buf;
+        buf_pools_[buf_gid]->Get(&buf);
+        op = AllocReadOp(desc, buf_gid, buf, flags);
+    }
+    op->read_cb = std::move(cb);
     EnqueueOp(op);
     return true;
 }
@@ -197,13 +457,13 @@ IOUring::StartReadInternal(int fd, uint16_t buf_gid, uint16_t flags, ReadCallbac
 bool
 IOUring::StartRead(int fd, uint16_t buf_gid, ReadCallback cb)
 {
-    return StartReadInternal(fd, buf_gid, kOpFlagRepeat, cb);
+    return StartReadInternal(fd, buf_gid, kOpFlagRepeat, std::move(cb));
 }
 
 bool
 IOUring::StartRecv(int fd, uint16_t buf_gid, ReadCallback cb)
 {
-    return StartReadInternal(fd, buf_gid, kOpFlagRepeat | kOpFlagUseRecv, cb);
+    return StartReadInternal(fd, buf_gid, kOpFlagRepeat | kOpFlagUseRecv, std::move(cb));
 }
 
 bool
@@ -230,29 +490,46 @@ IOUring::Write(int fd, std::span<const char> data, WriteCallback cb)
     }
     GET_AND_CHECK_DESC(fd, desc);
     Op* op = AllocWriteOp(desc, data);
-    write_cbs_[op->id] = cb;
+    op->write_cb = std::move(cb);
     EnqueueOp(op);
     return true;
 }
 
 bool
-IOUring::SendAll(int fd, std::span<const char> data, SendAllCallback cb)
+IOUring::WriteAt(int fd, uint64_t offset, std::span<const char> data, WriteCallback cb)
 {
     if (data.size() == 0) {
         return false;
     }
     GET_AND_CHECK_DESC(fd, desc);
-    Op* op = AllocSendAllOp(desc, data);
-    sendall_cbs_[op->id] = cb;
-    if (desc->last_send_op != nullptr) {
-        Op* last_op = desc->last_send_op;
-        DCHECK_EQ(op_type(last_op), kSendAll);
-        DCHECK_EQ(last_op->next_op, kInvalidOpId);
-        last_op->next_op = op->id;
-    } else {
-        EnqueueOp(op);
+    Op* op = AllocWriteOp(desc, data, offset);
+    op->write_cb = std::move(cb);
+    EnqueueOp(op);
+    return true;
+}
+
+bool
+IOUring::Fsync(int fd, bool datasync, FsyncCallback cb)
+{
+    GET_AND_CHECK_DESC(fd, desc);
+    Op* op = AllocFsyncOp(desc, datasync ? kOpFlagDataSync : 0);
+    op->status_cb = std::move(cb);
+    EnqueueOp(op);
+    return true;
+}
+
+bool
+IOUring::SendAll(int fd, std::span<const char> data, SendAllCallback cb)
+{
+    GET_AND_CHECK_DESC(fd, desc);
+    if (data.size() == 0) {
+        // Nothing to order with queued sends
+        cb(0);
+        return true;
     }
-    desc->last_send_op = op;
+    Op* op = AllocSendAllOp(desc, data);
+    op->status_cb = std::move(cb);
+    LinkSendOp(desc, op);
     return true;
 }
 
@@ -262,78 +539,256 @@ IOUring::SendAll(int fd,
                  SendAllCallback cb)
 {
     GET_AND_CHECK_DESC(fd, desc);
-    Op* first_op = nullptr;
-    Op* last_op = desc->last_send_op;
+    size_t total_size = 0;
+    for (std::span<const char> data: data_vec) {
+        total_size += data.size();
+    }
+    if (total_size == 0) {
+        cb(0);
+        return true;
+    }
+    Op* op = AllocSendMsgOp(desc);
+    SendMsgData* msg_data = op->msg_data;
     for (std::span<const char> data: data_vec) {
         if (data.size() > 0) {
-            Op* op = AllocSendAllOp(desc, data);
-            if (first_op == nullptr) {
-                first_op = op;
-            }
-            if (last_op != nullptr) {
-                DCHECK_EQ(op_type(last_op), kSendAll);
-                DCHECK_EQ(last_op->next_op, kInvalidOpId);
-                last_op->next_op = op->id;
-            }
-            last_op = op;
+            msg_data->iov.push_back({
+                .iov_base = const_cast<char*>(data.data()),
+                .iov_len  = data.size()
+            });
         }
     }
-    if (first_op == nullptr) {
+    msg_data->cbs.emplace_back(total_size, std::move(cb));
+    LinkSendOp(desc, op);
+    return true;
+}
+
+bool
+IOUring::SendZeroCopy(int fd, std::span<const char> data, SendZeroCopyCallback cb)
+{
+    if (data.size() == 0) {
         return false;
     }
-    DCHECK(last_op != desc->last_send_op);
-    Op* op = first_op;
-    while (op != last_op) {
-        op->root_op = last_op->id;
-        DCHECK_NE(op->next_op, kInvalidOpId);
-        DCHECK(ops_.contains(op->next_op));
-        op = ops_[op->next_op];
+    GET_AND_CHECK_DESC(fd, desc);
+    Op* op = AllocSendZCOp(desc, data, kInvalidOpId);
+    sendzc_states_[op->id] = SendZeroCopyState {
+        .cb = std::move(cb),
+        .status = 0,
+        .inflight_ops = 1,
+    };
+    LinkSendOp(desc, op);
+    return true;
+}
+
+bool
+IOUring::Close(int fd, CloseCallback cb)
+{
+    GET_AND_CHECK_DESC(fd, desc);
+    if (desc->active_read_op != nullptr) {
+        StopReadOrRecv(fd);
     }
-    sendall_cbs_[first_op->id] = cb;
-    if (desc->last_send_op == nullptr) {
-        EnqueueOp(first_op);
+    Op* op = AllocCloseOp(fd);
+    desc->close_op = op;
+    op->close_cb = std::move(cb);
+    if (desc->op_count == 0) {
+        FinishClose(desc);
     }
-    desc->last_send_op = last_op;
     return true;
 }
 
 bool
-IOUring::Close(int fd, CloseCallback cb)
+IOUring::Detach(int fd, CloseCallback cb)
 {
     GET_AND_CHECK_DESC(fd, desc);
     if (desc->active_read_op != nullptr) {
+        desc->active_read_op->flags |= kOpFlagDetaching;
         StopReadOrRecv(fd);
     }
     Op* op = AllocCloseOp(fd);
+    op->flags |= kOpFlagDetaching;
     desc->close_op = op;
-    close_cbs_[op->id] = cb;
+    op->close_cb = std::move(cb);
     if (desc->op_count == 0) {
-        UnregisterFd(desc);
-        EnqueueOp(op);
+        FinishClose(desc);
     }
     return true;
 }
 
 #undef GET_AND_CHECK_DESC
 
+bool
+IOUring::SendRingMessage(IOUring* target, uint32_t value, RingMessageCallback cb)
+{
+    DCHECK(target != this);
+    if (!msg_ring_supported_) {
+        return false;
+    }
+    Op* op = AllocMsgRingOp(target->ring_.ring_fd, value);
+    op->status_cb = std::move(cb);
+    EnqueueOp(op);
+    return true;
+}
+
+void
+IOUring::SetRingMessageHandler(RingMessageHandler handler)
+{
+    ring_message_handler_ = std::move(handler);
+}
+
+uint64_t
+IOUring::Timeout(int64_t deadline, TimeoutCallback cb)
+{
+    Op* op = AllocTimeoutOp(deadline);
+    op->status_cb = std::move(cb);
+    EnqueueOp(op);
+    return op->id;
+}
+
+void
+IOUring::CancelTimeout(uint64_t timeout_id)
+{
+    DCHECK_EQ(timeout_id & 0xff, static_cast<uint64_t>(kTimeout));
+    EnqueueOp(AllocCancelOp(timeout_id));
+}
+
+void
+IOUring::LinkSendOp(Descriptor* desc, Op* op)
+{
+    if (desc->last_send_op != nullptr) {
+        Op* last_op = desc->last_send_op;
+        DCHECK(op_type(last_op) == kSendAll || op_type(last_op) == kSendMsg
+                 || op_type(last_op) == kSendZC);
+        DCHECK_EQ(last_op->next_op, kInvalidOpId);
+        last_op->next_op = op->id;
+    } else {
+        EnqueueOp(op);
+    }
+    desc->last_send_op = op;
+}
+
+// Merges `op` and sends queued behind it into one kSendMsg op, which takes
+// their place in the send queue of the descriptor
+IOUring::Op*
+IOUring::CoalesceSendOps(Op* op)
+{
+    auto num_iovecs = [] (const Op* send_op) -> size_t {
+        if (send_op->msg_data == nullptr) {
+            return 1;
+        }
+        return send_op->msg_data->iov.size() - send_op->msg_data->iov_start;
+    };
+    // Zero-copy sends are not merged, as their data is released separately
+    auto mergeable = [this] (const Op* send_op) -> bool {
+        return op_type(send_op) == kSendAll || op_type(send_op) == kSendMsg;
+    };
+    if (op->next_op == kInvalidOpId) {
+        return op;
+    }
+    Op* second = DCHECK_NOTNULL(GetOp(op->next_op));
+    if (!mergeable(op) || !mergeable(second)
+          || num_iovecs(op) + num_iovecs(second) > IOV_MAX) {
+        return op;
+    }
+    Descriptor* desc = op->desc;
+    Op* batch_op = AllocSendMsgOp(desc);
+    SendMsgData* batch = batch_op->msg_data;
+    size_t total_iovecs = 0;
+    Op* cur = op;
+    while (cur != nullptr && mergeable(cur)
+             && (cur == op || total_iovecs + num_iovecs(cur) <= IOV_MAX)) {
+        DCHECK_EQ(cur->desc, desc);
+        total_iovecs += num_iovecs(cur);
+        if (op_type(cur) == kSendAll) {
+            batch->iov.push_back({
+                .iov_base = const_cast<char*>(cur->data),
+                .iov_len  = cur->data_len
+            });
+            batch->cbs.emplace_back(cur->data_len, std::move(cur->status_cb));
+        } else {
+            DCHECK_EQ(op_type(cur), kSendMsg);
+            SendMsgData* msg_data = cur->msg_data;
+            batch->iov.insert(batch->iov.end(),
+                              msg_data->iov.begin() + msg_data->iov_start,
+                              msg_data->iov.end());
+            for (size_t i = msg_data->cb_start; i < msg_data->cbs.size(); i++) {
+                batch->cbs.push_back(std::move(msg_data->cbs[i]));
+            }
+            msg_data_pool_.Return(msg_data);
+            cur->msg_data = nullptr;
+        }
+        batch_op->next_op = cur->next_op;
+        if (desc->last_send_op == cur) {
+            desc->last_send_op = batch_op;
+        }
+        desc->op_count--;
+        FreeOp(cur);
+        if (batch_op->next_op == kInvalidOpId) {
+            cur = nullptr;
+        } else {
+            cur = DCHECK_NOTNULL(GetOp(batch_op->next_op));
+        }
+    }
+    return batch_op;
+}
+
+bool
+IOUring::SpinForCompletions(int64_t* elapsed_ns)
+{
+    *elapsed_ns = 0;
+    if (cq_spin_ns_ == 0) {
+        return false;
+    }
+    int64_t start_timestamp = GetMonotonicNanoTimestamp();
+    // With SQPOLL, this only wakes up the SQ thread when it sleeps
+    int ret = io_uring_submit(&ring_);
+    if (ret < 0) {
+        LOG(FATAL) << "io_uring_submit failed: " << ERRNO_LOGSTR(-ret);
+    }
+    if (!sqpoll_) {
+        io_uring_enter_count_++;
+    }
+    int64_t elasped_time = 0;
+    bool ready = false;
+    while (true) {
+        if (io_uring_cq_ready(&ring_) > 0) {
+            ready = true;
+        }
+        elasped_time = GetMonotonicNanoTimestamp() - start_timestamp;
+        if (ready || elasped_time >= cq_spin_ns_) {
+            break;
+        }
+    }
+    // Counted as waiting, as in io_uring_enter
+    io_uring_enter_time_ns_ += elasped_time;
+    *elapsed_ns = elasped_time;
+    return ready;
+}
+
 void
 IOUring::EventLoopRunOnce(size_t* inflight_ops)
 {
     struct io_uring_cqe* cqe = nullptr;
     uint32_t nr_wait = absl::GetFlag(FLAGS_io_uring_cq_nr_wait);
-    if (absl::GetFlag(FLAGS_io_uring_cq_wait_timeout_us) == 0) {
+    // A sample covers spinning and blocking of one wait
+    int64_t spin_time = 0;
+    if (SpinForCompletions(&spin_time)) {
+        // Skip blocking, as completions are ready
+        io_uring_enter_time_stat_.AddSample(gsl::narrow_cast<int>(spin_time));
+    } else if (absl::GetFlag(FLAGS_io_uring_cq_wait_timeout_us) == 0) {
         int64_t start_timestamp = GetMonotonicNanoTimestamp();
         int ret = io_uring_submit_and_wait(&ring_, nr_wait);
         int64_t elasped_time = GetMonotonicNanoTimestamp() - start_timestamp;
+        io_uring_enter_count_++;
         if (ret < 0) {
             LOG(FATAL) << "io_uring_submit_and_wait failed: " << ERRNO_LOGSTR(-ret);
         }
-        io_uring_enter_time_stat_.AddSample(gsl::narrow_cast<int>(elasped_time));
+        io_uring_enter_time_ns_ += elasped_time;
+        io_uring_enter_time_stat_.AddSample(gsl::narrow_cast<int>(spin_time + elasped_time));
     } else {
         int64_t start_timestamp = GetMonotonicNanoTimestamp();
         int ret =
             io_uring_wait_cqes(&ring_, &cqe, nr_wait, &cqe_wait_timeout_, nullptr);
         int64_t elasped_time = GetMonotonicNanoTimestamp() - start_timestamp;
+        io_uring_enter_count_++;
         if (ret < 0) {
             if (ret == -ETIME) {
                 wait_timeout_counter_.Tick();
@@ -341,7 +796,8 @@ IOUring::EventLoopRunOnce(size_t* inflight_ops)
                 LOG(FATAL) << "io_uring_wait_cqes failed: " << ERRNO_LOGSTR(-ret);
             }
         }
-        io_uring_enter_time_stat_.AddSample(gsl::narrow_cast<int>(elasped_time));
+        io_uring_enter_time_ns_ += elasped_time;
+        io_uring_enter_time_stat_.AddSample(gsl::narrow_cast<int>(spin_time + elasped_time));
     }
     ev_loop_counter_.Tick();
     int64_t start_timestamp = GetMonotonicNanoTimestamp();
@@ -359,11 +815,25 @@ IOUring::EventLoopRunOnce(size_t* inflight_ops)
             }
         }
         uint64_t op_id = DCHECK_NOTNULL(cqe)->user_data;
-        DCHECK(ops_.contains(op_id));
-        Op* op = ops_[op_id];
-        ops_.erase(op_id);
+        if (op_id == kRingMessageId) {
+            // Posted by another ring, there is no op of this ring behind it
+            if (ring_message_handler_) {
+                ring_message_handler_(static_cast<uint32_t>(cqe->res));
+            } else {
+                HLOG(WARNING) << "Ring message received without a handler";
+            }
+            io_uring_cqe_seen(&ring_, cqe);
+            count++;
+            continue;
+        }
+        Op* op = GetOp(op_id);
+        DCHECK(op != nullptr) << fmt::format("Stale op id {:#x}", op_id);
+        // Multishot ops stay inflight until a CQE without IORING_CQE_F_MORE
+        bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
         OnOpComplete(op, cqe);
-        op_pool_.Return(op);
+        if (!more) {
+            FreeOp(op);
+        }
         io_uring_cqe_seen(&ring_, cqe);
         count++;
     }
@@ -372,35 +842,83 @@ IOUring::EventLoopRunOnce(size_t* inflight_ops)
         ev_loop_time_stat_.AddSample(gsl::narrow_cast<int>(elasped_time));
         average_op_time_stat_.AddSample(gsl::narrow_cast<int>(elasped_time / count));
         completed_ops_counter_.Tick(count);
+        completed_cqe_count_ += static_cast<uint64_t>(count);
         completed_ops_stat_.AddSample(gsl::narrow_cast<int>(count));
     }
     if (VLOG_IS_ON(2)) {
         VLOG(2) << "Inflight ops:";
-        for (const auto& [op_id, op]: ops_) {
-            DCHECK_EQ(op->id, op_id);
+        for (const Op& op: op_slots_) {
+            if (op.id == kInvalidOpId) {
+                continue;
+            }
             VLOG_F(2,
                    "id={}, type={}, fd={}",
-                   (op->id >> 8),
-                   kOpTypeStr[op_type(op)],
-                   op_fd(op));
+                   (op.id >> 8),
+                   kOpTypeStr[op_type(&op)],
+                   op_fd(&op));
         }
     }
-    *inflight_ops = ops_.size();
+    *inflight_ops = num_inflight_ops_;
+}
+
+IOUring::Op*
+IOUring::AllocOp(OpType type)
+{
+    uint32_t slot;
+    if (free_op_slots_.empty()) {
+        CHECK_LT(op_slots_.size(), kMaxOpSlots) << "Too many inflight ops";
+        slot = gsl::narrow_cast<uint32_t>(op_slots_.size());
+        op_slots_.emplace_back();
+    } else {
+        slot = free_op_slots_.back();
+        free_op_slots_.pop_back();
+    }
+    Op* op = &op_slots_[slot];
+    op->generation++;
+    op->id = (uint64_t{op->generation} << 32) + (uint64_t{slot} << 8)
+           + static_cast<uint64_t>(type);
+    num_inflight_ops_++;
+    return op;
+}
+
+void
+IOUring::FreeOp(Op* op)
+{
+    DCHECK(GetOp(op->id) == op);
+    DCHECK(op->msg_data == nullptr);
+    // Release captured state now, rather than when the slot is reused
+    op->status_cb = nullptr;
+    op->read_cb = nullptr;
+    op->write_cb = nullptr;
+    op->close_cb = nullptr;
+    free_op_slots_.push_back(gsl::narrow_cast<uint32_t>((op->id >> 8) & (kMaxOpSlots - 1)));
+    op->id = kInvalidOpId;
+    num_inflight_ops_--;
+}
+
+IOUring::Op*
+IOUring::GetOp(uint64_t op_id)
+{
+    size_t slot = gsl::narrow_cast<size_t>((op_id >> 8) & (kMaxOpSlots - 1));
+    if (op_id == kInvalidOpId || slot >= op_slots_.size()) {
+        return nullptr;
+    }
+    Op* op = &op_slots_[slot];
+    return op->id == op_id ? op : nullptr;
 }
 
 #define ALLOC_OP(TYPE, OP_VAR)      \
-    Op* OP_VAR = op_pool_.Get();    \
-    uint64_t id = next_op_id_++;    \
-    OP_VAR->id = (id << 8) + TYPE;  \
+    Op* OP_VAR = AllocOp(TYPE);     \
     OP_VAR->fd = -1;                \
     OP_VAR->desc = nullptr;         \
     OP_VAR->buf_gid = 0;            \
     OP_VAR->flags = 0;              \
     OP_VAR->buf = nullptr;          \
     OP_VAR->buf_len = 0;            \
+    OP_VAR->offset = 0;             \
     OP_VAR->root_op = kInvalidOpId; \
     OP_VAR->next_op = kInvalidOpId; \
-    ops_[op->id] = op
+    OP_VAR->msg_data = nullptr
 
 IOUring::Op*
 IOUring::AllocConnectOp(Descriptor* desc,
@@ -432,12 +950,23 @@ IOUring::AllocReadOp(Descriptor* desc,
 }
 
 IOUring::Op*
-IOUring::AllocWriteOp(Descriptor* desc, std::span<const char> data)
+IOUring::AllocWriteOp(Descriptor* desc, std::span<const char> data, uint64_t offset)
 {
     ALLOC_OP(kWrite, op);
     op->desc = desc;
     op->data = data.data();
     op->data_len = data.size();
+    op->offset = offset;
+    desc->op_count++;
+    return op;
+}
+
+IOUring::Op*
+IOUring::AllocFsyncOp(Descriptor* desc, uint16_t flags)
+{
+    ALLOC_OP(kFsync, op);
+    op->desc = desc;
+    op->flags = flags;
     desc->op_count++;
     return op;
 }
@@ -453,6 +982,40 @@ IOUring::AllocSendAllOp(Descriptor* desc, std::span<const char> data)
     return op;
 }
 
+IOUring::Op*
+IOUring::AllocSendMsgOp(Descriptor* desc)
+{
+    ALLOC_OP(kSendMsg, op);
+    op->desc = desc;
+    op->msg_data = msg_data_pool_.Get();
+    op->msg_data->iov.clear();
+    op->msg_data->iov_start = 0;
+    op->msg_data->cbs.clear();
+    op->msg_data->cb_start = 0;
+    desc->op_count++;
+    return op;
+}
+
+IOUring::Op*
+IOUring::AllocSendZCOp(Descriptor* desc, std::span<const char> data, uint64_t root_op)
+{
+    ALLOC_OP(kSendZC, op);
+    op->desc = desc;
+    op->data = data.data();
+    op->data_len = data.size();
+    op->root_op = (root_op == kInvalidOpId) ? op->id : root_op;
+    if (zc_bufs_registered_ && data.data() >= zc_bufs_base_
+          && data.data() < zc_bufs_base_ + zc_buf_size_ * num_zc_bufs_) {
+        size_t index = gsl::narrow_cast<size_t>(data.data() - zc_bufs_base_) / zc_buf_size_;
+        if (data.data() + data.size() <= zc_bufs_base_ + (index + 1) * zc_buf_size_) {
+            op->flags |= kOpFlagFixedBuffer;
+            op->buf_gid = gsl::narrow_cast<uint16_t>(index);
+        }
+    }
+    desc->op_count++;
+    return op;
+}
+
 IOUring::Op*
 IOUring::AllocCloseOp(int fd)
 {
@@ -469,6 +1032,24 @@ IOUring::AllocCancelOp(uint64_t op_id)
     return op;
 }
 
+IOUring::Op*
+IOUring::AllocMsgRingOp(int ring_fd, uint32_t value)
+{
+    ALLOC_OP(kMsgRing, op);
+    op->fd = ring_fd;
+    op->data_len = value;
+    return op;
+}
+
+IOUring::Op*
+IOUring::AllocTimeoutOp(int64_t deadline)
+{
+    ALLOC_OP(kTimeout, op);
+    op->ts.tv_sec = deadline / 1000000000;
+    op->ts.tv_nsec = deadline % 1000000000;
+    return op;
+}
+
 #undef ALLOC_OP
 
 void
@@ -497,6 +1078,21 @@ IOUring::UnregisterFd(Descriptor* desc)
            fd_indices_.size());
 }
 
+void
+IOUring::FinishClose(Descriptor* desc)
+{
+    Op* op = DCHECK_NOTNULL(desc->close_op);
+    UnregisterFd(desc);
+    if ((op->flags & kOpFlagDetaching) != 0) {
+        // Nothing to submit, as the fd stays open
+        CloseCallback cb = std::move(op->close_cb);
+        FreeOp(op);
+        cb();
+    } else {
+        EnqueueOp(op);
+    }
+}
+
 #ifdef __CLANG_CONVERSION_DIAGNOSTIC_ENABLED
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wshorten-64-to-32"
@@ -511,6 +1107,7 @@ IOUring::EnqueueOp(Op* op)
            kOpTypeStr[op_type(op)],
            op_fd(op));
     struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+    submitted_sqe_count_++;
     switch (op_type(op)) {
     case kConnect:
         io_uring_prep_connect(sqe, op_fd_idx(op), op->addr, op->addrlen);
@@ -518,7 +1115,12 @@ IOUring::EnqueueOp(Op* op)
         break;
     case kRead:
         DCHECK_NOTNULL(op->desc)->active_read_op = op;
-        if (op->flags & kOpFlagUseRecv) {
+        if (op->flags & kOpFlagMultishot) {
+            io_uring_prep_recv_multishot(sqe, op_fd_idx(op), nullptr, 0, 0);
+            sqe->buf_group = op->buf_gid;
+            io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT);
+            break;
+        } else if (op->flags & kOpFlagUseRecv) {
             io_uring_prep_recv(sqe, op_fd_idx(op), op->buf, op->buf_len, 0);
         } else {
             io_uring_prep_read(sqe, op_fd_idx(op), op->buf, op->buf_len, 0);
@@ -526,22 +1128,60 @@ IOUring::EnqueueOp(Op* op)
         io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE | IOSQE_ASYNC);
         break;
     case kWrite:
-        io_uring_prep_write(sqe, op_fd_idx(op), op->data, op->data_len, 0);
+        io_uring_prep_write(sqe, op_fd_idx(op), op->data, op->data_len, op->offset);
+        io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+        break;
+    case kFsync:
+        io_uring_prep_fsync(sqe, op_fd_idx(op),
+                            (op->flags & kOpFlagDataSync) ? IORING_FSYNC_DATASYNC : 0);
         io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
         break;
     case kSendAll:
         io_uring_prep_send(sqe, op_fd_idx(op), op->data, op->data_len, 0);
         io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
         break;
+    case kSendMsg: {
+        SendMsgData* msg_data = DCHECK_NOTNULL(op->msg_data);
+        DCHECK_LT(msg_data->iov_start, msg_data->iov.size());
+        memset(&msg_data->msg, 0, sizeof(msg_data->msg));
+        msg_data->msg.msg_iov = msg_data->iov.data() + msg_data->iov_start;
+        msg_data->msg.msg_iovlen = std::min<size_t>(
+            msg_data->iov.size() - msg_data->iov_start, IOV_MAX);
+        io_uring_prep_sendmsg(sqe, op_fd_idx(op), &msg_data->msg, 0);
+        io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+        break;
+    }
+    case kSendZC:
+        if (!send_zc_supported_) {
+            io_uring_prep_send(sqe, op_fd_idx(op), op->data, op->data_len, 0);
+        } else if (op->flags & kOpFlagFixedBuffer) {
+            io_uring_prep_send_zc_fixed(sqe, op_fd_idx(op), op->data, op->data_len,
+                                        0, 0, op->buf_gid);
+        } else {
+            io_uring_prep_send_zc(sqe, op_fd_idx(op), op->data, op->data_len, 0, 0);
+        }
+        io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+        break;
     case kClose:
         io_uring_prep_close(sqe, op->fd);
         break;
+    case kMsgRing:
+        io_uring_prep_msg_ring(sqe, op->fd, gsl::narrow_cast<uint32_t>(op->data_len),
+                               kRingMessageId, 0);
+        break;
+    case kTimeout:
+        io_uring_prep_timeout(sqe, &op->ts, 0, IORING_TIMEOUT_ABS);
+        break;
     case kCancel:
         VLOG_F(1,
                "Going to cancel op {} (type {}): ",
                (op->root_op >> 8),
                kOpTypeStr[op->root_op & 0xff]);
-        io_uring_prep_cancel(sqe, reinterpret_cast<void*>(op->root_op), 0);
+        if ((op->root_op & 0xff) == kTimeout) {
+            io_uring_prep_timeout_remove(sqe, op->root_op, 0);
+        } else {
+            io_uring_prep_cancel(sqe, reinterpret_cast<void*>(op->root_op), 0);
+        }
         break;
     default:
         UNREACHABLE();
@@ -557,6 +1197,7 @@ void
 IOUring::OnOpComplete(Op* op, struct io_uring_cqe* cqe)
 {
     int res = cqe->res;
+    bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
     VLOG(2) << fmt::format("Op completed: id={}, type={}, fd={}, res={}",
                            (op->id >> 8),
                            kOpTypeStr[op_type(op)],
@@ -568,7 +1209,11 @@ IOUring::OnOpComplete(Op* op, struct io_uring_cqe* cqe)
         HandleConnectComplete(op, res);
         break;
     case kRead:
-        HandleReadOpComplete(op, res, &next_op);
+        if (op->flags & kOpFlagMultishot) {
+            HandleMultishotRecvComplete(op, res, cqe->flags, &next_op);
+        } else {
+            HandleReadOpComplete(op, res, &next_op);
+        }
         break;
     case kWrite:
         HandleWriteOpComplete(op, res);
@@ -576,11 +1221,27 @@ IOUring::OnOpComplete(Op* op, struct io_uring_cqe* cqe)
     case kSendAll:
         HandleSendallOpComplete(op, res, &next_op);
         break;
+    case kSendMsg:
+        HandleSendMsgOpComplete(op, res, &next_op);
+        break;
+    case kSendZC:
+        HandleSendZCOpComplete(op, res, cqe->flags, &next_op);
+        break;
     case kClose:
         HandleCloseOpComplete(op, res);
         break;
+    case kFsync:
+        HandleFsyncOpComplete(op, res);
+        break;
+    case kMsgRing:
+        HandleMsgRingOpComplete(op, res);
+        break;
+    case kTimeout:
+        HandleTimeoutOpComplete(op, res);
+        break;
     case kCancel:
-        if (res < 0 && res != -EALREADY) {
+        // -ENOENT if the target has completed, which is common for timeouts
+        if (res < 0 && res != -EALREADY && res != -ENOENT) {
             LOG_F(WARNING,
                   "Failed to cancel op {} (type {}): {}",
                   (op->root_op >> 8),
@@ -592,17 +1253,18 @@ IOUring::OnOpComplete(Op* op, struct io_uring_cqe* cqe)
         UNREACHABLE();
     }
     if (next_op == nullptr && op->next_op != kInvalidOpId) {
-        DCHECK(ops_.contains(op->next_op));
-        next_op = ops_[op->next_op];
+        next_op = DCHECK_NOTNULL(GetOp(op->next_op));
     }
     if (next_op != nullptr) {
+        if (op_type(next_op) == kSendAll || op_type(next_op) == kSendMsg) {
+            next_op = CoalesceSendOps(next_op);
+        }
         EnqueueOp(next_op);
     }
-    if (op->desc != nullptr) {
+    if (op->desc != nullptr && !more) {
         op->desc->op_count--;
         if (op->desc->op_count == 0 && op->desc->close_op != nullptr) {
-            UnregisterFd(op->desc);
-            EnqueueOp(op->desc->close_op);
+            FinishClose(op->desc);
         }
     }
 }
@@ -611,33 +1273,32 @@ void
 IOUring::HandleConnectComplete(Op* op, int res)
 {
     DCHECK_EQ(op_type(op), kConnect);
-    DCHECK(connect_cbs_.contains(op->id));
+    DCHECK(op->status_cb);
     if (res >= 0) {
-        connect_cbs_[op->id](0);
+        op->status_cb(0);
     } else {
         errno = -res;
-        connect_cbs_[op->id](-1);
+        op->status_cb(-1);
     }
-    connect_cbs_.erase(op->id);
 }
 
 void
 IOUring::HandleReadOpComplete(Op* op, int res, Op** next_op)
 {
     DCHECK_EQ(op_type(op), kRead);
-    DCHECK(read_cbs_.contains(op->id));
+    DCHECK(op->read_cb);
     DCHECK_NOTNULL(op->desc)->active_read_op = nullptr;
     bool repeat = false;
     if (res >= 0) {
         std::span<const char> data(op->buf, static_cast<size_t>(res));
-        repeat = read_cbs_[op->id](0, data);
+        repeat = op->read_cb(0, data);
     } else if (res == -EAGAIN || res == -EINTR) {
         repeat = true;
     } else if (res == -ECANCELED) {
         LOG(INFO) << "ReadOp cancelled";
     } else {
         errno = -res;
-        repeat = read_cbs_[op->id](-1, EMPTY_CHAR_SPAN);
+        repeat = op->read_cb(-1, EMPTY_CHAR_SPAN);
     }
     if ((op->flags & kOpFlagRepeat) != 0 && (op->flags & kOpFlagCancelled) == 0 &&
         op->desc->close_op == nullptr && repeat)
@@ -646,59 +1307,114 @@ IOUring::HandleReadOpComplete(Op* op, int res, Op** next_op)
                                  op->buf_gid,
                                  std::span<char>(op->buf, op->buf_len),
                                  op->flags);
-        read_cbs_[new_op->id].swap(read_cbs_[op->id]);
-        read_cbs_.erase(op->id);
+        new_op->read_cb = std::move(op->read_cb);
         *next_op = new_op;
     } else {
-        read_cbs_.erase(op->id);
         DCHECK(buf_pools_.contains(op->buf_gid));
         buf_pools_[op->buf_gid]->Return(op->buf);
     }
 }
 
+void
+IOUring::HandleMultishotRecvComplete(Op* op, int res, uint32_t cqe_flags, Op** next_op)
+{
+    DCHECK_EQ(op_type(op), kRead);
+    DCHECK(op->read_cb);
+    Descriptor* desc = DCHECK_NOTNULL(op->desc);
+    // Data arriving after StopReadOrRecv is dropped, unless the fd is detaching
+    bool cancelled = (op->flags & kOpFlagCancelled) != 0
+                     && (op->flags & kOpFlagDetaching) == 0;
+    bool repeat = false;
+    if ((cqe_flags & IORING_CQE_F_BUFFER) != 0) {
+        DCHECK_GE(res, 0);
+        uint16_t bid = gsl::narrow_cast<uint16_t>(cqe_flags >> IORING_CQE_BUFFER_SHIFT);
+        if (!cancelled) {
+            std::span<const char> data(buf_rings_[op->buf_gid].bufs[bid],
+                                       static_cast<size_t>(res));
+            repeat = op->read_cb(0, data);
+        }
+        RecycleRingBuffer(op->buf_gid, bid);
+    } else if (res >= 0) {
+        if (!cancelled) {
+            repeat = op->read_cb(0, EMPTY_CHAR_SPAN);
+        }
+    } else if (res == -EAGAIN || res == -EINTR || res == -ENOBUFS) {
+        // With -ENOBUFS, buffers are back in the ring when the new op starts,
+        // as all callbacks of this batch return before the next submit
+        repeat = true;
+    } else if (res == -ECANCELED) {
+        LOG(INFO) << "ReadOp cancelled";
+    } else if (res == -EINVAL && multishot_recv_) {
+        HLOG(WARNING) << "Multishot recv not supported, fall back to single-shot recv";
+        multishot_recv_ = false;
+        repeat = true;
+    } else if (!cancelled) {
+        errno = -res;
+        repeat = op->read_cb(-1, EMPTY_CHAR_SPAN);
+    }
+    // The callback may have stopped reading or closed the fd
+    bool stop = (op->flags & kOpFlagCancelled) != 0 || desc->close_op != nullptr || !repeat;
+    if ((cqe_flags & IORING_CQE_F_MORE) != 0) {
+        if (stop && (op->flags & kOpFlagCancelled) == 0) {
+            op->flags |= kOpFlagCancelled;
+            EnqueueOp(AllocCancelOp(op->id));
+            desc->active_read_op = nullptr;
+        }
+        return;
+    }
+    if (desc->active_read_op == op) {
+        desc->active_read_op = nullptr;
+    }
+    if (stop) {
+        return;
+    }
+    Op* new_op = nullptr;
+    if (multishot_recv_) {
+        new_op = AllocReadOp(desc, op->buf_gid, std::span<char>(), op->flags);
+    } else {
+        std::span<char> buf;
+        buf_pools_[op->buf_gid]->Get(&buf);
+        new_op = AllocReadOp(desc, op->buf_gid, buf,
+                             gsl::narrow_cast<uint16_t>(op->flags & ~kOpFlagMultishot));
+    }
+    new_op->read_cb = std::move(op->read_cb);
+    *next_op = new_op;
+}
+
 void
 IOUring::HandleWriteOpComplete(Op* op, int res)
 {
     DCHECK_EQ(op_type(op), kWrite);
-    DCHECK(write_cbs_.contains(op->id));
+    DCHECK(op->write_cb);
     if (res >= 0) {
-        write_cbs_[op->id](0, gsl::narrow_cast<size_t>(res));
+        op->write_cb(0, gsl::narrow_cast<size_t>(res));
     } else {
         errno = -res;
-        write_cbs_[op->id](-1, 0);
+        op->write_cb(-1, 0);
     }
-    write_cbs_.erase(op->id);
 }
 
 void
 IOUring::HandleSendallOpComplete(Op* op, int res, Op** next_op)
 {
     DCHECK_EQ(op_type(op), kSendAll);
-    DCHECK(sendall_cbs_.contains(op->id));
+    DCHECK(op->status_cb);
     DCHECK(op->desc != nullptr);
-    SendAllCallback cb;
-    cb.swap(sendall_cbs_[op->id]);
-    sendall_cbs_.erase(op->id);
+    SendAllCallback cb = std::move(op->status_cb);
     if (res >= 0) {
         size_t nwrite = gsl::narrow_cast<size_t>(res);
-        if (nwrite == op->buf_len) {
-            if (op->root_op == kInvalidOpId) {
-                cb(0);
-                if (op->desc->last_send_op == op) {
-                    DCHECK_EQ(op->next_op, kInvalidOpId);
-                    op->desc->last_send_op = nullptr;
-                }
-            } else {
-                DCHECK_NE(op->next_op, kInvalidOpId);
-                sendall_cbs_[op->next_op].swap(cb);
+        if (nwrite == op->data_len) {
+            cb(0);
+            if (op->desc->last_send_op == op) {
+                DCHECK_EQ(op->next_op, kInvalidOpId);
+                op->desc->last_send_op = nullptr;
             }
         } else {
-            std::span<const char> remaining_data(op->buf + nwrite,
-                                                 op->buf_len - nwrite);
+            std::span<const char> remaining_data(op->data + nwrite,
+                                                 op->data_len - nwrite);
             Op* new_op = AllocSendAllOp(op->desc, remaining_data);
-            new_op->root_op = op->root_op;
             new_op->next_op = op->next_op;
-            sendall_cbs_[new_op->id].swap(cb);
+            new_op->status_cb = std::move(cb);
             if (op->desc->last_send_op == op) {
                 DCHECK_EQ(op->next_op, kInvalidOpId);
                 op->desc->last_send_op = new_op;
@@ -708,34 +1424,130 @@ IOUring::HandleSendallOpComplete(Op* op, int res, Op** next_op)
     } else {
         errno = -res;
         cb(-1);
-        if (op->root_op != kInvalidOpId) {
-            uint64_t final = op->root_op;
-            DCHECK(ops_.contains(final));
-            Op* final_op = ops_[final];
-            DCHECK_EQ(final_op->root_op, kInvalidOpId);
-            uint64_t cur = op->next_op;
-            while (cur != final) {
-                DCHECK_NE(cur, kInvalidOpId);
-                DCHECK(ops_.contains(cur));
-                Op* tmp_op = ops_[cur];
-                DCHECK_EQ(tmp_op->desc, op->desc);
-                op->desc->op_count--;
-                op_pool_.Return(tmp_op);
-                cur = tmp_op->next_op;
+        if (op->desc->last_send_op == op) {
+            DCHECK_EQ(op->next_op, kInvalidOpId);
+            op->desc->last_send_op = nullptr;
+        }
+    }
+}
+
+void
+IOUring::HandleSendMsgOpComplete(Op* op, int res, Op** next_op)
+{
+    DCHECK_EQ(op_type(op), kSendMsg);
+    DCHECK(op->desc != nullptr);
+    SendMsgData* msg_data = DCHECK_NOTNULL(op->msg_data);
+    std::vector<std::pair<int, SendAllCallback>> done_cbs;
+    if (res >= 0) {
+        size_t nwrite = gsl::narrow_cast<size_t>(res);
+        // Advance iovecs in place, without copying remaining ones
+        while (nwrite > 0) {
+            DCHECK_LT(msg_data->iov_start, msg_data->iov.size());
+            struct iovec& iov = msg_data->iov[msg_data->iov_start];
+            size_t n = std::min(nwrite, iov.iov_len);
+            iov.iov_base = reinterpret_cast<char*>(iov.iov_base) + n;
+            iov.iov_len -= n;
+            if (iov.iov_len == 0) {
+                msg_data->iov_start++;
             }
-            op->next_op = final_op->next_op;
-            if (op->desc->last_send_op == final_op) {
-                DCHECK_EQ(final_op->next_op, kInvalidOpId);
-                op->desc->last_send_op = nullptr;
+            nwrite -= n;
+        }
+        nwrite = gsl::narrow_cast<size_t>(res);
+        while (nwrite > 0) {
+            DCHECK_LT(msg_data->cb_start, msg_data->cbs.size());
+            auto& [remaining, cb] = msg_data->cbs[msg_data->cb_start];
+            size_t n = std::min(nwrite, remaining);
+            remaining -= n;
+            if (remaining == 0) {
+                done_cbs.emplace_back(0, std::move(cb));
+                msg_data->cb_start++;
             }
-            op->desc->op_count--;
-            op_pool_.Return(final_op);
+            nwrite -= n;
+        }
+    } else {
+        for (size_t i = msg_data->cb_start; i < msg_data->cbs.size(); i++) {
+            done_cbs.emplace_back(res, std::move(msg_data->cbs[i].second));
+        }
+        msg_data->iov_start = msg_data->iov.size();
+    }
+    // The send queue is updated before running callbacks, which may send more
+    if (msg_data->iov_start < msg_data->iov.size()) {
+        Op* new_op = AllocSendMsgOp(op->desc);
+        msg_data_pool_.Return(new_op->msg_data);
+        new_op->msg_data = msg_data;
+        new_op->next_op = op->next_op;
+        if (op->desc->last_send_op == op) {
+            DCHECK_EQ(op->next_op, kInvalidOpId);
+            op->desc->last_send_op = new_op;
+        }
+        *next_op = new_op;
+    } else {
+        if (op->desc->last_send_op == op) {
+            DCHECK_EQ(op->next_op, kInvalidOpId);
+            op->desc->last_send_op = nullptr;
+        }
+        msg_data_pool_.Return(msg_data);
+    }
+    op->msg_data = nullptr;
+    for (auto& [status, cb]: done_cbs) {
+        if (status < 0) {
+            errno = -status;
+            cb(-1);
         } else {
-            if (op->desc->last_send_op == op) {
-                DCHECK_EQ(op->next_op, kInvalidOpId);
-                op->desc->last_send_op = nullptr;
-            }
+            cb(0);
+        }
+    }
+}
+
+void
+IOUring::HandleSendZCOpComplete(Op* op, int res, uint32_t cqe_flags, Op** next_op)
+{
+    DCHECK_EQ(op_type(op), kSendZC);
+    DCHECK(op->desc != nullptr);
+    DCHECK(sendzc_states_.contains(op->root_op));
+    SendZeroCopyState& state = sendzc_states_[op->root_op];
+    if ((cqe_flags & IORING_CQE_F_NOTIF) == 0) {
+        // Result of the send. The next send of this fd can start now, while
+        // the data may still be held by the kernel.
+        Op* new_op = nullptr;
+        if (res >= 0 && gsl::narrow_cast<size_t>(res) < op->data_len) {
+            size_t nwrite = gsl::narrow_cast<size_t>(res);
+            new_op = AllocSendZCOp(op->desc,
+                                   std::span<const char>(op->data + nwrite,
+                                                         op->data_len - nwrite),
+                                   op->root_op);
+            new_op->next_op = op->next_op;
+            state.inflight_ops++;
+        } else if (res < 0) {
+            state.status = res;
+        }
+        if (op->desc->last_send_op == op) {
+            DCHECK_EQ(op->next_op, kInvalidOpId);
+            op->desc->last_send_op = new_op;
+        }
+        if (new_op != nullptr) {
+            *next_op = new_op;
+        } else if (op->next_op != kInvalidOpId) {
+            *next_op = DCHECK_NOTNULL(GetOp(op->next_op));
         }
+        // Not to start the next send again on the notification
+        op->next_op = kInvalidOpId;
+    }
+    if ((cqe_flags & IORING_CQE_F_MORE) != 0) {
+        return;
+    }
+    DCHECK_GT(state.inflight_ops, 0U);
+    if (--state.inflight_ops > 0) {
+        return;
+    }
+    SendZeroCopyCallback cb = std::move(state.cb);
+    int status = state.status;
+    sendzc_states_.erase(op->root_op);
+    if (status < 0) {
+        errno = -status;
+        cb(-1);
+    } else {
+        cb(0);
     }
 }
 
@@ -746,9 +1558,50 @@ IOUring::HandleCloseOpComplete(Op* op, int res)
     if (res < 0) {
         LOG_F(FATAL, "Failed to close fd {}: {}", op->fd, ERRNO_LOGSTR(-res));
     }
-    DCHECK(close_cbs_.contains(op->id));
-    close_cbs_[op->id]();
-    close_cbs_.erase(op->id);
+    DCHECK(op->close_cb);
+    op->close_cb();
+}
+
+void
+IOUring::HandleFsyncOpComplete(Op* op, int res)
+{
+    DCHECK_EQ(op_type(op), kFsync);
+    DCHECK(op->status_cb);
+    if (res >= 0) {
+        op->status_cb(0);
+    } else {
+        errno = -res;
+        op->status_cb(-1);
+    }
+}
+
+void
+IOUring::HandleMsgRingOpComplete(Op* op, int res)
+{
+    DCHECK_EQ(op_type(op), kMsgRing);
+    if (!op->status_cb) {
+        return;
+    }
+    if (res >= 0) {
+        op->status_cb(0);
+    } else {
+        errno = -res;
+        op->status_cb(-1);
+    }
+}
+
+void
+IOUring::HandleTimeoutOpComplete(Op* op, int res)
+{
+    DCHECK_EQ(op_type(op), kTimeout);
+    DCHECK(op->status_cb);
+    // Expired timeouts complete with -ETIME
+    if (res >= 0 || res == -ETIME) {
+        op->status_cb(0);
+    } else {
+        errno = -res;
+        op->status_cb(-1);
+    }
 }
 
 }} // namespace faas::server
@@ -4,6 +4,7 @@
 #include "common/stat.h"
 #include "utils/object_pool.h"
 #include "utils/buffer_pool.h"
+#include "utils/inline_function.h"
 
 __BEGIN_THIRD_PARTY_HEADERS
 #include <liburing.h>
@@ -14,39 +15,102 @@ namespace server {
 
 class IOUring {
 public:
-    explicit IOUring();
+    // `sq_thread_index` picks the CPU of the SQPOLL thread among
+    // --io_uring_sq_thread_cpus, and defaults to the id of this ring
+    explicit IOUring(int sq_thread_index = -1);
     ~IOUring();
 
     void PrepareBuffers(uint16_t gid, size_t buf_size);
     bool RegisterFd(int fd);
 
-    using ConnectCallback = std::function<void(int /* status */)>;
+    using ConnectCallback = utils::InlineFunction<void(int /* status */)>;
     bool Connect(int fd, const struct sockaddr* addr, size_t addrlen, ConnectCallback cb);
 
-    using ReadCallback = std::function<bool(int /* status */, std::span<const char> /* data */)>;
+    using ReadCallback =
+        utils::InlineFunction<bool(int /* status */, std::span<const char> /* data */)>;
     bool StartRead(int fd, uint16_t buf_gid, ReadCallback cb);
     bool StartRecv(int fd, uint16_t buf_gid, ReadCallback cb);
     bool StopReadOrRecv(int fd);
 
     // Partial write may happen. The caller is responsible for handling partial writes.
-    using WriteCallback = std::function<void(int /* status */, size_t /* nwrite */)>;
+    using WriteCallback = utils::InlineFunction<void(int /* status */, size_t /* nwrite */)>;
     bool Write(int fd, std::span<const char> data, WriteCallback cb);
+    // Only works for regular files. Partial write may happen as in Write.
+    bool WriteAt(int fd, uint64_t offset, std::span<const char> data, WriteCallback cb);
+
+    // Only works for regular files. If `datasync` is set, only flushes data
+    // and metadata required to read it back, as fdatasync does.
+    using FsyncCallback = utils::InlineFunction<void(int /* status */)>;
+    bool Fsync(int fd, bool datasync, FsyncCallback cb);
 
     // Only works for sockets. Partial write will not happen.
     // IOUring implementation will correctly order all SendAll writes.
-    using SendAllCallback = std::function<void(int /* status */)>;
+    // The vector version submits all spans in one sendmsg. Sends queued
+    // behind an inflight one are coalesced into one sendmsg as well.
+    // Sending nothing calls `cb` with status 0 right away.
+    using SendAllCallback = utils::InlineFunction<void(int /* status */)>;
     bool SendAll(int sockfd, std::span<const char> data, SendAllCallback cb);
     bool SendAll(int sockfd, const std::vector<std::span<const char>>& data_vec,
                  SendAllCallback cb);
 
-    using CloseCallback = std::function<void()>;
+    // Only works for sockets. Sends with IORING_OP_SEND_ZC if supported, and
+    // is ordered with SendAll writes. Partial write will not happen.
+    // `data` must stay valid until `cb` is called, which happens after the
+    // kernel releases it (the notification CQE), not when it is sent.
+    using SendZeroCopyCallback = utils::InlineFunction<void(int /* status */)>;
+    bool SendZeroCopy(int sockfd, std::span<const char> data, SendZeroCopyCallback cb);
+    // Registered buffers for SendZeroCopy, sized by --io_uring_zc_buf_size
+    // and --io_uring_zc_bufs. Data within them is sent as fixed buffers.
+    void PrepareZeroCopyBuffers();
+    // Returns a buffer of at least `size` bytes. It is a registered buffer if
+    // `size` fits and one is free, otherwise it comes from a BufferPool of
+    // power-of-two sized buffers.
+    std::span<char> NewZeroCopyBuffer(size_t size);
+    void ReturnZeroCopyBuffer(std::span<char> buf);
+
+    using CloseCallback = utils::InlineFunction<void()>;
     bool Close(int fd, CloseCallback cb);
+    // Stops reading and unregisters `fd` without closing it, after which
+    // `cb` runs and `fd` can be registered to another IOUring. Data received
+    // before the read is cancelled is still delivered.
+    bool Detach(int fd, CloseCallback cb);
+
+    // Posts a CQE to `target` with IORING_OP_MSG_RING, on which the ring
+    // message handler of `target` runs with `value`. Returns false if
+    // IORING_OP_MSG_RING is not supported. Like other calls, it can only be
+    // made from the thread running this IOUring, but not `target`.
+    using RingMessageCallback = utils::InlineFunction<void(int /* status */)>;
+    bool SendRingMessage(IOUring* target, uint32_t value, RingMessageCallback cb);
+    using RingMessageHandler = utils::InlineFunction<void(uint32_t /* value */)>;
+    void SetRingMessageHandler(RingMessageHandler handler);
+
+    // Runs `cb` once CLOCK_MONOTONIC reaches `deadline` (in nanoseconds),
+    // with IORING_OP_TIMEOUT. Returns the ID for CancelTimeout. A cancelled
+    // timeout runs `cb` with status -1 and errno set to ECANCELED.
+    using TimeoutCallback = utils::InlineFunction<void(int /* status */)>;
+    uint64_t Timeout(int64_t deadline, TimeoutCallback cb);
+    void CancelTimeout(uint64_t timeout_id);
 
     void EventLoopRunOnce(size_t* inflight_ops);
 
+    // Counters for benchmarks
+    uint64_t io_uring_enter_count() const { return io_uring_enter_count_; }
+    // Total time waiting for completions, in io_uring_enter or spinning
+    int64_t io_uring_enter_time_ns() const { return io_uring_enter_time_ns_; }
+    uint64_t completed_cqe_count() const { return completed_cqe_count_; }
+    uint64_t submitted_sqe_count() const { return submitted_sqe_count_; }
+    // Bytes of read buffers allocated by this IOUring, including those
+    // handed to the kernel by buffer rings
+    size_t resident_buffer_bytes() const;
+    // Releases free read buffers above watermarks, returns bytes released
+    size_t TrimBufferPools();
+
 private:
     int uring_id_;
     static std::atomic<int> next_uring_id_;
+    // Ring owning the SQ thread shared with --io_uring_share_sq_thread
+    static absl::Mutex shared_sq_mu_;
+    static int shared_sq_ring_fd_ ABSL_GUARDED_BY(shared_sq_mu_);
     struct io_uring ring_;
     struct __kernel_timespec cqe_wait_timeout_;
 
@@ -54,6 +118,34 @@ private:
 
     absl::flat_hash_map</* gid */ uint16_t, std::unique_ptr<utils::BufferPool>> buf_pools_;
 
+    // Kernel-provided buffer ring of a buffer group, used by multishot recv.
+    // Buffers are taken from the BufferPool of the same gid, and are given
+    // back to the ring once ReadCallback returns.
+    struct BufRing {
+        struct io_uring_buf_ring* ring;
+        uint32_t entries;
+        size_t buf_size;
+        std::vector<char*> bufs;  // Indexed by buffer ID
+    };
+    bool multishot_recv_;
+    const uint32_t buf_ring_entries_;
+    absl::flat_hash_map</* gid */ uint16_t, BufRing> buf_rings_;
+
+    bool send_zc_supported_;
+    char* zc_bufs_base_;
+    size_t zc_buf_size_;
+    size_t num_zc_bufs_;
+    bool zc_bufs_registered_;
+    std::vector<char*> free_zc_bufs_;
+    absl::flat_hash_map</* buf_size */ size_t, std::unique_ptr<utils::BufferPool>>
+        zc_buf_pools_;
+
+    bool msg_ring_supported_;
+    const bool sqpoll_;
+    bool owns_shared_sq_;
+    const int64_t cq_spin_ns_;
+    RingMessageHandler ring_message_handler_;
+
     struct Op;
     struct Descriptor {
         int fd;
@@ -73,7 +165,12 @@ private:
         kWrite   = 2,
         kSendAll = 3,
         kClose   = 4,
-        kCancel  = 5
+        kCancel  = 5,
+        kFsync   = 6,
+        kSendMsg = 7,
+        kSendZC  = 8,
+        kMsgRing = 9,
+        kTimeout = 10
     };
     static constexpr const char* kOpTypeStr[] = {
         "Connect",
@@ -81,45 +178,87 @@ private:
         "Write",
         "SendAll",
         "Close",
-        "Cancel"
+        "Cancel",
+        "Fsync",
+        "SendMsg",
+        "SendZC",
+        "MsgRing",
+        "Timeout"
     };
 
     enum {
         kOpFlagRepeat    = 1 << 0,
         kOpFlagUseRecv   = 1 << 1,
         kOpFlagCancelled = 1 << 2,
+        kOpFlagDataSync  = 1 << 3,
+        kOpFlagMultishot = 1 << 4,
+        kOpFlagFixedBuffer = 1 << 5,
+        kOpFlagDetaching = 1 << 6,
     };
+    // Op ID layout: generation (32-bit) | slot index (24-bit) | type (8-bit)
     static constexpr uint64_t kInvalidOpId = std::numeric_limits<uint64_t>::max();
+    // user_data of CQEs posted by other rings through kMsgRing
+    static constexpr uint64_t kRingMessageId = kInvalidOpId - 1;
+    static constexpr size_t kMaxOpSlots = size_t{1} << 24;
     static constexpr size_t kInvalidFdIndex = std::numeric_limits<size_t>::max();
+    struct SendMsgData {
+        std::vector<struct iovec> iov;
+        size_t iov_start;    // First iovec not fully sent, advanced on short writes
+        struct msghdr msg;
+        // Callbacks of coalesced sends, with their bytes not yet sent
+        std::vector<std::pair<size_t, SendAllCallback>> cbs;
+        size_t cb_start;
+    };
     struct Op {
-        uint64_t id;         // Lower 8-bit stores type
-        int fd;              // Used by kClose
-        Descriptor* desc;    // Used by kConnect, kRead, kWrite, kSendAll
-        uint16_t buf_gid;    // Used by kRead
+        uint64_t id;         // Lower 8-bit stores type, kInvalidOpId if the slot is free
+        uint32_t generation = 0;  // Bumped each time the slot is reused
+        int fd;              // Used by kClose, and kMsgRing for the fd of the target ring
+        Descriptor* desc;    // Used by kConnect, kRead, kWrite, kSendAll, kSendMsg, kSendZC
+        uint16_t buf_gid;    // Used by kRead, also the buffer ring of multishot kRead,
+                             // and the registered buffer of kSendZC
         uint16_t flags;
         union {
             char* buf;                    // Used by kRead
-            const char* data;             // Used by kWrite, kSendAll
+            const char* data;             // Used by kWrite, kSendAll, kSendZC
             const struct sockaddr* addr;  // Used by kConnect
         };
         union {
             size_t buf_len;   // Used by kRead
-            size_t data_len;  // Used by kWrite, kSendAll
+            size_t data_len;  // Used by kWrite, kSendAll, kSendZC, and kMsgRing
+                              // for the message value
             size_t addrlen;   // Used by kConnect
         };
-        uint64_t root_op;    // Used by kSendAll
-        uint64_t next_op;    // Used by kSendAll, kCancel
+        uint64_t offset;     // Used by kWrite
+        uint64_t root_op;    // Used by kCancel, kSendZC
+        uint64_t next_op;    // Used by kSendAll, kSendMsg, kSendZC
+        SendMsgData* msg_data;  // Used by kSendMsg
+        struct __kernel_timespec ts;  // Used by kTimeout
+        // Callbacks are kept inline, thus ops in flight do not allocate
+        SendAllCallback status_cb;  // Used by kConnect, kFsync, kSendAll, kMsgRing, kTimeout
+        ReadCallback read_cb;       // Used by kRead
+        WriteCallback write_cb;     // Used by kWrite
+        CloseCallback close_cb;     // Used by kClose
     };
 
-    uint64_t next_op_id_;
-    utils::SimpleObjectPool<Op> op_pool_;
-    absl::flat_hash_map</* op_id */ uint64_t, Op*> ops_;
+    // Ops are never freed, free slots are reused by new ops. Slots live in a
+    // deque so that Op pointers stay valid when more slots are added.
+    std::deque<Op> op_slots_;
+    std::vector<uint32_t> free_op_slots_;
+    size_t num_inflight_ops_;
+    utils::SimpleObjectPool<SendMsgData> msg_data_pool_;
+    // Keyed by the first op of a SendZeroCopy, as short writes continue
+    // with new ops. The callback runs once all of them are released.
+    struct SendZeroCopyState {
+        SendZeroCopyCallback cb;
+        int status;
+        size_t inflight_ops;
+    };
+    absl::flat_hash_map</* op_id */ uint64_t, SendZeroCopyState> sendzc_states_;
 
-    absl::flat_hash_map</* op_id */ uint64_t, ConnectCallback> connect_cbs_;
-    absl::flat_hash_map</* op_id */ uint64_t, ReadCallback> read_cbs_;
-    absl::flat_hash_map</* op_id */ uint64_t, WriteCallback> write_cbs_;
-    absl::flat_hash_map</* op_id */ uint64_t, SendAllCallback> sendall_cbs_;
-    absl::flat_hash_map</* op_id */ uint64_t, CloseCallback> close_cbs_;
+    uint64_t io_uring_enter_count_;
+    int64_t io_uring_enter_time_ns_;
+    uint64_t completed_cqe_count_;
+    uint64_t submitted_sqe_count_;
 
     stat::Counter ev_loop_counter_;
     stat::Counter wait_timeout_counter_;
@@ -142,24 +281,49 @@ private:
         return DCHECK_NOTNULL(op->desc)->index;
     }
 
+    Op* AllocOp(OpType type);
+    void FreeOp(Op* op);
+    // Returns nullptr if `op_id` is not inflight
+    Op* GetOp(uint64_t op_id);
+
     bool StartReadInternal(int fd, uint16_t buf_gid, uint16_t flags, ReadCallback cb);
 
+    bool SetupBufRing(uint16_t gid, size_t buf_size);
+    void RecycleRingBuffer(uint16_t gid, uint16_t bid);
+
     Op* AllocConnectOp(Descriptor* desc, const struct sockaddr* addr, size_t addrlen);
     Op* AllocReadOp(Descriptor* desc, uint16_t buf_gid, std::span<char> buf, uint16_t flags);
-    Op* AllocWriteOp(Descriptor* desc, std::span<const char> data);
+    Op* AllocWriteOp(Descriptor* desc, std::span<const char> data, uint64_t offset = 0);
+    Op* AllocFsyncOp(Descriptor* desc, uint16_t flags);
     Op* AllocSendAllOp(Descriptor* desc, std::span<const char> data);
+    Op* AllocSendMsgOp(Descriptor* desc);
+    Op* AllocSendZCOp(Descriptor* desc, std::span<const char> data, uint64_t root_op);
     Op* AllocCloseOp(int fd);
     Op* AllocCancelOp(uint64_t op_id);
+    Op* AllocMsgRingOp(int ring_fd, uint32_t value);
+    Op* AllocTimeoutOp(int64_t deadline);
 
     void UnregisterFd(Descriptor* desc);
+    void FinishClose(Descriptor* desc);
     void EnqueueOp(Op* op);
+    void LinkSendOp(Descriptor* desc, Op* op);
+    Op* CoalesceSendOps(Op* op);
+    // Returns true if completions are ready within --io_uring_cq_spin_us.
+    // Time spent spinning is set in `elapsed_ns`.
+    bool SpinForCompletions(int64_t* elapsed_ns);
     void OnOpComplete(Op* op, struct io_uring_cqe* cqe);
 
     void HandleConnectComplete(Op* op, int res);
     void HandleReadOpComplete(Op* op, int res, Op** next_op);
+    void HandleMultishotRecvComplete(Op* op, int res, uint32_t cqe_flags, Op** next_op);
     void HandleWriteOpComplete(Op* op, int res);
     void HandleSendallOpComplete(Op* op, int res, Op** next_op);
+    void HandleSendMsgOpComplete(Op* op, int res, Op** next_op);
+    void HandleSendZCOpComplete(Op* op, int res, uint32_t cqe_flags, Op** next_op);
     void HandleCloseOpComplete(Op* op, int res);
+    void HandleFsyncOpComplete(Op* op, int res);
+    void HandleMsgRingOpComplete(Op* op, int res);
+    void HandleTimeoutOpComplete(Op* op, int res);
 
     void CleanUpFn();
 
@@ -1,8 +1,23 @@
 #include "server/io_worker.h"
 
+#include "common/time.h"
 #include "server/constants.h"
 
 #include <sys/eventfd.h>
+#include <cmath>
+
+ABSL_FLAG(size_t, io_worker_function_queue_size, 1024,
+          "Number of cells in the queue of functions scheduled to each IOWorker");
+ABSL_FLAG(bool, io_worker_msg_ring_wakeup, true,
+          "IOWorkers wake up each other with IORING_OP_MSG_RING if supported, "
+          "instead of eventfd");
+ABSL_FLAG(std::string, io_worker_cpus, "",
+          "Comma-separated CPUs, on which IOWorker threads are pinned in turn");
+ABSL_FLAG(uint32_t, io_worker_load_window_ms, 100,
+          "Length of windows in which busy time of IOWorkers is measured");
+ABSL_FLAG(uint32_t, io_worker_buffer_trim_interval_ms, 1000,
+          "Interval at which IOWorkers trim free buffers above watermarks, "
+          "unless busy, 0 disables trimming");
 
 namespace faas { namespace server {
 
@@ -20,15 +35,30 @@ IOWorker::IOWorker(int worker_id,
     : worker_id_(static_cast<size_t>(worker_id)),
       worker_name_(worker_name),
       state_(kCreated),
-      io_uring_(),
+      io_uring_(worker_id),
+      timer_wheel_(&io_uring_),
       eventfd_(-1),
       pipe_to_server_fd_(-1),
       log_header_(fmt::format("{}: ", worker_name)),
       event_loop_thread_(fmt::format("{}/EL", worker_name),
                          absl::bind_front(&IOWorker::EventLoopThreadMain, this)),
       write_buffer_pool_(fmt::format("{}_Write", worker_name), write_buffer_size),
-      connections_on_closing_(0)
-{}
+      connections_on_closing_(0),
+      scheduled_functions_(absl::GetFlag(FLAGS_io_worker_function_queue_size)),
+      has_overflow_functions_(false),
+      wakeup_pending_(false),
+      msg_ring_wakeup_(absl::GetFlag(FLAGS_io_worker_msg_ring_wakeup)),
+      load_window_ns_(int64_t{absl::GetFlag(FLAGS_io_worker_load_window_ms)} * 1000000),
+      load_window_start_(0),
+      load_window_enter_time_(0),
+      busy_permille_(0),
+      load_(0),
+      buffer_trim_interval_ns_(
+          int64_t{absl::GetFlag(FLAGS_io_worker_buffer_trim_interval_ms)} * 1000000),
+      buffer_trim_timeout_id_(kInvalidTimeoutId)
+{
+    CHECK_GT(load_window_ns_, 0);
+}
 
 IOWorker::~IOWorker()
 {
@@ -59,6 +89,11 @@ IOWorker::Start(int pipe_to_server_fd)
             RunScheduledFunctions();
             return true;
         }));
+    io_uring_.SetRingMessageHandler([this](uint32_t value) {
+        if (state_.load(std::memory_order_acquire) == kRunning) {
+            RunScheduledFunctions();
+        }
+    });
     // Setup pipe to server for receiving connections
     pipe_to_server_fd_ = pipe_to_server_fd;
     URING_DCHECK_OK(io_uring_.RegisterFd(pipe_to_server_fd_));
@@ -77,6 +112,7 @@ IOWorker::Start(int pipe_to_server_fd)
             RegisterConnection(connection);
             return true;
         }));
+    ScheduleBufferTrim();
     // Start event loop thread
     event_loop_thread_.Start();
     state_.store(kRunning);
@@ -132,17 +168,7 @@ void
 IOWorker::OnConnectionClose(ConnectionBase* connection)
 {
     DCHECK(WithinMyEventLoopThread());
-    DCHECK(connections_.contains(connection->id()));
-    connections_.erase(connection->id());
-    int conn_type = connection->type();
-    if (conn_type >= 0) {
-        DCHECK(connections_by_type_.contains(conn_type));
-        connections_by_type_[conn_type]->Remove(connection->id());
-        HLOG_F(INFO,
-               "One connection of type {0} closed, total of type {0} is {1}",
-               conn_type,
-               connections_by_type_[conn_type]->size());
-    }
+    RemoveConnection(connection);
     DCHECK(pipe_to_server_fd_ >= -1);
     char* buf = connection->pipe_write_buf_for_transfer();
     memcpy(buf, &connection, __FAAS_PTR_SIZE);
@@ -163,6 +189,72 @@ IOWorker::OnConnectionClose(ConnectionBase* connection)
         }));
 }
 
+void
+IOWorker::RemoveConnection(ConnectionBase* connection)
+{
+    DCHECK(connections_.contains(connection->id()));
+    connections_.erase(connection->id());
+    int conn_type = connection->type();
+    if (conn_type >= 0) {
+        DCHECK(connections_by_type_.contains(conn_type));
+        connections_by_type_[conn_type]->Remove(connection->id());
+        HLOG_F(INFO,
+               "One connection of type {0} removed, total of type {0} is {1}",
+               conn_type,
+               connections_by_type_[conn_type]->size());
+    }
+}
+
+bool
+IOWorker::MigrateConnection(IOWorker* target, double load_share, int* conn_type)
+{
+    DCHECK(WithinMyEventLoopThread());
+    DCHECK(target != this);
+    if (state_.load(std::memory_order_acquire) != kRunning
+          || target->state_.load(std::memory_order_acquire) != kRunning) {
+        return false;
+    }
+    std::vector<std::pair<size_t, ConnectionBase*>> recv_bytes;
+    size_t total_bytes = 0;
+    for (const auto& [conn_id, bytes]: window_recv_bytes_) {
+        // Skip connections closed or migrated since the window ends
+        if (!connections_.contains(conn_id)) {
+            continue;
+        }
+        recv_bytes.emplace_back(bytes, connections_[conn_id]);
+        total_bytes += bytes;
+    }
+    std::vector<std::pair<double, ConnectionBase*>> candidates;
+    for (const auto& [bytes, connection]: recv_bytes) {
+        double share = static_cast<double>(bytes) / static_cast<double>(total_bytes);
+        if (share < 2 * load_share) {
+            candidates.emplace_back(std::abs(share - load_share), connection);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    for (const auto& [distance, connection]: candidates) {
+        if (connection->ScheduleDetach(
+                absl::bind_front(&IOWorker::OnConnectionDetached, this, target, connection))) {
+            // Removed right away, so that stopping this worker skips it
+            HLOG_F(INFO, "Migrate connection {} of type {:#x} to {}",
+                   connection->id(), connection->type(), target->worker_name());
+            *conn_type = connection->type();
+            RemoveConnection(connection);
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+IOWorker::OnConnectionDetached(IOWorker* target, ConnectionBase* connection)
+{
+    // If `target` is stopping, RegisterConnection closes the connection
+    target->ScheduleFunction(nullptr, [target, connection] {
+        target->RegisterConnection(connection);
+    });
+}
+
 void
 IOWorker::NewWriteBuffer(std::span<char>* buf)
 {
@@ -196,18 +288,94 @@ void
 IOWorker::EventLoopThreadMain()
 {
     current_ = this;
+    std::vector<int> cpus = base::Thread::ParseCpuList(absl::GetFlag(FLAGS_io_worker_cpus));
+    if (!cpus.empty()) {
+        base::Thread::SetCurrentThreadAffinity({cpus[worker_id_ % cpus.size()]});
+    }
     HLOG(INFO) << "Event loop starts";
     size_t inflight_ops;
     do {
         io_uring_.EventLoopRunOnce(&inflight_ops);
         RunIdleFunctions();
+        UpdateLoad();
     } while (inflight_ops > 0);
     HLOG(INFO) << "Event loop finishes";
     state_.store(kStopped);
 }
 
 void
-IOWorker::ScheduleFunction(ConnectionBase* owner, std::function<void()> fn)
+IOWorker::UpdateLoad()
+{
+    int64_t now = GetMonotonicNanoTimestamp();
+    if (load_window_start_ == 0) {
+        load_window_start_ = now;
+        load_window_enter_time_ = io_uring_.io_uring_enter_time_ns();
+        return;
+    }
+    int64_t elapsed = now - load_window_start_;
+    if (elapsed < load_window_ns_) {
+        return;
+    }
+    int64_t enter_time = io_uring_.io_uring_enter_time_ns();
+    int64_t busy_time = std::max<int64_t>(elapsed - (enter_time - load_window_enter_time_), 0);
+    uint32_t sample = gsl::narrow_cast<uint32_t>(std::min<int64_t>(busy_time * 1000 / elapsed, 1000));
+    // Average with previous windows, so that a short burst does not dominate
+    busy_permille_ = (busy_permille_ + sample) / 2;
+    size_t queued = scheduled_functions_.ApproxSize();
+    load_.store(busy_permille_ + gsl::narrow_cast<uint32_t>(std::min<size_t>(queued, 1000)),
+                std::memory_order_relaxed);
+    load_window_start_ = now;
+    load_window_enter_time_ = enter_time;
+    window_recv_bytes_.clear();
+    for (const auto& [conn_id, connection]: connections_) {
+        size_t bytes = connection->TakeRecvBytes();
+        if (bytes > 0) {
+            window_recv_bytes_.emplace_back(conn_id, bytes);
+        }
+    }
+}
+
+void
+IOWorker::ScheduleBufferTrim()
+{
+    if (buffer_trim_interval_ns_ == 0) {
+        return;
+    }
+    buffer_trim_timeout_id_ = io_uring_.Timeout(
+        GetMonotonicNanoTimestamp() + buffer_trim_interval_ns_,
+        [this] (int status) { OnBufferTrimTimeout(status); });
+}
+
+void
+IOWorker::OnBufferTrimTimeout(int status)
+{
+    buffer_trim_timeout_id_ = kInvalidTimeoutId;
+    if (state_.load(std::memory_order_acquire) != kRunning) {
+        return;
+    }
+    if (status != 0) {
+        PLOG(ERROR) << "Timeout of buffer trimming failed";
+    }
+    // Without other events, load is not updated while idle
+    UpdateLoad();
+    if (busy_permille_ < kBufferTrimMaxBusyPermille) {
+        TrimBufferPools();
+    }
+    ScheduleBufferTrim();
+}
+
+void
+IOWorker::TrimBufferPools()
+{
+    size_t released = write_buffer_pool_.Trim() * write_buffer_pool_.buffer_size();
+    released += io_uring_.TrimBufferPools();
+    if (released > 0) {
+        HVLOG_F(1, "Trimmed {} bytes of free buffers", released);
+    }
+}
+
+void
+IOWorker::ScheduleFunction(ConnectionBase* owner, Function fn)
 {
     if (state_.load(std::memory_order_acquire) != kRunning) {
         HLOG(WARNING)
@@ -215,27 +383,81 @@ IOWorker::ScheduleFunction(ConnectionBase* owner, std::function<void()> fn)
         return;
     }
     ScheduledFunction function = {.owner_id = (owner == nullptr) ? -1 : owner->id(),
-                                  .fn = fn};
+                                  .fn = std::move(fn)};
     if (WithinMyEventLoopThread()) {
         InvokeFunction(function);
         return;
     }
-    bool need_notify = false;
-    {
-        absl::MutexLock lk(&scheduled_function_mu_);
-        if (scheduled_functions_.empty()) {
-            need_notify = true;
+    EnqueueFunction(std::move(function));
+    WakeUpEventLoop();
+}
+
+void
+IOWorker::ScheduleFunctions(ConnectionBase* owner, std::span<Function> fns)
+{
+    if (fns.empty()) {
+        return;
+    }
+    if (state_.load(std::memory_order_acquire) != kRunning) {
+        HLOG(WARNING)
+            << "Cannot schedule function in non-running state, will ignore it";
+        return;
+    }
+    int owner_id = (owner == nullptr) ? -1 : owner->id();
+    if (WithinMyEventLoopThread()) {
+        for (Function& fn: fns) {
+            InvokeFunction(ScheduledFunction{.owner_id = owner_id, .fn = std::move(fn)});
         }
-        scheduled_functions_.push_back(std::move(function));
+        return;
+    }
+    for (Function& fn: fns) {
+        EnqueueFunction(ScheduledFunction{.owner_id = owner_id, .fn = std::move(fn)});
+    }
+    WakeUpEventLoop();
+}
+
+void
+IOWorker::EnqueueFunction(ScheduledFunction function)
+{
+    // Once some function overflows, later ones follow it to keep the order
+    if (!has_overflow_functions_.load(std::memory_order_acquire)
+          && scheduled_functions_.Push(function)) {
+        return;
+    }
+    absl::MutexLock lk(&overflow_function_mu_);
+    overflow_functions_.push_back(std::move(function));
+    has_overflow_functions_.store(true, std::memory_order_release);
+}
+
+void
+IOWorker::WakeUpEventLoop()
+{
+    // Pairs with the fence in RunScheduledFunctions, so that either this
+    // thread sees the flag cleared, or the event loop sees the new function
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (wakeup_pending_.exchange(true, std::memory_order_seq_cst)) {
+        return;
     }
-    if (need_notify) {
-        DCHECK(eventfd_ >= 0);
-        PCHECK(eventfd_write(eventfd_, 1) == 0) << "eventfd_write failed";
+    IOWorker* producer = current();
+    if (msg_ring_wakeup_ && producer != nullptr && producer != this) {
+        bool sent = producer->io_uring()->SendRingMessage(
+            &io_uring_, 0,
+            [this](int status) {
+                if (status != 0) {
+                    PLOG(ERROR) << "Failed to send ring message, wake up with eventfd";
+                    PCHECK(eventfd_write(eventfd_, 1) == 0) << "eventfd_write failed";
+                }
+            });
+        if (sent) {
+            return;
+        }
     }
+    DCHECK(eventfd_ >= 0);
+    PCHECK(eventfd_write(eventfd_, 1) == 0) << "eventfd_write failed";
 }
 
 void
-IOWorker::ScheduleIdleFunction(ConnectionBase* owner, std::function<void()> fn)
+IOWorker::ScheduleIdleFunction(ConnectionBase* owner, Function fn)
 {
     DCHECK(WithinMyEventLoopThread());
     if (state_.load(std::memory_order_acquire) != kRunning) {
@@ -245,7 +467,7 @@ IOWorker::ScheduleIdleFunction(ConnectionBase* owner, std::function<void()> fn)
     }
     idle_functions_.push_back(
         ScheduledFunction{.owner_id = (owner == nullptr) ? -1 : owner->id(),
-                          .fn = fn});
+                          .fn = std::move(fn)});
 }
 
 void
@@ -255,11 +477,20 @@ IOWorker::RunScheduledFunctions()
     if (state_.load(std::memory_order_acquire) != kRunning) {
         return;
     }
-    absl::InlinedVector<ScheduledFunction, 16> functions;
+    wakeup_pending_.store(false, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    ScheduledFunction function;
+    while (scheduled_functions_.Pop(&function)) {
+        InvokeFunction(function);
+    }
+    if (!has_overflow_functions_.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::vector<ScheduledFunction> functions;
     {
-        absl::MutexLock lk(&scheduled_function_mu_);
-        functions = std::move(scheduled_functions_);
-        scheduled_functions_.clear();
+        absl::MutexLock lk(&overflow_function_mu_);
+        functions.swap(overflow_functions_);
+        has_overflow_functions_.store(false, std::memory_order_release);
     }
     for (const ScheduledFunction& function: functions) {
         InvokeFunction(function);
@@ -273,10 +504,12 @@ IOWorker::RunIdleFunctions()
     if (state_.load(std::memory_order_acquire) != kRunning) {
         return;
     }
-    for (const ScheduledFunction& function: idle_functions_) {
+    // Idle functions may schedule more idle functions for the next iteration
+    absl::InlinedVector<ScheduledFunction, 16> functions;
+    functions.swap(idle_functions_);
+    for (const ScheduledFunction& function: functions) {
         InvokeFunction(function);
     }
-    idle_functions_.clear();
 }
 
 void
@@ -300,6 +533,9 @@ IOWorker::StopInternal()
     }
     HLOG(INFO) << "Start stopping process";
     state_.store(kStopping);
+    if (buffer_trim_timeout_id_ != kInvalidTimeoutId) {
+        io_uring_.CancelTimeout(buffer_trim_timeout_id_);
+    }
     if (connections_.empty() && connections_on_closing_ == 0) {
         CloseWorkerFds();
     } else {
@@ -4,7 +4,10 @@
 #include "base/thread.h"
 #include "utils/buffer_pool.h"
 #include "utils/round_robin_set.h"
+#include "utils/mpsc_queue.h"
+#include "utils/inline_function.h"
 #include "server/io_uring.h"
+#include "server/timer_wheel.h"
 
 namespace faas { namespace server {
 
@@ -30,6 +33,19 @@ public:
 
     virtual void Start(IOWorker* io_worker) = 0;
     virtual void ScheduleClose() = 0;
+    // Detaches from its IOWorker, after which `cb` runs and the connection
+    // can be started on another IOWorker. Returns false if migration is not
+    // supported.
+    virtual bool ScheduleDetach(std::function<void()> cb)
+    {
+        return false;
+    }
+    // Bytes received since the last call, used to weigh connections when
+    // migrating them
+    virtual size_t TakeRecvBytes()
+    {
+        return 0;
+    }
 
     // Only used for transferring connection from Server to IOWorker
     void set_id(int id) { id_ = id; }
@@ -55,6 +71,7 @@ public:
     size_t worker_id() const { return worker_id_; }
     std::string_view worker_name() const { return worker_name_; }
     IOUring* io_uring() { return &io_uring_; }
+    TimerWheel* timer_wheel() { return &timer_wheel_; }
 
     // Return current IOWorker within event loop thread
     static IOWorker* current() { return current_; }
@@ -65,6 +82,15 @@ public:
     bool WithinMyEventLoopThread();
 
     void RegisterConnection(ConnectionBase* connection);
+    // Moves to `target` the connection whose share of bytes received here in
+    // the last load window is closest to `load_share`. Connections above twice of it are skipped, as
+    // moving them only moves the hot spot. Returns false if none can be moved,
+    // otherwise `conn_type` is set to the type of the moved connection.
+    bool MigrateConnection(IOWorker* target, double load_share, int* conn_type);
+
+    // Busy time per mille within recent load windows (time outside of
+    // io_uring_enter), plus functions waiting in the queue. Thread-safe.
+    uint32_t load() const { return load_.load(std::memory_order_relaxed); }
 
     // Called by Connection for ONLY once
     void OnConnectionClose(ConnectionBase* connection);
@@ -85,15 +111,20 @@ public:
     template <class T>
     T* PickOrCreateConnection(int type, std::function<T*(IOWorker*)> create_cb);
 
+    using Function = utils::InlineFunction<void()>;
+
     // Schedule a function to run on this IO worker's event loop
     // thread. It can be called safely from other threads.
     // When the function is ready to run, IO worker will check if its
     // owner connection is still active, and will not run the function
     // if it is closed.
-    void ScheduleFunction(ConnectionBase* owner, std::function<void()> fn);
+    void ScheduleFunction(ConnectionBase* owner, Function fn);
+    // Schedule all functions in `fns` with a single wakeup of the event loop.
+    // Functions are moved out of `fns`.
+    void ScheduleFunctions(ConnectionBase* owner, std::span<Function> fns);
 
     // Idle functions will be invoked at the end of each event loop iteration.
-    void ScheduleIdleFunction(ConnectionBase* owner, std::function<void()> fn);
+    void ScheduleIdleFunction(ConnectionBase* owner, Function fn);
 
 private:
     enum State { kCreated, kRunning, kStopping, kStopped };
@@ -102,6 +133,7 @@ private:
     std::string worker_name_;
     std::atomic<State> state_;
     IOUring io_uring_;
+    TimerWheel timer_wheel_;
     static thread_local IOWorker* current_;
 
     int eventfd_;
@@ -119,14 +151,47 @@ private:
 
     struct ScheduledFunction {
         int owner_id;
-        std::function<void()> fn;
+        Function fn;
     };
-    absl::Mutex scheduled_function_mu_;
-    absl::InlinedVector<ScheduledFunction, 16> scheduled_functions_
-        ABSL_GUARDED_BY(scheduled_function_mu_);
+    // Functions scheduled from other threads. Once the queue is full, they go
+    // to `overflow_functions_` until the event loop drains it.
+    utils::BoundedMpscQueue<ScheduledFunction> scheduled_functions_;
+    std::atomic<bool> has_overflow_functions_;
+    absl::Mutex overflow_function_mu_;
+    std::vector<ScheduledFunction> overflow_functions_
+        ABSL_GUARDED_BY(overflow_function_mu_);
+    // Set once the event loop is notified, until it drains scheduled
+    // functions. Producers seeing it set skip the wakeup.
+    std::atomic<bool> wakeup_pending_;
+    // Wake up with IORING_OP_MSG_RING when scheduling from another IOWorker
+    const bool msg_ring_wakeup_;
     absl::InlinedVector<ScheduledFunction, 16> idle_functions_;
 
+    const int64_t load_window_ns_;
+    int64_t load_window_start_;
+    int64_t load_window_enter_time_;
+    uint32_t busy_permille_;
+    std::atomic<uint32_t> load_;
+    // Bytes received by connections within the last load window, so that
+    // migration weighs them over the same period as the load
+    std::vector<std::pair</* id */ int, size_t>> window_recv_bytes_;
+
+    // Free buffers are trimmed on a timer, so that idle workers trim them
+    // too, while busy workers skip trimming
+    static constexpr uint32_t kBufferTrimMaxBusyPermille = 500;
+    static constexpr uint64_t kInvalidTimeoutId = std::numeric_limits<uint64_t>::max();
+    const int64_t buffer_trim_interval_ns_;
+    uint64_t buffer_trim_timeout_id_;
+
     void EventLoopThreadMain();
+    void UpdateLoad();
+    void ScheduleBufferTrim();
+    void OnBufferTrimTimeout(int status);
+    void TrimBufferPools();
+    void RemoveConnection(ConnectionBase* connection);
+    void OnConnectionDetached(IOWorker* target, ConnectionBase* connection);
+    void EnqueueFunction(ScheduledFunction function);
+    void WakeUpEventLoop();
     void RunScheduledFunctions();
     void RunIdleFunctions();
     void InvokeFunction(const ScheduledFunction& function);
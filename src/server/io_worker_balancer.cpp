@@ -0,0 +1,112 @@
+#include "server/io_worker_balancer.h"
+
+ABSL_FLAG(uint32_t, io_worker_migrate_load_gap, 200,
+          "Migrate a connection from an IOWorker when its load exceeds "
+          "the least loaded one by this much (busy permille)");
+
+namespace faas {
+namespace server {
+
+IOWorkerBalancer::IOWorkerBalancer(std::vector<IOWorker*> io_workers)
+    : io_workers_(std::move(io_workers)),
+      next_io_worker_for_pick_(0) {
+    CHECK(!io_workers_.empty());
+    for (size_t i = 0; i < io_workers_.size(); i++) {
+        io_worker_indices_[io_workers_[i]] = i;
+    }
+}
+
+IOWorker* IOWorkerBalancer::PickForConnType(int conn_type) {
+    DCHECK_GE(conn_type, 0);
+    size_t n = io_workers_.size();
+    absl::MutexLock lk(&mu_);
+    std::vector<uint32_t>& placed = placed_connections_[conn_type];
+    if (placed.empty()) {
+        placed.resize(n, 0);
+    }
+    // Ties are broken round-robin, as before load is known
+    size_t start = next_io_worker_id_[conn_type]++;
+    size_t best = start % n;
+    uint64_t best_score = std::numeric_limits<uint64_t>::max();
+    for (size_t i = 0; i < n; i++) {
+        size_t idx = (start + i) % n;
+        uint64_t score = uint64_t{io_workers_[idx]->load()}
+                         + uint64_t{placed[idx]} * kConnectionPlacementLoad;
+        if (score < best_score) {
+            best = idx;
+            best_score = score;
+        }
+    }
+    placed[best]++;
+    return io_workers_[best];
+}
+
+void IOWorkerBalancer::OnConnectionClosed(int conn_type, IOWorker* io_worker) {
+    DCHECK(io_worker_indices_.contains(io_worker));
+    size_t idx = io_worker_indices_.at(io_worker);
+    absl::MutexLock lk(&mu_);
+    if (!placed_connections_.contains(conn_type)) {
+        // Not placed by PickForConnType()
+        return;
+    }
+    uint32_t& count = placed_connections_[conn_type][idx];
+    if (count > 0) {
+        count--;
+    }
+}
+
+void IOWorkerBalancer::OnConnectionMigrated(int conn_type, IOWorker* from, IOWorker* to) {
+    size_t from_idx = io_worker_indices_.at(from);
+    size_t to_idx = io_worker_indices_.at(to);
+    absl::MutexLock lk(&mu_);
+    if (!placed_connections_.contains(conn_type)) {
+        return;
+    }
+    std::vector<uint32_t>& placed = placed_connections_[conn_type];
+    if (placed[from_idx] > 0) {
+        placed[from_idx]--;
+        placed[to_idx]++;
+    }
+}
+
+IOWorker* IOWorkerBalancer::PickSome() const {
+    size_t n = io_workers_.size();
+    size_t counter = next_io_worker_for_pick_.fetch_add(1, std::memory_order_relaxed);
+    IOWorker* first = io_workers_[counter % n];
+    if (n == 1) {
+        return first;
+    }
+    // Vary the distance between the two choices every round
+    IOWorker* second = io_workers_[(counter + 1 + (counter / n) % (n - 1)) % n];
+    return second->load() < first->load() ? second : first;
+}
+
+void IOWorkerBalancer::BalanceCurrentIOWorker() {
+    IOWorker* current = DCHECK_NOTNULL(IOWorker::current());
+    IOWorker* least_loaded = nullptr;
+    for (IOWorker* io_worker: io_workers_) {
+        if (io_worker != current
+              && (least_loaded == nullptr || io_worker->load() < least_loaded->load())) {
+            least_loaded = io_worker;
+        }
+    }
+    if (least_loaded == nullptr) {
+        return;
+    }
+    uint32_t current_load = current->load();
+    uint32_t least_load = least_loaded->load();
+    uint32_t gap = absl::GetFlag(FLAGS_io_worker_migrate_load_gap);
+    if (current_load == 0 || current_load < least_load + gap) {
+        return;
+    }
+    // Moving half of the gap evens out both IOWorkers
+    double load_share = static_cast<double>(current_load - least_load)
+                        / 2 / static_cast<double>(current_load);
+    int conn_type;
+    if (current->MigrateConnection(least_loaded, load_share, &conn_type)) {
+        OnConnectionMigrated(conn_type, current, least_loaded);
+    }
+}
+
+}  // namespace server
+}  // namespace faas
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "base/common.h"
+#include "server/io_worker.h"
+
+namespace faas {
+namespace server {
+
+// Places connections and functions on the least loaded IOWorkers, judged
+// by IOWorker::load(), and moves connections off busy IOWorkers.
+class IOWorkerBalancer {
+public:
+    explicit IOWorkerBalancer(std::vector<IOWorker*> io_workers);
+    ~IOWorkerBalancer() {}
+
+    // Spreads connections of the same type, and prefers less loaded
+    // IOWorkers. Thread-safe.
+    IOWorker* PickForConnType(int conn_type);
+    // Called once a connection placed by PickForConnType() is closed on
+    // `io_worker`. Thread-safe.
+    void OnConnectionClosed(int conn_type, IOWorker* io_worker);
+    // The less loaded of two IOWorkers, which are chosen round-robin.
+    // Thread-safe.
+    IOWorker* PickSome() const;
+
+    // Called periodically within the event loop of each IOWorker. Migrates
+    // a connection to the least loaded IOWorker, if the current one is much
+    // busier than it. The connection is picked to carry about half of the
+    // load gap.
+    void BalanceCurrentIOWorker();
+
+private:
+    // A connection placed on an IOWorker weighs as much as this busy permille
+    static constexpr uint32_t kConnectionPlacementLoad = 100;
+
+    std::vector<IOWorker*> io_workers_;
+    absl::flat_hash_map<IOWorker*, /* index */ size_t> io_worker_indices_;
+    mutable std::atomic<size_t> next_io_worker_for_pick_;
+
+    absl::Mutex mu_;
+    absl::flat_hash_map</* conn_type */ int, size_t>
+        next_io_worker_id_ ABSL_GUARDED_BY(mu_);
+    absl::flat_hash_map</* conn_type */ int, std::vector<uint32_t>>
+        placed_connections_ ABSL_GUARDED_BY(mu_);
+
+    void OnConnectionMigrated(int conn_type, IOWorker* from, IOWorker* to);
+
+    DISALLOW_COPY_AND_ASSIGN(IOWorkerBalancer);
+};
+
+}  // namespace server
+}  // namespace faas
@@ -36,6 +36,11 @@ bool NodeWatcher::GetNodeAddr(NodeType node_type, uint16_t node_id,
     return true;
 }
 
+bool NodeWatcher::IsNodeOnline(NodeType node_type, uint16_t node_id) {
+    absl::MutexLock lk(&mu_);
+    return node_addr_[node_type].contains(node_id);
+}
+
 bool NodeWatcher::ParseNodePath(std::string_view path,
                                 NodeType* node_type, uint16_t* node_id) {
     if (path == "gateway") {
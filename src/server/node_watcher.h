@@ -29,6 +29,7 @@ public:
     void SetNodeOfflineCallback(NodeEventCallback cb);
 
     bool GetNodeAddr(NodeType node_type, uint16_t node_id, struct sockaddr_in* addr);
+    bool IsNodeOnline(NodeType node_type, uint16_t node_id);
 
     static NodeType GetSrcNodeType(protocol::ConnType conn_type);
     static NodeType GetDstNodeType(protocol::ConnType conn_type);
@@ -11,6 +11,10 @@
 #include <sys/eventfd.h>
 #include <sys/types.h>
 
+ABSL_FLAG(absl::Duration, io_worker_balance_interval, absl::Seconds(1),
+          "Interval of checking IOWorker loads for migrating idle connections, "
+          "0 to disable migration");
+
 #define log_header_ "ServerBase: "
 
 namespace faas { namespace server {
@@ -24,7 +28,6 @@ ServerBase::ServerBase(std::string_view node_name)
                          absl::bind_front(&ServerBase::EventLoopThreadMain, this)),
       zk_session_(absl::GetFlag(FLAGS_zookeeper_host),
                   absl::GetFlag(FLAGS_zookeeper_root_path)),
-      next_io_worker_for_pick_(0),
       next_connection_id_(0)
 {
     PCHECK(stop_eventfd_ >= 0) << "Failed to create eventfd";
@@ -42,6 +45,14 @@ ServerBase::Start()
     zk_session_.Start();
     SetupIOWorkers();
     state_.store(kBootstrapping);
+    absl::Duration balance_interval = absl::GetFlag(FLAGS_io_worker_balance_interval);
+    if (balance_interval > absl::ZeroDuration() && io_workers_.size() > 1) {
+        CreatePeriodicTimer(
+            kIOWorkerBalanceTimerId,
+            balance_interval,
+            absl::bind_front(&IOWorkerBalancer::BalanceCurrentIOWorker,
+                             io_worker_balancer_.get()));
+    }
     StartInternal();
     SetupMessageServer();
     node_watcher_.StartWatching(zk_session());
@@ -86,16 +97,13 @@ IOWorker*
 ServerBase::PickIOWorkerForConnType(int conn_type)
 {
     DCHECK(WithinMyEventLoopThread());
-    DCHECK_GE(conn_type, 0);
-    size_t idx = (next_io_worker_id_[conn_type]++) % io_workers_.size();
-    return io_workers_[idx].get();
+    return io_worker_balancer_->PickForConnType(conn_type);
 }
 
 IOWorker*
 ServerBase::SomeIOWorker() const
 {
-    size_t idx = next_io_worker_for_pick_.fetch_add(1, std::memory_order_relaxed);
-    return io_workers_.at(idx % io_workers_.size()).get();
+    return io_worker_balancer_->PickSome();
 }
 
 void
@@ -178,6 +186,11 @@ ServerBase::SetupIOWorkers()
         pipes_to_io_worker_[io_worker.get()] = pipe_fds[0];
         io_workers_.push_back(std::move(io_worker));
     }
+    std::vector<IOWorker*> io_workers;
+    for (const auto& io_worker: io_workers_) {
+        io_workers.push_back(io_worker.get());
+    }
+    io_worker_balancer_ = std::make_unique<IOWorkerBalancer>(std::move(io_workers));
 }
 
 void
@@ -306,6 +319,14 @@ ServerBase::DoReadClosedConnection(int pipefd)
             DCHECK(timers_.contains(timer));
             timers_.erase(timer);
         } else {
+            // Each IOWorker has its own pipe, and connections are closed by
+            // the IOWorker they run on
+            for (const auto& [io_worker, fd]: pipes_to_io_worker_) {
+                if (fd == pipefd) {
+                    io_worker_balancer_->OnConnectionClosed(connection->type(), io_worker);
+                    break;
+                }
+            }
             OnConnectionClose(connection);
         }
     }
@@ -5,6 +5,7 @@
 #include "common/protocol.h"
 #include "utils/appendable_buffer.h"
 #include "server/io_worker.h"
+#include "server/io_worker_balancer.h"
 #include "server/node_watcher.h"
 #include "server/timer.h"
 
@@ -71,12 +72,10 @@ private:
     zk::ZKSession zk_session_;
     NodeWatcher node_watcher_;
 
-    mutable std::atomic<size_t> next_io_worker_for_pick_;
-
     std::vector<std::unique_ptr<IOWorker>> io_workers_;
+    std::unique_ptr<IOWorkerBalancer> io_worker_balancer_;
     absl::flat_hash_map<IOWorker*, /* fd */ int> pipes_to_io_worker_;
     absl::flat_hash_map</* fd */ int, ConnectionCallback> connection_cbs_;
-    absl::flat_hash_map</* conn_type */ int, size_t> next_io_worker_id_;
     std::atomic<int> next_connection_id_;
     absl::flat_hash_set<std::unique_ptr<Timer>> timers_;
 
@@ -1,8 +1,6 @@
 #include "server/timer.h"
 
-#include "utils/io.h"
-#include "utils/timerfd.h"
-#include "server/constants.h"
+#include "common/time.h"
 
 namespace faas {
 namespace server {
@@ -13,11 +11,12 @@ Timer::Timer(int timer_type, Callback cb)
       cb_(cb),
       io_worker_(nullptr),
       state_(kCreated),
-      timerfd_(-1) {}
+      entry_(absl::bind_front(&Timer::OnExpired, this)),
+      next_deadline_(0) {}
 
 Timer::~Timer() {
     DCHECK(state_ == kCreated || state_ == kClosed);
-    DCHECK(timerfd_ == -1);
+    DCHECK(!entry_.scheduled());
 }
 
 void Timer::SetPeriodic(absl::Time initial, absl::Duration interval) {
@@ -30,10 +29,6 @@ void Timer::SetPeriodic(absl::Time initial, absl::Duration interval) {
 void Timer::Start(server::IOWorker* io_worker) {
     DCHECK(io_worker->WithinMyEventLoopThread());
     io_worker_ = io_worker;
-    timerfd_ = io_utils::CreateTimerFd();
-    CHECK(timerfd_ != -1);
-    io_utils::FdUnsetNonblocking(timerfd_);
-    URING_DCHECK_OK(current_io_uring()->RegisterFd(timerfd_));
     state_ = kIdle;
     if (periodic_) {
         absl::Duration initial_duration = initial_ - absl::Now();
@@ -41,32 +36,37 @@ void Timer::Start(server::IOWorker* io_worker) {
             LOG(WARNING) << "Has past the initial duration";
             initial_duration = absl::Microseconds(1);
         }
-        CHECK(io_utils::SetupTimerFdPeriodic(timerfd_, initial_duration, interval_));
+        next_deadline_ = GetMonotonicNanoTimestamp()
+                         + absl::ToInt64Nanoseconds(initial_duration);
+        io_worker_->timer_wheel()->Schedule(&entry_, next_deadline_);
         state_ = kScheduled;
     }
-    URING_DCHECK_OK(current_io_uring()->StartRead(
-        timerfd_, kOctaBufGroup,
-        [this] (int status, std::span<const char> data) -> bool {
-            if (state_ != kScheduled) {
-                return false;
-            }
-            if (!periodic_) {
-                state_ = kIdle;
-            }
-            cb_();
-            return true;
+}
+
+void Timer::OnExpired() {
+    if (state_ != kScheduled) {
+        return;
+    }
+    if (periodic_) {
+        // Skip missed periods, as timerfd does
+        int64_t interval = absl::ToInt64Nanoseconds(interval_);
+        int64_t now = GetMonotonicNanoTimestamp();
+        next_deadline_ += interval;
+        if (next_deadline_ <= now) {
+            next_deadline_ += ((now - next_deadline_) / interval + 1) * interval;
         }
-    ));
+        io_worker_->timer_wheel()->Schedule(&entry_, next_deadline_);
+    } else {
+        state_ = kIdle;
+    }
+    cb_();
 }
 
 void Timer::ScheduleClose() {
     DCHECK(io_worker_->WithinMyEventLoopThread());
-    state_ = kClosing;
-    URING_DCHECK_OK(current_io_uring()->Close(timerfd_, [this] () {
-        timerfd_ = -1;
-        state_ = kClosed;
-        io_worker_->OnConnectionClose(this);
-    }));
+    io_worker_->timer_wheel()->Cancel(&entry_);
+    state_ = kClosed;
+    io_worker_->OnConnectionClose(this);
 }
 
 bool Timer::TriggerIn(absl::Duration d) {
@@ -77,7 +77,7 @@ bool Timer::TriggerIn(absl::Duration d) {
         return false;
     }
     state_ = kScheduled;
-    CHECK(io_utils::SetupTimerFdOneTime(timerfd_, d));
+    io_worker_->timer_wheel()->ScheduleIn(&entry_, d);
     return true;
 }
 
@@ -0,0 +1,230 @@
+#include "server/timer_wheel.h"
+
+#include "common/time.h"
+
+ABSL_FLAG(uint32_t, timer_wheel_tick_us, 100, "Tick length of timer wheels");
+
+namespace faas {
+namespace server {
+
+TimerWheel::Entry::Entry(Callback cb)
+    : cb_(std::move(cb)),
+      prev_(nullptr),
+      next_(nullptr),
+      expires_(0),
+      slot_(kNotScheduled) {}
+
+TimerWheel::Entry::~Entry() {
+    DCHECK(!scheduled());
+}
+
+TimerWheel::TimerWheel(IOUring* io_uring)
+    : io_uring_(io_uring),
+      tick_ns_(int64_t{absl::GetFlag(FLAGS_timer_wheel_tick_us)} * 1000),
+      num_entries_(0),
+      advancing_(false),
+      timeout_id_(kInvalidTimeoutId),
+      timeout_tick_(kNever),
+      timeout_seqnum_(0) {
+    CHECK_GT(tick_ns_, 0);
+    now_tick_ = CurrentTick();
+    slots_.fill(nullptr);
+    bitmaps_.fill(0);
+}
+
+TimerWheel::~TimerWheel() {
+    DCHECK_EQ(num_entries_, 0U);
+}
+
+uint64_t TimerWheel::CurrentTick() const {
+    return static_cast<uint64_t>(GetMonotonicNanoTimestamp() / tick_ns_);
+}
+
+void TimerWheel::Schedule(Entry* entry, int64_t deadline) {
+    if (entry->scheduled()) {
+        Unlink(entry);
+        num_entries_--;
+    }
+    if (num_entries_ == 0 && !advancing_) {
+        // No timeout is armed when empty, so the wheel may lag far behind
+        now_tick_ = std::max(now_tick_, CurrentTick());
+    }
+    // Round up, so that entries never run before their deadlines
+    uint64_t expires = static_cast<uint64_t>(std::max<int64_t>(deadline, 0) + tick_ns_ - 1)
+                       / static_cast<uint64_t>(tick_ns_);
+    entry->expires_ = std::max(expires, now_tick_ + 1);
+    Insert(entry);
+    num_entries_++;
+    UpdateTimeout();
+}
+
+void TimerWheel::ScheduleIn(Entry* entry, absl::Duration d) {
+    Schedule(entry, GetMonotonicNanoTimestamp() + absl::ToInt64Nanoseconds(d));
+}
+
+void TimerWheel::Cancel(Entry* entry) {
+    if (!entry->scheduled()) {
+        return;
+    }
+    Unlink(entry);
+    num_entries_--;
+    UpdateTimeout();
+}
+
+void TimerWheel::Insert(Entry* entry) {
+    DCHECK(!entry->scheduled());
+    DCHECK_GE(entry->expires_, now_tick_);
+    uint64_t delta = entry->expires_ - now_tick_;
+    uint64_t at = entry->expires_;
+    size_t level = 0;
+    while (level + 1 < kLevels && delta >= (uint64_t{1} << (kSlotBits * (level + 1)))) {
+        level++;
+    }
+    if (delta >= (uint64_t{1} << (kSlotBits * kLevels))) {
+        // Beyond the range of the wheel, cascaded again from the last level
+        at = now_tick_ + (uint64_t{1} << (kSlotBits * kLevels)) - 1;
+    }
+    size_t index = (at >> (kSlotBits * level)) & kSlotMask;
+    uint32_t slot = gsl::narrow_cast<uint32_t>(level * kSlotsPerLevel + index);
+    Entry* head = slots_[slot];
+    entry->prev_ = nullptr;
+    entry->next_ = head;
+    if (head != nullptr) {
+        head->prev_ = entry;
+    }
+    slots_[slot] = entry;
+    entry->slot_ = slot;
+    bitmaps_[level] |= uint64_t{1} << index;
+}
+
+void TimerWheel::Unlink(Entry* entry) {
+    DCHECK(entry->scheduled());
+    uint32_t slot = entry->slot_;
+    if (entry->prev_ != nullptr) {
+        entry->prev_->next_ = entry->next_;
+    } else {
+        DCHECK(slots_[slot] == entry);
+        slots_[slot] = entry->next_;
+        if (entry->next_ == nullptr) {
+            bitmaps_[slot / kSlotsPerLevel] &= ~(uint64_t{1} << (slot % kSlotsPerLevel));
+        }
+    }
+    if (entry->next_ != nullptr) {
+        entry->next_->prev_ = entry->prev_;
+    }
+    entry->prev_ = nullptr;
+    entry->next_ = nullptr;
+    entry->slot_ = Entry::kNotScheduled;
+}
+
+void TimerWheel::Cascade(size_t level) {
+    size_t index = (now_tick_ >> (kSlotBits * level)) & kSlotMask;
+    size_t slot = level * kSlotsPerLevel + index;
+    while (slots_[slot] != nullptr) {
+        Entry* entry = slots_[slot];
+        Unlink(entry);
+        Insert(entry);
+    }
+}
+
+void TimerWheel::RunNextTick() {
+    now_tick_++;
+    // Lower levels are cascaded first, as higher ones may refill them
+    for (size_t level = 1; level < kLevels; level++) {
+        if ((now_tick_ & ((uint64_t{1} << (kSlotBits * level)) - 1)) != 0) {
+            break;
+        }
+        Cascade(level);
+    }
+    // Entries scheduled by callbacks never land in the current slot
+    size_t slot = now_tick_ & kSlotMask;
+    while (slots_[slot] != nullptr) {
+        Entry* entry = slots_[slot];
+        DCHECK_EQ(entry->expires_, now_tick_);
+        Unlink(entry);
+        num_entries_--;
+        // The entry may be rescheduled or destroyed by its callback
+        entry->cb_();
+    }
+}
+
+void TimerWheel::Advance(uint64_t tick) {
+    while (now_tick_ < tick) {
+        if (num_entries_ == 0) {
+            now_tick_ = tick;
+            break;
+        }
+        // Skip ticks with nothing to run or cascade
+        uint64_t next = NextEventTick();
+        if (next > now_tick_ + 1) {
+            now_tick_ = std::min(tick, next - 1);
+            continue;
+        }
+        RunNextTick();
+    }
+}
+
+uint64_t TimerWheel::NextEventTick() const {
+    uint64_t next = kNever;
+    for (size_t level = 0; level < kLevels; level++) {
+        uint64_t bitmap = bitmaps_[level];
+        if (bitmap == 0) {
+            continue;
+        }
+        // First non-empty slot after the current one, which is run (level 0)
+        // or cascaded (other levels) when lower bits of the tick become zero
+        size_t shift = kSlotBits * level;
+        uint64_t current = now_tick_ >> shift;
+        size_t rotate = (current + 1) & kSlotMask;
+        uint64_t rotated = rotate == 0 ? bitmap
+                                       : ((bitmap >> rotate) | (bitmap << (kSlotsPerLevel - rotate)));
+        uint64_t distance = static_cast<uint64_t>(__builtin_ctzll(rotated));
+        next = std::min(next, (current + 1 + distance) << shift);
+    }
+    return next;
+}
+
+void TimerWheel::UpdateTimeout() {
+    if (advancing_) {
+        // Updated once Advance finishes
+        return;
+    }
+    uint64_t next = (num_entries_ == 0) ? kNever : NextEventTick();
+    if (timeout_id_ != kInvalidTimeoutId) {
+        if (next >= timeout_tick_ && next != kNever) {
+            // Waking up earlier is fine, the timeout is re-armed on expiry
+            return;
+        }
+        uint64_t timeout_id = timeout_id_;
+        timeout_id_ = kInvalidTimeoutId;
+        timeout_tick_ = kNever;
+        io_uring_->CancelTimeout(timeout_id);
+    }
+    if (next == kNever) {
+        return;
+    }
+    uint64_t seqnum = ++timeout_seqnum_;
+    timeout_tick_ = next;
+    timeout_id_ = io_uring_->Timeout(
+        static_cast<int64_t>(next) * tick_ns_,
+        [this, seqnum] (int status) { OnTimeout(seqnum, status); });
+}
+
+void TimerWheel::OnTimeout(uint64_t seqnum, int status) {
+    if (seqnum != timeout_seqnum_ || timeout_id_ == kInvalidTimeoutId) {
+        // Cancelled in favor of an earlier one
+        return;
+    }
+    if (status != 0) {
+        PLOG(ERROR) << "Timeout of timer wheel failed";
+    }
+    timeout_id_ = kInvalidTimeoutId;
+    timeout_tick_ = kNever;
+    advancing_ = true;
+    Advance(CurrentTick());
+    advancing_ = false;
+    UpdateTimeout();
+}
+
+}  // namespace server
+}  // namespace faas
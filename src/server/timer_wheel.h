@@ -0,0 +1,93 @@
+#pragma once
+
+#include "base/common.h"
+#include "utils/inline_function.h"
+#include "server/io_uring.h"
+
+#include <array>
+
+namespace faas {
+namespace server {
+
+// Hierarchical timer wheel of an IOWorker, driven by a single
+// IORING_OP_TIMEOUT armed for the next tick with work to do.
+// Schedule and Cancel are O(1). Entries run no earlier than their deadlines,
+// and at most one tick (--timer_wheel_tick_us) late.
+// NOT thread-safe, only used within the event loop thread.
+class TimerWheel {
+public:
+    using Callback = utils::InlineFunction<void()>;
+
+    // Owned by the caller, and linked into the wheel while scheduled
+    class Entry {
+    public:
+        explicit Entry(Callback cb);
+        ~Entry();
+
+        bool scheduled() const { return slot_ != kNotScheduled; }
+
+    private:
+        friend class TimerWheel;
+        static constexpr uint32_t kNotScheduled = std::numeric_limits<uint32_t>::max();
+
+        Callback cb_;
+        Entry* prev_;
+        Entry* next_;
+        uint64_t expires_;  // In ticks
+        uint32_t slot_;
+
+        DISALLOW_COPY_AND_ASSIGN(Entry);
+    };
+
+    explicit TimerWheel(IOUring* io_uring);
+    ~TimerWheel();
+
+    size_t size() const { return num_entries_; }
+
+    // `deadline` is a CLOCK_MONOTONIC timestamp in nanoseconds. Scheduling
+    // an entry already scheduled moves it to the new deadline.
+    void Schedule(Entry* entry, int64_t deadline);
+    void ScheduleIn(Entry* entry, absl::Duration d);
+    void Cancel(Entry* entry);
+
+private:
+    static constexpr size_t kLevels = 5;
+    static constexpr size_t kSlotBits = 6;
+    static constexpr size_t kSlotsPerLevel = size_t{1} << kSlotBits;
+    static constexpr uint64_t kSlotMask = kSlotsPerLevel - 1;
+    static constexpr uint64_t kNever = std::numeric_limits<uint64_t>::max();
+    static constexpr uint64_t kInvalidTimeoutId = std::numeric_limits<uint64_t>::max();
+
+    IOUring* io_uring_;
+    const int64_t tick_ns_;
+    uint64_t now_tick_;
+    size_t num_entries_;
+
+    // Slot i of level l holds entries to run (l = 0) or to cascade into lower
+    // levels (l > 0) when bits [6l, 6l + 6) of the current tick become i
+    std::array<Entry*, kLevels * kSlotsPerLevel> slots_;
+    // Non-empty slots of each level
+    std::array<uint64_t, kLevels> bitmaps_;
+
+    bool advancing_;
+    // The armed IORING_OP_TIMEOUT, which expires at `timeout_tick_`
+    uint64_t timeout_id_;
+    uint64_t timeout_tick_;
+    // Tells the armed timeout from cancelled ones
+    uint64_t timeout_seqnum_;
+
+    uint64_t CurrentTick() const;
+    void Insert(Entry* entry);
+    void Unlink(Entry* entry);
+    void Cascade(size_t level);
+    void RunNextTick();
+    void Advance(uint64_t tick);
+    uint64_t NextEventTick() const;
+    void UpdateTimeout();
+    void OnTimeout(uint64_t seqnum, int status);
+
+    DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}  // namespace server
+}  // namespace faas
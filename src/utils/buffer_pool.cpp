@@ -0,0 +1,116 @@
+#include "utils/buffer_pool.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+ABSL_FLAG(size_t, buffer_pool_high_watermark_kb, 32768,
+          "Free buffers of each BufferPool above this size are trimmed when idle, "
+          "0 disables trimming");
+ABSL_FLAG(size_t, buffer_pool_low_watermark_kb, 8192,
+          "Size of free buffers each BufferPool keeps after trimming");
+ABSL_FLAG(int, buffer_pool_numa_node, -1,
+          "Allocate buffers of BufferPool preferably on this NUMA node, -1 for "
+          "the default memory policy");
+
+namespace faas {
+namespace utils {
+
+namespace {
+size_t RoundUp(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+}  // namespace
+
+BufferPool::BufferPool(std::string_view pool_name, size_t buffer_size)
+    : pool_name_(std::string(pool_name)),
+      buffer_size_(buffer_size),
+      numa_node_(-1),
+      mapped_size_(0),
+      in_use_buffers_(0),
+      peak_in_use_buffers_(0),
+      in_use_bytes_gauge_(stat::Gauge::StandardReportCallback(
+          fmt::format("BufferPool[{}] in_use_bytes", pool_name))) {
+    set_watermarks(absl::GetFlag(FLAGS_buffer_pool_low_watermark_kb) << 10,
+                   absl::GetFlag(FLAGS_buffer_pool_high_watermark_kb) << 10);
+    set_numa_node(absl::GetFlag(FLAGS_buffer_pool_numa_node));
+}
+
+BufferPool::~BufferPool() {
+    for (char* buf : all_buffers_) {
+        FreeBuffer(buf);
+    }
+}
+
+void BufferPool::set_watermarks(size_t low_bytes, size_t high_bytes) {
+    CHECK_LE(low_bytes, high_bytes);
+    low_watermark_ = low_bytes;
+    high_watermark_ = high_bytes;
+}
+
+void BufferPool::set_numa_node(int node) {
+    CHECK(all_buffers_.empty());
+    CHECK_GE(node, -1);
+    numa_node_ = node;
+    mapped_size_ = RoundUp(buffer_size_, static_cast<size_t>(getpagesize()));
+}
+
+void BufferPool::AllocateBuffer() {
+    char* buf = NewBuffer();
+    available_buffers_.push_back(buf);
+    all_buffers_.insert(buf);
+    LOG(INFO) << "BufferPool[" << pool_name_ << "]: Allocate new buffer, "
+              << "current buffer count is " << all_buffers_.size();
+}
+
+size_t BufferPool::Trim() {
+    in_use_bytes_gauge_.Set(in_use_bytes(), peak_in_use_bytes());
+    size_t free_bytes = available_buffers_.size() * buffer_size_;
+    if (high_watermark_ == 0 || free_bytes <= high_watermark_) {
+        return 0;
+    }
+    size_t n_keep = low_watermark_ / buffer_size_;
+    size_t n_release = available_buffers_.size() - n_keep;
+    // Buffers are taken from the back, thus ones in the front are cold
+    for (size_t i = 0; i < n_release; i++) {
+        char* buf = available_buffers_[i];
+        all_buffers_.erase(buf);
+        FreeBuffer(buf);
+    }
+    available_buffers_.erase(available_buffers_.begin(),
+                             available_buffers_.begin() + static_cast<ptrdiff_t>(n_release));
+    LOG(INFO) << "BufferPool[" << pool_name_ << "]: Release " << n_release << " buffers, "
+              << "current buffer count is " << all_buffers_.size();
+    return n_release;
+}
+
+char* BufferPool::NewBuffer() {
+    if (!use_mmap()) {
+        return new char[buffer_size_];
+    }
+    void* ptr = mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    PCHECK(ptr != MAP_FAILED) << "Failed to map buffer";
+    // Pages are not touched yet, thus will be faulted on the preferred node
+    unsigned long nodemask[4] = {0};
+    size_t max_node = sizeof(nodemask) * 8;
+    CHECK_LT(static_cast<size_t>(numa_node_), max_node);
+    size_t node = static_cast<size_t>(numa_node_);
+    nodemask[node / 64] = 1UL << (node % 64);
+    if (syscall(SYS_mbind, ptr, mapped_size_, MPOL_PREFERRED,
+                nodemask, max_node, 0) != 0) {
+        PLOG(WARNING) << "mbind failed";
+    }
+    return reinterpret_cast<char*>(ptr);
+}
+
+void BufferPool::FreeBuffer(char* buf) {
+    if (!use_mmap()) {
+        delete[] buf;
+    } else {
+        PCHECK(munmap(buf, mapped_size_) == 0);
+    }
+}
+
+}  // namespace utils
+}  // namespace faas
@@ -5,6 +5,7 @@
 #endif
 
 #include "base/common.h"
+#include "common/stat.h"
 
 namespace faas {
 namespace utils {
@@ -12,23 +13,31 @@ namespace utils {
 // BufferPool is NOT thread-safe
 class BufferPool {
 public:
-    BufferPool(std::string_view pool_name, size_t buffer_size)
-        : pool_name_(std::string(pool_name)), buffer_size_(buffer_size) {}
-    ~BufferPool() {}
+    BufferPool(std::string_view pool_name, size_t buffer_size);
+    ~BufferPool();
 
     size_t buffer_size() const { return buffer_size_; }
+    size_t total_buffers() const { return all_buffers_.size(); }
+    size_t free_buffers() const { return available_buffers_.size(); }
+    size_t allocated_bytes() const { return all_buffers_.size() * buffer_size_; }
+    int64_t in_use_bytes() const { return BuffersToBytes(in_use_buffers_); }
+    int64_t peak_in_use_bytes() const { return BuffersToBytes(peak_in_use_buffers_); }
+
+    // Once free buffers exceed `high_bytes`, Trim releases them down to
+    // `low_bytes`. Trimming is disabled if `high_bytes` is 0.
+    void set_watermarks(size_t low_bytes, size_t high_bytes);
+    // Can only be changed before the first allocation
+    void set_numa_node(int node);
 
     void Get(char** buf, size_t* size) {
-        if (available_buffers_.empty()) {
-            std::unique_ptr<char[]> new_buffer(new char[buffer_size_]);
-            available_buffers_.push_back(new_buffer.get());
-            all_buffers_.push_back(std::move(new_buffer));
-            LOG(INFO) << "BufferPool[" << pool_name_ << "]: Allocate new buffer, "
-                      << "current buffer count is " << all_buffers_.size();
+        if (__FAAS_PREDICT_FALSE(available_buffers_.empty())) {
+            AllocateBuffer();
         }
         *buf = available_buffers_.back();
         available_buffers_.pop_back();
         *size = buffer_size_;
+        in_use_buffers_++;
+        peak_in_use_buffers_ = std::max(peak_in_use_buffers_, in_use_buffers_);
     }
 
     void Get(std::span<char>* buf) {
@@ -39,7 +48,9 @@ public:
     }
 
     void Return(char* buf) {
+        DCHECK_GT(in_use_buffers_, 0U);
         available_buffers_.push_back(buf);
+        in_use_buffers_--;
     }
 
     void Return(std::span<char> buf) {
@@ -47,11 +58,34 @@ public:
         Return(buf.data());
     }
 
+    // Expected to be called when idle. Least recently returned buffers are
+    // released first. Returns the number of released buffers. Also reports
+    // in-use bytes, which are only counted by Get and Return.
+    size_t Trim();
+
 private:
     std::string pool_name_;
     size_t buffer_size_;
+    size_t low_watermark_;
+    size_t high_watermark_;
+    int numa_node_;
+    // Size of mappings, when not allocated from heap
+    size_t mapped_size_;
+
     absl::InlinedVector<char*, 16> available_buffers_;
-    absl::InlinedVector<std::unique_ptr<char[]>, 16> all_buffers_;
+    absl::flat_hash_set<char*> all_buffers_;
+    size_t in_use_buffers_;
+    size_t peak_in_use_buffers_;
+    stat::Gauge in_use_bytes_gauge_;
+
+    bool use_mmap() const { return numa_node_ >= 0; }
+    void AllocateBuffer();
+    char* NewBuffer();
+    void FreeBuffer(char* buf);
+
+    int64_t BuffersToBytes(size_t n) const {
+        return static_cast<int64_t>(n * buffer_size_);
+    }
 
     DISALLOW_COPY_AND_ASSIGN(BufferPool);
 };
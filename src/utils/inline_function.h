@@ -0,0 +1,159 @@
+#pragma once
+
+#include "base/common.h"
+
+namespace faas {
+namespace utils {
+
+// A std::function replacement that keeps callables up to `kInlineSize` bytes
+// within itself, so storing one in a preallocated slot does not allocate.
+// Larger callables fall back to the heap, as std::function does.
+template<class Signature, size_t kInlineSize = 48>
+class InlineFunction;
+
+template<class R, class... Args, size_t kInlineSize>
+class InlineFunction<R(Args...), kInlineSize> {
+public:
+    InlineFunction() : vtable_(nullptr) {}
+    InlineFunction(std::nullptr_t) : vtable_(nullptr) {}
+
+    template<class F,
+             class = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InlineFunction>
+                                      && std::is_invocable_r_v<R, std::decay_t<F>&, Args...>>>
+    InlineFunction(F&& f) : vtable_(nullptr) {
+        Assign(std::forward<F>(f));
+    }
+
+    InlineFunction(const InlineFunction& other) : vtable_(other.vtable_) {
+        if (vtable_ != nullptr) {
+            vtable_->copy(storage_, other.storage_);
+        }
+    }
+
+    InlineFunction(InlineFunction&& other) noexcept : vtable_(other.vtable_) {
+        if (vtable_ != nullptr) {
+            vtable_->move(storage_, other.storage_);
+            other.vtable_ = nullptr;
+        }
+    }
+
+    ~InlineFunction() { Reset(); }
+
+    InlineFunction& operator=(const InlineFunction& other) {
+        if (this != &other) {
+            InlineFunction tmp(other);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
+
+    InlineFunction& operator=(InlineFunction&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            if (other.vtable_ != nullptr) {
+                other.vtable_->move(storage_, other.storage_);
+                vtable_ = other.vtable_;
+                other.vtable_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InlineFunction& operator=(std::nullptr_t) {
+        Reset();
+        return *this;
+    }
+
+    void swap(InlineFunction& other) {
+        InlineFunction tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    explicit operator bool() const { return vtable_ != nullptr; }
+
+    R operator()(Args... args) const {
+        DCHECK(vtable_ != nullptr);
+        return vtable_->invoke(storage_, std::forward<Args>(args)...);
+    }
+
+    // Whether callables of type `F` are kept inline
+    template<class F>
+    static constexpr bool kStoredInline =
+        sizeof(F) <= kInlineSize && alignof(F) <= alignof(std::max_align_t)
+            && std::is_nothrow_move_constructible_v<F>;
+
+private:
+    struct VTable {
+        R (*invoke)(void* storage, Args&&... args);
+        void (*copy)(void* dst, const void* src);
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void* storage);
+    };
+
+    template<class F>
+    struct InlineOps {
+        static F* get(void* storage) { return std::launder(reinterpret_cast<F*>(storage)); }
+        static R invoke(void* storage, Args&&... args) {
+            return std::invoke(*get(storage), std::forward<Args>(args)...);
+        }
+        static void copy(void* dst, const void* src) {
+            new (dst) F(*get(const_cast<void*>(src)));
+        }
+        static void move(void* dst, void* src) {
+            new (dst) F(std::move(*get(src)));
+            get(src)->~F();
+        }
+        static void destroy(void* storage) { get(storage)->~F(); }
+        static constexpr VTable kVTable = { invoke, copy, move, destroy };
+    };
+
+    template<class F>
+    struct HeapOps {
+        static F*& get(void* storage) { return *reinterpret_cast<F**>(storage); }
+        static R invoke(void* storage, Args&&... args) {
+            return std::invoke(*get(storage), std::forward<Args>(args)...);
+        }
+        static void copy(void* dst, const void* src) {
+            *reinterpret_cast<F**>(dst) = new F(*get(const_cast<void*>(src)));
+        }
+        static void move(void* dst, void* src) {
+            *reinterpret_cast<F**>(dst) = get(src);
+            get(src) = nullptr;
+        }
+        static void destroy(void* storage) { delete get(storage); }
+        static constexpr VTable kVTable = { invoke, copy, move, destroy };
+    };
+
+    static_assert(kInlineSize >= sizeof(void*));
+
+    alignas(std::max_align_t) mutable char storage_[kInlineSize];
+    const VTable* vtable_;
+
+    template<class F>
+    void Assign(F&& f) {
+        using Fn = std::decay_t<F>;
+        if constexpr (std::is_pointer_v<Fn> || std::is_member_pointer_v<Fn>) {
+            if (f == nullptr) {
+                return;
+            }
+        }
+        if constexpr (kStoredInline<Fn>) {
+            new (storage_) Fn(std::forward<F>(f));
+            vtable_ = &InlineOps<Fn>::kVTable;
+        } else {
+            *reinterpret_cast<Fn**>(storage_) = new Fn(std::forward<F>(f));
+            vtable_ = &HeapOps<Fn>::kVTable;
+        }
+    }
+
+    void Reset() {
+        if (vtable_ != nullptr) {
+            vtable_->destroy(storage_);
+            vtable_ = nullptr;
+        }
+    }
+};
+
+}  // namespace utils
+}  // namespace faas
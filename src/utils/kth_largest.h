@@ -0,0 +1,86 @@
+#pragma once
+
+#include "base/common.h"
+
+namespace faas {
+namespace utils {
+
+// Tracks the k-th largest value among a small, fixed set of keys,
+// whose values are only allowed to grow. Values are kept sorted, so an
+// update moves one element towards the tail instead of re-sorting.
+template<class K, class V>
+class KthLargestTracker {
+public:
+    explicit KthLargestTracker(size_t k) : k_(k) {}
+    ~KthLargestTracker() {}
+
+    size_t size() const { return sorted_.size(); }
+    bool empty() const { return sorted_.empty(); }
+
+    bool Add(const K& key, const V& value);
+    // Return false if `key` does not exist or `value` is smaller than
+    // the current value of `key`
+    bool Update(const K& key, const V& value);
+
+    std::optional<V> Get(const K& key) const;
+    // Requires size() >= k
+    V kth_largest() const;
+
+private:
+    size_t k_;
+    // Sorted in ascending order of value
+    std::vector<std::pair<V, K>> sorted_;
+
+    DISALLOW_COPY_AND_ASSIGN(KthLargestTracker);
+};
+
+template<class K, class V>
+bool KthLargestTracker<K, V>::Add(const K& key, const V& value) {
+    for (const auto& [v, k] : sorted_) {
+        if (k == key) {
+            return false;
+        }
+    }
+    auto iter = absl::c_upper_bound(
+        sorted_, value,
+        [] (const V& lhs, const std::pair<V, K>& rhs) { return lhs < rhs.first; });
+    sorted_.insert(iter, std::make_pair(value, key));
+    return true;
+}
+
+template<class K, class V>
+bool KthLargestTracker<K, V>::Update(const K& key, const V& value) {
+    size_t idx = 0;
+    while (idx < sorted_.size() && sorted_[idx].second != key) {
+        idx++;
+    }
+    if (idx == sorted_.size() || value < sorted_[idx].first) {
+        return false;
+    }
+    sorted_[idx].first = value;
+    while (idx + 1 < sorted_.size() && sorted_[idx + 1].first < value) {
+        std::swap(sorted_[idx], sorted_[idx + 1]);
+        idx++;
+    }
+    return true;
+}
+
+template<class K, class V>
+std::optional<V> KthLargestTracker<K, V>::Get(const K& key) const {
+    for (const auto& [v, k] : sorted_) {
+        if (k == key) {
+            return v;
+        }
+    }
+    return std::nullopt;
+}
+
+template<class K, class V>
+V KthLargestTracker<K, V>::kth_largest() const {
+    DCHECK_GE(sorted_.size(), k_);
+    DCHECK_GT(k_, 0U);
+    return sorted_[sorted_.size() - k_].first;
+}
+
+}  // namespace utils
+}  // namespace faas
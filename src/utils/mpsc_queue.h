@@ -0,0 +1,96 @@
+#pragma once
+
+#include "base/common.h"
+
+namespace faas {
+namespace utils {
+
+// Bounded lock-free queue for many producers and a single consumer, after
+// Dmitry Vyukov's bounded MPMC queue. Elements live in preallocated cells,
+// thus Push and Pop do not allocate. Push fails when the queue is full.
+template<class T>
+class BoundedMpscQueue {
+public:
+    // `capacity` is rounded up to a power of 2
+    explicit BoundedMpscQueue(size_t capacity);
+    ~BoundedMpscQueue() {}
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Moves from `value` only on success. Thread-safe.
+    bool Push(T& value);
+    // Only called by the consumer thread
+    bool Pop(T* value);
+    // Number of elements pushed but not popped yet, racing with producers.
+    // Only called by the consumer thread.
+    size_t ApproxSize() const {
+        return enqueue_pos_.load(std::memory_order_relaxed) - dequeue_pos_;
+    }
+
+private:
+    struct alignas(__FAAS_CACHE_LINE_SIZE) Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(__FAAS_CACHE_LINE_SIZE) std::atomic<size_t> enqueue_pos_;
+    alignas(__FAAS_CACHE_LINE_SIZE) size_t dequeue_pos_;
+
+    DISALLOW_COPY_AND_ASSIGN(BoundedMpscQueue);
+};
+
+template<class T>
+BoundedMpscQueue<T>::BoundedMpscQueue(size_t capacity)
+    : enqueue_pos_(0), dequeue_pos_(0) {
+    size_t size = 1;
+    while (size < std::max<size_t>(capacity, 2)) {
+        size <<= 1;
+    }
+    mask_ = size - 1;
+    cells_.reset(new Cell[size]);
+    for (size_t i = 0; i < size; i++) {
+        cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+template<class T>
+bool BoundedMpscQueue<T>::Push(T& value) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells_[pos & mask_];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                                   std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+    cell->value = std::move(value);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+template<class T>
+bool BoundedMpscQueue<T>::Pop(T* value) {
+    Cell* cell = &cells_[dequeue_pos_ & mask_];
+    size_t seq = cell->seq.load(std::memory_order_acquire);
+    if (seq != dequeue_pos_ + 1) {
+        return false;
+    }
+    *value = std::move(cell->value);
+    cell->seq.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+    dequeue_pos_++;
+    return true;
+}
+
+}  // namespace utils
+}  // namespace faas
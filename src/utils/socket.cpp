@@ -11,6 +11,7 @@ __END_THIRD_PARTY_HEADERS
 #include "common/flags.h"
 #endif
 
+#include "utils/io.h"
 #include "utils/random.h"
 
 #include <arpa/inet.h>
@@ -161,6 +162,40 @@ int UnixSocketConnect(std::string_view path) {
     return fd;
 }
 
+bool UnixSocketSendFd(int sockfd, int fd, std::span<const char> data) {
+    DCHECK(!data.empty());
+    struct iovec iov;
+    iov.iov_base = const_cast<char*>(data.data());
+    iov.iov_len = data.size();
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    ssize_t ret;
+    do {
+        ret = sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+    } while (ret == -1 && errno == EINTR);
+    if (ret == -1) {
+        PLOG(ERROR) << "sendmsg failed";
+        return false;
+    }
+    // The fd goes with the first byte, so the rest can be sent normally
+    size_t sent = static_cast<size_t>(ret);
+    if (sent < data.size()) {
+        return io_utils::SendData(sockfd, data.data() + sent, data.size() - sent);
+    }
+    return true;
+}
+
 int TcpSocketBindAndListen(std::string_view ip, uint16_t port, int backlog) {
     struct sockaddr_in sockaddr;
     if (!FillTcpSocketAddr(&sockaddr, ip, port)) {
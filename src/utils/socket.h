@@ -13,6 +13,8 @@ bool SocketListen(int sockfd, int backlog);
 // Return sockfd on success, and return -1 on error
 int UnixSocketBindAndListen(std::string_view path, int backlog = 4);
 int UnixSocketConnect(std::string_view path);
+// Send `data` over the Unix socket, together with `fd` as SCM_RIGHTS
+bool UnixSocketSendFd(int sockfd, int fd, std::span<const char> data);
 int TcpSocketBindAndListen(std::string_view ip, uint16_t port, int backlog = 4);
 int TcpSocketConnect(std::string_view ip, uint16_t port);
 int Tcp6SocketBindAndListen(std::string_view ip, uint16_t port, int backlog = 4);
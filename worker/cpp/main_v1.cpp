@@ -20,10 +20,6 @@ void FuncWorkerV1Main(int argc, char* argv[]) {
     auto func_worker = std::make_unique<worker_v1::FuncWorker>();
     func_worker->set_func_id(
         utils::GetEnvVariableAsInt("FAAS_FUNC_ID", -1));
-    func_worker->set_fprocess_id(
-        utils::GetEnvVariableAsInt("FAAS_FPROCESS_ID", -1));
-    func_worker->set_client_id(
-        utils::GetEnvVariableAsInt("FAAS_CLIENT_ID", 0));
     func_worker->set_message_pipe_fd(
         utils::GetEnvVariableAsInt("FAAS_MSG_PIPE_FD", -1));
     if (utils::GetEnvVariableAsInt("FAAS_USE_ENGINE_SOCKET", 0) == 1) {
@@ -32,7 +28,18 @@ void FuncWorkerV1Main(int argc, char* argv[]) {
     func_worker->set_engine_tcp_port(
         utils::GetEnvVariableAsInt("FAAS_ENGINE_TCP_PORT", -1));
     func_worker->set_func_library_path(argv[1]);
-    func_worker->Serve();
+    if (utils::GetEnvVariableAsInt("FAAS_ZYGOTE", 0) == 1) {
+        // fprocess_id and client_id of forked workers come with fork requests
+        func_worker->set_fork_output_prefix(
+            utils::GetEnvVariable("FAAS_FORK_OUTPUT_PREFIX", ""));
+        func_worker->ServeAsZygote();
+    } else {
+        func_worker->set_fprocess_id(
+            utils::GetEnvVariableAsInt("FAAS_FPROCESS_ID", -1));
+        func_worker->set_client_id(
+            utils::GetEnvVariableAsInt("FAAS_CLIENT_ID", 0));
+        func_worker->Serve();
+    }
 }
 
 }  // namespace faas
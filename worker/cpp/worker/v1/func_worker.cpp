@@ -4,12 +4,19 @@
 #include "common/time.h"
 #include "ipc/base.h"
 #include "ipc/fifo.h"
+#include "utils/fs.h"
 #include "utils/io.h"
 #include "utils/socket.h"
 #include "utils/env_variables.h"
 #include "worker/worker_lib.h"
 
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
 
 namespace faas {
 namespace worker_v1 {
@@ -62,11 +69,108 @@ private:
     DISALLOW_COPY_AND_ASSIGN(DynamicLibrary);
 };
 
+// Exited workers stay zombies until reaped, for at most this long
+static constexpr int kZygoteReapIntervalMs = 1000;
+
+static size_t NumThreads() {
+    std::string status;
+    CHECK(fs_utils::ReadContents("/proc/self/status", &status));
+    size_t pos = status.find("\nThreads:");
+    CHECK(pos != std::string::npos);
+    return strtoul(status.c_str() + pos + strlen("\nThreads:"), nullptr, 10);
+}
+
 void FuncWorker::Serve() {
+    Initialize();
+    ConnectAndServe();
+}
+
+void FuncWorker::ServeAsZygote() {
+    Initialize();
+    LOG(INFO) << "Zygote initialized";
+    // Forked workers are reaped here, instead of by the kernel, so that a
+    // pid stays valid for KILL requests until it is removed
+    std::unordered_map</* pid */ pid_t, /* fprocess_id */ int> forked_workers;
+    pid_t zygote_pid = getpid();
+    while (true) {
+        pid_t exited_pid;
+        while ((exited_pid = waitpid(-1, nullptr, WNOHANG)) > 0) {
+            forked_workers.erase(exited_pid);
+        }
+        struct pollfd pfd = { .fd = message_pipe_fd_, .events = POLLIN, .revents = 0 };
+        int ret = poll(&pfd, 1, kZygoteReapIntervalMs);
+        if (ret == 0 || (ret == -1 && errno == EINTR)) {
+            continue;
+        }
+        PCHECK(ret > 0) << "poll failed";
+        protocol::ZygoteRequest request;
+        bool eof = false;
+        if (!io_utils::RecvMessage(message_pipe_fd_, &request, &eof)) {
+            if (eof) {
+                LOG(INFO) << "Launcher closed the message pipe";
+                return;
+            }
+            PLOG(FATAL) << "Failed to receive request from launcher";
+        }
+        if (request.type == protocol::ZygoteRequestType::KILL) {
+            auto iter = forked_workers.find(request.pid);
+            if (iter != forked_workers.end() && iter->second == request.fprocess_id) {
+                PCHECK(kill(request.pid, SIGKILL) == 0);
+            }
+            continue;
+        }
+        CHECK(request.type == protocol::ZygoteRequestType::FORK);
+        protocol::ZygoteForkResponse response = {
+            .fprocess_id = request.fprocess_id,
+            .pid = -1
+        };
+        int fds[2] = {-1, -1};
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+            PLOG(ERROR) << "socketpair failed";
+            PCHECK(io_utils::SendMessage(message_pipe_fd_, response));
+            continue;
+        }
+        // Only the forking thread exists in the child, while locks held by
+        // other threads would stay locked forever
+        CHECK_EQ(NumThreads(), 1U) << "Zygote must be single-threaded to fork";
+        pid_t pid = fork();
+        if (pid == 0) {
+            // Killed along with the zygote, which the launcher kills when
+            // stopping, so that no worker is left behind
+            PCHECK(prctl(PR_SET_PDEATHSIG, SIGKILL) == 0);
+            if (getppid() != zygote_pid) {
+                _exit(EXIT_FAILURE);
+            }
+            // fds[1] becomes the message pipe of the new worker, which the
+            // launcher watches for its exit
+            PCHECK(close(message_pipe_fd_) == 0);
+            PCHECK(close(fds[0]) == 0);
+            set_fprocess_id(request.fprocess_id);
+            RedirectForkedOutputs();
+            set_client_id(request.client_id);
+            set_message_pipe_fd(fds[1]);
+            ConnectAndServe();
+            return;
+        }
+        PCHECK(close(fds[1]) == 0);
+        if (pid == -1) {
+            PLOG(ERROR) << "fork failed";
+            PCHECK(io_utils::SendMessage(message_pipe_fd_, response));
+        } else {
+            forked_workers[pid] = request.fprocess_id;
+            response.pid = pid;
+            CHECK(utils::UnixSocketSendFd(
+                message_pipe_fd_, fds[0],
+                std::span<const char>(reinterpret_cast<const char*>(&response),
+                                      sizeof(response))))
+                << "Failed to send fork response to launcher";
+        }
+        PCHECK(close(fds[0]) == 0);
+    }
+}
+
+void FuncWorker::Initialize() {
     CHECK(func_id_ != -1);
-    CHECK(fprocess_id_ != -1);
-    CHECK(client_id_ > 0);
-    LOG(INFO) << "My client_id is " << client_id_;
     // Load function library
     CHECK(!func_library_path_.empty());
     func_library_ = DynamicLibrary::Create(func_library_path_);
@@ -89,6 +193,29 @@ void FuncWorker::Serve() {
         << "Failed to receive payload data from launcher";
     CHECK(func_config_.Load(std::string_view(payload, payload_size)))
         << "Failed to load function configs from payload";
+}
+
+void FuncWorker::RedirectForkedOutputs() {
+    if (fork_output_prefix_.empty()) {
+        return;
+    }
+    // Named as outputs of spawned func workers
+    std::string path_prefix = fork_output_prefix_ + std::to_string(fprocess_id_)
+                              + "." + std::to_string(GetMonotonicMicroTimestamp());
+    for (const auto& [fd, suffix] : { std::make_pair(STDOUT_FILENO, ".stdout"),
+                                      std::make_pair(STDERR_FILENO, ".stderr") }) {
+        std::string path = path_prefix + suffix;
+        int file_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        PCHECK(file_fd != -1) << "Failed to open " << path;
+        PCHECK(dup2(file_fd, fd) == fd);
+        PCHECK(close(file_fd) == 0);
+    }
+}
+
+void FuncWorker::ConnectAndServe() {
+    CHECK(fprocess_id_ != -1);
+    CHECK(client_id_ > 0);
+    LOG(INFO) << "My client_id is " << client_id_;
     // Connect to engine via IPC path
     if (engine_tcp_port_ == -1) {
         engine_sock_fd_ = utils::UnixSocketConnect(ipc::GetEngineUnixSocketPath());
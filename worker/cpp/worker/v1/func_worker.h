@@ -26,8 +26,16 @@ public:
     }
     void enable_use_engine_socket() { use_engine_socket_ = true; }
     void set_engine_tcp_port(int port) { engine_tcp_port_ = port; }
+    // Forked workers write stdout and stderr to files starting with this
+    // prefix and their fprocess_id, if not empty
+    void set_fork_output_prefix(std::string_view prefix) {
+        fork_output_prefix_ = std::string(prefix);
+    }
 
     void Serve();
+    // Load and initialize the function library, then fork func workers
+    // on requests from the launcher
+    void ServeAsZygote();
 
 private:
     int func_id_;
@@ -37,6 +45,7 @@ private:
     std::string func_library_path_;
     bool use_engine_socket_;
     int engine_tcp_port_;
+    std::string fork_output_prefix_;
     bool use_fifo_for_nested_call_;
     int func_call_timeout_ms_;
 
@@ -70,6 +79,9 @@ private:
     std::atomic<uint32_t> next_call_id_;
     std::atomic<uint64_t> current_func_call_id_;
 
+    void Initialize();
+    void RedirectForkedOutputs();
+    void ConnectAndServe();
     void MainServingLoop();
     void HandshakeWithEngine();
 
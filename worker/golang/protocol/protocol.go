@@ -60,6 +60,8 @@ const (
 	SharedLogOpType_CC_TXN_COMMIT uint16 = 0x08
 	SharedLogOpType_CC_TXN_WRITE  uint16 = 0x09
 	SharedLogOpType_OVERWRITE     uint16 = 0x0a
+	// conflict check of txn commits
+	SharedLogOpType_CHECK_CONFLICT uint16 = 0x0b
 )
 
 // SharedLogResultType enum
@@ -71,6 +73,8 @@ const (
 	SharedLogResultType_TRIM_OK    uint16 = 0x22
 	SharedLogResultType_LOCALID    uint16 = 0x23
 	SharedLogResultType_AUXDATA_OK uint16 = 0x24
+	// SharedLogResultType_REPLICATE_OK = 0x25
+	SharedLogResultType_CHECK_CONFLICT_OK uint16 = 0x26
 	// Error results
 	SharedLogResultType_BAD_ARGS    uint16 = 0x30
 	SharedLogResultType_DISCARDED   uint16 = 0x31
@@ -78,6 +82,7 @@ const (
 	SharedLogResultType_DATA_LOST   uint16 = 0x33
 	SharedLogResultType_TRIM_FAILED uint16 = 0x34
 	SharedLogResultType_COND_FAILED uint16 = 0x35
+	SharedLogResultType_UNSUPPORTED uint16 = 0x36
 )
 
 const MaxLogSeqnum = uint64(0xffff000000000000)
@@ -316,6 +321,20 @@ func NewSharedLogSetAuxDataMessage(currentCallId uint64, myClientId uint16, seqN
 	return buffer
 }
 
+// Tags are placed in inline data, as in append messages
+func NewSharedLogCheckConflictMessage(currentCallId uint64, myClientId uint16, numTags uint16, fromSeqNum uint64, toSeqNum uint64, clientData uint64) []byte {
+	buffer := NewEmptyMessage()
+	tmp := (currentCallId << MessageTypeBits) + uint64(MessageType_SHARED_LOG_OP)
+	binary.LittleEndian.PutUint64(buffer[0:8], tmp)
+	binary.LittleEndian.PutUint16(buffer[32:34], SharedLogOpType_CHECK_CONFLICT)
+	binary.LittleEndian.PutUint16(buffer[34:36], myClientId)
+	binary.LittleEndian.PutUint16(buffer[36:38], numTags)
+	binary.LittleEndian.PutUint64(buffer[40:48], fromSeqNum)
+	binary.LittleEndian.PutUint64(buffer[48:56], clientData)
+	binary.LittleEndian.PutUint64(buffer[8:16], toSeqNum)
+	return buffer
+}
+
 func GetClientIdFromMessage(buffer []byte) uint16 {
 	return GetFuncCallFromMessage(buffer).ClientId
 }
@@ -43,6 +43,9 @@ type Environment interface {
 	SharedLogConditionalAppend(ctx context.Context, tags []uint64, data []byte, condTag uint64, condPos uint32) ( /* seqnum */ uint64, error)
 	// Overwrite a log entry, used for callee to write to a position specified by the caller
 	SharedLogOverwrite(ctx context.Context, tag uint64, pos uint32, data []byte) error
+	// Find seqnums (in descending order) of logs with any of `tags` within [fromSeqNum, toSeqNum)
+	// Returns false if the engine cannot answer, then callers should read logs instead
+	SharedLogCheckConflict(ctx context.Context, tags []uint64, fromSeqNum uint64, toSeqNum uint64) ([]uint64, bool, error)
 }
 
 type FuncHandler interface {
@@ -963,6 +963,54 @@ func (w *FuncWorker) SharedLogReadPrev(ctx context.Context, tag uint64, seqNum u
 // 	}
 // }
 
+// Implement types.Environment
+func (w *FuncWorker) SharedLogCheckConflict(ctx context.Context, tags []uint64, fromSeqNum uint64, toSeqNum uint64) ([]uint64, bool, error) {
+	tags, err := checkAndDuplicateTags(tags)
+	if err != nil {
+		return nil, false, err
+	}
+	if len(tags) == 0 || fromSeqNum >= toSeqNum {
+		return nil, true, nil
+	}
+	if len(tags)*protocol.SharedLogTagByteSize > protocol.MessageInlineDataSize {
+		return nil, false, nil
+	}
+
+	id := atomic.AddUint64(&w.nextLogOpId, 1)
+	currentCallId := atomic.LoadUint64(&w.currentCall)
+	message := protocol.NewSharedLogCheckConflictMessage(currentCallId, w.clientId, uint16(len(tags)), fromSeqNum, toSeqNum, id)
+	protocol.FillInlineDataInMessage(message, protocol.BuildLogTagsBuffer(tags))
+
+	w.mux.Lock()
+	outputChan := make(chan []byte, 1)
+	w.outgoingLogOps[id] = outputChan
+	_, err = w.outputPipe.Write(message)
+	w.mux.Unlock()
+	if err != nil {
+		return nil, false, err
+	}
+
+	var response []byte
+	select {
+	case <-ctx.Done():
+		return nil, false, ctx.Err()
+	case response = <-outputChan:
+	}
+	result := protocol.GetSharedLogResultTypeFromMessage(response)
+	if result == protocol.SharedLogResultType_CHECK_CONFLICT_OK {
+		inlineData := protocol.GetInlineDataFromMessage(response)
+		seqNums := make([]uint64, len(inlineData)/protocol.SharedLogTagByteSize)
+		for i := range seqNums {
+			seqNums[i] = binary.LittleEndian.Uint64(inlineData[i*protocol.SharedLogTagByteSize:])
+		}
+		return seqNums, true, nil
+	} else if result == protocol.SharedLogResultType_UNSUPPORTED {
+		return nil, false, nil
+	} else {
+		return nil, false, fmt.Errorf("Failed to check conflicts in [%#016x, %#016x)", fromSeqNum, toSeqNum)
+	}
+}
+
 // Implement types.Environment
 func (w *FuncWorker) SharedLogCheckTail(ctx context.Context, tag uint64) (*types.LogEntry, error) {
 	return w.SharedLogReadPrev(ctx, tag, protocol.MaxLogSeqnum)